@@ -2,7 +2,7 @@
  * cppcmb.hpp
  *
  * This file has been merged from multiple source files.
- * Generation date: 2019-04-30 21:05:50.808514
+ * Generation date: 2026-10-19 03:07:08.904017
  *
  * Copyright (c) 2018-2019 Peter Lenkefi
  * Distributed under the MIT License.
@@ -14,16 +14,32 @@
 #ifndef CPPCMB_HPP
 #define CPPCMB_HPP
 
+#include <algorithm>
 #include <any>
+#include <array>
+#include <bitset>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <deque>
+#include <functional>
+#include <istream>
 #include <iterator>
+#include <limits>
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
+#include <ostream>
+#include <set>
+#include <string>
 #include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -33,2808 +49,11466 @@
 namespace cppcmb {
 namespace detail {
 
-template <typename Self>
-class crtp {
-public:
-    using self_type = Self;
-
-    [[nodiscard]]
-    constexpr self_type& self() & noexcept {
-        return static_cast<self_type&>(*this);
-    }
-
-    [[nodiscard]]
-    constexpr self_type const& self() const& noexcept {
-        return static_cast<self_type const&>(*this);
-    }
-};
-
-} /* namespace detail */
-} /* namespace cppcmb */
+inline constexpr std::size_t swar_width = sizeof(std::uint64_t);
 
-namespace cppcmb {
-namespace detail {
+inline constexpr std::uint64_t swar_ones = 0x0101010101010101U;
+inline constexpr std::uint64_t swar_highs = 0x8080808080808080U;
 
 /**
- * @see https://en.cppreference.com/w/cpp/experimental/nonesuch
+ * Loads 8 bytes from an arbitrarily aligned address.
  */
-struct nonesuch { // NOLINT(cppcoreguidelines-special-member-functions)
-    ~nonesuch()                     = delete;
-    nonesuch(nonesuch const&)       = delete;
-    void operator=(nonesuch const&) = delete;
-};
+template <typename CharT>
+[[nodiscard]] inline std::uint64_t swar_load(CharT const* p) noexcept {
+    static_assert(sizeof(CharT) == 1, "SWAR loads only work on bytes!");
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
 
 /**
- * @see https://en.cppreference.com/w/cpp/experimental/is_detected
+ * Broadcasts a byte to every lane of the word.
  */
-template <typename Default, typename AlwaysVoid,
-    template <typename...> typename Op, typename... Args>
-struct detector {
-    using value_t = std::false_type;
-    using type = Default;
-};
-
-template <typename Default,
-    template <typename...> typename Op, typename... Args>
-struct detector<Default, std::void_t<Op<Args...>>, Op, Args...> {
-    using value_t = std::true_type;
-    using type = Op<Args...>;
-};
-
-template <template <typename...> typename Op, typename... Args>
-using is_detected = typename detector<nonesuch, void, Op, Args...>::value_t;
-
-template <template <typename...> typename Op, typename... Args>
-using detected_t = typename detector<nonesuch, void, Op, Args...>::type;
-
-template <typename Default,
-    template <typename...> typename Op, typename... Args>
-using detected_or = detector<Default, void, Op, Args...>;
-
-// Additional utilities
-
-template <template <typename...> typename Op, typename... Args>
-inline constexpr auto is_detected_v = is_detected<Op, Args...>::value;
-
-template <typename Default,
-    template <typename...> typename Op, typename... Args>
-using detected_or_t = typename detected_or<Default, Op, Args...>::type;
-
-template <typename Expected,
-    template <typename...> typename Op, typename... Args>
-using is_detected_exact = std::is_same<Expected, detected_t<Op, Args...>>;
-
-template <typename Expected,
-    template <typename...> typename Op, typename... Args>
-inline constexpr auto is_detected_exact_v =
-    is_detected_exact<Expected, Op, Args...>::value;
-
-template <typename To, template <typename...> typename Op, typename... Args>
-using is_detected_convertible =
-    std::is_convertible<detected_t<Op, Args...>, To>;
-
-template <typename To, template <typename...> typename Op, typename... Args>
-inline constexpr auto is_detected_convertible_v =
-    is_detected_convertible<To, Op, Args...>::value;
-
-} /* namespace detail */
-} /* namespace cppcmb */
-
-namespace cppcmb {
-namespace detail {
-
-template <typename, template <typename...> typename>
-struct is_specialization : std::false_type {};
-
-template <template <typename...> typename T, typename... Ts>
-struct is_specialization<T<Ts...>, T> : std::true_type {};
-
-template <typename T, template <typename...> typename Templ>
-inline constexpr bool is_specialization_v = is_specialization<T, Templ>::value;
-
-} /* namespace detail */
-} /* namespace cppcmb */
-
-namespace cppcmb {
-namespace detail {
-
-template <typename T>
-struct remove_cvref : std::remove_cv<std::remove_reference_t<T>> {};
-
-template <typename T>
-using remove_cvref_t = typename remove_cvref<T>::type;
-
-} /* namespace detail */
-} /* namespace cppcmb */
-
-namespace cppcmb {
-namespace detail {
+[[nodiscard]] constexpr std::uint64_t swar_broadcast(unsigned char b) noexcept {
+    return swar_ones * b;
+}
 
 /**
- * Assertion with a custom message.
+ * True, if every byte of the word is 7-bit ASCII.
  */
-#define cppcmb_assert(msg, ...) assert(((void)msg, (__VA_ARGS__)))
+[[nodiscard]] constexpr bool swar_is_ascii(std::uint64_t word) noexcept {
+    return (word & swar_highs) == 0;
+}
 
 /**
- * Panic (assertion failure) with a custom message.
+ * Converts every ASCII upper-case letter in the word to lower-case, leaving
+ * every other byte untouched.
  */
-#define cppcmb_panic(msg) cppcmb_assert(msg, false)
+[[nodiscard]] constexpr std::uint64_t swar_to_lower(std::uint64_t word)
+    noexcept {
+    // Only look at the low 7 bits, so the additions can't carry between lanes
+    auto low7 = word & ~swar_highs;
+    // The high bit of the lanes is set where the byte is >= 'A' and > 'Z'
+    auto ge_a = low7 + swar_broadcast(0x80 - 'A');
+    auto gt_z = low7 + swar_broadcast(0x80 - 'Z' - 1);
+    auto is_upper = (ge_a ^ gt_z) & ~word & swar_highs;
+    // 0x80 >> 2 is 0x20, the ASCII case bit
+    return word | (is_upper >> 2);
+}
 
 /**
- * Concatenates two tokens.
+ * Returns a word, where the high bit of lane i is set if byte i of the word is
+ * in [lo; hi]. Every other bit is zero. Only works on 7-bit ASCII words and
+ * bounds.
  */
-#define cppcmb_cat(x, y) cppcmb_prelude_cat(x, y)
+[[nodiscard]] constexpr std::uint64_t swar_in_range(std::uint64_t word,
+    unsigned char lo, unsigned char hi) noexcept {
+    // Like in swar_to_lower, the high bit of the lanes is set where the byte
+    // is >= lo and > hi, the additions can't carry between lanes
+    auto ge_lo = word + swar_broadcast(static_cast<unsigned char>(0x80 - lo));
+    auto gt_hi = word + swar_broadcast(
+        static_cast<unsigned char>(0x80 - hi - 1)
+    );
+    return ge_lo & ~gt_hi & swar_highs;
+}
 
 /**
- * Generates a unique identifier with a given prefix.
+ * Returns a word, where the high bit of lane i is set if byte i of the word
+ * equals b. Every other bit is zero.
  */
-#define cppcmb_unique_id(prefix) cppcmb_cat(prefix, __LINE__)
+[[nodiscard]] constexpr std::uint64_t swar_eq_lanes(std::uint64_t word,
+    unsigned char b) noexcept {
+    auto x = word ^ swar_broadcast(b);
+    // The high bit of every lane is set where the lane is zero
+    auto low7 = ~swar_highs;
+    return ~(((x & low7) + low7) | x) & swar_highs;
+}
 
 /**
- * Simplifies forwarding syntax, we don't have to provide the template argument.
+ * Gathers the high bits of the lanes into a byte, bit i from lane i.
  */
-#define cppcmb_fwd(...) ::std::forward<decltype(__VA_ARGS__)>(__VA_ARGS__)
+[[nodiscard]] constexpr unsigned swar_gather_highs(std::uint64_t highs)
+    noexcept {
+    // Gather the high bits into the top byte
+    return unsigned((((highs & swar_highs) >> 7) * 0x0102040810204080U) >> 56);
+}
 
 /**
- * A simple concept emulation macro. Does SFINAE in a safe way.
+ * Returns a byte, where bit i is set if byte i of the word equals b.
  */
-#define cppcmb_requires_t(...) \
-cppcmb_prelude_requires_t1(cppcmb_unique_id(cppcmb_concept_req), __VA_ARGS__)
+[[nodiscard]] constexpr unsigned swar_eq_bits(std::uint64_t word,
+    unsigned char b) noexcept {
+    return swar_gather_highs(swar_eq_lanes(word, b));
+}
 
 /**
- * Generates an is_self_v template variable so the types won't get littered with
- * the same self-check code.
+ * Number of set bits.
  */
-#define cppcmb_self_check(type) \
-cppcmb_prelude_self_check(type, cppcmb_unique_id(cppcmb_self_type))
+[[nodiscard]] constexpr unsigned bit_count(std::uint64_t x) noexcept {
+    x = x - ((x >> 1) & 0x5555555555555555U);
+    x = (x & 0x3333333333333333U) + ((x >> 2) & 0x3333333333333333U);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FU;
+    return unsigned((x * swar_ones) >> 56);
+}
 
 /**
- * Generates specialization-check for a template-type.
+ * Index of the lowest set bit. x must not be 0.
  */
-#define cppcmb_is_specialization(type) \
-cppcmb_prelude_is_specialization(type, cppcmb_unique_id(cppcmb_tspec_type))
+[[nodiscard]] constexpr unsigned bit_ctz(std::uint64_t x) noexcept {
+    // The isolated lowest bit times a de Bruijn sequence has a distinct top
+    // 6 bits for every bit index
+    constexpr unsigned char index[64] = {
+         0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6,
+    };
+    return index[((x & (~x + 1)) * 0x03F79D71B4CB0A89U) >> 58];
+}
 
 /**
- * Generates a getter with all member-qualifiers for owned values.
+ * Bit i of the result is the XOR of bits 0..i of x.
  */
-#define cppcmb_getter(name, ...)                                        \
-[[nodiscard]]                                                           \
-constexpr auto& name() & noexcept(noexcept(__VA_ARGS__)) {              \
-    return __VA_ARGS__;                                                 \
-}                                                                       \
-[[nodiscard]]                                                           \
-constexpr auto const& name() const& noexcept(noexcept(__VA_ARGS__)) {   \
-    return __VA_ARGS__;                                                 \
-}                                                                       \
-[[nodiscard]]                                                           \
-constexpr auto&& name() && noexcept(noexcept(__VA_ARGS__)) {            \
-    return std::move(__VA_ARGS__);                                      \
-}                                                                       \
-[[nodiscard]]                                                           \
-constexpr auto const&& name() const&& noexcept(noexcept(__VA_ARGS__)) { \
-    return std::move(__VA_ARGS__);                                      \
+[[nodiscard]] constexpr std::uint64_t prefix_xor(std::uint64_t x) noexcept {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
 }
 
 /**
- * Returns an expression with automatic noexcept qualifier. Only for computed,
- * non-owned values.
+ * The length of the common prefix of [a; a + n) and [b; b + n). Bytes are
+ * compared a word at a time, only the first differing word byte by byte.
  */
-// XXX(LPeter1997): GCC internal compiler error
-/*
-#define cppcmb_return(...)                               \
-noexcept(noexcept(__VA_ARGS__)) -> decltype(__VA_ARGS__) \
-{ return __VA_ARGS__; }
-*/
-#define cppcmb_return(...) -> decltype(auto) { return __VA_ARGS__; }
-
-// Macro details
-
-#define cppcmb_prelude_cat(x, y) x ## y
-
-#define cppcmb_prelude_requires_t1(id, ...) 						\
-bool id = false,                                                    \
-::std::enable_if_t<id || (__VA_ARGS__), ::std::nullptr_t> = nullptr
-
-#define cppcmb_prelude_self_check(type, id)                      \
-template <typename id>                                           \
-static constexpr bool is_self_v =                                \
-    ::std::is_same_v<::cppcmb::detail::remove_cvref_t<id>, type>
+template <typename CharT>
+[[nodiscard]] inline std::size_t common_prefix(CharT const* a,
+    CharT const* b, std::size_t n) noexcept {
+    std::size_t i = 0;
+    if constexpr (sizeof(CharT) == 1) {
+        while (i + swar_width <= n && swar_load(a + i) == swar_load(b + i)) {
+            i += swar_width;
+        }
+    }
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
 
-#define cppcmb_prelude_is_specialization(type, id)               \
-template <typename id>                                           \
-using is_##type = ::cppcmb::detail::is_specialization<id, type>; \
-template <typename id>                                           \
-inline constexpr bool is_##type##_v = is_##type<id>::value
+/**
+ * The length of the common suffix of [a_end - n; a_end) and
+ * [b_end - n; b_end), like common_prefix, but backwards.
+ */
+template <typename CharT>
+[[nodiscard]] inline std::size_t common_suffix(CharT const* a_end,
+    CharT const* b_end, std::size_t n) noexcept {
+    std::size_t i = 0;
+    if constexpr (sizeof(CharT) == 1) {
+        while (i + swar_width <= n
+            && swar_load(a_end - i - swar_width)
+            == swar_load(b_end - i - swar_width)) {
+            i += swar_width;
+        }
+    }
+    while (i < n && a_end[-std::ptrdiff_t(i) - 1]
+        == b_end[-std::ptrdiff_t(i) - 1]) {
+        ++i;
+    }
+    return i;
+}
 
 } /* namespace detail */
 } /* namespace cppcmb */
 
 namespace cppcmb {
+namespace detail {
 
-template <typename... Ts>
-class product {
-private:
-    using tuple_type = decltype(std::make_tuple(std::declval<Ts>()...));
-
-    cppcmb_self_check(product);
+inline constexpr std::size_t block_width = 64;
 
-    tuple_type m_Value;
+/**
+ * A block of input. The last block of the input is copied into a zero-padded
+ * buffer, valid() tells which bytes are part of the input.
+ */
+class byte_block {
+private:
+    unsigned char const* m_Data;
+    std::size_t          m_Length;
+    unsigned char        m_Padded[block_width];
 
 public:
-    static constexpr auto index_sequence =
-        std::make_index_sequence<sizeof...(Ts)>();
-
-    template <typename T,
-        cppcmb_requires_t(sizeof...(Ts) == 1 && !is_self_v<T>)>
-    constexpr product(T&& val)
-        noexcept(std::is_nothrow_constructible_v<tuple_type, T&&>)
-        : m_Value(cppcmb_fwd(val)) {
+    byte_block(unsigned char const* data, std::size_t len) noexcept
+        : m_Data(data), m_Length(len < block_width ? len : block_width) {
+        if (len < block_width) {
+            std::memset(m_Padded, 0, block_width);
+            std::memcpy(m_Padded, data, len);
+            m_Data = m_Padded;
+        }
     }
 
-    template <typename... Us, cppcmb_requires_t(sizeof...(Us) != 1)>
-    constexpr product(Us&&... vals)
-        noexcept(std::is_nothrow_constructible_v<tuple_type, Us&&...>)
-        : m_Value(cppcmb_fwd(vals)...) {
-    }
+    byte_block(byte_block const&) = delete;
+    byte_block& operator=(byte_block const&) = delete;
 
-    template <std::size_t Idx>
-    [[nodiscard]] constexpr auto& get() & noexcept {
-        return std::get<Idx>(m_Value);
-    }
-    template <std::size_t Idx>
-    [[nodiscard]] constexpr auto const& get() const& noexcept {
-        return std::get<Idx>(m_Value);
+    [[nodiscard]] std::size_t length() const noexcept {
+        return m_Length;
     }
-    template <std::size_t Idx>
-    [[nodiscard]] constexpr auto&& get() && noexcept {
-        return std::get<Idx>(std::move(m_Value));
+
+    [[nodiscard]] std::uint64_t valid() const noexcept {
+        return m_Length == block_width
+            ? ~std::uint64_t(0)
+            : (std::uint64_t(1) << m_Length) - 1;
     }
-    template <std::size_t Idx>
-    [[nodiscard]] constexpr auto const&& get() const&& noexcept {
-        return std::get<Idx>(std::move(m_Value));
+
+    /**
+     * The mask of the bytes equal to c.
+     */
+    [[nodiscard]] std::uint64_t eq(unsigned char c) const noexcept {
+        std::uint64_t mask = 0;
+        for (std::size_t i = 0; i < block_width / swar_width; ++i) {
+            auto word = swar_load(m_Data + i * swar_width);
+            mask |= std::uint64_t(swar_eq_bits(word, c)) << (i * swar_width);
+        }
+        return mask & valid();
     }
 
-    cppcmb_getter(as_tuple, m_Value)
+    /**
+     * The mask of the bytes equal to any of the n bytes of set.
+     */
+    [[nodiscard]] std::uint64_t eq_any(unsigned char const* set,
+        std::size_t n) const noexcept {
+        std::uint64_t mask = 0;
+        for (std::size_t i = 0; i < block_width / swar_width; ++i) {
+            auto word = swar_load(m_Data + i * swar_width);
+            std::uint64_t lanes = 0;
+            for (std::size_t j = 0; j < n; ++j) {
+                lanes |= swar_eq_lanes(word, set[j]);
+            }
+            mask |= std::uint64_t(swar_gather_highs(lanes)) << (i * swar_width);
+        }
+        return mask & valid();
+    }
 };
 
-template <typename... Ts>
-product(Ts...) -> product<Ts...>;
+/**
+ * Finds the escaped characters, given the masks of escape characters of
+ * consecutive blocks. An escaped escape character is not reported, only the
+ * characters after odd-length runs of escape characters.
+ */
+class escape_scanner {
+private:
+    static constexpr std::uint64_t even_bits = 0x5555555555555555U;
+    static constexpr std::uint64_t odd_bits = ~even_bits;
 
-// To fix a GCC bug
-template <typename T, typename... Ts>
-product(T, Ts...) -> product<T, Ts...>;
+    // 1, if the first character of the next block is escaped
+    std::uint64_t m_Carry = 0;
+
+public:
+    [[nodiscard]] std::uint64_t next(std::uint64_t esc) noexcept {
+        auto start_edges = esc & ~(esc << 1);
+        // A run that continues from the previous block starts "one earlier"
+        auto even_start_mask = even_bits ^ m_Carry;
+        auto even_starts = start_edges & even_start_mask;
+        auto odd_starts = start_edges & ~even_start_mask;
+
+        auto even_carries = esc + even_starts;
+        auto odd_carries = esc + odd_starts;
+        auto overflow = odd_carries < esc;
+        odd_carries |= m_Carry;
+        m_Carry = overflow ? 1 : 0;
+
+        auto even_carry_ends = even_carries & ~esc;
+        auto odd_carry_ends = odd_carries & ~esc;
+        return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+    }
+};
 
 /**
- * Make products comparable.
+ * Finds the quoted regions, given the masks of unescaped quotes of
+ * consecutive blocks. The opening quote is part of the region, the closing
+ * one is not.
  */
-template <typename... Ts, typename... Us>
-[[nodiscard]] constexpr auto operator==(
-    product<Ts...> const& l,
-    product<Us...> const& r
-) cppcmb_return(l.as_tuple() == r.as_tuple())
-
-template <typename... Ts, typename... Us>
-[[nodiscard]] constexpr auto operator!=(
-    product<Ts...> const& l,
-    product<Us...> const& r
-) cppcmb_return(l.as_tuple() != r.as_tuple())
-
-namespace detail {
-
-cppcmb_is_specialization(product);
-
-// Base-case for sizeof...(Ts) != 1
-template <typename... Ts>
-[[nodiscard]]
-constexpr auto product_values_impl(product<Ts...>&& res) noexcept {
-    // XXX(LPeter1997): Is this right?
-    // XXX(LPeter1997): Is the noexcept specifier right?
-    return std::move(res);
-}
-
-// Base-case for exactly one element
-// XXX(LPeter1997): Noexcept specifier
-template <typename T>
-[[nodiscard]] constexpr auto product_values_impl(product<T>&& res) {
-    return std::move(res).template get<0>();
-}
+class quote_scanner {
+private:
+    // All ones, if the next block starts inside a string
+    std::uint64_t m_InString = 0;
 
-// XXX(LPeter1997): Noexcept specifier
-template <typename... Ts, typename Head, typename... Tail>
-[[nodiscard]] constexpr auto
-product_values_impl(product<Ts...>&& res, Head&& h, Tail&&... t);
+public:
+    [[nodiscard]] std::uint64_t next(std::uint64_t quotes) noexcept {
+        auto in_string = prefix_xor(quotes) ^ m_InString;
+        m_InString = std::uint64_t(0) - (in_string >> 63);
+        return in_string;
+    }
+};
 
-// XXX(LPeter1997): Noexcept specifier
-template <std::size_t... Is, typename... Ts, typename Head, typename... Tail>
-[[nodiscard]] constexpr auto product_values_expand(
-    std::index_sequence<Is...>,
-    product<Ts...>&& res, Head&& h, Tail&&... t) {
+} /* namespace detail */
+} /* namespace cppcmb */
 
-    return product_values_impl(
-        std::move(res),
-        cppcmb_fwd(h).template get<Is>()...,
-        cppcmb_fwd(t)...
-    );
-}
+namespace cppcmb {
+namespace detail {
 
-// XXX(LPeter1997): Noexcept specifier
-template <std::size_t... Is, typename... Ts, typename Head, typename... Tail>
-[[nodiscard]] constexpr auto product_values_append(
-    std::index_sequence<Is...>,
-    product<Ts...>&& res, Head&& h, Tail&&... t) {
+using byte_set = std::bitset<256>;
 
-    return product_values_impl(
-        product(std::move(res).template get<Is>()..., cppcmb_fwd(h)),
-        cppcmb_fwd(t)...
-    );
-}
+/**
+ * An NFA with epsilon moves. Every state has at most one byte transition.
+ * States can carry a tag, that is recorded when a path goes through them,
+ * these mark the boundaries of capture groups. Tags don't change the
+ * language, the DFA ignores them.
+ */
+class nfa {
+public:
+    static constexpr std::size_t no_tag = std::size_t(-1);
 
-// XXX(LPeter1997): Noexcept specifier
-template <typename... Ts, typename Head, typename... Tail>
-[[nodiscard]] constexpr auto product_values_head(
-    std::true_type,
-    product<Ts...>&& res, Head&& h, Tail&&... t) {
+    /**
+     * A piece of the automaton with a single entry and a single exit.
+     */
+    struct fragment {
+        std::size_t start;
+        std::size_t end;
+    };
 
-    return product_values_expand(
-        remove_cvref_t<Head>::index_sequence,
-        std::move(res),
-        cppcmb_fwd(h),
-        cppcmb_fwd(t)...
-    );
-}
+private:
+    struct state {
+        std::vector<std::size_t> epsilon;
+        byte_set                 bytes;
+        std::size_t              next = 0;
+        std::size_t              tag  = no_tag;
+    };
 
-// XXX(LPeter1997): Noexcept specifier
-template <typename... Ts, typename Head, typename... Tail>
-[[nodiscard]] constexpr auto product_values_head(
-    std::false_type,
-    product<Ts...>&& res, Head&& h, Tail&&... t) {
+    std::vector<state> m_States;
 
-    return product_values_append(
-        product<Ts...>::index_sequence,
-        std::move(res),
-        cppcmb_fwd(h),
-        cppcmb_fwd(t)...
-    );
-}
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    std::size_t add_state() {
+        m_States.emplace_back();
+        return m_States.size() - 1;
+    }
 
-// XXX(LPeter1997): Noexcept specifier
-template <typename... Ts, typename Head, typename... Tail>
-[[nodiscard]] constexpr auto
-product_values_impl(product<Ts...>&& res, Head&& h, Tail&&... t) {
-    return product_values_head(
-        is_product<remove_cvref_t<Head>>(),
-        std::move(res),
-        cppcmb_fwd(h),
-        cppcmb_fwd(t)...
-    );
-}
+    // XXX(LPeter1997): Noexcept specifier
+    void add_epsilon(std::size_t from, std::size_t to) {
+        m_States[from].epsilon.push_back(to);
+    }
 
-} /* namespace detail */
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * A fragment that consumes one byte of the set.
+     */
+    fragment bytes(byte_set const& set) {
+        auto s = add_state();
+        auto e = add_state();
+        m_States[s].bytes = set;
+        m_States[s].next = e;
+        return { s, e };
+    }
 
-// XXX(LPeter1997): Noexcept specifier
-/**
- * Concatenate products and values.
- */
-template <typename... Ts>
-[[nodiscard]] constexpr auto product_values(Ts&&... vs) {
-    // XXX(LPeter1997): GCC bug
-    return detail::product_values_impl(product<>(), cppcmb_fwd(vs)...);
-}
+    // XXX(LPeter1997): Noexcept specifier
+    fragment epsilon() {
+        auto s = add_state();
+        auto e = add_state();
+        add_epsilon(s, e);
+        return { s, e };
+    }
 
-} /* namespace cppcmb */
+    // XXX(LPeter1997): Noexcept specifier
+    fragment sequence(fragment a, fragment b) {
+        add_epsilon(a.end, b.start);
+        return { a.start, b.end };
+    }
 
-namespace cppcmb {
+    // XXX(LPeter1997): Noexcept specifier
+    fragment choice(fragment a, fragment b) {
+        auto s = add_state();
+        auto e = add_state();
+        add_epsilon(s, a.start);
+        add_epsilon(s, b.start);
+        add_epsilon(a.end, e);
+        add_epsilon(b.end, e);
+        return { s, e };
+    }
 
-template <typename... Ts>
-class sum {
-private:
-    using variant_type = std::variant<Ts...>;
+    // XXX(LPeter1997): Noexcept specifier
+    fragment optional(fragment a) {
+        return choice(a, epsilon());
+    }
 
-    cppcmb_self_check(sum);
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Records open before, and close after the fragment.
+     */
+    fragment tagged(fragment a, std::size_t open, std::size_t close) {
+        auto s = add_state();
+        auto e = add_state();
+        m_States[s].tag = open;
+        m_States[e].tag = close;
+        add_epsilon(s, a.start);
+        add_epsilon(a.end, e);
+        return { s, e };
+    }
 
-    variant_type m_Value;
+    // XXX(LPeter1997): Noexcept specifier
+    fragment repeat(fragment a) {
+        auto s = add_state();
+        auto e = add_state();
+        add_epsilon(s, a.start);
+        add_epsilon(s, e);
+        add_epsilon(a.end, a.start);
+        add_epsilon(a.end, e);
+        return { s, e };
+    }
 
-public:
-    template <typename T, cppcmb_requires_t(!is_self_v<T>)>
-    constexpr sum(T&& val)
-        noexcept(std::is_nothrow_constructible_v<variant_type, T&&>)
-        : m_Value(cppcmb_fwd(val)) {
+    /**
+     * Makes the states from the first one on ignore ASCII case, every byte
+     * behaves like its lower-case version.
+     */
+    void fold_case(std::size_t first) noexcept {
+        for (auto s = first; s < m_States.size(); ++s) {
+            auto& bytes = m_States[s].bytes;
+            for (std::size_t b = 'A'; b <= 'Z'; ++b) {
+                bytes[b] = bytes[b - 'A' + 'a'];
+            }
+        }
     }
 
-    template <typename U>
-    [[nodiscard]] constexpr auto& get() & {
-        return std::get<U>(m_Value);
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_States.size();
     }
-    template <typename U>
-    [[nodiscard]] constexpr auto const& get() const& {
-        return std::get<U>(m_Value);
+
+    [[nodiscard]] byte_set const& bytes_of(std::size_t s) const noexcept {
+        return m_States[s].bytes;
     }
-    template <typename U>
-    [[nodiscard]] constexpr auto&& get() && {
-        return std::get<U>(std::move(m_Value));
+
+    [[nodiscard]] std::size_t next_of(std::size_t s) const noexcept {
+        return m_States[s].next;
     }
-    template <typename U>
-    [[nodiscard]] constexpr auto const&& get() const&& {
-        return std::get<U>(std::move(m_Value));
+
+    [[nodiscard]] std::vector<std::size_t> const& epsilon_of(std::size_t s)
+        const noexcept {
+        return m_States[s].epsilon;
     }
 
-    cppcmb_getter(as_variant, m_Value)
+    [[nodiscard]] std::size_t tag_of(std::size_t s) const noexcept {
+        return m_States[s].tag;
+    }
 };
 
 /**
- * Make sums comparable.
+ * Byte classes of an NFA: bytes get the same class if no byte transition
+ * tells them apart.
  */
-template <typename... Ts>
-[[nodiscard]] constexpr auto operator==(
-    sum<Ts...> const& l,
-    sum<Ts...> const& r
-) cppcmb_return(l.as_variant() == r.as_variant())
+struct byte_classes {
+    std::array<std::uint8_t, 256> of{};
+    std::size_t                   count = 1;
 
-template <typename... Ts>
-[[nodiscard]] constexpr auto operator!=(
-    sum<Ts...> const& l,
-    sum<Ts...> const& r
-) cppcmb_return(l.as_variant() != r.as_variant())
+    byte_classes() = default;
 
-namespace detail {
+    // XXX(LPeter1997): Noexcept specifier
+    explicit byte_classes(nfa const& n) {
+        // Split the classes by every byte set of the NFA
+        for (std::size_t s = 0; s < n.size(); ++s) {
+            auto const& set = n.bytes_of(s);
+            if (set.none()) {
+                continue;
+            }
+            std::map<std::pair<std::uint8_t, bool>, std::uint8_t> split;
+            for (std::size_t b = 0; b < 256; ++b) {
+                auto key = std::make_pair(of[b], bool(set[b]));
+                auto it = split.try_emplace(
+                    key, std::uint8_t(split.size())
+                ).first;
+                of[b] = it->second;
+            }
+            count = split.size();
+        }
+    }
 
-cppcmb_is_specialization(sum);
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * A byte of every class.
+     */
+    [[nodiscard]] std::vector<std::size_t> representatives() const {
+        std::vector<std::size_t> repr(count);
+        for (std::size_t b = 256; b-- > 0;) {
+            repr[of[b]] = b;
+        }
+        return repr;
+    }
+};
 
-template <typename T, typename... Ts>
-inline constexpr bool contains_type_v = (... || std::is_same_v<T, Ts>);
+/**
+ * A DFA over byte classes. State 0 is the dead state, it has no way out. A
+ * DFA can have multiple accepting NFA states (rules), a DFA state accepts the
+ * first rule it contains.
+ */
+class dfa {
+public:
+    using state_type = std::uint32_t;
 
-////////////////////////////////////////////////////
+    static constexpr state_type dead = 0;
+    static constexpr std::size_t no_rule = std::size_t(-1);
+    // The number of records matched at once
+    static constexpr std::size_t batch_lanes = 16;
 
-template <typename...>
-struct sum_values_t_impl;
+private:
+    std::array<std::uint8_t, 256> m_Classes{};
+    std::size_t                   m_ClassCount = 1;
+    std::vector<state_type>       m_Table;
+    // The accepted rule plus one, 0 if the state doesn't accept
+    std::vector<std::uint32_t>    m_Accepting;
+    state_type                    m_Start = dead;
 
-template <typename T>
-struct sum_values_t_impl<sum<T>> {
-    using type = T;
-};
+    // XXX(LPeter1997): Noexcept specifier
+    static void close(nfa const& n, std::vector<std::size_t>& set) {
+        std::vector<std::size_t> stack = set;
+        std::vector<bool> seen(n.size());
+        for (auto s : set) {
+            seen[s] = true;
+        }
+        while (!stack.empty()) {
+            auto s = stack.back();
+            stack.pop_back();
+            for (auto t : n.epsilon_of(s)) {
+                if (!seen[t]) {
+                    seen[t] = true;
+                    set.push_back(t);
+                    stack.push_back(t);
+                }
+            }
+        }
+        std::sort(set.begin(), set.end());
+    }
 
-template <typename... Ts>
-struct sum_values_t_impl<sum<Ts...>> {
-    using type = sum<Ts...>;
-};
+public:
+    dfa() = default;
 
-template <typename... Ts, typename... Us, typename... Vs>
-struct sum_values_t_impl<sum<Ts...>, sum<Us...>, Vs...> {
-    using type = typename sum_values_t_impl<sum<Ts...>, Us..., Vs...>::type;
-};
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The subset construction. The fragment's end is the accepting state.
+     */
+    dfa(nfa const& n, nfa::fragment f)
+        : dfa(n, f.start, std::vector<std::size_t>{ f.end }) {
+    }
 
-template <typename... Ts, typename Head, typename... Tail>
-struct sum_values_t_impl<sum<Ts...>, Head, Tail...> {
-    using type = std::conditional_t<
-        contains_type_v<Head, Ts...>,
-        typename sum_values_t_impl<sum<Ts...>, Tail...>::type,
-        typename sum_values_t_impl<sum<Ts..., Head>, Tail...>::type
-    >;
-};
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The subset construction with multiple rules, rule i is accepted in the
+     * NFA state ends[i].
+     */
+    dfa(nfa const& n, std::size_t start,
+        std::vector<std::size_t> const& ends) {
+        auto classes = byte_classes(n);
+        m_Classes = classes.of;
+        m_ClassCount = classes.count;
+        auto repr = classes.representatives();
+
+        std::map<std::vector<std::size_t>, state_type> ids;
+        std::vector<std::vector<std::size_t>> sets;
+        auto intern = [&](std::vector<std::size_t> set) {
+            if (set.empty()) {
+                return dead;
+            }
+            auto [it, inserted] = ids.try_emplace(set, state_type(sets.size()));
+            if (inserted) {
+                std::uint32_t accepting = 0;
+                for (std::size_t i = 0; i < ends.size(); ++i) {
+                    if (std::binary_search(set.begin(), set.end(), ends[i])) {
+                        accepting = std::uint32_t(i + 1);
+                        break;
+                    }
+                }
+                sets.push_back(std::move(set));
+                m_Accepting.push_back(accepting);
+                m_Table.resize(m_Table.size() + m_ClassCount, dead);
+            }
+            return it->second;
+        };
+
+        // The dead state
+        sets.emplace_back();
+        m_Accepting.push_back(0);
+        m_Table.resize(m_ClassCount, dead);
+
+        std::vector<std::size_t> init = { start };
+        close(n, init);
+        m_Start = intern(std::move(init));
+
+        for (std::size_t id = 1; id < sets.size(); ++id) {
+            for (std::size_t c = 0; c < m_ClassCount; ++c) {
+                std::vector<std::size_t> target;
+                for (auto s : sets[id]) {
+                    if (n.bytes_of(s)[repr[c]]) {
+                        target.push_back(n.next_of(s));
+                    }
+                }
+                close(n, target);
+                target.erase(
+                    std::unique(target.begin(), target.end()), target.end()
+                );
+                auto to = intern(std::move(target));
+                m_Table[id * m_ClassCount + c] = to;
+            }
+        }
+    }
 
-} /* namespace detail */
+    [[nodiscard]] state_type start() const noexcept {
+        return m_Start;
+    }
 
-template <typename... Ts>
-using sum_values_t = typename detail::sum_values_t_impl<sum<>, Ts...>::type;
+    [[nodiscard]] std::size_t state_count() const noexcept {
+        return m_Accepting.size();
+    }
 
-namespace detail {
+    [[nodiscard]] std::size_t class_count() const noexcept {
+        return m_ClassCount;
+    }
 
-// XXX(LPeter1997): Noexcept specifier
-template <typename RetT, typename T>
-constexpr auto sum_values_impl(std::false_type, T&& val) {
-    return RetT(cppcmb_fwd(val));
-}
-
-// XXX(LPeter1997): Noexcept specifier
-template <typename RetT, typename T>
-constexpr decltype(auto) sum_values_impl(std::true_type, T&& val) {
-    return std::visit(
-        [](auto&& v) -> RetT { return RetT(cppcmb_fwd(v)); },
-        cppcmb_fwd(val).as_variant()
-    );
-}
-
-} /* namespace detail */
-
-// XXX(LPeter1997): Noexcept specifier
-template <typename... Ts, typename T>
-constexpr auto sum_values(T&& val) {
-    return detail::sum_values_impl<sum_values_t<Ts...>>(
-        detail::is_sum<detail::remove_cvref_t<T>>(),
-        cppcmb_fwd(val)
-    );
-}
+    [[nodiscard]] std::uint8_t class_of(unsigned char b) const noexcept {
+        return m_Classes[b];
+    }
 
-} /* namespace cppcmb */
+    [[nodiscard]] bool accepting(state_type s) const noexcept {
+        return m_Accepting[s] != 0;
+    }
 
-namespace cppcmb {
+    /**
+     * The rule accepted in the state, or no_rule.
+     */
+    [[nodiscard]] std::size_t rule(state_type s) const noexcept {
+        return m_Accepting[s] == 0 ? no_rule : m_Accepting[s] - 1;
+    }
 
-namespace detail {
+    [[nodiscard]] state_type next(state_type s, unsigned char b)
+        const noexcept {
+        return m_Table[s * m_ClassCount + m_Classes[b]];
+    }
 
-// XXX(LPeter1997): Noexcept specifier
-// Arg is a product
-template <typename Fn, typename T>
-[[nodiscard]] constexpr decltype(auto) apply_value_impl(
-    std::true_type,
-    std::false_type,
-    Fn&& fn, T&& arg) {
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The states that can still reach an accepting state.
+     */
+    [[nodiscard]] std::vector<bool> live_states() const {
+        std::vector<bool> live(state_count());
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (std::size_t s = 1; s < live.size(); ++s) {
+                if (live[s]) {
+                    continue;
+                }
+                bool l = m_Accepting[s] != 0;
+                for (std::size_t c = 0; !l && c < m_ClassCount; ++c) {
+                    l = live[m_Table[s * m_ClassCount + c]];
+                }
+                if (l) {
+                    live[s] = true;
+                    changed = true;
+                }
+            }
+        }
+        return live;
+    }
 
-    return std::apply(
-        cppcmb_fwd(fn), cppcmb_fwd(arg).as_tuple()
-    );
-}
+    /**
+     * The length of the longest prefix of the bytes that is accepted, or -1
+     * if there's none. furthest is set to the number of bytes looked at.
+     */
+    template <typename CharT>
+    [[nodiscard]] std::ptrdiff_t longest_match(CharT const* data,
+        std::size_t len, std::size_t& furthest) const noexcept {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        auto s = m_Start;
+        std::ptrdiff_t last = accepting(s) ? 0 : -1;
+        std::size_t i = 0;
+        while (i < len) {
+            s = next(s, static_cast<unsigned char>(data[i]));
+            ++i;
+            if (s == dead) {
+                break;
+            }
+            if (accepting(s)) {
+                last = std::ptrdiff_t(i);
+            }
+        }
+        furthest = i;
+        return last;
+    }
 
-// XXX(LPeter1997): Noexcept specifier
-// Arg is a sum
-template <typename Fn, typename T>
-[[nodiscard]] constexpr decltype(auto) apply_value_impl(
-    std::false_type,
-    std::true_type,
-    Fn&& fn, T&& arg) {
+    /**
+     * Like longest_match, but also tells the rule accepted at the end of the
+     * match.
+     */
+    template <typename CharT>
+    [[nodiscard]] std::ptrdiff_t longest_match(CharT const* data,
+        std::size_t len, std::size_t& furthest, std::size_t& matched_rule)
+        const noexcept {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        auto s = m_Start;
+        std::ptrdiff_t last = accepting(s) ? 0 : -1;
+        matched_rule = rule(s);
+        std::size_t i = 0;
+        while (i < len) {
+            s = next(s, static_cast<unsigned char>(data[i]));
+            ++i;
+            if (s == dead) {
+                break;
+            }
+            if (accepting(s)) {
+                last = std::ptrdiff_t(i);
+                matched_rule = rule(s);
+            }
+        }
+        furthest = i;
+        return last;
+    }
 
-    return std::visit(
-        cppcmb_fwd(fn), cppcmb_fwd(arg).as_variant()
-    );
-}
+    /**
+     * Matches at most batch_lanes records at once, record i is data[i] with
+     * length lens[i]. Bit i of the result is set, if the whole record is
+     * accepted. The lanes step in lockstep, so the independent table loads
+     * overlap (and can be compiled into gathers), instead of waiting for each
+     * other one record at a time.
+     */
+    template <typename CharT>
+    [[nodiscard]] std::uint32_t full_match_batch(CharT const* const* data,
+        std::size_t const* lens, std::size_t n) const noexcept {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        std::array<unsigned char const*, batch_lanes> bytes{};
+        std::array<std::size_t, batch_lanes> len{};
+        std::array<state_type, batch_lanes> s{};
+        std::size_t longest = 0;
+        for (std::size_t l = 0; l < n; ++l) {
+            bytes[l] = reinterpret_cast<unsigned char const*>(data[l]);
+            len[l] = lens[l];
+            s[l] = m_Start;
+            longest = len[l] > longest ? len[l] : longest;
+        }
 
-// XXX(LPeter1997): Noexcept specifier
-// Arg is a single value
-template <typename Fn, typename T>
-[[nodiscard]] constexpr decltype(auto) apply_value_impl(
-    std::false_type,
-    std::false_type,
-    Fn&& fn, T&& arg) {
+        auto const* table = m_Table.data();
+        auto const* classes = m_Classes.data();
+        auto const cc = m_ClassCount;
+        for (std::size_t i = 0; i < longest; ++i) {
+            state_type alive = 0;
+            for (std::size_t l = 0; l < batch_lanes; ++l) {
+                // Finished lanes read a dummy byte and keep their state
+                bool active = i < len[l];
+                auto b = active ? bytes[l][i] : 0;
+                auto next = table[s[l] * cc + classes[b]];
+                s[l] = active ? next : s[l];
+                alive |= s[l];
+            }
+            if (alive == dead) {
+                break;
+            }
+        }
 
-    return cppcmb_fwd(fn)(cppcmb_fwd(arg));
-}
+        std::uint32_t bits = 0;
+        for (std::size_t l = 0; l < n; ++l) {
+            bits |= std::uint32_t(m_Accepting[s[l]] != 0) << l;
+        }
+        return bits;
+    }
+};
 
 } /* namespace detail */
-
-// XXX(LPeter1997): Noexcept specifier
-// XXX(LPeter1997): Make apply recursive, so that underlying sums or
-// products can get unwrapped too
-template <typename Fn, typename T>
-[[nodiscard]] constexpr decltype(auto) apply_value(Fn&& fn, T&& arg) {
-    return detail::apply_value_impl(
-        detail::is_product<detail::remove_cvref_t<T>>(),
-        detail::is_sum<detail::remove_cvref_t<T>>(),
-        cppcmb_fwd(fn),
-        cppcmb_fwd(arg)
-    );
-}
-
 } /* namespace cppcmb */
 
 namespace cppcmb {
-
 namespace detail {
 
 /**
- * Concept for the reader source.
- * The reader has to have:
- *  - An operator[](std::size_t) that returns the element at the given index
- *  - A .size() member or size(source) that returns the length of the source
+ * Tag positions, npos for the tags that weren't recorded.
  */
+template <std::size_t Tags>
+using tag_positions = std::array<std::size_t, Tags>;
 
-template <typename T>
-using element_at_t = decltype(std::declval<T>()[std::declval<std::size_t>()]);
-
-template <typename T>
-using msize_t = decltype(std::size(std::declval<T>()));
-
-// Readable source concept for the reader
-template <typename T>
-inline constexpr bool is_reader_source_v =
-       is_detected_v<element_at_t, T>
-    && is_detected_v<msize_t, T>;
-
-} /* namespace detail */
-
-class memo_context;
-
-template <typename Src>
-class reader {
-public:
-    static_assert(
-        detail::is_reader_source_v<Src>,
-        "The reader source must have a subscript operator [std::size_t] and a "
-        "size() member function!"
-    );
-
-private:
-    Src const*    m_Source  = nullptr;
-    std::size_t   m_Cursor  = 0U;
-    memo_context* m_MemoCtx = nullptr;
+inline constexpr std::size_t npos_tag = std::size_t(-1);
 
+class capture_automaton {
 public:
-    using value_type = detail::remove_cvref_t<decltype((*m_Source)[m_Cursor])>;
-
-    constexpr reader() noexcept = default;
-
-    constexpr reader(Src const& src, std::size_t idx, memo_context* t) noexcept
-        : m_Source(::std::addressof(src)), m_MemoCtx(t) {
-        seek(idx);
-    }
-
-    constexpr reader(Src const& src, std::size_t idx, memo_context& t) noexcept
-        : reader(src, idx, &t) {
-    }
+    using tag_mask = std::uint64_t;
 
-    constexpr reader(Src const& src, std::size_t idx = 0U) noexcept
-        : reader(src, idx, nullptr) {
-    }
+    static constexpr std::size_t max_tags = 64;
 
-    constexpr reader(Src const& src, memo_context& t) noexcept
-        : reader(src, 0U, t) {
+private:
+    static constexpr std::uint32_t no_node = std::uint32_t(-1);
+
+    // A step of the one-pass automaton
+    struct step {
+        std::uint32_t next = no_node;
+        tag_mask      tags = 0;
+    };
+
+    nfa                        m_Nfa;
+    nfa::fragment              m_Fragment{};
+    byte_classes               m_Classes;
+    bool                       m_OnePass = true;
+
+    // One-pass tables, indexed by node
+    std::vector<step>          m_Steps;
+    std::vector<std::uint8_t>  m_Accepting;
+    std::vector<tag_mask>      m_AcceptTags;
+
+    template <std::size_t Tags>
+    static void apply_tags(tag_positions<Tags>& pos, tag_mask tags,
+        std::size_t at) noexcept {
+        while (tags != 0) {
+            pos[bit_ctz(tags)] = at;
+            tags &= tags - 1;
+        }
     }
 
-    // Just to avoid nasty bugs
-    reader(Src const&& src, std::size_t idx, memo_context* t) = delete;
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Builds the one-pass tables. Every state after a byte transition (and
+     * the start) is a node. From a node, every byte class must lead to at
+     * most one byte transition, through one set of tags, and the final
+     * state must be reachable through at most one set of tags.
+     */
+    void build_one_pass() {
+        auto const repr = m_Classes.representatives();
+        auto const cc = m_Classes.count;
+
+        std::vector<std::uint32_t> node_of(m_Nfa.size(), no_node);
+        std::vector<std::size_t> nodes;
+        auto intern = [&](std::size_t s) {
+            if (node_of[s] == no_node) {
+                node_of[s] = std::uint32_t(nodes.size());
+                nodes.push_back(s);
+                m_Steps.resize(m_Steps.size() + cc);
+                m_Accepting.push_back(0);
+                m_AcceptTags.push_back(0);
+            }
+            return node_of[s];
+        };
+        intern(m_Fragment.start);
+
+        std::vector<tag_mask> seen_tags(m_Nfa.size());
+        std::vector<std::uint8_t> seen(m_Nfa.size());
+        std::vector<std::pair<std::size_t, tag_mask>> stack;
+        for (std::size_t node = 0; node < nodes.size(); ++node) {
+            std::fill(seen.begin(), seen.end(), 0);
+            stack.assign(1, { nodes[node], 0 });
+            while (!stack.empty()) {
+                auto [s, tags] = stack.back();
+                stack.pop_back();
+                if (m_Nfa.tag_of(s) != nfa::no_tag) {
+                    tags |= tag_mask(1) << m_Nfa.tag_of(s);
+                }
+                if (seen[s]) {
+                    if (seen_tags[s] != tags) {
+                        // Two ways to the same state
+                        m_OnePass = false;
+                        return;
+                    }
+                    continue;
+                }
+                seen[s] = 1;
+                seen_tags[s] = tags;
 
-    [[nodiscard]] constexpr auto* source_ptr() const noexcept {
-        return m_Source;
+                if (s == m_Fragment.end) {
+                    m_Accepting[node] = 1;
+                    m_AcceptTags[node] = tags;
+                }
+                auto const& bytes = m_Nfa.bytes_of(s);
+                if (bytes.any()) {
+                    auto next = intern(m_Nfa.next_of(s));
+                    for (std::size_t c = 0; c < cc; ++c) {
+                        if (!bytes[repr[c]]) {
+                            continue;
+                        }
+                        auto& st = m_Steps[node * cc + c];
+                        if (st.next != no_node) {
+                            // The byte doesn't decide the way
+                            m_OnePass = false;
+                            return;
+                        }
+                        st = step{ next, tags };
+                    }
+                }
+                for (auto t : m_Nfa.epsilon_of(s)) {
+                    stack.emplace_back(t, tags);
+                }
+            }
+        }
     }
 
-    [[nodiscard]] constexpr auto const& source() const noexcept {
-        cppcmb_assert(
-            "A reader without a source can't return a source-reference!",
-            source_ptr() != nullptr
-        );
-        return *source_ptr();
+    template <std::size_t Tags, typename CharT>
+    [[nodiscard]] std::ptrdiff_t match_one_pass(CharT const* data,
+        std::size_t len, tag_positions<Tags>& out, std::size_t& furthest)
+        const noexcept {
+        auto const cc = m_Classes.count;
+        tag_positions<Tags> pos;
+        pos.fill(npos_tag);
+        std::ptrdiff_t last = -1;
+        std::uint32_t node = 0;
+        std::size_t i = 0;
+        while (true) {
+            if (m_Accepting[node]) {
+                last = std::ptrdiff_t(i);
+                out = pos;
+                apply_tags(out, m_AcceptTags[node], i);
+            }
+            if (i == len) {
+                break;
+            }
+            auto b = static_cast<unsigned char>(data[i]);
+            auto const& st = m_Steps[node * cc + m_Classes.of[b]];
+            ++i;
+            if (st.next == no_node) {
+                break;
+            }
+            apply_tags(pos, st.tags, i - 1);
+            node = st.next;
+        }
+        furthest = i;
+        return last;
     }
 
-    [[nodiscard]] constexpr auto const& cursor() const noexcept {
-        return m_Cursor;
-    }
+    template <std::size_t Tags>
+    struct thread {
+        std::size_t         state;
+        tag_positions<Tags> pos;
+    };
 
-    [[nodiscard]] constexpr bool is_end() const noexcept {
-        return cursor() >= std::size(source());
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Adds the state and everything reachable with epsilon moves, in
+     * priority order. The first thread to reach a state wins.
+     */
+    template <std::size_t Tags>
+    void add_thread(std::vector<thread<Tags>>& list,
+        std::vector<std::size_t>& mark, std::size_t gen,
+        std::size_t s, tag_positions<Tags> pos, std::size_t at) const {
+        if (mark[s] == gen) {
+            return;
+        }
+        mark[s] = gen;
+        if (m_Nfa.tag_of(s) != nfa::no_tag) {
+            pos[m_Nfa.tag_of(s)] = at;
+        }
+        list.push_back({ s, pos });
+        for (auto t : m_Nfa.epsilon_of(s)) {
+            add_thread(list, mark, gen, t, pos, at);
+        }
     }
 
-    [[nodiscard]] constexpr auto const& current() const noexcept {
-        cppcmb_assert(
-            "current() can only be invoked when the cursor is not past the "
-            "elements!",
-            cursor() < std::size(source())
-        );
-        return (*m_Source)[cursor()];
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t Tags, typename CharT>
+    [[nodiscard]] std::ptrdiff_t match_nfa(CharT const* data,
+        std::size_t len, tag_positions<Tags>& out,
+        std::size_t& furthest) const {
+        std::vector<thread<Tags>> curr;
+        std::vector<thread<Tags>> next;
+        std::vector<std::size_t> mark(m_Nfa.size(), 0);
+        std::size_t gen = 1;
+
+        tag_positions<Tags> init;
+        init.fill(npos_tag);
+        add_thread(curr, mark, gen, m_Fragment.start, init, 0);
+
+        std::ptrdiff_t last = -1;
+        std::size_t i = 0;
+        while (!curr.empty()) {
+            bool accepted = false;
+            for (auto const& th : curr) {
+                if (th.state == m_Fragment.end && !accepted) {
+                    // Longest match, the first thread at the same length
+                    last = std::ptrdiff_t(i);
+                    out = th.pos;
+                    accepted = true;
+                }
+            }
+            if (i == len) {
+                break;
+            }
+            auto b = static_cast<std::size_t>(
+                static_cast<unsigned char>(data[i])
+            );
+            ++gen;
+            next.clear();
+            for (auto const& th : curr) {
+                if (m_Nfa.bytes_of(th.state)[b]) {
+                    add_thread(
+                        next, mark, gen, m_Nfa.next_of(th.state), th.pos, i + 1
+                    );
+                }
+            }
+            ++i;
+            std::swap(curr, next);
+        }
+        furthest = i;
+        return last;
     }
 
-    constexpr void seek(std::size_t idx) noexcept {
-        cppcmb_assert(
-            "seek() argument must be in the bounds of source!",
-            idx <= std::size(source())
-        );
-        m_Cursor = idx;
-    }
+public:
+    capture_automaton() = default;
 
-    constexpr void next() noexcept {
-        seek(cursor() + 1);
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The fragment's end is the accepting state. Tags must be less than
+     * max_tags.
+     */
+    capture_automaton(nfa n, nfa::fragment f)
+        : m_Nfa(std::move(n)), m_Fragment(f), m_Classes(m_Nfa) {
+        build_one_pass();
+        if (!m_OnePass) {
+            m_Steps.clear();
+            m_Accepting.clear();
+            m_AcceptTags.clear();
+        }
     }
 
-    [[nodiscard]] constexpr auto* context_ptr() const noexcept {
-        return m_MemoCtx;
+    /**
+     * True, if the pattern can be matched in one deterministic pass.
+     */
+    [[nodiscard]] bool one_pass() const noexcept {
+        return m_OnePass;
     }
 
-    [[nodiscard]] constexpr auto& context() const noexcept {
-        cppcmb_assert(
-            "A memo-context must be assigned before accessing it!",
-            m_MemoCtx != nullptr
-        );
-        return *context_ptr();
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The length of the longest accepted prefix, or -1 if there's none. The
+     * tag positions are the ones of that match. furthest is set to the number
+     * of bytes looked at.
+     */
+    template <std::size_t Tags, typename CharT>
+    [[nodiscard]] std::ptrdiff_t longest_match(CharT const* data,
+        std::size_t len, tag_positions<Tags>& tags,
+        std::size_t& furthest) const {
+        static_assert(sizeof(CharT) == 1, "Automata only work on bytes!");
+        static_assert(Tags <= max_tags, "Too many tags!");
+
+        if (m_OnePass) {
+            return match_one_pass(data, len, tags, furthest);
+        }
+        return match_nfa(data, len, tags, furthest);
     }
 };
 
+} /* namespace detail */
 } /* namespace cppcmb */
 
 namespace cppcmb {
-
 namespace detail {
 
-/**
- * A tag-type for every combinator, so it's easier to check inheritance.
- */
-class combinator_base {};
+template <typename Self>
+class crtp {
+public:
+    using self_type = Self;
+
+    [[nodiscard]]
+    constexpr self_type& self() & noexcept {
+        return static_cast<self_type&>(*this);
+    }
+
+    [[nodiscard]]
+    constexpr self_type const& self() const& noexcept {
+        return static_cast<self_type const&>(*this);
+    }
+};
 
 } /* namespace detail */
+} /* namespace cppcmb */
+
+namespace cppcmb {
+namespace detail {
 
 /**
- * Check if a type correctly derives from the combinator base.
- * The user actually has to derive from combinator<Self>, but that already
- * derives from combinator base, so this check is sufficient.
+ * A 128-bit hash value.
  */
-template <typename T>
-using is_combinator = std::is_base_of<detail::combinator_base, T>;
+struct hash128 {
+    std::uint64_t low  = 0;
+    std::uint64_t high = 0;
 
-template <typename T>
-inline constexpr bool is_combinator_v = is_combinator<T>::value;
+    [[nodiscard]] constexpr bool operator==(hash128 const& o) const noexcept {
+        return low == o.low && high == o.high;
+    }
 
-namespace detail {
+    [[nodiscard]] constexpr bool operator!=(hash128 const& o) const noexcept {
+        return !(*this == o);
+    }
+};
 
 /**
- * Helpers, mainly for operators.
+ * Hasher for using hash128 as a key in unordered containers.
  */
+struct hash128_hasher {
+    [[nodiscard]] constexpr std::size_t operator()(hash128 const& h)
+        const noexcept {
+        // The bits are already well mixed
+        return std::size_t(h.low ^ h.high);
+    }
+};
 
-template <typename T>
-inline constexpr bool is_combinator_cvref_v =
-    is_combinator_v<remove_cvref_t<T>>;
-
-template <typename... Ts>
-inline constexpr bool all_combinators_cvref_v =
-    (... & is_combinator_cvref_v<Ts>);
+namespace hash_impl {
 
-} /* namespace detail */
+inline constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87U;
+inline constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FU;
+inline constexpr std::uint64_t prime3 = 0x165667B19E3779F9U;
+inline constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63U;
+inline constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5U;
 
-// Forward-declare the action combinator, the base combinator has to see it
-template <typename Cmb, typename Fn>
-class action_t;
+[[nodiscard]] constexpr std::uint64_t rotl(std::uint64_t x, unsigned r)
+    noexcept {
+    return (x << r) | (x >> (64U - r));
+}
 
-#define cppcmb_noexcept_subscript(...) \
-noexcept(noexcept(action_t(std::declval<__VA_ARGS__>(), cppcmb_fwd(fn))))
+[[nodiscard]] inline std::uint64_t read64(unsigned char const* p) noexcept {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
 
-/**
- * The actual type that all other combinators have to derive from.
- */
-template <typename Self>
-class combinator : public detail::crtp<Self>,
-                   private detail::combinator_base {
-public:
-    template <typename Fn>
-    [[nodiscard]] constexpr auto operator[](Fn&& fn) &
-        cppcmb_noexcept_subscript(Self&) {
+[[nodiscard]] inline std::uint64_t read32(unsigned char const* p) noexcept {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
 
-        return action_t(this->self(), cppcmb_fwd(fn));
-    }
+[[nodiscard]] constexpr std::uint64_t mix_round(
+    std::uint64_t acc, std::uint64_t in) noexcept {
+    acc += in * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
 
-    template <typename Fn>
-    [[nodiscard]] constexpr auto operator[](Fn&& fn) const&
-        cppcmb_noexcept_subscript(Self const&) {
+[[nodiscard]] constexpr std::uint64_t merge(std::uint64_t acc, std::uint64_t v)
+    noexcept {
+    acc ^= mix_round(0, v);
+    return acc * prime1 + prime4;
+}
 
-        return action_t(this->self(), cppcmb_fwd(fn));
-    }
+[[nodiscard]] constexpr std::uint64_t avalanche(std::uint64_t h) noexcept {
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
 
-    template <typename Fn>
-    [[nodiscard]] constexpr auto operator[](Fn&& fn) &&
-        cppcmb_noexcept_subscript(Self&&) {
+} /* namespace hash_impl */
 
-        return action_t(std::move(this->self()), cppcmb_fwd(fn));
+/**
+ * Hashes len bytes starting at data.
+ */
+[[nodiscard]] inline hash128 hash_bytes(
+    void const* data, std::size_t len, std::uint64_t seed = 0) noexcept {
+
+    using namespace hash_impl;
+
+    auto const* p = static_cast<unsigned char const*>(data);
+    auto const* const end = p + len;
+
+    std::uint64_t h1;
+    std::uint64_t h2;
+    if (len >= 32) {
+        std::uint64_t v1 = seed + prime1 + prime2;
+        std::uint64_t v2 = seed + prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - prime1;
+        // Main loop, the 4 lanes don't depend on each other
+        auto const* const limit = end - 32;
+        do {
+            v1 = mix_round(v1, read64(p));
+            v2 = mix_round(v2, read64(p + 8));
+            v3 = mix_round(v3, read64(p + 16));
+            v4 = mix_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h1 = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h1 = merge(merge(merge(merge(h1, v1), v2), v3), v4);
+        // The second half combines the lanes in a different order
+        h2 = rotl(v4, 1) + rotl(v3, 7) + rotl(v2, 12) + rotl(v1, 18);
+        h2 = merge(merge(merge(merge(h2, v4), v3), v2), v1);
+    }
+    else {
+        h1 = seed + prime5;
+        h2 = seed + prime4;
     }
 
-    template <typename Fn>
-    [[nodiscard]] constexpr auto operator[](Fn&& fn) const&&
-        cppcmb_noexcept_subscript(Self const&&) {
+    h1 += std::uint64_t(len);
+    h2 ^= std::uint64_t(len) * prime1;
 
-        return action_t(std::move(this->self()), cppcmb_fwd(fn));
+    // Tail
+    for (; end - p >= 8; p += 8) {
+        auto k = mix_round(0, read64(p));
+        h1 = rotl(h1 ^ k, 27) * prime1 + prime4;
+        h2 = rotl(h2 + k, 31) * prime2 + prime3;
+    }
+    if (end - p >= 4) {
+        auto k = read32(p) * prime1;
+        h1 = rotl(h1 ^ k, 23) * prime2 + prime3;
+        h2 = rotl(h2 + k, 29) * prime3 + prime5;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        auto k = std::uint64_t(*p) * prime5;
+        h1 = rotl(h1 ^ k, 11) * prime1;
+        h2 = rotl(h2 + k, 13) * prime2;
     }
-};
-
-#undef cppcmb_noexcept_subscript
 
-namespace detail {
+    h1 = avalanche(h1);
+    h2 = avalanche(h2 ^ h1);
+    return { h1, h2 };
+}
 
 /**
- * Concept check for parser interface.
+ * Hashes the contents of a string view.
  */
-template <typename T, typename Src>
-using apply_t = decltype(
-    std::declval<T>().apply(std::declval<reader<Src> const&>())
-);
-
-template <typename T, typename Src>
-inline constexpr bool has_parser_interface_v =
-       is_detected_v<apply_t, T, Src>
-    && is_combinator_v<T>;
+template <typename CharT>
+[[nodiscard]] hash128 hash_string(
+    std::basic_string_view<CharT> str, std::uint64_t seed = 0) noexcept {
+    return hash_bytes(str.data(), str.size() * sizeof(CharT), seed);
+}
 
 } /* namespace detail */
+} /* namespace cppcmb */
 
-/**
- * Every parser can use this at the beginning of the apply function to check
- * sub-parsers.
- */
-#define cppcmb_assert_parser(p, src)                  \
-static_assert(                                        \
-    ::cppcmb::detail::has_parser_interface_v<p, src>, \
-    "A parser must be derived from combinator<Self> " \
-    " and have a member function apply(reader<Src>)!" \
-    " (note: apply has to be const-qualified!)"       \
-)
+namespace cppcmb {
+namespace detail {
 
 /**
- * Helper to get the parser result.
+ * @see https://en.cppreference.com/w/cpp/experimental/nonesuch
  */
-template <typename P, typename Src>
-using parser_result_t = detail::remove_cvref_t<decltype(
-    std::declval<P>().apply(std::declval<reader<Src> const&>())
-)>;
+struct nonesuch { // NOLINT(cppcoreguidelines-special-member-functions)
+    ~nonesuch()                     = delete;
+    nonesuch(nonesuch const&)       = delete;
+    void operator=(nonesuch const&) = delete;
+};
 
 /**
- * Helper to get the result value of a parse success.
+ * @see https://en.cppreference.com/w/cpp/experimental/is_detected
  */
-template <typename P, typename Src>
-using parser_value_t = detail::remove_cvref_t<decltype(
-    std::declval<parser_result_t<P, Src>>().success().value()
-)>;
+template <typename Default, typename AlwaysVoid,
+    template <typename...> typename Op, typename... Args>
+struct detector {
+    using value_t = std::false_type;
+    using type = Default;
+};
 
-} /* namespace cppcmb */
+template <typename Default,
+    template <typename...> typename Op, typename... Args>
+struct detector<Default, std::void_t<Op<Args...>>, Op, Args...> {
+    using value_t = std::true_type;
+    using type = Op<Args...>;
+};
 
-namespace cppcmb {
+template <template <typename...> typename Op, typename... Args>
+using is_detected = typename detector<nonesuch, void, Op, Args...>::value_t;
 
-/**
- * Some type-constructor for maybe.
- */
-template <typename T>
-class some {
-public:
-    using value_type = T;
+template <template <typename...> typename Op, typename... Args>
+using detected_t = typename detector<nonesuch, void, Op, Args...>::type;
 
-private:
-    cppcmb_self_check(some);
+template <typename Default,
+    template <typename...> typename Op, typename... Args>
+using detected_or = detector<Default, void, Op, Args...>;
 
-    T m_Value;
+// Additional utilities
 
-public:
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename TFwd, cppcmb_requires_t(!is_self_v<TFwd>)>
-    constexpr some(TFwd&& val)
-        : m_Value(cppcmb_fwd(val)) {
-    }
+template <template <typename...> typename Op, typename... Args>
+inline constexpr auto is_detected_v = is_detected<Op, Args...>::value;
 
-    cppcmb_getter(value, m_Value)
-};
+template <typename Default,
+    template <typename...> typename Op, typename... Args>
+using detected_or_t = typename detected_or<Default, Op, Args...>::type;
 
-template <typename TFwd>
-some(TFwd) -> some<TFwd>;
+template <typename Expected,
+    template <typename...> typename Op, typename... Args>
+using is_detected_exact = std::is_same<Expected, detected_t<Op, Args...>>;
 
-/**
- * None type-constructor for maybe.
- */
-class none {};
+template <typename Expected,
+    template <typename...> typename Op, typename... Args>
+inline constexpr auto is_detected_exact_v =
+    is_detected_exact<Expected, Op, Args...>::value;
 
-/**
- * Generic maybe-type.
- */
-template <typename T>
-class maybe {
-public:
-    using some_type = ::cppcmb::some<T>;
-    using none_type = ::cppcmb::none;
+template <typename To, template <typename...> typename Op, typename... Args>
+using is_detected_convertible =
+    std::is_convertible<detected_t<Op, Args...>, To>;
 
-private:
-    cppcmb_self_check(maybe);
+template <typename To, template <typename...> typename Op, typename... Args>
+inline constexpr auto is_detected_convertible_v =
+    is_detected_convertible<To, Op, Args...>::value;
 
-    std::variant<some_type, none_type> m_Data;
+} /* namespace detail */
+} /* namespace cppcmb */
 
-public:
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename TFwd, cppcmb_requires_t(!is_self_v<TFwd>)>
-    constexpr maybe(TFwd&& val)
-        : m_Data(cppcmb_fwd(val)) {
-    }
+namespace cppcmb {
+namespace detail {
 
-    [[nodiscard]] constexpr bool is_some() const noexcept {
-        return std::holds_alternative<some_type>(m_Data);
-    }
+template <typename, template <typename...> typename>
+struct is_specialization : std::false_type {};
 
-    [[nodiscard]] constexpr bool is_none() const noexcept {
-        return std::holds_alternative<none_type>(m_Data);
-    }
+template <template <typename...> typename T, typename... Ts>
+struct is_specialization<T<Ts...>, T> : std::true_type {};
 
-    cppcmb_getter(some, std::get<some_type>(m_Data))
-    cppcmb_getter(none, std::get<none_type>(m_Data))
-};
+template <typename T, template <typename...> typename Templ>
+inline constexpr bool is_specialization_v = is_specialization<T, Templ>::value;
+
+} /* namespace detail */
+} /* namespace cppcmb */
 
+namespace cppcmb {
 namespace detail {
 
-cppcmb_is_specialization(maybe);
+template <typename T>
+struct remove_cvref : std::remove_cv<std::remove_reference_t<T>> {};
 
-} /* namespace detail */
+template <typename T>
+using remove_cvref_t = typename remove_cvref<T>::type;
 
+} /* namespace detail */
 } /* namespace cppcmb */
 
 namespace cppcmb {
+namespace detail {
 
 /**
- * Success "type-constructor". The type that the parser returns when it
- * succeeded.
+ * Assertion with a custom message.
  */
-template <typename T>
-class success {
-public:
-    using value_type = T;
-
-private:
-    value_type  m_Value;
-    std::size_t m_Matched;
+#define cppcmb_assert(msg, ...) assert(((void)msg, (__VA_ARGS__)))
 
-public:
-    template <typename TFwd>
-    constexpr success(TFwd&& val, std::size_t matched)
-        noexcept(std::is_nothrow_constructible_v<value_type, TFwd&&>)
-        : m_Value(cppcmb_fwd(val)), m_Matched(matched) {
-    }
+/**
+ * Panic (assertion failure) with a custom message.
+ */
+#define cppcmb_panic(msg) cppcmb_assert(msg, false)
 
-    cppcmb_getter(value, m_Value)
+/**
+ * Concatenates two tokens.
+ */
+#define cppcmb_cat(x, y) cppcmb_prelude_cat(x, y)
 
-    [[nodiscard]] constexpr auto const& matched() const noexcept {
-        return m_Matched;
-    }
-};
+/**
+ * Generates a unique identifier with a given prefix.
+ */
+#define cppcmb_unique_id(prefix) cppcmb_cat(prefix, __LINE__)
 
-template <typename TFwd>
-success(TFwd, std::size_t) -> success<TFwd>;
+/**
+ * Simplifies forwarding syntax, we don't have to provide the template argument.
+ */
+#define cppcmb_fwd(...) ::std::forward<decltype(__VA_ARGS__)>(__VA_ARGS__)
 
 /**
- * Failure "type-constructor". The type that the parser returns when it fails.
+ * A simple concept emulation macro. Does SFINAE in a safe way.
  */
-class failure { };
+#define cppcmb_requires_t(...) \
+cppcmb_prelude_requires_t1(cppcmb_unique_id(cppcmb_concept_req), __VA_ARGS__)
 
 /**
- * The result type of a parser. It's either a success or a failure type.
+ * Generates an is_self_v template variable so the types won't get littered with
+ * the same self-check code.
  */
-template <typename T>
-class result {
-public:
-    using success_type = ::cppcmb::success<T>;
-    using failure_type = ::cppcmb::failure;
+#define cppcmb_self_check(type) \
+cppcmb_prelude_self_check(type, cppcmb_unique_id(cppcmb_self_type))
 
-private:
-    using either_type = std::variant<success_type, failure_type>;
+/**
+ * Generates specialization-check for a template-type.
+ */
+#define cppcmb_is_specialization(type) \
+cppcmb_prelude_is_specialization(type, cppcmb_unique_id(cppcmb_tspec_type))
 
-    /**
-     * The packrat parsers will have to fiddle with the furthest values.
-     */
-    template <typename>
-    friend class drec_packrat_t;
-    template <typename>
-    friend class irec_packrat_t;
+/**
+ * Generates a getter with all member-qualifiers for owned values.
+ */
+#define cppcmb_getter(name, ...)                                        \
+[[nodiscard]]                                                           \
+constexpr auto& name() & noexcept(noexcept(__VA_ARGS__)) {              \
+    return __VA_ARGS__;                                                 \
+}                                                                       \
+[[nodiscard]]                                                           \
+constexpr auto const& name() const& noexcept(noexcept(__VA_ARGS__)) {   \
+    return __VA_ARGS__;                                                 \
+}                                                                       \
+[[nodiscard]]                                                           \
+constexpr auto&& name() && noexcept(noexcept(__VA_ARGS__)) {            \
+    return std::move(__VA_ARGS__);                                      \
+}                                                                       \
+[[nodiscard]]                                                           \
+constexpr auto const&& name() const&& noexcept(noexcept(__VA_ARGS__)) { \
+    return std::move(__VA_ARGS__);                                      \
+}
 
-    either_type m_Data;
-    std::size_t m_Furthest;
+/**
+ * Returns an expression with automatic noexcept qualifier. Only for computed,
+ * non-owned values.
+ */
+// XXX(LPeter1997): GCC internal compiler error
+/*
+#define cppcmb_return(...)                               \
+noexcept(noexcept(__VA_ARGS__)) -> decltype(__VA_ARGS__) \
+{ return __VA_ARGS__; }
+*/
+#define cppcmb_return(...) -> decltype(auto) { return __VA_ARGS__; }
 
-public:
-    template <typename TFwd>
-    constexpr result(TFwd&& val, std::size_t furthest)
-        noexcept(std::is_nothrow_constructible_v<either_type, TFwd&&>)
-        : m_Data(cppcmb_fwd(val)), m_Furthest(furthest) {
-    }
+// Macro details
 
-    [[nodiscard]] constexpr bool is_success() const noexcept {
-        return std::holds_alternative<success_type>(m_Data);
-    }
+#define cppcmb_prelude_cat(x, y) x ## y
 
-    [[nodiscard]] constexpr bool is_failure() const noexcept {
-        return std::holds_alternative<failure_type>(m_Data);
-    }
+#define cppcmb_prelude_requires_t1(id, ...) 						\
+bool id = false,                                                    \
+::std::enable_if_t<id || (__VA_ARGS__), ::std::nullptr_t> = nullptr
 
-    cppcmb_getter(success, std::get<success_type>(m_Data))
-    cppcmb_getter(failure, std::get<failure_type>(m_Data))
+#define cppcmb_prelude_self_check(type, id)                      \
+template <typename id>                                           \
+static constexpr bool is_self_v =                                \
+    ::std::is_same_v<::cppcmb::detail::remove_cvref_t<id>, type>
 
-    [[nodiscard]] constexpr auto const& furthest() const noexcept {
-        return m_Furthest;
-    }
-};
+#define cppcmb_prelude_is_specialization(type, id)               \
+template <typename id>                                           \
+using is_##type = ::cppcmb::detail::is_specialization<id, type>; \
+template <typename id>                                           \
+inline constexpr bool is_##type##_v = is_##type<id>::value
 
+} /* namespace detail */
 } /* namespace cppcmb */
 
 namespace cppcmb {
-
 namespace detail {
 
 /**
- * Just to improve error messages.
+ * A rough rank of how common a byte is in text, higher is more common.
  */
-struct action_apply_helper {
-    template <typename Fn, typename T>
-    constexpr auto operator()(Fn const& f, T&& v) const
-        cppcmb_return(apply_value(f, cppcmb_fwd(v)))
-};
+[[nodiscard]] constexpr int byte_rank(unsigned char b) noexcept {
+    if (b == ' ') {
+        return 6;
+    }
+    if (b >= 'a' && b <= 'z') {
+        auto frequent = std::string_view("etaoinsr");
+        return frequent.find(char(b)) != std::string_view::npos ? 5 : 4;
+    }
+    if ((b >= '0' && b <= '9') || (b >= 'A' && b <= 'Z')
+        || b == '\n' || b == '\t' || b == ',' || b == '.') {
+        return 3;
+    }
+    if (b >= 0x20 && b < 0x7f) {
+        return 2;
+    }
+    return 1;
+}
 
-} /* namespace detail */
+/**
+ * Finds the positions where a match of an automaton can start.
+ */
+class prefilter {
+public:
+    static constexpr std::size_t npos = std::size_t(-1);
+    // Longer prefixes don't skip more
+    static constexpr std::size_t max_prefix = 32;
+    // Larger first byte sets are looked up in a table
+    static constexpr std::size_t max_scan_bytes = 4;
 
-template <typename P, typename Fn>
-class action_t : public combinator<action_t<P, Fn>> {
 private:
-    P  m_Parser;
-    Fn m_Fn;
+    enum class kind { any, literal, bytes };
+
+    kind                                      m_Kind = kind::any;
+    std::string                               m_Prefix;
+    std::size_t                               m_Rare = 0;
+    std::array<bool, 256>                     m_First{};
+    std::array<unsigned char, max_scan_bytes> m_Scan{};
+    std::size_t                               m_ScanCount = 0;
+
+    [[nodiscard]] std::size_t find_literal(unsigned char const* data,
+        std::size_t len, std::size_t from) const noexcept {
+        auto const plen = m_Prefix.size();
+        auto const* prefix = m_Prefix.data();
+        auto const rare = static_cast<unsigned char>(m_Prefix[m_Rare]);
+        while (from + plen <= len) {
+            auto const* hit = static_cast<unsigned char const*>(std::memchr(
+                data + from + m_Rare, rare, len - plen - from + 1
+            ));
+            if (hit == nullptr) {
+                return npos;
+            }
+            auto cand = std::size_t(hit - data) - m_Rare;
+            if (std::memcmp(data + cand, prefix, plen) == 0) {
+                return cand;
+            }
+            from = cand + 1;
+        }
+        return npos;
+    }
 
-public:
-    // XXX(LPeter1997): Is it right to have such a long noexcept specifier?
-    template <typename PFwd, typename FnFwd>
-    constexpr action_t(PFwd&& cmb, FnFwd&& fn)
-        noexcept(
-            std::is_nothrow_constructible_v<P, PFwd&&>
-         && std::is_nothrow_constructible_v<Fn, FnFwd&&>
-        )
-        : m_Parser(cppcmb_fwd(cmb)), m_Fn(cppcmb_fwd(fn)) {
+    [[nodiscard]] std::size_t find_bytes(unsigned char const* data,
+        std::size_t len, std::size_t from) const noexcept {
+        if (m_ScanCount == 0) {
+            for (; from < len; ++from) {
+                if (m_First[data[from]]) {
+                    return from;
+                }
+            }
+            return npos;
+        }
+        for (; from < len; from += block_width) {
+            auto block = byte_block(data + from, len - from);
+            auto mask = block.eq_any(m_Scan.data(), m_ScanCount);
+            if (mask != 0) {
+                return from + bit_ctz(mask);
+            }
+        }
+        return npos;
     }
 
+public:
+    prefilter() = default;
+
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& src) const {
-        cppcmb_assert_parser(P, Src);
+    explicit prefilter(dfa const& d) {
+        if (d.accepting(d.start())) {
+            // Matches the empty string anywhere
+            return;
+        }
 
-        using value_t = parser_value_t<P, Src>;
-        using apply_t = decltype(&action_t::apply_fn<value_t&&>);
-        using fn_result_t = std::invoke_result_t<apply_t, action_t, value_t>;
-        using dispatch_tag =
-            detail::is_maybe<detail::remove_cvref_t<fn_result_t>>;
+        // Follow the start while exactly one byte leads on
+        auto s = d.start();
+        while (m_Prefix.size() < max_prefix && !d.accepting(s)) {
+            std::size_t count = 0;
+            unsigned char only = 0;
+            for (std::size_t b = 0; b < 256 && count < 2; ++b) {
+                if (d.next(s, static_cast<unsigned char>(b)) != dfa::dead) {
+                    only = static_cast<unsigned char>(b);
+                    ++count;
+                }
+            }
+            if (count != 1) {
+                break;
+            }
+            m_Prefix.push_back(static_cast<char>(only));
+            s = d.next(s, only);
+        }
+        if (!m_Prefix.empty()) {
+            m_Kind = kind::literal;
+            for (std::size_t i = 1; i < m_Prefix.size(); ++i) {
+                auto rank = [&](std::size_t j) {
+                    return byte_rank(static_cast<unsigned char>(m_Prefix[j]));
+                };
+                if (rank(i) < rank(m_Rare)) {
+                    m_Rare = i;
+                }
+            }
+            return;
+        }
 
-        return apply_impl<fn_result_t>(src, dispatch_tag());
+        m_Kind = kind::bytes;
+        std::size_t count = 0;
+        for (std::size_t b = 0; b < 256; ++b) {
+            auto ch = static_cast<unsigned char>(b);
+            m_First[b] = d.next(d.start(), ch) != dfa::dead;
+            if (m_First[b] && count++ < max_scan_bytes) {
+                m_Scan[count - 1] = ch;
+            }
+        }
+        m_ScanCount = count <= max_scan_bytes ? count : 0;
     }
 
-private:
     /**
-     * Original solution:
-     *
-     * template <typename T>
-     * using maybe_value_t = detail::remove_cvref_t<decltype(
-     *      std::declval<T>().some().value()
-     * )>;
-     *
-     * But it triggered a GCC internal compiler error.
+     * The required literal prefix of every match, might be empty.
      */
-    template <typename T>
-    using maybe_some_t = typename detail::remove_cvref_t<T>::some_type;
+    [[nodiscard]] std::string const& prefix() const noexcept {
+        return m_Prefix;
+    }
 
-    template <typename T>
-    using maybe_value_t = typename maybe_some_t<T>::value_type;
+    /**
+     * The first position from 'from' where a match can start, or npos. For
+     * patterns that can match the empty string, every position up to and
+     * including len is a candidate.
+     */
+    [[nodiscard]] std::size_t next(unsigned char const* data,
+        std::size_t len, std::size_t from) const noexcept {
+        switch (m_Kind) {
+        case kind::literal: return find_literal(data, len, from);
+        case kind::bytes:   return find_bytes(data, len, from);
+        default:            return from <= len ? from : npos;
+        }
+    }
+};
 
-    // XXX(LPeter1997): Noexcept specifier
-    // Action can fail
-    template <typename FRes, typename Src>
-    [[nodiscard]] constexpr auto apply_impl(
-        reader<Src> const& src,
-        std::true_type) const -> result<maybe_value_t<FRes>> {
+/**
+ * A match found by searching, npos begin if there's none.
+ */
+struct match_span {
+    std::size_t begin  = prefilter::npos;
+    std::size_t length = 0;
+};
 
-        using result_t = result<maybe_value_t<FRes>>;
+/**
+ * A DFA with its prefilter, finds the leftmost-longest match.
+ */
+class dfa_searcher {
+private:
+    /**
+     * An anchored run of the DFA that is still alive.
+     */
+    struct run {
+        dfa::state_type state;
+        std::size_t     begin;
+    };
 
-        auto inv = m_Parser.apply(src);
-        if (inv.is_failure()) {
-            // Early failure
-            return result_t(std::move(inv).failure(), inv.furthest());
-        }
+    dfa       m_Dfa;
+    prefilter m_Prefilter;
 
-        auto succ = std::move(inv).success();
-        // Try to apply the action
-        auto act_inv = apply_fn(std::move(succ).value());
-        // In any case we will have to decorate the result with the position
-        if (act_inv.is_none()) {
-            return result_t(failure(), inv.furthest());
-        }
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    explicit dfa_searcher(dfa d)
+        : m_Dfa(std::move(d)), m_Prefilter(m_Dfa) {
+    }
 
-        return result_t(
-            success(std::move(act_inv).some().value(), succ.matched()),
-            inv.furthest()
-        );
+    [[nodiscard]] dfa const& automaton() const noexcept {
+        return m_Dfa;
+    }
+
+    [[nodiscard]] prefilter const& filter() const noexcept {
+        return m_Prefilter;
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    // Action can't fail
-    template <typename FRes, typename Src>
-    [[nodiscard]] constexpr auto apply_impl(
-        reader<Src> const& src,
-        std::false_type) const -> result<FRes> {
+    /**
+     * Finds the first match that starts at 'from' or later. furthest is set
+     * to the number of bytes looked at.
+     *
+     * The runs from every candidate start are advanced together in one
+     * forward pass, ordered by their start. Runs that reach the same state
+     * have the same future, so only the earliest one is kept. This bounds the
+     * live runs by the number of states, so the search is linear in the
+     * input, instead of re-scanning from every failed candidate.
+     */
+    template <typename CharT>
+    [[nodiscard]] match_span search(CharT const* chars, std::size_t len,
+        std::size_t from, std::size_t& furthest) const {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        auto const* data = reinterpret_cast<unsigned char const*>(chars);
+        auto best = match_span();
+        std::vector<run> runs;
+        std::vector<run> next_runs;
+        // The position, at which a state was last taken by a run
+        std::vector<std::size_t> taken(m_Dfa.state_count(), prefilter::npos);
+
+        auto pos = from;
+        furthest = from;
+        while (true) {
+            if (runs.empty()) {
+                if (best.begin != prefilter::npos) {
+                    break;
+                }
+                pos = m_Prefilter.next(data, len, pos);
+                if (pos == prefilter::npos) {
+                    furthest = len;
+                    break;
+                }
+            }
+            // A new run starts here, unless a match started before
+            auto start = m_Dfa.start();
+            if (best.begin == prefilter::npos && taken[start] != pos) {
+                taken[start] = pos;
+                runs.push_back({ start, pos });
+                if (m_Dfa.accepting(start)) {
+                    best = { pos, 0 };
+                }
+            }
+            if (pos == len) {
+                break;
+            }
 
-        auto inv = m_Parser.apply(src);
-        if (inv.is_failure()) {
-            // Early failure
-            return result<FRes>(
-                std::move(inv).failure(),
-                inv.furthest()
-            );
+            auto b = data[pos++];
+            furthest = pos;
+            next_runs.clear();
+            for (auto const& r : runs) {
+                if (best.begin != prefilter::npos && r.begin > best.begin) {
+                    // Can't be leftmost anymore, the later runs neither
+                    break;
+                }
+                auto s = m_Dfa.next(r.state, b);
+                if (s == dfa::dead || taken[s] == pos) {
+                    continue;
+                }
+                taken[s] = pos;
+                next_runs.push_back({ s, r.begin });
+                if (m_Dfa.accepting(s) && (best.begin == prefilter::npos
+                    || r.begin < best.begin
+                    || (r.begin == best.begin
+                        && pos - r.begin > best.length))) {
+                    best = { r.begin, pos - r.begin };
+                }
+            }
+            std::swap(runs, next_runs);
         }
-
-        auto succ = std::move(inv).success();
-        // Apply the action
-        auto act_val = apply_fn(std::move(succ).value());
-        // Wrap it in a success
-        return result<FRes>(
-            success(std::move(act_val), succ.matched()),
-            inv.furthest()
-        );
-    }
-
-    // Invoke the function with a value
-    template <typename T>
-    [[nodiscard]] constexpr decltype(auto) apply_fn(T&& val) const {
-        static_assert(
-            std::is_invocable_v<detail::action_apply_helper, Fn, T&&>,
-             "The given action function must be invocable with the parser's "
-             "successful value type! "
-             "(note: the function's invocation must be const-qualified!)"
-        );
-        return apply_value(m_Fn, cppcmb_fwd(val));
+        return best;
     }
 };
 
-template <typename PFwd, typename FnFwd>
-action_t(PFwd, FnFwd) -> action_t<PFwd, FnFwd>;
-
+} /* namespace detail */
 } /* namespace cppcmb */
 
 namespace cppcmb {
+namespace detail {
 
-/**
- * A tag-type for a more uniform alternative syntax.
- * This can be put as the first element of an alternative chain so every new
- * line can start with the alternative operator. It's completely ignored.
- * Example:
- * auto parser = pass
- *             | first
- *             | second
- *             ;
- */
-struct pass_t {};
-
-inline constexpr auto pass = pass_t();
-
-template <typename P1, typename P2>
-class alt_t : public combinator<alt_t<P1, P2>> {
-private:
-    template <typename Src>
-    using value_t = sum_values_t<
-        parser_value_t<P1, Src>,
-        parser_value_t<P2, Src>
-    >;
-
-    P1 m_First;
-    P2 m_Second;
-
-public:
-    template <typename P1Fwd, typename P2Fwd>
-    constexpr alt_t(P1Fwd&& p1, P2Fwd&& p2)
-        noexcept(
-            std::is_nothrow_constructible_v<P1, P1Fwd&&>
-         && std::is_nothrow_constructible_v<P2, P2Fwd&&>
-        )
-        : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
-    }
-
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<value_t<Src>> {
-        cppcmb_assert_parser(P1, Src);
-        cppcmb_assert_parser(P2, Src);
-
-        using result_t = result<value_t<Src>>;
-
-        // Try to apply the first alternative
-        auto p1_inv = m_First.apply(r);
-        if (p1_inv.is_success()) {
-            auto p1_succ = std::move(p1_inv).success();
-            return result_t(
-                success(
-                    sum_values<value_t<Src>>(std::move(p1_succ).value()),
-                    p1_succ.matched()
-                ),
-                p1_inv.furthest()
-            );
-        }
-
-        // Try to apply the second alternative
-        auto p2_inv = m_Second.apply(r);
-        if (p2_inv.is_success()) {
-            auto p2_succ = std::move(p2_inv).success();
-            return result_t(
-                success(
-                    sum_values<value_t<Src>>(std::move(p2_succ).value()),
-                    p2_succ.matched()
-                ),
-                std::max(p1_inv.furthest(), p2_inv.furthest())
-            );
-        }
-
-        // Both failed, return the error which got further
-        auto p1_err = std::move(p1_inv).failure();
-        auto p2_err = std::move(p2_inv).failure();
-
-        if (p1_inv.furthest() > p2_inv.furthest()) {
-            return result_t(std::move(p1_err), p1_inv.furthest());
-        }
-        if (p1_inv.furthest() < p2_inv.furthest()) {
-            return result_t(std::move(p2_err), p2_inv.furthest());
-        }
-        // They got to the same distance, need to merge errors
-        // XXX(LPeter1997): Implement, for now we just return the first
-        return result_t(std::move(p1_err), p1_inv.furthest());
-    }
-};
-
-template <typename P1Fwd, typename P2Fwd>
-alt_t(P1Fwd, P2Fwd) -> alt_t<P1Fwd, P2Fwd>;
+inline constexpr unsigned unicode_block_bits = 8;
 
 /**
- * Operator for making alternatives.
+ * XID_Start
  */
-template <typename P1, typename P2,
-    cppcmb_requires_t(detail::all_combinators_cvref_v<P1, P2>)>
-[[nodiscard]] constexpr auto operator|(P1&& p1, P2&& p2)
-    cppcmb_return(alt_t(cppcmb_fwd(p1), cppcmb_fwd(p2)))
+struct xid_start_table {
+    static constexpr std::uint64_t ascii[2] = {
+        0x0000000000000000U, 0x07fffffe07fffffeU,
+    };
+
+    static constexpr std::uint8_t stage1[788] = {
+          1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,  16,
+         17,   2,  18,  19,  20,   2,  21,  22,  23,  24,  25,  26,  27,  28,   2,  29,
+         30,  31,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  32,  33,   0,   0,
+         34,  35,   0,   0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,  28,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,  36,   2,  37,  38,  39,  40,  41,  42,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,  43,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   2,  44,  45,  46,  47,  48,  49,
+         50,  51,  52,  53,  54,  55,   2,  56,  57,  58,  59,  60,  61,  62,  63,  64,
+         65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,   0,  76,  77,  78,  79,
+          2,   2,   2,  80,  81,  82,   0,   0,   0,   0,   0,   0,   0,   0,   0,  83,
+          2,   2,   2,   2,  84,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   2,   2,  85,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   2,   2,  86,  87,   0,   0,  88,  89,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,  90,   2,   2,   2,   2,  91,  92,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  93,
+          2,  94,  95,   0,   0,   0,   0,   0,   0,   0,   0,   0,  96,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,  97,  98,  99, 100,   0,   0,   0,   0,   0,   0,   0, 101,
+          0, 102, 103,   0,   0,   0,   0, 104, 105, 106,   0,   0,   0,   0, 107,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2, 108,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2, 109, 110,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2, 111,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2, 112,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   2,   2, 113,   0,   0,   0,   0,   0,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2, 114,
+    };
+
+    static constexpr std::uint64_t stage2[115][4] = {
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x07fffffe07fffffeU, 0x0420040000000000U, 0xff7fffffff7fffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000501f0003ffc3U },
+        { 0x0000000000000000U, 0xb8df000000000000U, 0xfffffffbffffd740U, 0xffbfffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xfffffffffffffc03U, 0xffffffffffffffffU },
+        { 0xfffeffffffffffffU, 0xffffffff027fffffU, 0x00000000000001ffU, 0x000787ffffff0000U },
+        { 0xffffffff00000000U, 0xfffec000000007ffU, 0xffffffffffffffffU, 0x9c00c060002fffffU },
+        { 0x0000fffffffd0000U, 0xffffffffffffe000U, 0x0002003fffffffffU, 0x043007fffffffc00U },
+        { 0x00000110043fffffU, 0xffff07ff01ffffffU, 0xffffffff00007effU, 0x00000000000003ffU },
+        { 0x23fffffffffffff0U, 0xfffe0003ff010000U, 0x23c5fdfffff99fe1U, 0x10030003b0004000U },
+        { 0x036dfdfffff987e0U, 0x001c00005e000000U, 0x23edfdfffffbbfe0U, 0x0200000300010000U },
+        { 0x23edfdfffff99fe0U, 0x00020003b0000000U, 0x03ffc718d63dc7e8U, 0x0000000000010000U },
+        { 0x23fffdfffffddfe0U, 0x0000000327000000U, 0x23effdfffffddfe1U, 0x0006000360000000U },
+        { 0x27fffffffffddff0U, 0xfc00000380704000U, 0x2ffbfffffc7fffe0U, 0x000000000000007fU },
+        { 0x0005fffffffffffeU, 0x000000000000007fU, 0x2005ffaffffff7d6U, 0x00000000f000005fU },
+        { 0x0000000000000001U, 0x00001ffffffffeffU, 0x0000000000001f00U, 0x0000000000000000U },
+        { 0x800007ffffffffffU, 0xffe1c0623c3f0000U, 0xffffffff00004003U, 0xf7ffffffffff20bfU },
+        { 0xffffffffffffffffU, 0xffffffff3d7f3dffU, 0x7f3dffffffff3dffU, 0xffffffffff7fff3dU },
+        { 0xffffffffff3dffffU, 0x0000000007ffffffU, 0xffffffff0000ffffU, 0x3f3fffffffffffffU },
+        { 0xfffffffffffffffeU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffff9fffffffffffU, 0xffffffff07fffffeU, 0x01ffc7ffffffffffU },
+        { 0x0003ffff8003ffffU, 0x0001dfff0003ffffU, 0x000fffffffffffffU, 0x0000000010800000U },
+        { 0xffffffff00000000U, 0x01ffffffffffffffU, 0xffff05ffffffffffU, 0x003fffffffffffffU },
+        { 0x000000007fffffffU, 0x001f3fffffff0000U, 0xffff0fffffffffffU, 0x00000000000003ffU },
+        { 0xffffffff007fffffU, 0x00000000001fffffU, 0x0000008000000000U, 0x0000000000000000U },
+        { 0x000fffffffffffe0U, 0x0000000000001fe0U, 0xfc00c001fffffff8U, 0x0000003fffffffffU },
+        { 0x0000000fffffffffU, 0x3ffffffffc00e000U, 0xe7ffffffffff01ffU, 0x046fde0000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000000000000U },
+        { 0xffffffff3f3fffffU, 0x3fffffffaaff3f3fU, 0x5fdfffffffffffffU, 0x1fdc1fff0fcf1fdcU },
+        { 0x0000000000000000U, 0x8002000000000000U, 0x000000001fff0000U, 0x0000000000000000U },
+        { 0xf3fffd503f2ffc84U, 0xffffffff000043e0U, 0x00000000000001ffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x000c781fffffffffU },
+        { 0xffff20bfffffffffU, 0x000080ffffffffffU, 0x7f7f7f7f007fffffU, 0x000000007f7f7f7fU },
+        { 0x1f3e03fe000000e0U, 0xfffffffffffffffeU, 0xfffffffee07fffffU, 0xf7ffffffffffffffU },
+        { 0xfffeffffffffffe0U, 0xffffffffffffffffU, 0xffffffff00007fffU, 0xffff000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000000001fffU, 0x3fffffffffff0000U },
+        { 0x00000c00ffff1fffU, 0x80007fffffffffffU, 0xffffffff3fffffffU, 0x0000ffffffffffffU },
+        { 0xfffffffcff800000U, 0xffffffffffffffffU, 0xfffffffffffff9ffU, 0xfffc000003eb07ffU },
+        { 0x00000007fffff7bbU, 0x000fffffffffffffU, 0x000ffffffffffffcU, 0x68fc000000000000U },
+        { 0xffff003ffffffc00U, 0x1fffffff0000007fU, 0x0007fffffffffff0U, 0x7c00ffdf00008000U },
+        { 0x000001ffffffffffU, 0xc47fffff00000ff7U, 0x3e62ffffffffffffU, 0x001c07ff38000005U },
+        { 0xffff7f7f007e7e7eU, 0xffff03fff7ffffffU, 0xffffffffffffffffU, 0x00000007ffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff000fffffffffU, 0x0ffffffffffff87fU },
+        { 0xffffffffffffffffU, 0xffff3fffffffffffU, 0xffffffffffffffffU, 0x0000000003ffffffU },
+        { 0x5f7ffdffa0f8007fU, 0xffffffffffffffdbU, 0x0003ffffffffffffU, 0xfffffffffff80000U },
+        { 0xffffffffffffffffU, 0xfffffff03fffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0x3fffffffffffffffU, 0xffffffffffff0000U, 0xfffffffffffcffffU, 0x03ff0000000000ffU },
+        { 0x0000000000000000U, 0xaa8a000000000000U, 0xffffffffffffffffU, 0x1fffffffffffffffU },
+        { 0x07fffffe00000000U, 0xffffffc007fffffeU, 0x7fffffff3fffffffU, 0x000000001cfcfcfcU },
+        { 0xb7ffff7fffffefffU, 0x000000003fff3fffU, 0xffffffffffffffffU, 0x07ffffffffffffffU },
+        { 0x0000000000000000U, 0x001fffffffffffffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xffffffff1fffffffU, 0x000000000001ffffU },
+        { 0xffffe000ffffffffU, 0x003fffffffff07ffU, 0xffffffff3fffffffU, 0x00000000003eff0fU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff00003fffffffU, 0x0fffffffff0fffffU },
+        { 0xffff00ffffffffffU, 0xf7ff000fffffffffU, 0x1bfbfffbffb7f7ffU, 0x0000000000000000U },
+        { 0x007fffffffffffffU, 0x000000ff003fffffU, 0x07fdffffffffffbfU, 0x0000000000000000U },
+        { 0x91bffffffffffd3fU, 0x007fffff003fffffU, 0x000000007fffffffU, 0x0037ffff00000000U },
+        { 0x03ffffff003fffffU, 0x0000000000000000U, 0xc0ffffffffffffffU, 0x0000000000000000U },
+        { 0x003ffffffeef0001U, 0x1fffffff00000000U, 0x000000001fffffffU, 0x0000001ffffffeffU },
+        { 0x003fffffffffffffU, 0x0007ffff003fffffU, 0x000000000003ffffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000001ffU, 0x0007ffffffffffffU, 0x0007ffffffffffffU },
+        { 0x0000000fffffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x000303ffffffffffU, 0x0000000000000000U },
+        { 0xffff00801fffffffU, 0xffff00000000003fU, 0xffff000000000003U, 0x007fffff0000001fU },
+        { 0x00fffffffffffff8U, 0x0026000000000000U, 0x0000fffffffffff8U, 0x000001ffffff0000U },
+        { 0x0000007ffffffff8U, 0x0047ffffffff0090U, 0x0007fffffffffff8U, 0x000000001400001eU },
+        { 0x00000ffffffbffffU, 0x0000000000000000U, 0xffff01ffbfffbd7fU, 0x000000007fffffffU },
+        { 0x23edfdfffff99fe0U, 0x00000003e0010000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x001fffffffffffffU, 0x0000000380000780U, 0x0000ffffffffffffU, 0x00000000000000b0U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x00007fffffffffffU, 0x000000000f000000U },
+        { 0x0000ffffffffffffU, 0x0000000000000010U, 0x010007ffffffffffU, 0x0000000000000000U },
+        { 0x0000000007ffffffU, 0x000000000000007fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x00000fffffffffffU, 0x0000000000000000U, 0xffffffff00000000U, 0x80000000ffffffffU },
+        { 0x8000ffffff6ff27fU, 0x0000000000000002U, 0xfffffcff00000000U, 0x0000000a0001ffffU },
+        { 0x0407fffffffff801U, 0xfffffffff0010000U, 0xffff0000200003ffU, 0x01ffffffffffffffU },
+        { 0x00007ffffffffdffU, 0xfffc000000000001U, 0x000000000000ffffU, 0x0000000000000000U },
+        { 0x0001fffffffffb7fU, 0xfffffdbf00000040U, 0x00000000010003ffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0007ffff00000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0001000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000003ffffffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00007fffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0x000000000000000fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xffffffffffff0000U, 0x0001ffffffffffffU },
+        { 0x00007fffffffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x000000000000007fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x01ffffffffffffffU, 0xffff00007fffffffU, 0x7fffffffffffffffU, 0x00003fffffff0000U },
+        { 0x0000ffffffffffffU, 0xe0fffff80000000fU, 0x000000000000ffffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0xffffffffffffffffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000107ffU, 0x00000000fff80000U, 0x0000000b00000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00ffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000000003fffffU },
+        { 0x00000000000001ffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x6fef000000000000U },
+        { 0x00000007ffffffffU, 0xffff00f000070000U, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0fffffffffffffffU },
+        { 0xffffffffffffffffU, 0x1fff07ffffffffffU, 0x0000000003ff01ffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffdfffffU, 0xebffde64dfffffffU, 0xffffffffffffffefU },
+        { 0x7bffffffdfdfe7bfU, 0xfffffffffffdfc5fU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffff3fffffffffU, 0xf7fffffff7fffffdU },
+        { 0xffdfffffffdfffffU, 0xffff7fffffff7fffU, 0xfffffdfffffffdffU, 0x0000000000000ff7U },
+        { 0x000000007fffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x3f801fffffffffffU, 0x0000000000004000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x00003fffffff0000U, 0x00000fffffffffffU },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x7fff6f7f00000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x000000000000001fU },
+        { 0xffffffffffffffffU, 0x000000000000080fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0af7fe96ffffffefU, 0x5ef7f796aa96ea84U, 0x0ffffbee0ffffbffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000000ffffffffU },
+        { 0x01ffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffff3fffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff0003ffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000001ffffffffU },
+        { 0x000000003fffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000007ffU, 0x0000000000000000U, 0x0000000000000000U },
+    };
+};
 
 /**
- * Ignore pass.
+ * XID_Continue
  */
-template <typename P2,
-    cppcmb_requires_t(detail::is_combinator_cvref_v<P2>)>
-[[nodiscard]] constexpr auto operator|(pass_t, P2&& p2)
-    cppcmb_return(cppcmb_fwd(p2))
-
-} /* namespace cppcmb */
-
-// XXX(LPeter1997): We could check the collection for push_back (better errors)
-
-namespace cppcmb {
+struct xid_continue_table {
+    static constexpr std::uint64_t ascii[2] = {
+        0x03ff000000000000U, 0x07fffffe87fffffeU,
+    };
+
+    static constexpr std::uint8_t stage1[3586] = {
+          1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,  16,
+         17,   2,  18,  19,  20,   2,  21,  22,  23,  24,  25,  26,  27,   2,   2,  28,
+         29,  30,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  31,  32,   0,   0,
+         33,  34,   0,   0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,  35,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,  36,   2,  37,  38,  39,  40,  41,  42,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,  43,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   2,  44,  45,  46,  47,  48,  49,
+         50,  51,  52,  53,  54,  55,   2,  56,  57,  58,  59,  60,  61,  62,  63,  64,
+         65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,   0,  76,  77,  78,  79,
+          2,   2,   2,  80,  81,  82,   0,   0,   0,   0,   0,   0,   0,   0,   0,  83,
+          2,   2,   2,   2,  84,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   2,   2,  85,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   2,   2,  86,  87,   0,   0,  88,  89,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,  90,   2,   2,   2,   2,  91,  92,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  93,
+          2,  94,  95,   0,   0,   0,   0,   0,   0,   0,   0,   0,  96,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  97,
+          0,  98,  99,   0, 100, 101, 102, 103,   0,   0, 104,   0,   0,   0,   0, 105,
+        106, 107, 108,   0,   0,   0,   0, 109, 110, 111,   0,   0,   0,   0, 112,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, 113,   0,   0,   0,   0,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2, 114,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2, 115, 116,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2, 117,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2, 118,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   2,   2, 119,   0,   0,   0,   0,   0,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2, 120,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0, 121,
+    };
+
+    static constexpr std::uint64_t stage2[122][4] = {
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x03ff000000000000U, 0x07fffffe87fffffeU, 0x04a0040000000000U, 0xff7fffffff7fffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000501f0003ffc3U },
+        { 0xffffffffffffffffU, 0xb8dfffffffffffffU, 0xfffffffbffffd7c0U, 0xffbfffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xfffffffffffffcfbU, 0xffffffffffffffffU },
+        { 0xfffeffffffffffffU, 0xffffffff027fffffU, 0xbffffffffffe01ffU, 0x000787ffffff00b6U },
+        { 0xffffffff07ff0000U, 0xffffc3ffffffffffU, 0xffffffffffffffffU, 0x9ffffdff9fefffffU },
+        { 0xffffffffffff0000U, 0xffffffffffffe7ffU, 0x0003ffffffffffffU, 0x243fffffffffffffU },
+        { 0x00003fffffffffffU, 0xffff07ff0fffffffU, 0xffffffffff007effU, 0xfffffffbffffffffU },
+        { 0xffffffffffffffffU, 0xfffeffcfffffffffU, 0xf3c5fdfffff99fefU, 0x5003ffcfb080799fU },
+        { 0xd36dfdfffff987eeU, 0x003fffc05e023987U, 0xf3edfdfffffbbfeeU, 0xfe00ffcf00013bbfU },
+        { 0xf3edfdfffff99feeU, 0x0002ffcfb0e0399fU, 0xc3ffc718d63dc7ecU, 0x0000ffc000813dc7U },
+        { 0xf3fffdfffffddfffU, 0x0000ffcf27603ddfU, 0xf3effdfffffddfefU, 0x0006ffcf60603ddfU },
+        { 0xfffffffffffddfffU, 0xfc00ffcf80f07ddfU, 0x2ffbfffffc7fffeeU, 0x000cffc0ff5f847fU },
+        { 0x07fffffffffffffeU, 0x0000000003ff7fffU, 0x3fffffaffffff7d6U, 0x00000000f3ff3f5fU },
+        { 0xc2a003ff03000001U, 0xfffe1ffffffffeffU, 0x1ffffffffeffffdfU, 0x0000000000000040U },
+        { 0xffffffffffffffffU, 0xffffffffffff03ffU, 0xffffffff3fffffffU, 0xf7ffffffffff20bfU },
+        { 0xffffffffffffffffU, 0xffffffff3d7f3dffU, 0x7f3dffffffff3dffU, 0xffffffffff7fff3dU },
+        { 0xffffffffff3dffffU, 0x0003fe00e7ffffffU, 0xffffffff0000ffffU, 0x3f3fffffffffffffU },
+        { 0xfffffffffffffffeU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffff9fffffffffffU, 0xffffffff07fffffeU, 0x01ffc7ffffffffffU },
+        { 0x001fffff803fffffU, 0x000ddfff000fffffU, 0xffffffffffffffffU, 0x000003ff308fffffU },
+        { 0xffffffff03ffb800U, 0x01ffffffffffffffU, 0xffff07ffffffffffU, 0x003fffffffffffffU },
+        { 0x0fff0fff7fffffffU, 0x001f3fffffffffc0U, 0xffff0fffffffffffU, 0x0000000007ff03ffU },
+        { 0xffffffff0fffffffU, 0x9fffffff7fffffffU, 0xbfff008003ff03ffU, 0x0000000000007fffU },
+        { 0xffffffffffffffffU, 0x000ff80003ff1fffU, 0xffffffffffffffffU, 0x000fffffffffffffU },
+        { 0x00ffffffffffffffU, 0x3fffffffffffe3ffU, 0xe7ffffffffff01ffU, 0x07fffffffff70000U },
+        { 0xffffffff3f3fffffU, 0x3fffffffaaff3f3fU, 0x5fdfffffffffffffU, 0x1fdc1fff0fcf1fdcU },
+        { 0x8000000000000000U, 0x8002000000100001U, 0x000000001fff0000U, 0x0001ffe21fff0000U },
+        { 0xf3fffd503f2ffc84U, 0xffffffff000043e0U, 0x00000000000001ffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x000ff81fffffffffU },
+        { 0xffff20bfffffffffU, 0x800080ffffffffffU, 0x7f7f7f7f007fffffU, 0xffffffff7f7f7f7fU },
+        { 0x1f3efffe000000e0U, 0xfffffffffffffffeU, 0xfffffffee67fffffU, 0xf7ffffffffffffffU },
+        { 0xfffeffffffffffe0U, 0xffffffffffffffffU, 0xffffffff00007fffU, 0xffff000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000000001fffU, 0x3fffffffffff0000U },
+        { 0x00000fffffff1fffU, 0xbff0ffffffffffffU, 0xffffffffffffffffU, 0x0003ffffffffffffU },
+        { 0xfffffffcff800000U, 0xffffffffffffffffU, 0xfffffffffffff9ffU, 0xfffc000003eb07ffU },
+        { 0x000010ffffffffffU, 0x000fffffffffffffU, 0xffffffffffffffffU, 0xe8ffffff03ff003fU },
+        { 0xffff3fffffffffffU, 0x1fffffff000fffffU, 0xffffffffffffffffU, 0x7fffffff03ff8001U },
+        { 0x007fffffffffffffU, 0xfc7fffff03ff3fffU, 0xffffffffffffffffU, 0x007cffff38000007U },
+        { 0xffff7f7f007e7e7eU, 0xffff03fff7ffffffU, 0xffffffffffffffffU, 0x03ff37ffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff000fffffffffU, 0x0ffffffffffff87fU },
+        { 0xffffffffffffffffU, 0xffff3fffffffffffU, 0xffffffffffffffffU, 0x0000000003ffffffU },
+        { 0x5f7ffdffe0f8007fU, 0xffffffffffffffdbU, 0x0003ffffffffffffU, 0xfffffffffff80000U },
+        { 0xffffffffffffffffU, 0xfffffff03fffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0x3fffffffffffffffU, 0xffffffffffff0000U, 0xfffffffffffcffffU, 0x03ff0000000000ffU },
+        { 0x0018ffff0000ffffU, 0xaa8a00000000e000U, 0xffffffffffffffffU, 0x1fffffffffffffffU },
+        { 0x87fffffe03ff0000U, 0xffffffc007fffffeU, 0x7fffffffffffffffU, 0x000000001cfcfcfcU },
+        { 0xb7ffff7fffffefffU, 0x000000003fff3fffU, 0xffffffffffffffffU, 0x07ffffffffffffffU },
+        { 0x0000000000000000U, 0x001fffffffffffffU, 0x0000000000000000U, 0x2000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xffffffff1fffffffU, 0x000000010001ffffU },
+        { 0xffffe000ffffffffU, 0x07ffffffffff07ffU, 0xffffffff3fffffffU, 0x00000000003eff0fU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff03ff3fffffffU, 0x0fffffffff0fffffU },
+        { 0xffff00ffffffffffU, 0xf7ff000fffffffffU, 0x1bfbfffbffb7f7ffU, 0x0000000000000000U },
+        { 0x007fffffffffffffU, 0x000000ff003fffffU, 0x07fdffffffffffbfU, 0x0000000000000000U },
+        { 0x91bffffffffffd3fU, 0x007fffff003fffffU, 0x000000007fffffffU, 0x0037ffff00000000U },
+        { 0x03ffffff003fffffU, 0x0000000000000000U, 0xc0ffffffffffffffU, 0x0000000000000000U },
+        { 0x873ffffffeeff06fU, 0x1fffffff00000000U, 0x000000001fffffffU, 0x0000007ffffffeffU },
+        { 0x003fffffffffffffU, 0x0007ffff003fffffU, 0x000000000003ffffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000001ffU, 0x0007ffffffffffffU, 0x0007ffffffffffffU },
+        { 0x03ff00ffffffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x00031bffffffffffU, 0x0000000000000000U },
+        { 0xffff00801fffffffU, 0xffff00000001ffffU, 0xffff00000000003fU, 0x007fffff0000001fU },
+        { 0xffffffffffffffffU, 0x803fffc00000007fU, 0x07ffffffffffffffU, 0x03ff01ffffff0004U },
+        { 0xffdfffffffffffffU, 0x004fffffffff00f0U, 0xffffffffffffffffU, 0x0000000017ffde1fU },
+        { 0x40fffffffffbffffU, 0x0000000000000000U, 0xffff01ffbfffbd7fU, 0x03ff07ffffffffffU },
+        { 0xfbedfdfffff99fefU, 0x001f1fcfe081399fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000003c3ff07ffU, 0xffffffffffffffffU, 0x0000000003ff00bfU },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xff3fffffffffffffU, 0x000000003f000001U },
+        { 0xffffffffffffffffU, 0x0000000003ff0011U, 0x01ffffffffffffffU, 0x00000000000003ffU },
+        { 0x03ff0fffe7ffffffU, 0x000000000000007fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x07ffffffffffffffU, 0x0000000000000000U, 0xffffffff00000000U, 0x800003ffffffffffU },
+        { 0xf9bfffffff6ff27fU, 0x0000000003ff000fU, 0xfffffcff00000000U, 0x0000001bfcffffffU },
+        { 0x7fffffffffffffffU, 0xffffffffffff0080U, 0xffff000023ffffffU, 0x01ffffffffffffffU },
+        { 0xff7ffffffffffdffU, 0xfffc000003ff0001U, 0x007ffefffffcffffU, 0x0000000000000000U },
+        { 0xb47ffffffffffb7fU, 0xfffffdbf03ff00ffU, 0x000003ff01fb7fffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x007fffff00000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0001000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000003ffffffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00007fffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0x000000000000000fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xffffffffffff0000U, 0x0001ffffffffffffU },
+        { 0x00007fffffffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x000000000000007fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x01ffffffffffffffU, 0xffff03ff7fffffffU, 0x7fffffffffffffffU, 0x001f3fffffff03ffU },
+        { 0x007fffffffffffffU, 0xe0fffff803ff000fU, 0x000000000000ffffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0xffffffffffffffffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffff87ffU, 0x00000000ffff80ffU, 0x0003001b00000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00ffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000000003fffffU },
+        { 0x00000000000001ffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x6fef000000000000U },
+        { 0x00000007ffffffffU, 0xffff00f000070000U, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0fffffffffffffffU },
+        { 0xffffffffffffffffU, 0x1fff07ffffffffffU, 0x0000000063ff01ffU, 0x0000000000000000U },
+        { 0xffff3fffffffffffU, 0x000000000000007fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0xf807e3e000000000U, 0x00003c0000000fe7U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x000000000000001cU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffdfffffU, 0xebffde64dfffffffU, 0xffffffffffffffefU },
+        { 0x7bffffffdfdfe7bfU, 0xfffffffffffdfc5fU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffff3fffffffffU, 0xf7fffffff7fffffdU },
+        { 0xffdfffffffdfffffU, 0xffff7fffffff7fffU, 0xfffffdfffffffdffU, 0xffffffffffffcff7U },
+        { 0xf87fffffffffffffU, 0x00201fffffffffffU, 0x0000fffef8000010U, 0x0000000000000000U },
+        { 0x000000007fffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x000007dbf9ffff7fU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x3fff1fffffffffffU, 0x00000000000043ffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x00007fffffff0000U, 0x03ffffffffffffffU },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x7fff6f7f00000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000000007f001fU },
+        { 0xffffffffffffffffU, 0x0000000003ff0fffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0af7fe96ffffffefU, 0x5ef7f796aa96ea84U, 0x0ffffbee0ffffbffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x03ff000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000000ffffffffU },
+        { 0x01ffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffff3fffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff0003ffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000001ffffffffU },
+        { 0x000000003fffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000007ffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000ffffffffffffU },
+    };
+};
 
 /**
- * A type-pack that describes a collection except it's type.
- * Used for the many and many1 combinators.
+ * General_Category=L
  */
-template <
-    template <typename...> typename Coll,
-    template <typename> typename... Ts
->
-struct collect_to_t {
-    template <typename T>
-    using type = Coll<T, Ts<T>...>;
+struct letter_table {
+    static constexpr std::uint64_t ascii[2] = {
+        0x0000000000000000U, 0x07fffffe07fffffeU,
+    };
+
+    static constexpr std::uint8_t stage1[788] = {
+          1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,  16,
+         17,   2,  18,  19,  20,   2,  21,  22,  23,  24,  25,  26,  27,  28,   2,  29,
+         30,  31,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  32,  33,  34,   0,
+         35,  36,   0,   0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,  28,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,  37,   2,  38,  39,  40,  41,  42,  43,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,  44,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   2,  45,  46,   2,  47,  48,  49,
+         50,   0,  51,  52,  53,  54,   2,  55,  56,  57,  58,  59,  60,  61,  62,  63,
+         64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,   0,  75,  76,  77,  78,
+          2,   2,   2,  79,  80,  81,   0,   0,   0,   0,   0,   0,   0,   0,   0,  82,
+          2,   2,   2,   2,  83,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   2,   2,  84,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   2,   2,  85,  86,   0,   0,  87,  88,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,  89,   2,   2,   2,   2,  90,  91,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  92,
+          2,  93,  94,   0,   0,   0,   0,   0,   0,   0,   0,   0,  95,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,  96,  97,  98,  99,   0,   0,   0,   0,   0,   0,   0, 100,
+          0, 101, 102,   0,   0,   0,   0, 103, 104, 105,   0,   0,   0,   0, 106,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2, 107,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2, 108, 109,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2, 110,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2, 111,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   2,   2, 112,   0,   0,   0,   0,   0,
+          2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+          2,   2,   2, 113,
+    };
+
+    static constexpr std::uint64_t stage2[114][4] = {
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x07fffffe07fffffeU, 0x0420040000000000U, 0xff7fffffff7fffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000501f0003ffc3U },
+        { 0x0000000000000000U, 0xbcdf000000000000U, 0xfffffffbffffd740U, 0xffbfffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xfffffffffffffc03U, 0xffffffffffffffffU },
+        { 0xfffeffffffffffffU, 0xffffffff027fffffU, 0x00000000000001ffU, 0x000787ffffff0000U },
+        { 0xffffffff00000000U, 0xfffec000000007ffU, 0xffffffffffffffffU, 0x9c00c060002fffffU },
+        { 0x0000fffffffd0000U, 0xffffffffffffe000U, 0x0002003fffffffffU, 0x043007fffffffc00U },
+        { 0x00000110043fffffU, 0xffff07ff01ffffffU, 0xffffffff00007effU, 0x00000000000003ffU },
+        { 0x23fffffffffffff0U, 0xfffe0003ff010000U, 0x23c5fdfffff99fe1U, 0x10030003b0004000U },
+        { 0x036dfdfffff987e0U, 0x001c00005e000000U, 0x23edfdfffffbbfe0U, 0x0200000300010000U },
+        { 0x23edfdfffff99fe0U, 0x00020003b0000000U, 0x03ffc718d63dc7e8U, 0x0000000000010000U },
+        { 0x23fffdfffffddfe0U, 0x0000000327000000U, 0x23effdfffffddfe1U, 0x0006000360000000U },
+        { 0x27fffffffffddff0U, 0xfc00000380704000U, 0x2ffbfffffc7fffe0U, 0x000000000000007fU },
+        { 0x000dfffffffffffeU, 0x000000000000007fU, 0x200dffaffffff7d6U, 0x00000000f000005fU },
+        { 0x0000000000000001U, 0x00001ffffffffeffU, 0x0000000000001f00U, 0x0000000000000000U },
+        { 0x800007ffffffffffU, 0xffe1c0623c3f0000U, 0xffffffff00004003U, 0xf7ffffffffff20bfU },
+        { 0xffffffffffffffffU, 0xffffffff3d7f3dffU, 0x7f3dffffffff3dffU, 0xffffffffff7fff3dU },
+        { 0xffffffffff3dffffU, 0x0000000007ffffffU, 0xffffffff0000ffffU, 0x3f3fffffffffffffU },
+        { 0xfffffffffffffffeU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffff9fffffffffffU, 0xffffffff07fffffeU, 0x01fe07ffffffffffU },
+        { 0x0003ffff8003ffffU, 0x0001dfff0003ffffU, 0x000fffffffffffffU, 0x0000000010800000U },
+        { 0xffffffff00000000U, 0x01ffffffffffffffU, 0xffff05ffffffff9fU, 0x003fffffffffffffU },
+        { 0x000000007fffffffU, 0x001f3fffffff0000U, 0xffff0fffffffffffU, 0x00000000000003ffU },
+        { 0xffffffff007fffffU, 0x00000000001fffffU, 0x0000008000000000U, 0x0000000000000000U },
+        { 0x000fffffffffffe0U, 0x0000000000001fe0U, 0xfc00c001fffffff8U, 0x0000003fffffffffU },
+        { 0x0000000fffffffffU, 0x3ffffffffc00e000U, 0xe7ffffffffff01ffU, 0x046fde0000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000000000000U },
+        { 0xffffffff3f3fffffU, 0x3fffffffaaff3f3fU, 0x5fdfffffffffffffU, 0x1fdc1fff0fcf1fdcU },
+        { 0x0000000000000000U, 0x8002000000000000U, 0x000000001fff0000U, 0x0000000000000000U },
+        { 0xf3ffbd503e2ffc84U, 0x00000000000043e0U, 0x0000000000000018U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x000c781fffffffffU },
+        { 0xffff20bfffffffffU, 0x000080ffffffffffU, 0x7f7f7f7f007fffffU, 0x000000007f7f7f7fU },
+        { 0x0000800000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x183e000000000060U, 0xfffffffffffffffeU, 0xfffffffee07fffffU, 0xf7ffffffffffffffU },
+        { 0xfffeffffffffffe0U, 0xffffffffffffffffU, 0xffffffff00007fffU, 0xffff000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000000001fffU, 0x3fffffffffff0000U },
+        { 0x00000c00ffff1fffU, 0x80007fffffffffffU, 0xffffffff3fffffffU, 0x0000003fffffffffU },
+        { 0xfffffffcff800000U, 0xffffffffffffffffU, 0xfffffffffffff9ffU, 0xfffc000003eb07ffU },
+        { 0x00000007fffff7bbU, 0x000fffffffffffffU, 0x000ffffffffffffcU, 0x68fc000000000000U },
+        { 0xffff003ffffffc00U, 0x1fffffff0000007fU, 0x0007fffffffffff0U, 0x7c00ffdf00008000U },
+        { 0x000001ffffffffffU, 0xc47fffff00000ff7U, 0x3e62ffffffffffffU, 0x001c07ff38000005U },
+        { 0xffff7f7f007e7e7eU, 0xffff03fff7ffffffU, 0xffffffffffffffffU, 0x00000007ffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff000fffffffffU, 0x0ffffffffffff87fU },
+        { 0xffffffffffffffffU, 0xffff3fffffffffffU, 0xffffffffffffffffU, 0x0000000003ffffffU },
+        { 0x5f7ffdffa0f8007fU, 0xffffffffffffffdbU, 0x0003ffffffffffffU, 0xfffffffffff80000U },
+        { 0x3fffffffffffffffU, 0xffffffffffff0000U, 0xfffffffffffcffffU, 0x0fff0000000000ffU },
+        { 0x0000000000000000U, 0xffdf000000000000U, 0xffffffffffffffffU, 0x1fffffffffffffffU },
+        { 0x07fffffe00000000U, 0xffffffc007fffffeU, 0x7fffffffffffffffU, 0x000000001cfcfcfcU },
+        { 0xb7ffff7fffffefffU, 0x000000003fff3fffU, 0xffffffffffffffffU, 0x07ffffffffffffffU },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xffffffff1fffffffU, 0x000000000001ffffU },
+        { 0xffffe000ffffffffU, 0x003fffffffff03fdU, 0xffffffff3fffffffU, 0x000000000000ff0fU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff00003fffffffU, 0x0fffffffff0fffffU },
+        { 0xffff00ffffffffffU, 0xf7ff000fffffffffU, 0x1bfbfffbffb7f7ffU, 0x0000000000000000U },
+        { 0x007fffffffffffffU, 0x000000ff003fffffU, 0x07fdffffffffffbfU, 0x0000000000000000U },
+        { 0x91bffffffffffd3fU, 0x007fffff003fffffU, 0x000000007fffffffU, 0x0037ffff00000000U },
+        { 0x03ffffff003fffffU, 0x0000000000000000U, 0xc0ffffffffffffffU, 0x0000000000000000U },
+        { 0x003ffffffeef0001U, 0x1fffffff00000000U, 0x000000001fffffffU, 0x0000001ffffffeffU },
+        { 0x003fffffffffffffU, 0x0007ffff003fffffU, 0x000000000003ffffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000001ffU, 0x0007ffffffffffffU, 0x0007ffffffffffffU },
+        { 0x0000000fffffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x000303ffffffffffU, 0x0000000000000000U },
+        { 0xffff00801fffffffU, 0xffff00000000003fU, 0xffff000000000003U, 0x007fffff0000001fU },
+        { 0x00fffffffffffff8U, 0x0026000000000000U, 0x0000fffffffffff8U, 0x000001ffffff0000U },
+        { 0x0000007ffffffff8U, 0x0047ffffffff0090U, 0x0007fffffffffff8U, 0x000000001400001eU },
+        { 0x00000ffffffbffffU, 0x0000000000000000U, 0xffff01ffbfffbd7fU, 0x000000007fffffffU },
+        { 0x23edfdfffff99fe0U, 0x00000003e0010000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x001fffffffffffffU, 0x0000000380000780U, 0x0000ffffffffffffU, 0x00000000000000b0U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x00007fffffffffffU, 0x000000000f000000U },
+        { 0x0000ffffffffffffU, 0x0000000000000010U, 0x010007ffffffffffU, 0x0000000000000000U },
+        { 0x0000000007ffffffU, 0x000000000000007fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x00000fffffffffffU, 0x0000000000000000U, 0xffffffff00000000U, 0x80000000ffffffffU },
+        { 0x8000ffffff6ff27fU, 0x0000000000000002U, 0xfffffcff00000000U, 0x0000000a0001ffffU },
+        { 0x0407fffffffff801U, 0xfffffffff0010000U, 0xffff0000200003ffU, 0x01ffffffffffffffU },
+        { 0x00007ffffffffdffU, 0xfffc000000000001U, 0x000000000000ffffU, 0x0000000000000000U },
+        { 0x0001fffffffffb7fU, 0xfffffdbf00000040U, 0x00000000010003ffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0007ffff00000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0001000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0000000003ffffffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0x000000000000000fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0xffffffffffff0000U, 0x0001ffffffffffffU },
+        { 0x00007fffffffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x000000000000007fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x01ffffffffffffffU, 0xffff00007fffffffU, 0x7fffffffffffffffU, 0x00003fffffff0000U },
+        { 0x0000ffffffffffffU, 0xe0fffff80000000fU, 0x000000000000ffffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0xffffffffffffffffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000107ffU, 0x00000000fff80000U, 0x0000000b00000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00ffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000000003fffffU },
+        { 0x00000000000001ffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x6fef000000000000U },
+        { 0x00000007ffffffffU, 0xffff00f000070000U, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x0fffffffffffffffU },
+        { 0xffffffffffffffffU, 0x1fff07ffffffffffU, 0x0000000003ff01ffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffdfffffU, 0xebffde64dfffffffU, 0xffffffffffffffefU },
+        { 0x7bffffffdfdfe7bfU, 0xfffffffffffdfc5fU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffff3fffffffffU, 0xf7fffffff7fffffdU },
+        { 0xffdfffffffdfffffU, 0xffff7fffffff7fffU, 0xfffffdfffffffdffU, 0x0000000000000ff7U },
+        { 0x000000007fffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x3f801fffffffffffU, 0x0000000000004000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x00003fffffff0000U, 0x00000fffffffffffU },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x7fff6f7f00000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x000000000000001fU },
+        { 0xffffffffffffffffU, 0x000000000000080fU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0af7fe96ffffffefU, 0x5ef7f796aa96ea84U, 0x0ffffbee0ffffbffU, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000000ffffffffU },
+        { 0x01ffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffff3fffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffff0003ffffffffU, 0xffffffffffffffffU },
+        { 0xffffffffffffffffU, 0xffffffffffffffffU, 0xffffffffffffffffU, 0x00000001ffffffffU },
+        { 0x000000003fffffffU, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0xffffffffffffffffU, 0x00000000000007ffU, 0x0000000000000000U, 0x0000000000000000U },
+    };
 };
 
-template <
-    template <typename...> typename Coll,
-    template <typename> typename... Ts
->
-inline constexpr auto collect_to = collect_to_t<Coll, Ts...>();
-
-namespace detail {
-
 /**
- * Tag-type for many and many1.
+ * General_Category=Nd
  */
-struct many_tag {};
+struct digit_table {
+    static constexpr std::uint64_t ascii[2] = {
+        0x03ff000000000000U, 0x0000000000000000U,
+    };
+
+    static constexpr std::uint8_t stage1[508] = {
+          1,   0,   0,   0,   0,   0,   2,   3,   0,   4,   4,   4,   4,   4,   5,   6,
+          7,   0,   0,   0,   0,   0,   0,   8,   9,  10,  11,  12,  13,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   6,   0,  14,  15,  16,  17,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   9,
+          0,   0,   0,   0,  18,   0,   0,   0,   0,   0,   0,   0,   0,   1,   0,   0,
+         19,  20,  17,   0,   5,   0,  21,   1,   8,  16,   0,   0,  16,  22,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  23,  16,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,  24,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,  25,  17,   0,   0,   0,   0,   0,   0,  16,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  17,
+    };
+
+    static constexpr std::uint64_t stage2[26][4] = {
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x03ff000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x000003ff00000000U, 0x0000000000000000U, 0x03ff000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x00000000000003ffU },
+        { 0x0000000000000000U, 0x0000ffc000000000U, 0x0000000000000000U, 0x0000ffc000000000U },
+        { 0x0000000000000000U, 0x0000000003ff0000U, 0x0000000000000000U, 0x0000000003ff0000U },
+        { 0x000003ff00000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x00000000000003ffU, 0x0000000003ff0000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x000003ff00000000U },
+        { 0x0000000003ff0000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x000000000000ffc0U, 0x0000000000000000U, 0x0000000003ff0000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000003ff03ffU, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000003ff0000U, 0x03ff000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000003ff03ffU, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000003ff0000U },
+        { 0x00000000000003ffU, 0x0000000000000000U, 0x0000000000000000U, 0x03ff000003ff0000U },
+        { 0x0000000000000000U, 0x0000000003ff0000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x03ff000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x000003ff00000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000ffc000000000U, 0x0000000000000000U, 0x03ff000000000000U },
+        { 0xffc0000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000003ff0000U },
+        { 0x0000000000000000U, 0x0000000003ff0000U, 0x0000000000000000U, 0x00000000000003ffU },
+        { 0x0000000000000000U, 0x0000000003ff0000U, 0x000003ff00000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x000003ff00000000U, 0x0000000000000000U, 0x00000000000003ffU },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0xffffffffffffc000U },
+        { 0x0000000000000000U, 0x00000000000003ffU, 0x0000000000000000U, 0x0000000000000000U },
+    };
+};
 
 /**
- * SFINAE for many types.
+ * General_Category=Zs
  */
-template <typename T>
-inline constexpr bool is_many_v = std::is_base_of_v<many_tag, T>;
+struct space_table {
+    static constexpr std::uint64_t ascii[2] = {
+        0x0000000100000000U, 0x0000000000000000U,
+    };
+
+    static constexpr std::uint8_t stage1[49] = {
+          1,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          0,   0,   0,   0,   0,   0,   2,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          3,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+          4,
+    };
+
+    static constexpr std::uint64_t stage2[5][4] = {
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000100000000U, 0x0000000000000000U, 0x0000000100000000U, 0x0000000000000000U },
+        { 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000001U, 0x0000000000000000U },
+        { 0x00008000000007ffU, 0x0000000080000000U, 0x0000000000000000U, 0x0000000000000000U },
+        { 0x0000000000000001U, 0x0000000000000000U, 0x0000000000000000U, 0x0000000000000000U },
+    };
+};
 
 } /* namespace detail */
+} /* namespace cppcmb */
 
-template <typename P, typename To = collect_to_t<std::vector>>
-class many_t : public combinator<many_t<P>>,
-               private detail::many_tag {
+namespace cppcmb {
+
+template <typename... Ts>
+class product {
 private:
-    cppcmb_self_check(many_t);
+    using tuple_type = decltype(std::make_tuple(std::declval<Ts>()...));
 
-    template <typename Src>
-    using value_t = typename To::template type<parser_value_t<P, Src>>;
+    cppcmb_self_check(product);
 
-    P m_Parser;
+    tuple_type m_Value;
 
 public:
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr many_t(PFwd&& p)
-        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
-        : m_Parser(cppcmb_fwd(p)) {
+    static constexpr auto index_sequence =
+        std::make_index_sequence<sizeof...(Ts)>();
+
+    template <typename T,
+        cppcmb_requires_t(sizeof...(Ts) == 1 && !is_self_v<T>)>
+    constexpr product(T&& val)
+        noexcept(std::is_nothrow_constructible_v<tuple_type, T&&>)
+        : m_Value(cppcmb_fwd(val)) {
     }
 
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) &
-        cppcmb_return(many_t<P, To2>(m_Parser))
+    template <typename... Us, cppcmb_requires_t(sizeof...(Us) != 1)>
+    constexpr product(Us&&... vals)
+        noexcept(std::is_nothrow_constructible_v<tuple_type, Us&&...>)
+        : m_Value(cppcmb_fwd(vals)...) {
+    }
 
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) const&
-        cppcmb_return(many_t<P, To2>(m_Parser))
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) &&
-        cppcmb_return(many_t<P, To2>(std::move(m_Parser)))
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) const&&
-        cppcmb_return(many_t<P, To2>(std::move(m_Parser)))
+    template <std::size_t Idx>
+    [[nodiscard]] constexpr auto& get() & noexcept {
+        return std::get<Idx>(m_Value);
+    }
+    template <std::size_t Idx>
+    [[nodiscard]] constexpr auto const& get() const& noexcept {
+        return std::get<Idx>(m_Value);
+    }
+    template <std::size_t Idx>
+    [[nodiscard]] constexpr auto&& get() && noexcept {
+        return std::get<Idx>(std::move(m_Value));
+    }
+    template <std::size_t Idx>
+    [[nodiscard]] constexpr auto const&& get() const&& noexcept {
+        return std::get<Idx>(std::move(m_Value));
+    }
 
-    cppcmb_getter(underlying, m_Parser)
+    cppcmb_getter(as_tuple, m_Value)
+};
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<value_t<Src>> {
-        cppcmb_assert_parser(P, Src);
+template <typename... Ts>
+product(Ts...) -> product<Ts...>;
 
-        using result_t = result<value_t<Src>>;
-
-        std::size_t furthest = 0U;
-        std::size_t matched = 0U;
-        auto coll = value_t<Src>();
-        auto rr = r;
-        while (true) {
-            auto p_inv = m_Parser.apply(rr);
-            furthest = std::max(furthest, matched + p_inv.furthest());
-            if (p_inv.is_failure()) {
-                // Stop applying
-                break;
-            }
-            auto p_succ = std::move(p_inv).success();
-            matched += p_succ.matched();
-            // Add to collection
-            coll.push_back(std::move(p_succ).value());
-            // Move reader
-            rr.seek(rr.cursor() + p_succ.matched());
-        }
-        return result_t(success(std::move(coll), matched), furthest);
-    }
-};
-
-template <typename PFwd>
-many_t(PFwd) -> many_t<PFwd>;
+// To fix a GCC bug
+template <typename T, typename... Ts>
+product(T, Ts...) -> product<T, Ts...>;
 
 /**
- * Operator for making many parser.
+ * Make products comparable.
  */
-template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
-[[nodiscard]] constexpr auto operator*(P&& p)
-    cppcmb_return(many_t(cppcmb_fwd(p)))
+template <typename... Ts, typename... Us>
+[[nodiscard]] constexpr auto operator==(
+    product<Ts...> const& l,
+    product<Us...> const& r
+) cppcmb_return(l.as_tuple() == r.as_tuple())
 
-/**
- * Operator to collect 'many' and 'many1' to a different container.
- */
-template <typename P, typename To,
-    cppcmb_requires_t(detail::is_many_v<detail::remove_cvref_t<P>>)>
-[[nodiscard]] constexpr auto operator>>(P&& p, To to)
-    cppcmb_return(cppcmb_fwd(p).collect_to(to))
+template <typename... Ts, typename... Us>
+[[nodiscard]] constexpr auto operator!=(
+    product<Ts...> const& l,
+    product<Us...> const& r
+) cppcmb_return(l.as_tuple() != r.as_tuple())
 
-} /* namespace cppcmb */
+namespace detail {
 
-namespace cppcmb {
+cppcmb_is_specialization(product);
 
-template <typename P, typename To = collect_to_t<std::vector>>
-class many1_t : public combinator<many1_t<P>>,
-                private detail::many_tag {
-private:
-    cppcmb_self_check(many1_t);
+// Base-case for sizeof...(Ts) != 1
+template <typename... Ts>
+[[nodiscard]]
+constexpr auto product_values_impl(product<Ts...>&& res) noexcept {
+    // XXX(LPeter1997): Is this right?
+    // XXX(LPeter1997): Is the noexcept specifier right?
+    return std::move(res);
+}
 
-    template <typename Src>
-    using value_t = parser_value_t<many_t<P, To>, Src>;
+// Base-case for exactly one element
+// XXX(LPeter1997): Noexcept specifier
+template <typename T>
+[[nodiscard]] constexpr auto product_values_impl(product<T>&& res) {
+    return std::move(res).template get<0>();
+}
 
-    many_t<P, To> m_Parser;
+// XXX(LPeter1997): Noexcept specifier
+template <typename... Ts, typename Head, typename... Tail>
+[[nodiscard]] constexpr auto
+product_values_impl(product<Ts...>&& res, Head&& h, Tail&&... t);
 
-public:
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr many1_t(PFwd&& p)
-        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
-        : m_Parser(many_t<P, To>(cppcmb_fwd(p))) {
-    }
+// XXX(LPeter1997): Noexcept specifier
+template <std::size_t... Is, typename... Ts, typename Head, typename... Tail>
+[[nodiscard]] constexpr auto product_values_expand(
+    std::index_sequence<Is...>,
+    product<Ts...>&& res, Head&& h, Tail&&... t) {
 
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) &
-        cppcmb_return(many1_t<P, To2>(m_Parser.underlying()))
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) const&
-        cppcmb_return(many1_t<P, To2>(m_Parser.underlying()))
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) &&
-        cppcmb_return(many1_t<P, To2>(std::move(m_Parser).underlying()))
-    template <typename To2>
-    [[nodiscard]] constexpr auto collect_to(To2) const&&
-        cppcmb_return(many1_t<P, To2>(std::move(m_Parser).underlying()))
+    return product_values_impl(
+        std::move(res),
+        cppcmb_fwd(h).template get<Is>()...,
+        cppcmb_fwd(t)...
+    );
+}
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<value_t<Src>> {
-        cppcmb_assert_parser(P, Src);
+// XXX(LPeter1997): Noexcept specifier
+template <std::size_t... Is, typename... Ts, typename Head, typename... Tail>
+[[nodiscard]] constexpr auto product_values_append(
+    std::index_sequence<Is...>,
+    product<Ts...>&& res, Head&& h, Tail&&... t) {
 
-        using result_t = result<value_t<Src>>;
+    return product_values_impl(
+        product(std::move(res).template get<Is>()..., cppcmb_fwd(h)),
+        cppcmb_fwd(t)...
+    );
+}
 
-        auto p_inv = m_Parser.apply(r);
+// XXX(LPeter1997): Noexcept specifier
+template <typename... Ts, typename Head, typename... Tail>
+[[nodiscard]] constexpr auto product_values_head(
+    std::true_type,
+    product<Ts...>&& res, Head&& h, Tail&&... t) {
 
-        cppcmb_assert(
-            "The underlying 'many' parser must always succeed!",
-            p_inv.is_success()
-        );
+    return product_values_expand(
+        remove_cvref_t<Head>::index_sequence,
+        std::move(res),
+        cppcmb_fwd(h),
+        cppcmb_fwd(t)...
+    );
+}
 
-        auto p_succ = std::move(p_inv).success();
-        if (p_succ.value().size() > 0) {
-            // Succeed
-            return result_t(std::move(p_succ), p_inv.furthest());
-        }
-        // Fail
-        return result_t(failure(), p_inv.furthest());
-    }
-};
+// XXX(LPeter1997): Noexcept specifier
+template <typename... Ts, typename Head, typename... Tail>
+[[nodiscard]] constexpr auto product_values_head(
+    std::false_type,
+    product<Ts...>&& res, Head&& h, Tail&&... t) {
 
-template <typename PFwd>
-many1_t(PFwd) -> many1_t<PFwd>;
+    return product_values_append(
+        product<Ts...>::index_sequence,
+        std::move(res),
+        cppcmb_fwd(h),
+        cppcmb_fwd(t)...
+    );
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename... Ts, typename Head, typename... Tail>
+[[nodiscard]] constexpr auto
+product_values_impl(product<Ts...>&& res, Head&& h, Tail&&... t) {
+    return product_values_head(
+        is_product<remove_cvref_t<Head>>(),
+        std::move(res),
+        cppcmb_fwd(h),
+        cppcmb_fwd(t)...
+    );
+}
+
+} /* namespace detail */
 
+// XXX(LPeter1997): Noexcept specifier
 /**
- * Operator for making many1 parser.
+ * Concatenate products and values.
  */
-template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
-[[nodiscard]] constexpr auto operator+(P&& p)
-    cppcmb_return(many1_t(cppcmb_fwd(p)))
+template <typename... Ts>
+[[nodiscard]] constexpr auto product_values(Ts&&... vs) {
+    // XXX(LPeter1997): GCC bug
+    return detail::product_values_impl(product<>(), cppcmb_fwd(vs)...);
+}
 
 } /* namespace cppcmb */
 
 namespace cppcmb {
 
-class one_t : public combinator<one_t> {
-public:
-    // XXX(LPeter1997): Do we need typename here?
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<typename reader<Src>::value_type> {
+template <typename... Ts>
+class sum {
+private:
+    using variant_type = std::variant<Ts...>;
 
-        using result_t = result<typename reader<Src>::value_type>;
+    cppcmb_self_check(sum);
 
-        if (r.is_end()) {
-            // Nothing to consume
-            return result_t(failure(), 0U);
-        }
-        // Consume an element
-        return result_t(success(r.current(), 1U), 1U);
+    variant_type m_Value;
+
+public:
+    template <typename T, cppcmb_requires_t(!is_self_v<T>)>
+    constexpr sum(T&& val)
+        noexcept(std::is_nothrow_constructible_v<variant_type, T&&>)
+        : m_Value(cppcmb_fwd(val)) {
+    }
+
+    template <typename U>
+    [[nodiscard]] constexpr auto& get() & {
+        return std::get<U>(m_Value);
+    }
+    template <typename U>
+    [[nodiscard]] constexpr auto const& get() const& {
+        return std::get<U>(m_Value);
+    }
+    template <typename U>
+    [[nodiscard]] constexpr auto&& get() && {
+        return std::get<U>(std::move(m_Value));
+    }
+    template <typename U>
+    [[nodiscard]] constexpr auto const&& get() const&& {
+        return std::get<U>(std::move(m_Value));
     }
+
+    cppcmb_getter(as_variant, m_Value)
 };
 
-// Value for 'one' parser
-inline constexpr one_t one = one_t();
+/**
+ * Make sums comparable.
+ */
+template <typename... Ts>
+[[nodiscard]] constexpr auto operator==(
+    sum<Ts...> const& l,
+    sum<Ts...> const& r
+) cppcmb_return(l.as_variant() == r.as_variant())
 
-} /* namespace cppcmb */
+template <typename... Ts>
+[[nodiscard]] constexpr auto operator!=(
+    sum<Ts...> const& l,
+    sum<Ts...> const& r
+) cppcmb_return(l.as_variant() != r.as_variant())
 
-namespace cppcmb {
+namespace detail {
 
-template <typename P1, typename P2>
-class seq_t : public combinator<seq_t<P1, P2>> {
-private:
-    template <typename Src>
-    using value_t = decltype(product_values(
-        std::declval<parser_value_t<P1, Src>>(),
-        std::declval<parser_value_t<P2, Src>>()
-    ));
+cppcmb_is_specialization(sum);
 
-    P1 m_First;
-    P2 m_Second;
+template <typename T, typename... Ts>
+inline constexpr bool contains_type_v = (... || std::is_same_v<T, Ts>);
 
-public:
-    template <typename P1Fwd, typename P2Fwd>
-    constexpr seq_t(P1Fwd&& p1, P2Fwd&& p2)
-        noexcept(
-            std::is_nothrow_constructible_v<P1, P1Fwd&&>
-         && std::is_nothrow_constructible_v<P2, P2Fwd&&>
-        )
-        : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
-    }
+////////////////////////////////////////////////////
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<value_t<Src>> {
-        cppcmb_assert_parser(P1, Src);
-        cppcmb_assert_parser(P2, Src);
+template <typename...>
+struct sum_values_t_impl;
 
-        using result_t = result<value_t<Src>>;
+template <typename T>
+struct sum_values_t_impl<sum<T>> {
+    using type = T;
+};
 
-        auto p1_inv = m_First.apply(r);
-        if (p1_inv.is_failure()) {
-            // Early failure, don't continue
-            return result_t(std::move(p1_inv).failure(), p1_inv.furthest());
-        }
-        // Get the success alternative
-        auto p1_succ = std::move(p1_inv).success();
-        // Create the next reader
-        auto r2 = reader(
-            r.source(), r.cursor() + p1_succ.matched(), r.context_ptr()
-        );
-        // Invoke the second parser
-        auto p2_inv = m_Second.apply(r2);
-        // Max peek distance
-        auto max_furthest = std::max(
-            p1_inv.furthest(),
-            p1_succ.matched() + p2_inv.furthest()
-        );
-        if (p2_inv.is_failure()) {
-            // Second failed, fail on that error
-            return result_t(
-                std::move(p2_inv).failure(),
-                max_furthest
-            );
-        }
-        // Get the success alternative
-        auto p2_succ = std::move(p2_inv).success();
-        // Combine the values
-        return result_t(
-            success(
-                product_values(
-                    std::move(p1_succ).value(),
-                    std::move(p2_succ).value()
-                ),
-                p1_succ.matched() + p2_succ.matched()
-            ),
-            max_furthest
-        );
-    }
+template <typename... Ts>
+struct sum_values_t_impl<sum<Ts...>> {
+    using type = sum<Ts...>;
 };
 
-template <typename P1Fwd, typename P2Fwd>
-seq_t(P1Fwd, P2Fwd) -> seq_t<P1Fwd, P2Fwd>;
+template <typename... Ts, typename... Us, typename... Vs>
+struct sum_values_t_impl<sum<Ts...>, sum<Us...>, Vs...> {
+    using type = typename sum_values_t_impl<sum<Ts...>, Us..., Vs...>::type;
+};
 
-/**
- * Operator for making a sequence.
- */
-template <typename P1, typename P2,
-    cppcmb_requires_t(detail::all_combinators_cvref_v<P1, P2>)>
-[[nodiscard]] constexpr auto operator&(P1&& p1, P2&& p2)
-    cppcmb_return(seq_t(cppcmb_fwd(p1), cppcmb_fwd(p2)))
+template <typename... Ts, typename Head, typename... Tail>
+struct sum_values_t_impl<sum<Ts...>, Head, Tail...> {
+    using type = std::conditional_t<
+        contains_type_v<Head, Ts...>,
+        typename sum_values_t_impl<sum<Ts...>, Tail...>::type,
+        typename sum_values_t_impl<sum<Ts..., Head>, Tail...>::type
+    >;
+};
+
+} /* namespace detail */
+
+template <typename... Ts>
+using sum_values_t = typename detail::sum_values_t_impl<sum<>, Ts...>::type;
+
+namespace detail {
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename RetT, typename T>
+constexpr auto sum_values_impl(std::false_type, T&& val) {
+    return RetT(cppcmb_fwd(val));
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename RetT, typename T>
+constexpr decltype(auto) sum_values_impl(std::true_type, T&& val) {
+    return std::visit(
+        [](auto&& v) -> RetT { return RetT(cppcmb_fwd(v)); },
+        cppcmb_fwd(val).as_variant()
+    );
+}
+
+} /* namespace detail */
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename... Ts, typename T>
+constexpr auto sum_values(T&& val) {
+    return detail::sum_values_impl<sum_values_t<Ts...>>(
+        detail::is_sum<detail::remove_cvref_t<T>>(),
+        cppcmb_fwd(val)
+    );
+}
 
 } /* namespace cppcmb */
 
 namespace cppcmb {
 
-template <typename Pred>
-class filter {
-private:
-    cppcmb_self_check(filter);
+namespace detail {
 
-    template <typename... Ts>
-    using value_t = decltype(product_values(
-        std::declval<Ts>()...
-    ));
+// XXX(LPeter1997): Noexcept specifier
+// Arg is a product
+template <typename Fn, typename T>
+[[nodiscard]] constexpr decltype(auto) apply_value_impl(
+    std::true_type,
+    std::false_type,
+    Fn&& fn, T&& arg) {
 
-    Pred m_Predicate;
+    return std::apply(
+        cppcmb_fwd(fn), cppcmb_fwd(arg).as_tuple()
+    );
+}
+
+// XXX(LPeter1997): Noexcept specifier
+// Arg is a sum
+template <typename Fn, typename T>
+[[nodiscard]] constexpr decltype(auto) apply_value_impl(
+    std::false_type,
+    std::true_type,
+    Fn&& fn, T&& arg) {
+
+    return std::visit(
+        cppcmb_fwd(fn), cppcmb_fwd(arg).as_variant()
+    );
+}
+
+// XXX(LPeter1997): Noexcept specifier
+// Arg is a single value
+template <typename Fn, typename T>
+[[nodiscard]] constexpr decltype(auto) apply_value_impl(
+    std::false_type,
+    std::false_type,
+    Fn&& fn, T&& arg) {
+
+    return cppcmb_fwd(fn)(cppcmb_fwd(arg));
+}
+
+} /* namespace detail */
+
+// XXX(LPeter1997): Noexcept specifier
+// XXX(LPeter1997): Make apply recursive, so that underlying sums or
+// products can get unwrapped too
+template <typename Fn, typename T>
+[[nodiscard]] constexpr decltype(auto) apply_value(Fn&& fn, T&& arg) {
+    return detail::apply_value_impl(
+        detail::is_product<detail::remove_cvref_t<T>>(),
+        detail::is_sum<detail::remove_cvref_t<T>>(),
+        cppcmb_fwd(fn),
+        cppcmb_fwd(arg)
+    );
+}
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
 
+/**
+ * An open-addressed hash table of shared, immutable values. The values stay
+ * alive as long as anything refers to them, even after the pool is cleared
+ * or destroyed.
+ */
+template <typename T, typename Hash = std::hash<T>,
+    typename Eq = std::equal_to<T>>
+class hash_cons_pool {
 public:
-    template <typename PredFwd, cppcmb_requires_t(!is_self_v<PredFwd>)>
-    constexpr filter(PredFwd&& pred)
-        noexcept(std::is_nothrow_constructible_v<Pred, PredFwd&&>)
-        : m_Predicate(cppcmb_fwd(pred)) {
-    }
+    using value_type   = T;
+    using pointer_type = std::shared_ptr<T const>;
+
+private:
+    static constexpr std::size_t empty = std::size_t(-1);
+
+    struct slot {
+        std::size_t   index = empty;
+        // The low bits of the hash, to skip most comparisons
+        std::uint32_t hash  = 0;
+    };
+
+    std::vector<slot>         m_Slots;
+    std::vector<pointer_type> m_Values;
+    std::vector<std::size_t>  m_Hashes;
+    Hash                      m_Hash;
+    Eq                        m_Eq;
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename... Ts>
-    [[nodiscard]] constexpr auto operator()(Ts&&... args) const
-        -> maybe<value_t<Ts&&...>> {
-        static_assert(
-            std::is_invocable_v<Pred, Ts&&...>,
-            "The predicate must be invocable with the parser value!"
-        );
-        using result_t = std::invoke_result_t<Pred, Ts&&...>;
-        static_assert(
-            std::is_convertible_v<result_t, bool>,
-            "The predicate must return a type that is convertible to bool!"
+    void grow() {
+        auto slots = std::vector<slot>(
+            m_Slots.empty() ? 64 : m_Slots.size() * 2
         );
-
-        if (m_Predicate(args...)) {
-            // Predicate returned true, succeed
-            return some(product_values(cppcmb_fwd(args)...));
+        auto const mask = slots.size() - 1;
+        for (auto const& s : m_Slots) {
+            if (s.index == empty) {
+                continue;
+            }
+            auto i = m_Hashes[s.index] & mask;
+            while (slots[i].index != empty) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = s;
         }
-        // Predicate failed, fail
-        return none();
+        m_Slots = std::move(slots);
     }
-};
 
-template <typename PredFwd>
-filter(PredFwd) -> filter<PredFwd>;
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The slot of the value, or the empty slot where it would be inserted.
+     */
+    [[nodiscard]] std::size_t probe(T const& value, std::size_t h) const {
+        auto const mask = m_Slots.size() - 1;
+        auto i = h & mask;
+        while (true) {
+            auto const& s = m_Slots[i];
+            if (s.index == empty || (s.hash == std::uint32_t(h)
+                && m_Eq(*m_Values[s.index], value))) {
+                return i;
+            }
+            i = (i + 1) & mask;
+        }
+    }
 
-} /* namespace cppcmb */
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    explicit hash_cons_pool(Hash hash = Hash(), Eq eq = Eq())
+        : m_Hash(std::move(hash)), m_Eq(std::move(eq)) {
+    }
 
-// XXX(LPeter1997): There is probably a bug with Clang where selecting nothing
-// from product<> fails. The JSON example (other repo right now) shows that at
-// line 127
+    /**
+     * The number of distinct values.
+     */
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_Values.size();
+    }
 
-namespace cppcmb {
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The shared value equal to the argument, it's only copied into the pool
+     * if it's not there yet.
+     */
+    template <typename TFwd>
+    pointer_type intern(TFwd&& value) {
+        // Keep the load factor under 1/2
+        if (2 * (m_Values.size() + 1) > m_Slots.size()) {
+            grow();
+        }
+        auto h = std::size_t(m_Hash(value));
+        auto& s = m_Slots[probe(value, h)];
+        if (s.index == empty) {
+            s.index = m_Values.size();
+            s.hash = std::uint32_t(h);
+            m_Values.push_back(std::make_shared<T const>(cppcmb_fwd(value)));
+            m_Hashes.push_back(h);
+        }
+        return m_Values[s.index];
+    }
 
-template <std::size_t... Ns>
-class select_t {
-public:
     // XXX(LPeter1997): Noexcept specifier
-    template <typename... Ts>
-    [[nodiscard]] constexpr decltype(auto) operator()(Ts&&... args) const {
-        return product_values(
-            std::get<Ns>(std::tuple(cppcmb_fwd(args)...))...
-        );
+    /**
+     * Forgets every value, like between parses. The values that are still
+     * referenced stay valid.
+     */
+    void clear() {
+        m_Slots.clear();
+        m_Values.clear();
+        m_Hashes.clear();
     }
 };
 
-template <std::size_t... Ns>
-inline constexpr auto select = select_t<Ns...>();
-
 } /* namespace cppcmb */
 
 namespace cppcmb {
 
-namespace detail {
-namespace regex {
+template <typename T, std::size_t Capacity>
+class inline_vector {
+public:
+    using value_type     = T;
+    using size_type      = std::size_t;
+    using iterator       = T*;
+    using const_iterator = T const*;
 
-/**
- * <top>           ::= <term> '|' <top>
- *                   | <term>
- *                   ;
- *
- * <term>          ::= <factor> <term>
- *                   | <factor>
- *                   ;
- *
- * <factor>        ::= <atom> '*'
- *                   | <atom> '+'
- *                   | <atom> '?'
- *                   | <atom>
- *                   ;
- *
- * <atom>          ::= '(' <top> ')'
- *                   | '[' <char_grouping> ']'
- *                   | <literal>
- *                   ;
- *
- * <char_grouping> ::= <group_element> <char_grouping>
- *                   | <group_element>
- *                   ;
- *
- * <group_element> ::= '\' '-'
- *                   | <literal> '-' <literal>
- *                   | <literal>
- *                   ;
- *
- * <literal>       ::= CHAR
- *                   | '\' SPECIAL_CHAR
- *                   ;
- */
+private:
+    // Zero-sized arrays are not allowed
+    static constexpr std::size_t storage_count = Capacity > 0 ? Capacity : 1;
 
-template <char Ch>
-constexpr bool is_char(char c) { return c == Ch; }
+    alignas(T) unsigned char m_Storage[sizeof(T) * storage_count];
+    std::size_t m_Size = 0;
 
-template <char Ch>
-inline constexpr auto ch = one[filter(is_char<Ch>)][select<>];
+public:
+    inline_vector() noexcept = default;
 
-template <char Ch1, char Ch2>
-constexpr bool is_range(char c) {
-    static_assert(Ch1 <= Ch2);
-    return c >= Ch1 && c <= Ch2;
-}
+    // XXX(LPeter1997): Noexcept specifier
+    inline_vector(inline_vector const& o) {
+        for (auto const& e : o) {
+            push_back(e);
+        }
+    }
 
-template <char Ch1, char Ch2>
-inline constexpr auto range = one[filter(is_range<Ch1, Ch2>)][select<>];
+    inline_vector(inline_vector&& o)
+        noexcept(std::is_nothrow_move_constructible_v<T>) {
+        for (auto& e : o) {
+            push_back(std::move(e));
+        }
+    }
 
-// XXX(LPeter1997): We publish something like this in the API
-/**
- * A dummy collection interface.
- */
-template <typename>
-class drop_collection {
-private:
-    std::size_t cnt = 0;
+    // XXX(LPeter1997): Noexcept specifier
+    inline_vector& operator=(inline_vector const& o) {
+        if (this != &o) {
+            clear();
+            for (auto const& e : o) {
+                push_back(e);
+            }
+        }
+        return *this;
+    }
 
-public:
+    inline_vector& operator=(inline_vector&& o)
+        noexcept(std::is_nothrow_move_constructible_v<T>) {
+        if (this != &o) {
+            clear();
+            for (auto& e : o) {
+                push_back(std::move(e));
+            }
+        }
+        return *this;
+    }
+
+    ~inline_vector() {
+        clear();
+    }
+
+    [[nodiscard]] static constexpr std::size_t capacity() noexcept {
+        return Capacity;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_Size; }
+    [[nodiscard]] bool empty() const noexcept { return m_Size == 0; }
+    [[nodiscard]] bool full() const noexcept { return m_Size == Capacity; }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    [[nodiscard]] T* data() noexcept {
+        return std::launder(reinterpret_cast<T*>(m_Storage));
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    [[nodiscard]] T const* data() const noexcept {
+        return std::launder(reinterpret_cast<T const*>(m_Storage));
+    }
+
+    [[nodiscard]] iterator begin() noexcept { return data(); }
+    [[nodiscard]] const_iterator begin() const noexcept { return data(); }
+    [[nodiscard]] iterator end() noexcept { return data() + m_Size; }
+    [[nodiscard]] const_iterator end() const noexcept {
+        return data() + m_Size;
+    }
+
+    [[nodiscard]] T& operator[](std::size_t idx) noexcept {
+        cppcmb_assert("Index out of bounds!", idx < m_Size);
+        return data()[idx];
+    }
+    [[nodiscard]] T const& operator[](std::size_t idx) const noexcept {
+        cppcmb_assert("Index out of bounds!", idx < m_Size);
+        return data()[idx];
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
     template <typename TFwd>
-    constexpr void push_back(TFwd&&) noexcept {
-        ++cnt;
+    void push_back(TFwd&& val) {
+        cppcmb_assert("push_back() on a full inline_vector!", !full());
+        ::new (static_cast<void*>(m_Storage + sizeof(T) * m_Size))
+            T(cppcmb_fwd(val));
+        ++m_Size;
     }
 
-    [[nodiscard]] constexpr std::size_t size() const noexcept { return cnt; }
+    void clear() noexcept {
+        for (std::size_t i = 0; i < m_Size; ++i) {
+            data()[i].~T();
+        }
+        m_Size = 0;
+    }
 };
 
+template <typename T, std::size_t C1, std::size_t C2>
+[[nodiscard]] bool operator==(
+    inline_vector<T, C1> const& l,
+    inline_vector<T, C2> const& r) {
+
+    if (l.size() != r.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < l.size(); ++i) {
+        if (!(l[i] == r[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T, std::size_t C1, std::size_t C2>
+[[nodiscard]] bool operator!=(
+    inline_vector<T, C1> const& l,
+    inline_vector<T, C2> const& r) {
+
+    return !(l == r);
+}
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
 /**
- * Succeeds when the underlying character-parser fails. Can only be used with
- * single character parsers!
+ * Concept for the reader source.
+ * The reader has to have:
+ *  - An operator[](std::size_t) that returns the element at the given index
+ *  - A .size() member or size(source) that returns the length of the source
  */
-template <typename P>
-class not_char : public combinator<not_char<P>> {
-private:
-    cppcmb_self_check(not_char);
 
-    P m_Parser;
+template <typename T>
+using element_at_t = decltype(std::declval<T>()[std::declval<std::size_t>()]);
+
+template <typename T>
+using msize_t = decltype(std::size(std::declval<T>()));
+
+// Readable source concept for the reader
+template <typename T>
+inline constexpr bool is_reader_source_v =
+       is_detected_v<element_at_t, T>
+    && is_detected_v<msize_t, T>;
+
+template <typename T>
+using mdata_t = decltype(std::data(std::declval<T const&>()));
+
+/**
+ * Sources that store their elements contiguously (like std::basic_string_view)
+ * can be scanned in bulk instead of element-by-element.
+ */
+template <typename T>
+inline constexpr bool is_contiguous_source_v = is_detected_v<mdata_t, T>;
+
+} /* namespace detail */
+
+class memo_context;
 
+template <typename Src>
+class reader {
 public:
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr not_char(PFwd&& p)
-        : m_Parser(cppcmb_fwd(p)) {
+    static_assert(
+        detail::is_reader_source_v<Src>,
+        "The reader source must have a subscript operator [std::size_t] and a "
+        "size() member function!"
+    );
+
+private:
+    Src const*    m_Source  = nullptr;
+    std::size_t   m_Cursor  = 0U;
+    memo_context* m_MemoCtx = nullptr;
+
+public:
+    using value_type = detail::remove_cvref_t<decltype((*m_Source)[m_Cursor])>;
+
+    constexpr reader() noexcept = default;
+
+    constexpr reader(Src const& src, std::size_t idx, memo_context* t) noexcept
+        : m_Source(::std::addressof(src)), m_MemoCtx(t) {
+        seek(idx);
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<product<>> {
-        cppcmb_assert_parser(P, Src);
+    constexpr reader(Src const& src, std::size_t idx, memo_context& t) noexcept
+        : reader(src, idx, &t) {
+    }
 
-        using result_t = result<product<>>;
+    constexpr reader(Src const& src, std::size_t idx = 0U) noexcept
+        : reader(src, idx, nullptr) {
+    }
 
-        auto inv = m_Parser.apply(r);
-        if (inv.is_success()) {
-            // We fail
-            return result_t(failure(), inv.furthest());
-        }
-        // We succeed
-        return result_t(success(product<>(), 1), inv.furthest());
+    constexpr reader(Src const& src, memo_context& t) noexcept
+        : reader(src, 0U, t) {
     }
-};
 
-template <typename PFwd>
-not_char(PFwd) -> not_char<PFwd>;
+    // Just to avoid nasty bugs
+    reader(Src const&& src, std::size_t idx, memo_context* t) = delete;
 
-struct parser {
-    template <typename T>
-    [[nodiscard]] static constexpr auto star(T p) noexcept {
-        return action_t((*p >> collect_to<drop_collection>), select<>);
+    [[nodiscard]] constexpr auto* source_ptr() const noexcept {
+        return m_Source;
     }
 
-    template <typename T>
-    [[nodiscard]] static constexpr auto plus(T p) noexcept {
-        return action_t((+p >> collect_to<drop_collection>), select<>);
+    [[nodiscard]] constexpr auto const& source() const noexcept {
+        cppcmb_assert(
+            "A reader without a source can't return a source-reference!",
+            source_ptr() != nullptr
+        );
+        return *source_ptr();
     }
 
-    template <typename T>
-    [[nodiscard]] static constexpr auto qmark(T p) noexcept {
-        return action_t(-p, select<>);
+    [[nodiscard]] constexpr auto const& cursor() const noexcept {
+        return m_Cursor;
     }
 
-    template <typename T>
-    static constexpr bool is_failure(T) {
-        return std::is_same_v<remove_cvref_t<T>, failure>;
+    [[nodiscard]] constexpr bool is_end() const noexcept {
+        return cursor() >= std::size(source());
     }
 
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr char char_at(Src src) noexcept {
-        return src()[Idx];
+    // Sources (like views) are allowed to return their elements by value
+    [[nodiscard]] constexpr decltype(auto) current() const noexcept {
+        cppcmb_assert(
+            "current() can only be invoked when the cursor is not past the "
+            "elements!",
+            cursor() < std::size(source())
+        );
+        return (*m_Source)[cursor()];
     }
 
-    [[nodiscard]] static constexpr bool is_special(char ch) noexcept {
-        return ch == '(' || ch == ')'
-            || ch == '[' || ch == ']'
-            || ch == '*' || ch == '+'
-            || ch == '|' || ch == '?'
-            || ch == '\\'
-            ;
+    constexpr void seek(std::size_t idx) noexcept {
+        cppcmb_assert(
+            "seek() argument must be in the bounds of source!",
+            idx <= std::size(source())
+        );
+        m_Cursor = idx;
     }
 
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto top(Src src) noexcept {
-        constexpr auto lhs = term<Idx>(src);
-        static_assert(!is_failure(lhs));
-        constexpr std::size_t NextIdx = Idx + lhs.matched();
-        if constexpr (char_at<NextIdx>(src) == '|') {
-            constexpr auto rhs = top<NextIdx + 1>(src);
-            static_assert(!is_failure(rhs));
-            return success(
-                lhs.value() | rhs.value(),
-                lhs.matched() + 1 + rhs.matched()
-            );
-        }
-        else {
-            return lhs;
-        }
+    constexpr void next() noexcept {
+        seek(cursor() + 1);
     }
 
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto term(Src src) noexcept {
-        constexpr auto lhs = factor<Idx>(src);
-        static_assert(!is_failure(lhs));
-        constexpr std::size_t NextIdx = Idx + lhs.matched();
-        return term_impl<NextIdx>(lhs, src);
+    [[nodiscard]] constexpr auto* context_ptr() const noexcept {
+        return m_MemoCtx;
     }
 
-    template <std::size_t Idx, typename Res, typename Src>
-    [[nodiscard]] static constexpr auto term_impl(Res res, Src src) noexcept {
-        if constexpr (src().size() <= Idx) {
-            return res;
-        }
-        else {
+    [[nodiscard]] constexpr auto& context() const noexcept {
+        cppcmb_assert(
+            "A memo-context must be assigned before accessing it!",
+            m_MemoCtx != nullptr
+        );
+        return *context_ptr();
+    }
+};
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+/**
+ * A tag-type for every combinator, so it's easier to check inheritance.
+ */
+class combinator_base {};
+
+} /* namespace detail */
+
+/**
+ * Check if a type correctly derives from the combinator base.
+ * The user actually has to derive from combinator<Self>, but that already
+ * derives from combinator base, so this check is sufficient.
+ */
+template <typename T>
+using is_combinator = std::is_base_of<detail::combinator_base, T>;
+
+template <typename T>
+inline constexpr bool is_combinator_v = is_combinator<T>::value;
+
+namespace detail {
+
+/**
+ * Helpers, mainly for operators.
+ */
+
+template <typename T>
+inline constexpr bool is_combinator_cvref_v =
+    is_combinator_v<remove_cvref_t<T>>;
+
+template <typename... Ts>
+inline constexpr bool all_combinators_cvref_v =
+    (... & is_combinator_cvref_v<Ts>);
+
+} /* namespace detail */
+
+// Forward-declare the action combinator, the base combinator has to see it
+template <typename Cmb, typename Fn>
+class action_t;
+
+#define cppcmb_noexcept_subscript(...) \
+noexcept(noexcept(action_t(std::declval<__VA_ARGS__>(), cppcmb_fwd(fn))))
+
+/**
+ * The actual type that all other combinators have to derive from.
+ */
+template <typename Self>
+class combinator : public detail::crtp<Self>,
+                   private detail::combinator_base {
+public:
+    template <typename Fn>
+    [[nodiscard]] constexpr auto operator[](Fn&& fn) &
+        cppcmb_noexcept_subscript(Self&) {
+
+        return action_t(this->self(), cppcmb_fwd(fn));
+    }
+
+    template <typename Fn>
+    [[nodiscard]] constexpr auto operator[](Fn&& fn) const&
+        cppcmb_noexcept_subscript(Self const&) {
+
+        return action_t(this->self(), cppcmb_fwd(fn));
+    }
+
+    template <typename Fn>
+    [[nodiscard]] constexpr auto operator[](Fn&& fn) &&
+        cppcmb_noexcept_subscript(Self&&) {
+
+        return action_t(std::move(this->self()), cppcmb_fwd(fn));
+    }
+
+    template <typename Fn>
+    [[nodiscard]] constexpr auto operator[](Fn&& fn) const&&
+        cppcmb_noexcept_subscript(Self const&&) {
+
+        return action_t(std::move(this->self()), cppcmb_fwd(fn));
+    }
+};
+
+#undef cppcmb_noexcept_subscript
+
+namespace detail {
+
+/**
+ * Concept check for parser interface.
+ */
+template <typename T, typename Src>
+using apply_t = decltype(
+    std::declval<T>().apply(std::declval<reader<Src> const&>())
+);
+
+template <typename T, typename Src>
+inline constexpr bool has_parser_interface_v =
+       is_detected_v<apply_t, T, Src>
+    && is_combinator_v<T>;
+
+} /* namespace detail */
+
+/**
+ * Every parser can use this at the beginning of the apply function to check
+ * sub-parsers.
+ */
+#define cppcmb_assert_parser(p, src)                  \
+static_assert(                                        \
+    ::cppcmb::detail::has_parser_interface_v<p, src>, \
+    "A parser must be derived from combinator<Self> " \
+    " and have a member function apply(reader<Src>)!" \
+    " (note: apply has to be const-qualified!)"       \
+)
+
+/**
+ * Helper to get the parser result.
+ */
+template <typename P, typename Src>
+using parser_result_t = detail::remove_cvref_t<decltype(
+    std::declval<P>().apply(std::declval<reader<Src> const&>())
+)>;
+
+/**
+ * Helper to get the result value of a parse success.
+ */
+template <typename P, typename Src>
+using parser_value_t = detail::remove_cvref_t<decltype(
+    std::declval<parser_result_t<P, Src>>().success().value()
+)>;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * Success "type-constructor". The type that the parser returns when it
+ * succeeded.
+ */
+template <typename T>
+class success {
+public:
+    using value_type = T;
+
+private:
+    value_type  m_Value;
+    std::size_t m_Matched;
+
+public:
+    template <typename TFwd>
+    constexpr success(TFwd&& val, std::size_t matched)
+        noexcept(std::is_nothrow_constructible_v<value_type, TFwd&&>)
+        : m_Value(cppcmb_fwd(val)), m_Matched(matched) {
+    }
+
+    cppcmb_getter(value, m_Value)
+
+    [[nodiscard]] constexpr auto const& matched() const noexcept {
+        return m_Matched;
+    }
+};
+
+template <typename TFwd>
+success(TFwd, std::size_t) -> success<TFwd>;
+
+/**
+ * Failure "type-constructor". The type that the parser returns when it fails.
+ */
+class failure { };
+
+/**
+ * The result type of a parser. It's either a success or a failure type.
+ */
+template <typename T>
+class result {
+public:
+    using success_type = ::cppcmb::success<T>;
+    using failure_type = ::cppcmb::failure;
+
+private:
+    using either_type = std::variant<success_type, failure_type>;
+
+    /**
+     * The packrat parsers will have to fiddle with the furthest values.
+     */
+    template <typename>
+    friend class drec_packrat_t;
+    template <typename>
+    friend class irec_packrat_t;
+
+    either_type m_Data;
+    std::size_t m_Furthest;
+
+public:
+    template <typename TFwd>
+    constexpr result(TFwd&& val, std::size_t furthest)
+        noexcept(std::is_nothrow_constructible_v<either_type, TFwd&&>)
+        : m_Data(cppcmb_fwd(val)), m_Furthest(furthest) {
+    }
+
+    [[nodiscard]] constexpr bool is_success() const noexcept {
+        return std::holds_alternative<success_type>(m_Data);
+    }
+
+    [[nodiscard]] constexpr bool is_failure() const noexcept {
+        return std::holds_alternative<failure_type>(m_Data);
+    }
+
+    cppcmb_getter(success, std::get<success_type>(m_Data))
+    cppcmb_getter(failure, std::get<failure_type>(m_Data))
+
+    [[nodiscard]] constexpr auto const& furthest() const noexcept {
+        return m_Furthest;
+    }
+};
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+template <typename T>
+[[nodiscard]] constexpr T ascii_to_lower(T c) noexcept {
+    if (c >= T('A') && c <= T('Z')) {
+        return T(c - T('A') + T('a'));
+    }
+    return c;
+}
+
+template <typename T>
+[[nodiscard]] constexpr bool ascii_has_upper(std::basic_string_view<T> str)
+    noexcept {
+    for (auto c : str) {
+        if (c >= T('A') && c <= T('Z')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * A view of the source that returns every element with ASCII letters
+ * converted to lower-case.
+ */
+template <typename Src>
+class ascii_fold_view {
+private:
+    Src const* m_Source;
+
+public:
+    constexpr explicit ascii_fold_view(Src const& src) noexcept
+        : m_Source(::std::addressof(src)) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] constexpr auto operator[](std::size_t idx) const {
+        return ascii_to_lower(remove_cvref_t<decltype((*m_Source)[idx])>(
+            (*m_Source)[idx]
+        ));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] constexpr auto size() const {
+        return std::size(*m_Source);
+    }
+};
+
+/**
+ * Compares the literal with the source at the given position, ignoring ASCII
+ * case. Returns the number of matching elements, which is the length of the
+ * literal on success.
+ */
+template <typename Src, typename CharT>
+[[nodiscard]] constexpr std::size_t ascii_icase_prefix(
+    Src const& src, std::size_t idx, std::basic_string_view<CharT> lit) {
+
+    using elem_t = remove_cvref_t<decltype(src[idx])>;
+
+    auto const size = std::size(src);
+    auto const len = lit.size();
+    std::size_t i = 0;
+
+    if constexpr (is_contiguous_source_v<Src>
+               && sizeof(elem_t) == 1 && sizeof(CharT) == 1) {
+        // Compare 8 bytes at a time
+        auto const* data = std::data(src) + idx;
+        auto const* ldata = lit.data();
+        while (i + swar_width <= len && idx + i + swar_width <= size) {
+            auto w1 = swar_to_lower(swar_load(data + i));
+            auto w2 = swar_to_lower(swar_load(ldata + i));
+            if (w1 != w2) {
+                // Let the element-wise loop find the exact position
+                break;
+            }
+            i += swar_width;
+        }
+    }
+
+    for (; i < len && idx + i < size; ++i) {
+        if (ascii_to_lower(src[idx + i]) != elem_t(ascii_to_lower(lit[i]))) {
+            break;
+        }
+    }
+    return i;
+}
+
+} /* namespace detail */
+
+/**
+ * Matches a literal, ignoring ASCII case.
+ */
+template <typename CharT>
+class ilit_t : public combinator<ilit_t<CharT>> {
+private:
+    std::basic_string_view<CharT> m_Literal;
+
+public:
+    constexpr ilit_t(std::basic_string_view<CharT> lit) noexcept
+        : m_Literal(lit) {
+    }
+
+    [[nodiscard]] constexpr auto const& literal() const noexcept {
+        return m_Literal;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<product<>> {
+
+        using result_t = result<product<>>;
+
+        auto len = detail::ascii_icase_prefix(
+            r.source(), r.cursor(), m_Literal
+        );
+        if (len == m_Literal.size()) {
+            return result_t(success(product<>(), len), len);
+        }
+        // We looked at the mismatching element too, if there was one
+        auto peeked = r.cursor() + len < std::size(r.source()) ? len + 1 : len;
+        return result_t(failure(), peeked);
+    }
+};
+
+template <typename CharT>
+ilit_t(std::basic_string_view<CharT>) -> ilit_t<CharT>;
+
+/**
+ * Creates a case-insensitive literal parser.
+ */
+template <typename CharT>
+[[nodiscard]] constexpr auto ilit(CharT const* lit) noexcept {
+    return ilit_t(std::basic_string_view<CharT>(lit));
+}
+
+template <typename CharT>
+[[nodiscard]] constexpr auto ilit(std::basic_string_view<CharT> lit) noexcept {
+    return ilit_t(lit);
+}
+
+/**
+ * Applies the underlying parser to the input with ASCII letters folded to
+ * lower-case. The underlying parser has to expect lower-case input.
+ */
+template <typename P>
+class ignore_case_t : public combinator<ignore_case_t<P>> {
+private:
+    cppcmb_self_check(ignore_case_t);
+
+    P m_Parser;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr ignore_case_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        using view_t = detail::ascii_fold_view<Src>;
+        cppcmb_assert_parser(P, view_t);
+
+        auto folded = view_t(r.source());
+        return m_Parser.apply(reader(folded, r.cursor(), r.context_ptr()));
+    }
+};
+
+template <typename PFwd>
+ignore_case_t(PFwd) -> ignore_case_t<PFwd>;
+
+/**
+ * Wrapper to make any combinator case-insensitive.
+ */
+template <typename PFwd>
+[[nodiscard]] constexpr auto ignore_case(PFwd&& p)
+    cppcmb_return(ignore_case_t(cppcmb_fwd(p)))
+
+/**
+ * Matches the longest of the given keywords, ignoring ASCII case. The result
+ * is the index of the matched keyword.
+ */
+template <typename CharT, std::size_t N>
+class ikeyword_set_t : public combinator<ikeyword_set_t<CharT, N>> {
+private:
+    std::array<std::basic_string_view<CharT>, N> m_Keywords;
+
+public:
+    constexpr ikeyword_set_t(
+        std::array<std::basic_string_view<CharT>, N> const& kws) noexcept
+        : m_Keywords(kws) {
+    }
+
+    cppcmb_getter(keywords, m_Keywords)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<std::size_t> {
+
+        using result_t = result<std::size_t>;
+
+        auto const& src = r.source();
+        auto const idx = r.cursor();
+        auto const rem = std::size(src) - idx;
+
+        if (rem == 0) {
+            return result_t(failure(), 0U);
+        }
+        // Most keywords can be ruled out by their first character
+        auto first = detail::ascii_to_lower(src[idx]);
+
+        std::size_t best = N;
+        std::size_t best_len = 0;
+        std::size_t furthest = 1;
+        for (std::size_t i = 0; i < N; ++i) {
+            auto const& kw = m_Keywords[i];
+            if (kw.size() > rem || (best != N && kw.size() <= best_len)) {
+                continue;
+            }
+            if (!kw.empty()
+             && first != decltype(first)(detail::ascii_to_lower(kw[0]))) {
+                continue;
+            }
+            auto len = detail::ascii_icase_prefix(src, idx, kw);
+            furthest = std::max(furthest, std::min(len + 1, rem));
+            if (len == kw.size()) {
+                best = i;
+                best_len = len;
+            }
+        }
+
+        if (best == N) {
+            return result_t(failure(), furthest);
+        }
+        return result_t(success(best, best_len), furthest);
+    }
+};
+
+/**
+ * Creates a case-insensitive keyword-set parser.
+ */
+template <typename CharT, typename... Ts>
+[[nodiscard]] constexpr auto ikeywords(CharT const* first, Ts const*... rest)
+    noexcept {
+
+    static_assert(
+        (... && std::is_same_v<CharT, Ts>),
+        "All keywords must have the same character type!"
+    );
+    using str_t = std::basic_string_view<CharT>;
+    return ikeyword_set_t<CharT, sizeof...(Ts) + 1>({
+        str_t(first), str_t(rest)...
+    });
+}
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * Some type-constructor for maybe.
+ */
+template <typename T>
+class some {
+public:
+    using value_type = T;
+
+private:
+    cppcmb_self_check(some);
+
+    T m_Value;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename TFwd, cppcmb_requires_t(!is_self_v<TFwd>)>
+    constexpr some(TFwd&& val)
+        : m_Value(cppcmb_fwd(val)) {
+    }
+
+    cppcmb_getter(value, m_Value)
+};
+
+template <typename TFwd>
+some(TFwd) -> some<TFwd>;
+
+/**
+ * None type-constructor for maybe.
+ */
+class none {};
+
+/**
+ * Generic maybe-type.
+ */
+template <typename T>
+class maybe {
+public:
+    using some_type = ::cppcmb::some<T>;
+    using none_type = ::cppcmb::none;
+
+private:
+    cppcmb_self_check(maybe);
+
+    std::variant<some_type, none_type> m_Data;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename TFwd, cppcmb_requires_t(!is_self_v<TFwd>)>
+    constexpr maybe(TFwd&& val)
+        : m_Data(cppcmb_fwd(val)) {
+    }
+
+    [[nodiscard]] constexpr bool is_some() const noexcept {
+        return std::holds_alternative<some_type>(m_Data);
+    }
+
+    [[nodiscard]] constexpr bool is_none() const noexcept {
+        return std::holds_alternative<none_type>(m_Data);
+    }
+
+    cppcmb_getter(some, std::get<some_type>(m_Data))
+    cppcmb_getter(none, std::get<none_type>(m_Data))
+};
+
+namespace detail {
+
+cppcmb_is_specialization(maybe);
+
+} /* namespace detail */
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+/**
+ * Just to improve error messages.
+ */
+struct action_apply_helper {
+    template <typename Fn, typename T>
+    constexpr auto operator()(Fn const& f, T&& v) const
+        cppcmb_return(apply_value(f, cppcmb_fwd(v)))
+};
+
+} /* namespace detail */
+
+template <typename P, typename Fn>
+class action_t : public combinator<action_t<P, Fn>> {
+private:
+    P  m_Parser;
+    Fn m_Fn;
+
+public:
+    // XXX(LPeter1997): Is it right to have such a long noexcept specifier?
+    template <typename PFwd, typename FnFwd>
+    constexpr action_t(PFwd&& cmb, FnFwd&& fn)
+        noexcept(
+            std::is_nothrow_constructible_v<P, PFwd&&>
+         && std::is_nothrow_constructible_v<Fn, FnFwd&&>
+        )
+        : m_Parser(cppcmb_fwd(cmb)), m_Fn(cppcmb_fwd(fn)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+    cppcmb_getter(function, m_Fn)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& src) const {
+        cppcmb_assert_parser(P, Src);
+
+        using value_t = parser_value_t<P, Src>;
+        using apply_t = decltype(&action_t::apply_fn<value_t&&>);
+        using fn_result_t = std::invoke_result_t<apply_t, action_t, value_t>;
+        using dispatch_tag =
+            detail::is_maybe<detail::remove_cvref_t<fn_result_t>>;
+
+        return apply_impl<fn_result_t>(src, dispatch_tag());
+    }
+
+private:
+    /**
+     * Original solution:
+     *
+     * template <typename T>
+     * using maybe_value_t = detail::remove_cvref_t<decltype(
+     *      std::declval<T>().some().value()
+     * )>;
+     *
+     * But it triggered a GCC internal compiler error.
+     */
+    template <typename T>
+    using maybe_some_t = typename detail::remove_cvref_t<T>::some_type;
+
+    template <typename T>
+    using maybe_value_t = typename maybe_some_t<T>::value_type;
+
+    // XXX(LPeter1997): Noexcept specifier
+    // Action can fail
+    template <typename FRes, typename Src>
+    [[nodiscard]] constexpr auto apply_impl(
+        reader<Src> const& src,
+        std::true_type) const -> result<maybe_value_t<FRes>> {
+
+        using result_t = result<maybe_value_t<FRes>>;
+
+        auto inv = m_Parser.apply(src);
+        if (inv.is_failure()) {
+            // Early failure
+            return result_t(std::move(inv).failure(), inv.furthest());
+        }
+
+        auto succ = std::move(inv).success();
+        // Try to apply the action
+        auto act_inv = apply_fn(std::move(succ).value());
+        // In any case we will have to decorate the result with the position
+        if (act_inv.is_none()) {
+            return result_t(failure(), inv.furthest());
+        }
+
+        return result_t(
+            success(std::move(act_inv).some().value(), succ.matched()),
+            inv.furthest()
+        );
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    // Action can't fail
+    template <typename FRes, typename Src>
+    [[nodiscard]] constexpr auto apply_impl(
+        reader<Src> const& src,
+        std::false_type) const -> result<FRes> {
+
+        auto inv = m_Parser.apply(src);
+        if (inv.is_failure()) {
+            // Early failure
+            return result<FRes>(
+                std::move(inv).failure(),
+                inv.furthest()
+            );
+        }
+
+        auto succ = std::move(inv).success();
+        // Apply the action
+        auto act_val = apply_fn(std::move(succ).value());
+        // Wrap it in a success
+        return result<FRes>(
+            success(std::move(act_val), succ.matched()),
+            inv.furthest()
+        );
+    }
+
+    // Invoke the function with a value
+    template <typename T>
+    [[nodiscard]] constexpr decltype(auto) apply_fn(T&& val) const {
+        static_assert(
+            std::is_invocable_v<detail::action_apply_helper, Fn, T&&>,
+             "The given action function must be invocable with the parser's "
+             "successful value type! "
+             "(note: the function's invocation must be const-qualified!)"
+        );
+        return apply_value(m_Fn, cppcmb_fwd(val));
+    }
+};
+
+template <typename PFwd, typename FnFwd>
+action_t(PFwd, FnFwd) -> action_t<PFwd, FnFwd>;
+
+} /* namespace cppcmb */
+
+// XXX(LPeter1997): Move operations from the parsers to here
+// The structures should be aware of their usage, they shouldn't be just
+// wrappers around STL containers...
+
+namespace cppcmb {
+
+/**
+ * Statistics of a memo table compaction.
+ */
+struct compaction_stats {
+    std::size_t entries_removed = 0;
+    std::size_t bytes_reclaimed = 0;
+};
+
+class memo_context;
+
+/**
+ * A point in the parse, that it can backtrack to, when a branch of a choice
+ * fails.
+ */
+struct choice_point {
+    // The length of the trail at the start of the branch
+    std::size_t trail = 0;
+    // The length of the state log at the start of the branch
+    std::size_t log   = 0;
+    // The length of the state log when the enclosing branch started
+    std::size_t outer = 0;
+};
+
+/**
+ * A memorized parser application that has been re-parsed in place.
+ */
+struct reparsed_block {
+    // The memo ID of the parser
+    std::uintptr_t rule   = 0;
+    std::size_t    offset = 0;
+    // The matched length in the edited source
+    std::size_t    length = 0;
+    // The result of the parser
+    std::any       result;
+};
+
+namespace detail {
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Functionality for hashing a pair. Straight from Boost.
+ */
+template <typename T>
+constexpr void hash_combine(std::size_t& seed, T const& v) {
+    // NOLINTNEXTLINE
+    seed ^= std::hash<T>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+struct pair_hasher {
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename T1, typename T2>
+    constexpr auto operator()(std::pair<T1, T2> const& p) const {
+        std::size_t seed = 0;
+        hash_combine(seed, p.first);
+        hash_combine(seed, p.second);
+        return seed;
+    }
+};
+
+/**
+ * Describes how the results of a parser can be written out, so they survive
+ * the process. The stable ID identifies the parser across processes.
+ */
+struct persistent_rule {
+    std::uint64_t stable_id;
+    void (*write)(std::any const&, std::string&);
+};
+
+/**
+ * A persisted entry that hasn't been claimed by it's parser yet.
+ */
+struct pending_entry {
+    std::string data;
+    std::size_t furthest;
+};
+
+/**
+ * The outcome of a memorized value, used for compaction.
+ */
+enum class memo_status {
+    // Not a result, like the bookkeeping of left-recursion
+    unknown,
+    success,
+    failure,
+};
+
+/**
+ * Re-applies the memorizing parser self at the position of the source, if
+ * the source is of the type the parser was applied to before.
+ */
+using block_reapply_fn = std::optional<reparsed_block> (*)(
+    void const* self, void const* src, std::type_info const& src_type,
+    std::size_t pos, memo_context& ctx
+);
+
+/**
+ * Lets a memorized success be re-parsed by itself.
+ */
+struct memo_block {
+    void const*      self    = nullptr;
+    block_reapply_fn reapply = nullptr;
+};
+
+/**
+ * A memorized entry that an edit overlaps.
+ */
+struct overlapping_entry {
+    std::uintptr_t pid;
+    std::size_t    pos;
+    // A success that can be re-parsed by itself
+    bool           is_block;
+    std::size_t    matched;
+    memo_block     block;
+};
+
+/**
+ * A memorized value with it's bookkeeping.
+ */
+struct memo_entry {
+    std::any    value;
+    std::size_t furthest = 0;
+    memo_status status   = memo_status::unknown;
+    // Estimated size of the value, if it doesn't fit into the std::any
+    std::size_t heap_size = 0;
+    // Entries that depend on the parse state are only valid in the version
+    // of the state they were computed in
+    bool          dependent = false;
+    std::uint64_t version   = 0;
+    // The matched length of a success
+    std::size_t   matched   = 0;
+    memo_block    block;
+    // The entries the evaluation used, pair<parser identifier, offset from
+    // this entry>, so they survive shifting the entries
+    std::vector<std::pair<std::uintptr_t, std::size_t>> children;
+};
+
+/**
+ * The state and trail bookkeeping of a memorizing parser's evaluation.
+ */
+struct state_frame {
+    std::uint64_t version;
+    bool          dependent;
+    std::size_t   trail;
+};
+
+/**
+ * Memorization table for packrat parsers.
+ */
+class memo_table {
+private:
+    // pair<parser identifier, position>
+    using key_type = std::pair<std::uintptr_t, std::size_t>;
+    using value_type = memo_entry;
+    // pair<stable identifier, position>
+    using pending_key_type = std::pair<std::uint64_t, std::size_t>;
+
+    // pair<position, parser identifier>
+    using span_key = std::pair<std::size_t, std::uintptr_t>;
+
+    static constexpr std::size_t span_classes =
+        std::numeric_limits<std::size_t>::digits + 1;
+
+    std::unordered_map<key_type, value_type, pair_hasher> m_Cache;
+    // The entries ordered by position, in classes of how far they looked
+    // (see span_class), to find the ones an edit overlaps
+    std::array<std::set<span_key>, span_classes>          m_Spans;
+
+    // Persistence support
+    std::unordered_map<std::uintptr_t, persistent_rule> m_Persistent;
+    std::unordered_map<std::uint64_t, std::uintptr_t>   m_StableIDs;
+    std::unordered_set<std::uint64_t>                   m_Ambiguous;
+    std::unordered_map<
+        pending_key_type, pending_entry, pair_hasher
+    >                                                   m_Pending;
+
+    // Parse state versioning, versions are never reused, not even between
+    // parses
+    std::uint64_t m_StateVersion = 0;
+    std::uint64_t m_FrameVersion = 0;
+    bool          m_Dependent    = false;
+
+    // The entries used by the evaluations in progress and by the ones they
+    // finished, in order. The ones of failed branches are dropped again (see
+    // memo_context::backtrack), so at the end of a parse it holds the
+    // entries the result was derived from directly.
+    std::vector<key_type> m_Trail;
+    std::size_t           m_FrameTrail = 0;
+
+    /**
+     * True, if an entry at r_from that looked at furthest elements overlaps
+     * the edited range [start; end).
+     */
+    [[nodiscard]] static constexpr bool overlaps(std::size_t r_from,
+        std::size_t furthest, std::size_t start, std::size_t end) noexcept {
+        // [r_from; r_to) is the entry's interval
+        // XXX(LPeter1997): Allow equality?
+        auto r_to = r_from + furthest;
+        return !(start > r_to || r_from > end);
+    }
+
+    /**
+     * The class of an entry that looked at furthest elements. The entries
+     * of class k looked at less than 2^k elements.
+     */
+    [[nodiscard]] static constexpr std::size_t span_class(
+        std::size_t furthest) noexcept {
+        std::size_t k = 0;
+        for (; furthest != 0; furthest >>= 1) {
+            ++k;
+        }
+        return k;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The keys of the entries that overlap the edited range [start; end].
+     * Only the entries of each class, that start close enough to the edit
+     * to reach it, are looked at.
+     */
+    [[nodiscard]] std::vector<key_type>
+    overlapping_keys(std::size_t start, std::size_t end) const {
+        std::vector<key_type> res;
+        for (std::size_t k = 0; k < span_classes; ++k) {
+            auto const& spans = m_Spans[k];
+            auto const reach = k < span_classes - 1
+                ? (std::size_t(1) << k) - 1
+                : std::numeric_limits<std::size_t>::max();
+            auto from = start > reach ? start - reach : 0;
+            for (auto it = spans.lower_bound({ from, 0 });
+                it != spans.end() && it->first <= end; ++it) {
+                auto key = key_type(it->second, it->first);
+                auto const& e = m_Cache.find(key)->second;
+                if (overlaps(key.second, e.furthest, start, end)) {
+                    res.push_back(key);
+                }
+            }
+        }
+        return res;
+    }
+
+public:
+    [[nodiscard]] std::uint64_t state_version() const noexcept {
+        return m_StateVersion;
+    }
+
+    /**
+     * Signals that the parse state changed. Entries that depend on the state
+     * are not reused after this.
+     */
+    void bump_state_version() noexcept {
+        ++m_StateVersion;
+    }
+
+    /**
+     * Signals that the current evaluation depends on the parse state.
+     */
+    void note_state_read() noexcept {
+        m_Dependent = true;
+    }
+
+    /**
+     * Starts the evaluation of a memorized parser. The entries put before
+     * leaving the frame depend on the state, if the evaluation read or
+     * changed it.
+     */
+    [[nodiscard]] state_frame enter_state_frame() noexcept {
+        auto f = state_frame{ m_FrameVersion, m_Dependent, m_FrameTrail };
+        m_FrameVersion = m_StateVersion;
+        m_Dependent = false;
+        m_FrameTrail = m_Trail.size();
+        return f;
+    }
+
+    /**
+     * Ends the evaluation, the dependency propagates to the enclosing one.
+     * The entries it used are children of the entry it put last, only that
+     * one stays on the trail.
+     */
+    void leave_state_frame(state_frame const& f) noexcept {
+        m_Dependent = f.dependent || m_Dependent
+            || m_StateVersion != m_FrameVersion;
+        m_FrameVersion = f.version;
+        if (m_Trail.size() > m_FrameTrail) {
+            auto own = m_Trail.back();
+            // Doesn't allocate, the trail only shrinks
+            m_Trail.resize(m_FrameTrail);
+            m_Trail.push_back(own);
+        }
+        m_FrameTrail = f.trail;
+    }
+
+    [[nodiscard]] std::size_t trail_size() const noexcept {
+        return m_Trail.size();
+    }
+
+    /**
+     * Drops the entries used between the two trail sizes, the branch that
+     * used them was not taken.
+     */
+    void drop_trail(std::size_t from, std::size_t to) noexcept {
+        m_Trail.erase(
+            m_Trail.begin() + std::ptrdiff_t(from),
+            m_Trail.begin() + std::ptrdiff_t(to)
+        );
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]]
+    /* constexpr */ std::any* get(std::uintptr_t pid, std::size_t pos) {
+        auto it = m_Cache.find({ pid, pos });
+        if (it == m_Cache.end()) {
+            return nullptr;
+        }
+        auto const& e = it->second;
+        if (e.dependent) {
+            if (e.version != m_StateVersion) {
+                // Stale, the state changed since
+                return nullptr;
+            }
+            m_Dependent = true;
+        }
+        m_Trail.push_back(it->first);
+        return &it->second.value;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]]
+    constexpr std::any* get(std::uintptr_t pid, reader<Src> const& r) {
+        return get(pid, r.cursor());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename TFwd>
+    constexpr auto& put(std::uintptr_t pid, std::size_t pos,
+        TFwd&& val, std::size_t furth, memo_block block = memo_block()) {
+
+        using raw_type = remove_cvref_t<TFwd>;
+        auto id = std::pair(pid, pos);
+        auto status = memo_status::unknown;
+        std::size_t matched = 0;
+        if constexpr (is_specialization_v<raw_type, result>) {
+            status = val.is_success()
+                ? memo_status::success : memo_status::failure;
+            matched = val.is_success() ? val.success().matched() : 0;
+        }
+        // Assume small-buffer optimization for pointer-sized values
+        auto heap = sizeof(raw_type) > sizeof(void*) ? sizeof(raw_type) : 0;
+        // A change in the frame means the result was computed in multiple
+        // versions of the state, it can't be reused in any of them
+        bool dependent = m_Dependent || m_StateVersion != m_FrameVersion;
+        auto [it, fresh] = m_Cache.try_emplace(id);
+        auto cls = span_class(furth);
+        if (fresh) {
+            m_Spans[cls].insert({ pos, pid });
+        }
+        else if (auto old = span_class(it->second.furthest); old != cls) {
+            m_Spans[old].erase({ pos, pid });
+            m_Spans[cls].insert({ pos, pid });
+        }
+        // The entries used since the frame started, except for the entry
+        // itself, like the seed of a left-recursive one
+        std::vector<std::pair<std::uintptr_t, std::size_t>> children;
+        for (auto i = m_FrameTrail; i < m_Trail.size(); ++i) {
+            auto const& [c_pid, c_pos] = m_Trail[i];
+            if (c_pos >= pos && m_Trail[i] != id) {
+                children.push_back({ c_pid, c_pos - pos });
+            }
+        }
+        auto& a = (it->second = memo_entry{
+            std::any(cppcmb_fwd(val)), furth, status, heap,
+            dependent, m_FrameVersion, matched, block, std::move(children)
+        });
+        m_Trail.push_back(id);
+        return std::any_cast<raw_type&>(a.value);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src, typename TFwd>
+    constexpr auto& put(std::uintptr_t pid, reader<Src> const& r,
+        TFwd&& val, std::size_t furth, memo_block block = memo_block()) {
+
+        return put(pid, r.cursor(), cppcmb_fwd(val), furth, block);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The entries, that invalidate would drop for the edit. Results that
+     * depend on the parse state are not blocks, the state of their position
+     * isn't known.
+     */
+    [[nodiscard]] std::vector<overlapping_entry>
+    overlapping(std::size_t start, std::size_t rem) const {
+        std::vector<overlapping_entry> res;
+        for (auto const& k : overlapping_keys(start, start + rem)) {
+            auto const& v = m_Cache.find(k)->second;
+            auto is_block = v.block.reapply != nullptr && !v.dependent
+                && v.status == memo_status::success;
+            res.push_back({ k.first, k.second, is_block, v.matched, v.block });
+        }
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] bool contains(std::uintptr_t pid, std::size_t pos) const {
+        return m_Cache.count({ pid, pos }) != 0;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void erase(std::uintptr_t pid, std::size_t pos) {
+        auto it = m_Cache.find({ pid, pos });
+        if (it != m_Cache.end()) {
+            m_Spans[span_class(it->second.furthest)].erase({ pos, pid });
+            m_Cache.erase(it);
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /* constexpr */ void clear() {
+        m_Cache.clear();
+        m_Trail.clear();
+        m_FrameTrail = 0;
+        for (auto& spans : m_Spans) {
+            spans.clear();
+        }
+        m_Pending.clear();
+        m_FrameVersion = m_StateVersion;
+        m_Dependent = false;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Keeps the derivation of the last parse: the entries it used directly,
+     * and the ones the successes among them used, recursively. The other
+     * results are only kept, if they start at most neighborhood elements
+     * away from an entry of the derivation, these are the alternatives a
+     * later reparse is likely to ask for again. Entries that are not results
+     * are kept. The reclaimed bytes are an estimate.
+     */
+    compaction_stats compact(std::size_t neighborhood) {
+        std::unordered_set<key_type, pair_hasher> live;
+        std::vector<std::size_t> starts;
+        auto work = m_Trail;
+        while (!work.empty()) {
+            auto k = work.back();
+            work.pop_back();
+            auto it = m_Cache.find(k);
+            if (it == m_Cache.end() || !live.insert(k).second) {
+                continue;
+            }
+            starts.push_back(k.second);
+            auto const& v = it->second;
+            if (v.status == memo_status::failure) {
+                // Whatever it used didn't end up in the result
+                continue;
+            }
+            for (auto const& [c_pid, c_off] : v.children) {
+                work.push_back({ c_pid, k.second + c_off });
+            }
+        }
+        std::sort(starts.begin(), starts.end());
+
+        auto near_live = [&](std::size_t pos) {
+            auto from = pos > neighborhood ? pos - neighborhood : 0;
+            auto it = std::lower_bound(starts.begin(), starts.end(), from);
+            return it != starts.end() && *it <= pos + neighborhood;
+        };
+
+        // Rough size of a node in the hash table and in the span set
+        constexpr auto node_size =
+            sizeof(key_type) + sizeof(value_type) + 2 * sizeof(void*)
+            + sizeof(span_key) + 4 * sizeof(void*);
+
+        compaction_stats stats;
+        for (auto it = m_Cache.begin(); it != m_Cache.end();) {
+            auto const& [k, v] = *it;
+            if (v.status != memo_status::unknown && live.count(k) == 0
+             && !near_live(k.second)) {
+                ++stats.entries_removed;
+                stats.bytes_reclaimed += node_size + v.heap_size
+                    + v.children.capacity() * sizeof(v.children[0]);
+                m_Spans[span_class(v.furthest)].erase({ k.second, k.first });
+                it = m_Cache.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        return stats;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Marks the entries of the given parser as persistable. If two different
+     * parsers share a stable ID, neither of them is persisted.
+     */
+    void register_persistent(std::uintptr_t pid, persistent_rule rule) {
+        auto [it, inserted] = m_StableIDs.insert({ rule.stable_id, pid });
+        if (!inserted && it->second != pid) {
+            m_Ambiguous.insert(rule.stable_id);
+        }
+        m_Persistent.insert({ pid, rule });
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void add_pending(std::uint64_t sid, std::size_t pos, pending_entry e) {
+        m_Pending.insert_or_assign({ sid, pos }, std::move(e));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Removes and returns the persisted entry of a parser at the position.
+     */
+    [[nodiscard]] std::optional<pending_entry>
+    take_pending(std::uint64_t sid, std::size_t pos) {
+        if (m_Pending.empty()) {
+            return std::nullopt;
+        }
+        auto it = m_Pending.find({ sid, pos });
+        if (it == m_Pending.end() || m_Ambiguous.count(sid) != 0) {
+            return std::nullopt;
+        }
+        auto e = std::move(it->second);
+        m_Pending.erase(it);
+        return e;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Calls fn(stable ID, position, furthest, data) for every entry that can
+     * be persisted, including the ones that haven't been claimed yet.
+     */
+    template <typename Fn>
+    void for_each_persistent(Fn&& fn) const {
+        for (auto const& [k, v] : m_Cache) {
+            if (v.dependent) {
+                // The state isn't saved
+                continue;
+            }
+            auto it = m_Persistent.find(k.first);
+            if (it == m_Persistent.end()
+             || m_Ambiguous.count(it->second.stable_id) != 0) {
+                continue;
+            }
+            std::string data;
+            it->second.write(v.value, data);
+            fn(it->second.stable_id, k.second, v.furthest, data);
+        }
+        for (auto const& [k, v] : m_Pending) {
+            if (m_Ambiguous.count(k.first) == 0) {
+                fn(k.first, k.second, v.furthest, v.data);
+            }
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void invalidate(std::size_t start, std::size_t rem, std::size_t ins) {
+        // start: Position of the source we are manipulating
+        // rem: Removed length
+        // ins: Inserted length
+
+        // The positions on the trail are stale, a new parse starts
+        m_Trail.clear();
+        m_FrameTrail = 0;
+
+        auto end = start + rem;
+        for (auto const& [pid, pos] : overlapping_keys(start, end)) {
+            erase(pid, pos);
+        }
+
+        // The entries after the edit are shifted, the nodes are moved, so
+        // the values are not copied. Every entry that started inside the
+        // edit overlapped it, the order of the entries doesn't change.
+        // XXX(LPeter1997): Still linear in the entries after the edit, that
+        // would need relative positions
+        std::intptr_t diff = std::intptr_t(ins) - std::intptr_t(rem);
+        if (diff != 0) {
+            std::vector<decltype(m_Cache)::node_type> entries;
+            std::vector<std::set<span_key>::node_type> spans;
+            for (auto& cls : m_Spans) {
+                spans.clear();
+                auto it = cls.lower_bound({ start, 0 });
+                while (it != cls.end()) {
+                    spans.push_back(cls.extract(it++));
+                }
+                for (auto& n : spans) {
+                    auto& [pos, pid] = n.value();
+                    entries.push_back(m_Cache.extract({ pid, pos }));
+                    pos = pos + ins - rem;
+                    cls.insert(cls.end(), std::move(n));
+                }
+            }
+            for (auto& n : entries) {
+                n.key().second = n.key().second + ins - rem;
+                m_Cache.insert(std::move(n));
+            }
+        }
+
+        // Persisted entries follow the same rules
+        decltype(m_Pending) pending;
+        for (auto& [k, v] : m_Pending) {
+            auto r_from = k.second;
+            if (overlaps(r_from, v.furthest, start, end)) {
+                // Overlapping
+                continue;
+            }
+            auto pos = r_from >= start ? r_from + diff : r_from;
+            pending.insert({ { k.first, pos }, std::move(v) });
+        }
+        m_Pending = std::move(pending);
+    }
+};
+
+/**
+ * Evaluates a memorized parser in a state frame, until the end of the scope.
+ * The results must be put into the table inside the scope.
+ */
+class state_frame_scope {
+private:
+    memo_table& m_Table;
+    state_frame m_Frame;
+
+public:
+    explicit state_frame_scope(memo_table& table) noexcept
+        : m_Table(table), m_Frame(table.enter_state_frame()) {
+    }
+
+    state_frame_scope(state_frame_scope const&) = delete;
+    state_frame_scope& operator=(state_frame_scope const&) = delete;
+
+    ~state_frame_scope() {
+        m_Table.leave_state_frame(m_Frame);
+    }
+};
+
+class irec_head {
+private:
+    std::uintptr_t                     m_HeadID;
+    std::unordered_set<std::uintptr_t> m_InvolvedIDSet;
+    std::unordered_set<std::uintptr_t> m_EvalIDSet;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    explicit /* constexpr */ irec_head(std::uintptr_t hid)
+        : m_HeadID(hid) {
+    }
+
+    [[nodiscard]] constexpr std::uintptr_t head_id() const noexcept {
+        return m_HeadID;
+    }
+
+    cppcmb_getter(involved_set, m_InvolvedIDSet)
+    cppcmb_getter(eval_set, m_EvalIDSet)
+};
+
+class irec_left_recursive {
+private:
+    std::any                 m_Seed;
+    std::uintptr_t           m_ParserID;
+    std::optional<irec_head> m_Head;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename TFwd>
+    constexpr irec_left_recursive(TFwd&& seed, std::uintptr_t pid)
+        : m_Seed(cppcmb_fwd(seed)), m_ParserID(pid) {
+    }
+
+    cppcmb_getter(seed, m_Seed)
+    cppcmb_getter(head, m_Head)
+
+    [[nodiscard]] constexpr std::uintptr_t parser_id() const noexcept {
+        return m_ParserID;
+    }
+};
+
+/**
+ * A type to track call-heads.
+ */
+class call_head_table {
+private:
+    std::unordered_map<std::size_t, irec_head*> m_Heads;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]]
+    /* constexpr */ irec_head* get(std::size_t n) const {
+        auto it = m_Heads.find(n);
+        if (it == m_Heads.end()) {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]]
+    /* constexpr */ irec_head* get(reader<Src> const& r) const {
+        return get(r.cursor());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    constexpr decltype(auto) operator[](reader<Src> const& r) {
+        return m_Heads[r.cursor()];
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto find(reader<Src> const& r) {
+        return m_Heads.find(r.cursor());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto find(reader<Src> const& r) const {
+        return m_Heads.find(r.cursor());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto begin() { return m_Heads.begin(); }
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto begin() const { return m_Heads.begin(); }
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto end() { return m_Heads.end(); }
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto end() const { return m_Heads.end(); }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename It>
+    constexpr void erase(It it) {
+        m_Heads.erase(it);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void clear() {
+        m_Heads.clear();
+    }
+};
+
+class call_stack {
+private:
+    std::deque<std::shared_ptr<irec_left_recursive>> m_Stack;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename TFwd>
+    constexpr void push_front(TFwd&& val) {
+        m_Stack.push_front(val);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /* constexpr */ void pop_front() {
+        m_Stack.pop_front();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto begin() { return m_Stack.begin(); }
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto begin() const { return m_Stack.begin(); }
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto end() { return m_Stack.end(); }
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] /* constexpr */ auto end() const { return m_Stack.end(); }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void clear() {
+        m_Stack.clear();
+    }
+};
+
+/**
+ * Re-evaluation statistics of a rule for adaptive memoization.
+ * A fixed subset of positions is sampled into a small bitset, a sample that
+ * hits an already set bit is counted as a re-evaluation at the same position.
+ * Distinct positions can share a bit, so this slightly overestimates.
+ */
+class rule_stats {
+private:
+    static constexpr std::size_t sketch_bits = 1024;
+    // Roughly every 4th position is sampled
+    static constexpr std::uint64_t sample_mask = 3;
+
+    std::bitset<sketch_bits> m_Sketch;
+    std::size_t              m_Distinct    = 0;
+    std::size_t              m_Samples     = 0;
+    std::size_t              m_Repeats     = 0;
+    std::size_t              m_Evaluations = 0;
+    bool                     m_Memoized    = false;
+
+public:
+    [[nodiscard]] bool memoized() const noexcept { return m_Memoized; }
+    [[nodiscard]] std::size_t samples() const noexcept { return m_Samples; }
+    [[nodiscard]] std::size_t repeats() const noexcept { return m_Repeats; }
+    [[nodiscard]] std::size_t evaluations() const noexcept {
+        return m_Evaluations;
+    }
+
+    /**
+     * Records an evaluation of the rule at the given position. Turns on
+     * memoization once there are at least min_samples samples and at least
+     * percent% of them are re-evaluations.
+     */
+    void record(std::size_t pos,
+        std::size_t min_samples, std::size_t percent) noexcept {
+
+        ++m_Evaluations;
+        auto h = std::uint64_t(pos) * 0x9E3779B97F4A7C15U;
+        h ^= h >> 29;
+        if ((h & sample_mask) != 0) {
+            return;
+        }
+        auto bit = std::size_t((h >> 2) % sketch_bits);
+        ++m_Samples;
+        if (m_Sketch.test(bit)) {
+            ++m_Repeats;
+        }
+        else {
+            m_Sketch.set(bit);
+            ++m_Distinct;
+        }
+        if (m_Samples >= min_samples
+         && m_Repeats * 100 >= percent * m_Samples) {
+            m_Memoized = true;
+        }
+        if (m_Distinct > sketch_bits / 2) {
+            // The sketch is getting saturated, start a new window
+            reset_sketch();
+            m_Samples /= 2;
+            m_Repeats /= 2;
+        }
+    }
+
+    /**
+     * Forgets the sampled positions, but keeps the decision and counters.
+     */
+    void reset_sketch() noexcept {
+        m_Sketch.reset();
+        m_Distinct = 0;
+    }
+};
+
+/**
+ * Statistics of adaptively memoized rules.
+ */
+class rule_stats_table {
+private:
+    static constexpr std::size_t recent_size = 16;
+
+    struct recent_slot {
+        std::uintptr_t pid   = 0;
+        rule_stats*    stats = nullptr;
+    };
+
+    /**
+     * The stats of the recently looked up rules. The stats are looked up on
+     * every evaluation, a hash lookup would cost more than most rules. The
+     * slots point into the table they belong to, so they are not copied.
+     */
+    struct recent_cache {
+        std::array<recent_slot, recent_size> slots{};
+
+        recent_cache() = default;
+
+        recent_cache(recent_cache const&) noexcept {
+        }
+
+        recent_cache& operator=(recent_cache const&) noexcept {
+            slots = {};
+            return *this;
+        }
+    };
+
+    // The elements of an unordered_map don't move, and stats are never erased
+    std::unordered_map<std::uintptr_t, rule_stats> m_Stats;
+    recent_cache                                   m_Recent;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] rule_stats& operator[](std::uintptr_t pid) {
+        auto h = (std::uint64_t(pid) * 0x9E3779B97F4A7C15U) >> 60;
+        auto& slot = m_Recent.slots[std::size_t(h) % recent_size];
+        if (slot.stats == nullptr || slot.pid != pid) {
+            slot = { pid, &m_Stats[pid] };
+        }
+        return *slot.stats;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] rule_stats const* get(std::uintptr_t pid) const {
+        auto it = m_Stats.find(pid);
+        return it == m_Stats.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * Positions are meaningless for a new input, decisions are kept.
+     */
+    void new_input() noexcept {
+        for (auto& [_, st] : m_Stats) {
+            st.reset_sketch();
+        }
+    }
+};
+
+// XXX(LPeter1997): These are not really helper structures and don't belong to
+// the memo context.
+// Furthermore, they should belong to a structure instead.
+
+template <typename Coll, typename Val, typename It>
+constexpr bool contains(Coll const& coll, Val const& v, It& it) {
+    it = coll.find(v);
+    return it != coll.end();
+}
+
+template <typename Coll, typename Val>
+constexpr bool contains(Coll const& coll, Val const& v) {
+    auto it = coll.end();
+    return contains(coll, v, it);
+}
+
+} /* namespace detail */
+
+// XXX(LPeter1997): Probably don't need a full getter with all qualifiers
+// Only need a mutable-lvalue getter for all 3 helpers
+class memo_context {
+private:
+    detail::memo_table       m_MemoTable;
+    detail::call_head_table  m_RecursionHeads;
+    detail::call_stack       m_LrStack;
+    detail::rule_stats_table m_RuleStats;
+    std::any                 m_State;
+    std::any                 m_InitialState;
+    // The states before the first change in each open branch, that are
+    // restored, when the branch fails
+    std::vector<std::any>    m_StateLog;
+    // The length of the state log when the innermost open branch started
+    std::size_t              m_BranchLog = no_branch;
+
+    static constexpr std::size_t no_branch = std::size_t(-1);
+
+public:
+    cppcmb_getter(memo, m_MemoTable)
+    cppcmb_getter(call_heads, m_RecursionHeads)
+    cppcmb_getter(call_stack, m_LrStack)
+    cppcmb_getter(rule_stats, m_RuleStats)
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Sets the state that every parse starts with.
+     */
+    template <typename T>
+    void set_state(T init) {
+        m_InitialState = std::move(init);
+        m_State = m_InitialState;
+        m_MemoTable.bump_state_version();
+    }
+
+    [[nodiscard]] bool has_state() const noexcept {
+        return m_State.has_value();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Restores the initial state, for a new parse.
+     */
+    void reset_state() {
+        m_StateLog.clear();
+        m_BranchLog = no_branch;
+        if (m_InitialState.has_value()) {
+            m_State = m_InitialState;
+            m_MemoTable.bump_state_version();
+        }
+    }
+
+    /**
+     * The current state, without registering a dependency on it.
+     */
+    template <typename T>
+    [[nodiscard]] T const& peek_state() const noexcept {
+        auto const* st = std::any_cast<T>(&m_State);
+        cppcmb_assert("The parse state is not set or of another type!", st);
+        return *st;
+    }
+
+    /**
+     * The current state. The memorized results computed now depend on it.
+     */
+    template <typename T>
+    [[nodiscard]] T const& read_state() noexcept {
+        m_MemoTable.note_state_read();
+        return peek_state<T>();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Calls fn with the mutable state. The memorized results of the previous
+     * state aren't reused after this. The change is undone, if an enclosing
+     * branch fails.
+     */
+    template <typename T, typename Fn>
+    decltype(auto) update_state(Fn&& fn) {
+        auto* st = std::any_cast<T>(&m_State);
+        cppcmb_assert("The parse state is not set or of another type!", st);
+        if (m_StateLog.size() == m_BranchLog) {
+            // First change in the innermost branch
+            m_StateLog.push_back(m_State);
+        }
+        m_MemoTable.bump_state_version();
+        return cppcmb_fwd(fn)(*st);
+    }
+
+    /**
+     * Marks the start of a branch, that the parse backtracks from, if it
+     * fails. Every branch must be left with leave_branch.
+     */
+    [[nodiscard]] choice_point enter_branch() noexcept {
+        auto cp = choice_point{
+            m_MemoTable.trail_size(), m_StateLog.size(), m_BranchLog
+        };
+        m_BranchLog = cp.log;
+        return cp;
+    }
+
+    /**
+     * True, if the state changed since the start of the innermost open
+     * branch, that started at from.
+     */
+    [[nodiscard]] bool changed_state(choice_point const& from)
+        const noexcept {
+        return m_StateLog.size() > from.log;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Backtracks to the start of the innermost open branch, that started at
+     * from. What it used is not part of the derivation, and the state
+     * changes in it are undone. The branch stays open.
+     */
+    void backtrack(choice_point const& from) {
+        m_MemoTable.drop_trail(from.trail, m_MemoTable.trail_size());
+        if (m_StateLog.size() > from.log) {
+            m_State = std::move(m_StateLog[from.log]);
+            m_StateLog.resize(from.log);
+            m_MemoTable.bump_state_version();
+        }
+    }
+
+    /**
+     * Backtracks from the branch between from and to, that was not taken in
+     * the end, like the shorter one of an eager alternative. Only the
+     * derivation is affected.
+     */
+    void backtrack(choice_point const& from, choice_point const& to)
+        noexcept {
+        m_MemoTable.drop_trail(from.trail, to.trail);
+    }
+
+    /**
+     * Leaves the innermost open branch, that started at from, keeping its
+     * changes. The state before them is kept for the enclosing branch, if
+     * that has no change recorded yet.
+     */
+    void leave_branch(choice_point const& from) noexcept {
+        m_BranchLog = from.outer;
+        auto keep = from.outer == from.log ? from.log + 1 : from.log;
+        if (m_StateLog.size() > keep) {
+            m_StateLog.resize(keep);
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void clear() {
+        m_MemoTable.clear();
+        m_RecursionHeads.clear();
+        m_LrStack.clear();
+        m_RuleStats.new_input();
+    }
+};
+
+namespace detail {
+
+/**
+ * A branch of a choice, until the end of the scope. Readers without a memo
+ * context don't backtrack anything.
+ */
+class branch_scope {
+private:
+    memo_context* m_Context;
+    choice_point  m_Point;
+
+public:
+    template <typename Src>
+    explicit branch_scope(reader<Src> const& r) noexcept
+        : m_Context(r.context_ptr()),
+          m_Point(m_Context != nullptr
+              ? m_Context->enter_branch() : choice_point()) {
+    }
+
+    branch_scope(branch_scope const&) = delete;
+    branch_scope& operator=(branch_scope const&) = delete;
+
+    ~branch_scope() {
+        if (m_Context != nullptr) {
+            m_Context->leave_branch(m_Point);
+        }
+    }
+
+    [[nodiscard]] bool changed_state() const noexcept {
+        return m_Context != nullptr && m_Context->changed_state(m_Point);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void backtrack() {
+        if (m_Context != nullptr) {
+            m_Context->backtrack(m_Point);
+        }
+    }
+
+    /**
+     * Drops the derivation of this branch until the start of next.
+     */
+    void backtrack_until(branch_scope const& next) noexcept {
+        if (m_Context != nullptr) {
+            m_Context->backtrack(m_Point, next.m_Point);
+        }
+    }
+};
+
+} /* namespace detail */
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * A tag-type for a more uniform alternative syntax.
+ * This can be put as the first element of an alternative chain so every new
+ * line can start with the alternative operator. It's completely ignored.
+ * Example:
+ * auto parser = pass
+ *             | first
+ *             | second
+ *             ;
+ */
+struct pass_t {};
+
+inline constexpr auto pass = pass_t();
+
+template <typename P1, typename P2>
+class alt_t : public combinator<alt_t<P1, P2>> {
+private:
+    template <typename Src>
+    using value_t = sum_values_t<
+        parser_value_t<P1, Src>,
+        parser_value_t<P2, Src>
+    >;
+
+    P1 m_First;
+    P2 m_Second;
+
+public:
+    template <typename P1Fwd, typename P2Fwd>
+    constexpr alt_t(P1Fwd&& p1, P2Fwd&& p2)
+        noexcept(
+            std::is_nothrow_constructible_v<P1, P1Fwd&&>
+         && std::is_nothrow_constructible_v<P2, P2Fwd&&>
+        )
+        : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
+    }
+
+    cppcmb_getter(first, m_First)
+    cppcmb_getter(second, m_Second)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P1, Src);
+        cppcmb_assert_parser(P2, Src);
+
+        using result_t = result<value_t<Src>>;
+
+        // Try to apply the first alternative
+        auto branch = detail::branch_scope(r);
+        auto p1_inv = m_First.apply(r);
+        if (p1_inv.is_success()) {
+            auto p1_succ = std::move(p1_inv).success();
+            return result_t(
+                success(
+                    sum_values<value_t<Src>>(std::move(p1_succ).value()),
+                    p1_succ.matched()
+                ),
+                p1_inv.furthest()
+            );
+        }
+
+        branch.backtrack();
+
+        // Try to apply the second alternative
+        auto p2_inv = m_Second.apply(r);
+        if (p2_inv.is_success()) {
+            auto p2_succ = std::move(p2_inv).success();
+            return result_t(
+                success(
+                    sum_values<value_t<Src>>(std::move(p2_succ).value()),
+                    p2_succ.matched()
+                ),
+                std::max(p1_inv.furthest(), p2_inv.furthest())
+            );
+        }
+
+        branch.backtrack();
+
+        // Both failed, return the error which got further
+        auto p1_err = std::move(p1_inv).failure();
+        auto p2_err = std::move(p2_inv).failure();
+
+        if (p1_inv.furthest() > p2_inv.furthest()) {
+            return result_t(std::move(p1_err), p1_inv.furthest());
+        }
+        if (p1_inv.furthest() < p2_inv.furthest()) {
+            return result_t(std::move(p2_err), p2_inv.furthest());
+        }
+        // They got to the same distance, need to merge errors
+        // XXX(LPeter1997): Implement, for now we just return the first
+        return result_t(std::move(p1_err), p1_inv.furthest());
+    }
+};
+
+template <typename P1Fwd, typename P2Fwd>
+alt_t(P1Fwd, P2Fwd) -> alt_t<P1Fwd, P2Fwd>;
+
+/**
+ * Operator for making alternatives.
+ */
+template <typename P1, typename P2,
+    cppcmb_requires_t(detail::all_combinators_cvref_v<P1, P2>)>
+[[nodiscard]] constexpr auto operator|(P1&& p1, P2&& p2)
+    cppcmb_return(alt_t(cppcmb_fwd(p1), cppcmb_fwd(p2)))
+
+/**
+ * Ignore pass.
+ */
+template <typename P2,
+    cppcmb_requires_t(detail::is_combinator_cvref_v<P2>)>
+[[nodiscard]] constexpr auto operator|(pass_t, P2&& p2)
+    cppcmb_return(cppcmb_fwd(p2))
+
+} /* namespace cppcmb */
+
+// XXX(LPeter1997): We could check the collection for push_back (better errors)
+
+namespace cppcmb {
+
+/**
+ * A type-pack that describes a collection except it's type.
+ * Used for the many and many1 combinators.
+ */
+template <
+    template <typename...> typename Coll,
+    template <typename> typename... Ts
+>
+struct collect_to_t {
+    template <typename T>
+    using type = Coll<T, Ts<T>...>;
+};
+
+template <
+    template <typename...> typename Coll,
+    template <typename> typename... Ts
+>
+inline constexpr auto collect_to = collect_to_t<Coll, Ts...>();
+
+namespace detail {
+
+/**
+ * Tag-type for many and many1.
+ */
+struct many_tag {};
+
+/**
+ * SFINAE for many types.
+ */
+template <typename T>
+inline constexpr bool is_many_v = std::is_base_of_v<many_tag, T>;
+
+} /* namespace detail */
+
+template <typename P, typename To = collect_to_t<std::vector>>
+class many_t : public combinator<many_t<P>>,
+               private detail::many_tag {
+private:
+    cppcmb_self_check(many_t);
+
+    template <typename Src>
+    using value_t = typename To::template type<parser_value_t<P, Src>>;
+
+    P m_Parser;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr many_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) &
+        cppcmb_return(many_t<P, To2>(m_Parser))
+
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) const&
+        cppcmb_return(many_t<P, To2>(m_Parser))
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) &&
+        cppcmb_return(many_t<P, To2>(std::move(m_Parser)))
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) const&&
+        cppcmb_return(many_t<P, To2>(std::move(m_Parser)))
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = result<value_t<Src>>;
+
+        std::size_t furthest = 0U;
+        std::size_t matched = 0U;
+        auto coll = value_t<Src>();
+        auto rr = r;
+        while (true) {
+            auto branch = detail::branch_scope(rr);
+            auto p_inv = m_Parser.apply(rr);
+            furthest = std::max(furthest, matched + p_inv.furthest());
+            if (p_inv.is_failure()) {
+                // Stop applying
+                branch.backtrack();
+                break;
+            }
+            auto p_succ = std::move(p_inv).success();
+            matched += p_succ.matched();
+            // Add to collection
+            coll.push_back(std::move(p_succ).value());
+            // Move reader
+            rr.seek(rr.cursor() + p_succ.matched());
+        }
+        return result_t(success(std::move(coll), matched), furthest);
+    }
+};
+
+template <typename PFwd>
+many_t(PFwd) -> many_t<PFwd>;
+
+/**
+ * Operator for making many parser.
+ */
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+[[nodiscard]] constexpr auto operator*(P&& p)
+    cppcmb_return(many_t(cppcmb_fwd(p)))
+
+/**
+ * Operator to collect 'many' and 'many1' to a different container.
+ */
+template <typename P, typename To,
+    cppcmb_requires_t(detail::is_many_v<detail::remove_cvref_t<P>>)>
+[[nodiscard]] constexpr auto operator>>(P&& p, To to)
+    cppcmb_return(cppcmb_fwd(p).collect_to(to))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename P, typename To = collect_to_t<std::vector>>
+class many1_t : public combinator<many1_t<P>>,
+                private detail::many_tag {
+private:
+    cppcmb_self_check(many1_t);
+
+    template <typename Src>
+    using value_t = parser_value_t<many_t<P, To>, Src>;
+
+    many_t<P, To> m_Parser;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr many1_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(many_t<P, To>(cppcmb_fwd(p))) {
+    }
+
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) &
+        cppcmb_return(many1_t<P, To2>(m_Parser.underlying()))
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) const&
+        cppcmb_return(many1_t<P, To2>(m_Parser.underlying()))
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) &&
+        cppcmb_return(many1_t<P, To2>(std::move(m_Parser).underlying()))
+    template <typename To2>
+    [[nodiscard]] constexpr auto collect_to(To2) const&&
+        cppcmb_return(many1_t<P, To2>(std::move(m_Parser).underlying()))
+
+    cppcmb_getter(underlying, m_Parser.underlying())
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = result<value_t<Src>>;
+
+        auto p_inv = m_Parser.apply(r);
+
+        cppcmb_assert(
+            "The underlying 'many' parser must always succeed!",
+            p_inv.is_success()
+        );
+
+        auto p_succ = std::move(p_inv).success();
+        if (p_succ.value().size() > 0) {
+            // Succeed
+            return result_t(std::move(p_succ), p_inv.furthest());
+        }
+        // Fail
+        return result_t(failure(), p_inv.furthest());
+    }
+};
+
+template <typename PFwd>
+many1_t(PFwd) -> many1_t<PFwd>;
+
+/**
+ * Operator for making many1 parser.
+ */
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+[[nodiscard]] constexpr auto operator+(P&& p)
+    cppcmb_return(many1_t(cppcmb_fwd(p)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+class one_t : public combinator<one_t> {
+public:
+    // XXX(LPeter1997): Do we need typename here?
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<typename reader<Src>::value_type> {
+
+        using result_t = result<typename reader<Src>::value_type>;
+
+        if (r.is_end()) {
+            // Nothing to consume
+            return result_t(failure(), 0U);
+        }
+        // Consume an element
+        return result_t(success(r.current(), 1U), 1U);
+    }
+};
+
+// Value for 'one' parser
+inline constexpr one_t one = one_t();
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename P1, typename P2>
+class seq_t : public combinator<seq_t<P1, P2>> {
+private:
+    template <typename Src>
+    using value_t = decltype(product_values(
+        std::declval<parser_value_t<P1, Src>>(),
+        std::declval<parser_value_t<P2, Src>>()
+    ));
+
+    P1 m_First;
+    P2 m_Second;
+
+public:
+    template <typename P1Fwd, typename P2Fwd>
+    constexpr seq_t(P1Fwd&& p1, P2Fwd&& p2)
+        noexcept(
+            std::is_nothrow_constructible_v<P1, P1Fwd&&>
+         && std::is_nothrow_constructible_v<P2, P2Fwd&&>
+        )
+        : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
+    }
+
+    cppcmb_getter(first, m_First)
+    cppcmb_getter(second, m_Second)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P1, Src);
+        cppcmb_assert_parser(P2, Src);
+
+        using result_t = result<value_t<Src>>;
+
+        auto p1_inv = m_First.apply(r);
+        if (p1_inv.is_failure()) {
+            // Early failure, don't continue
+            return result_t(std::move(p1_inv).failure(), p1_inv.furthest());
+        }
+        // Get the success alternative
+        auto p1_succ = std::move(p1_inv).success();
+        // Create the next reader
+        auto r2 = reader(
+            r.source(), r.cursor() + p1_succ.matched(), r.context_ptr()
+        );
+        // Invoke the second parser
+        auto p2_inv = m_Second.apply(r2);
+        // Max peek distance
+        auto max_furthest = std::max(
+            p1_inv.furthest(),
+            p1_succ.matched() + p2_inv.furthest()
+        );
+        if (p2_inv.is_failure()) {
+            // Second failed, fail on that error
+            return result_t(
+                std::move(p2_inv).failure(),
+                max_furthest
+            );
+        }
+        // Get the success alternative
+        auto p2_succ = std::move(p2_inv).success();
+        // Combine the values
+        return result_t(
+            success(
+                product_values(
+                    std::move(p1_succ).value(),
+                    std::move(p2_succ).value()
+                ),
+                p1_succ.matched() + p2_succ.matched()
+            ),
+            max_furthest
+        );
+    }
+};
+
+template <typename P1Fwd, typename P2Fwd>
+seq_t(P1Fwd, P2Fwd) -> seq_t<P1Fwd, P2Fwd>;
+
+/**
+ * Operator for making a sequence.
+ */
+template <typename P1, typename P2,
+    cppcmb_requires_t(detail::all_combinators_cvref_v<P1, P2>)>
+[[nodiscard]] constexpr auto operator&(P1&& p1, P2&& p2)
+    cppcmb_return(seq_t(cppcmb_fwd(p1), cppcmb_fwd(p2)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename Pred>
+class filter {
+private:
+    cppcmb_self_check(filter);
+
+    template <typename... Ts>
+    using value_t = decltype(product_values(
+        std::declval<Ts>()...
+    ));
+
+    Pred m_Predicate;
+
+public:
+    template <typename PredFwd, cppcmb_requires_t(!is_self_v<PredFwd>)>
+    constexpr filter(PredFwd&& pred)
+        noexcept(std::is_nothrow_constructible_v<Pred, PredFwd&&>)
+        : m_Predicate(cppcmb_fwd(pred)) {
+    }
+
+    cppcmb_getter(predicate, m_Predicate)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... Ts>
+    [[nodiscard]] constexpr auto operator()(Ts&&... args) const
+        -> maybe<value_t<Ts&&...>> {
+        static_assert(
+            std::is_invocable_v<Pred, Ts&&...>,
+            "The predicate must be invocable with the parser value!"
+        );
+        using result_t = std::invoke_result_t<Pred, Ts&&...>;
+        static_assert(
+            std::is_convertible_v<result_t, bool>,
+            "The predicate must return a type that is convertible to bool!"
+        );
+
+        if (m_Predicate(args...)) {
+            // Predicate returned true, succeed
+            return some(product_values(cppcmb_fwd(args)...));
+        }
+        // Predicate failed, fail
+        return none();
+    }
+};
+
+template <typename PredFwd>
+filter(PredFwd) -> filter<PredFwd>;
+
+} /* namespace cppcmb */
+
+// XXX(LPeter1997): There is probably a bug with Clang where selecting nothing
+// from product<> fails. The JSON example (other repo right now) shows that at
+// line 127
+
+namespace cppcmb {
+
+template <std::size_t... Ns>
+class select_t {
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... Ts>
+    [[nodiscard]] constexpr decltype(auto) operator()(Ts&&... args) const {
+        return product_values(
+            std::get<Ns>(std::tuple(cppcmb_fwd(args)...))...
+        );
+    }
+};
+
+template <std::size_t... Ns>
+inline constexpr auto select = select_t<Ns...>();
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+namespace regex {
+
+/**
+ * <top>           ::= <term> '|' <top>
+ *                   | <term>
+ *                   ;
+ *
+ * <term>          ::= <factor> <term>
+ *                   | <factor>
+ *                   ;
+ *
+ * <factor>        ::= <atom> '*'
+ *                   | <atom> '+'
+ *                   | <atom> '?'
+ *                   | <atom>
+ *                   ;
+ *
+ * <atom>          ::= '(' <top> ')'
+ *                   | '[' <char_grouping> ']'
+ *                   | <literal>
+ *                   ;
+ *
+ * <char_grouping> ::= <group_element> <char_grouping>
+ *                   | <group_element>
+ *                   ;
+ *
+ * <group_element> ::= '\' '-'
+ *                   | <literal> '-' <literal>
+ *                   | <literal>
+ *                   ;
+ *
+ * <literal>       ::= CHAR
+ *                   | '\' SPECIAL_CHAR
+ *                   ;
+ */
+
+template <char Ch>
+constexpr bool is_char(char c) { return c == Ch; }
+
+template <char Ch>
+inline constexpr auto ch = one[filter(is_char<Ch>)][select<>];
+
+template <char Ch1, char Ch2>
+constexpr bool is_range(char c) {
+    static_assert(Ch1 <= Ch2);
+    return c >= Ch1 && c <= Ch2;
+}
+
+template <char Ch1, char Ch2>
+inline constexpr auto range = one[filter(is_range<Ch1, Ch2>)][select<>];
+
+// XXX(LPeter1997): We publish something like this in the API
+/**
+ * A dummy collection interface.
+ */
+template <typename>
+class drop_collection {
+private:
+    std::size_t cnt = 0;
+
+public:
+    template <typename TFwd>
+    constexpr void push_back(TFwd&&) noexcept {
+        ++cnt;
+    }
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept { return cnt; }
+};
+
+/**
+ * Succeeds when the underlying character-parser fails. Can only be used with
+ * single character parsers!
+ */
+template <typename P>
+class not_char : public combinator<not_char<P>> {
+private:
+    cppcmb_self_check(not_char);
+
+    P m_Parser;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr not_char(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<product<>> {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = result<product<>>;
+
+        auto inv = m_Parser.apply(r);
+        if (inv.is_success()) {
+            // We fail
+            return result_t(failure(), inv.furthest());
+        }
+        // We succeed
+        return result_t(success(product<>(), 1), inv.furthest());
+    }
+};
+
+template <typename PFwd>
+not_char(PFwd) -> not_char<PFwd>;
+
+/**
+ * Marks the I-th capture group (counted from 1) of a pattern. As a parser,
+ * it's the same as the underlying one.
+ */
+template <std::size_t I, typename P>
+class group : public combinator<group<I, P>> {
+private:
+    cppcmb_self_check(group);
+
+    P m_Parser;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr group(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+        return m_Parser.apply(r);
+    }
+};
+
+/**
+ * The number of capture groups that start before the index.
+ */
+template <typename Src>
+[[nodiscard]] constexpr std::size_t count_groups(Src src, std::size_t end)
+    noexcept {
+    std::size_t n = 0;
+    bool in_class = false;
+    for (std::size_t i = 0; i < end && i < src().size(); ++i) {
+        char c = src()[i];
+        if (c == '\\') {
+            // Skip the escaped character
+            ++i;
+        }
+        else if (in_class) {
+            in_class = c != ']';
+        }
+        else if (c == '[') {
+            in_class = true;
+        }
+        else if (c == '(') {
+            ++n;
+        }
+    }
+    return n;
+}
+
+/**
+ * When Capture is true, the groups are wrapped in the group marker.
+ */
+template <bool Capture>
+struct basic_parser {
+    template <typename T>
+    [[nodiscard]] static constexpr auto star(T p) noexcept {
+        return action_t((*p >> collect_to<drop_collection>), select<>);
+    }
+
+    template <typename T>
+    [[nodiscard]] static constexpr auto plus(T p) noexcept {
+        return action_t((+p >> collect_to<drop_collection>), select<>);
+    }
+
+    template <typename T>
+    [[nodiscard]] static constexpr auto qmark(T p) noexcept {
+        return action_t(-p, select<>);
+    }
+
+    template <typename T>
+    static constexpr bool is_failure(T) {
+        return std::is_same_v<remove_cvref_t<T>, failure>;
+    }
+
+    // The parser peeks one past the end of the pattern, which must be a
+    // constant expression too
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr char char_at(Src src) noexcept {
+        if constexpr (Idx < src().size()) {
+            return src()[Idx];
+        }
+        else {
+            return '\0';
+        }
+    }
+
+    [[nodiscard]] static constexpr bool is_special(char ch) noexcept {
+        return ch == '(' || ch == ')'
+            || ch == '[' || ch == ']'
+            || ch == '*' || ch == '+'
+            || ch == '|' || ch == '?'
+            || ch == '\\'
+            ;
+    }
+
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto top(Src src) noexcept {
+        constexpr auto lhs = term<Idx>(src);
+        static_assert(!is_failure(lhs));
+        constexpr std::size_t NextIdx = Idx + lhs.matched();
+        if constexpr (char_at<NextIdx>(src) == '|') {
+            constexpr auto rhs = top<NextIdx + 1>(src);
+            static_assert(!is_failure(rhs));
+            return success(
+                lhs.value() | rhs.value(),
+                lhs.matched() + 1 + rhs.matched()
+            );
+        }
+        else {
+            return lhs;
+        }
+    }
+
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto term(Src src) noexcept {
+        constexpr auto lhs = factor<Idx>(src);
+        static_assert(!is_failure(lhs));
+        constexpr std::size_t NextIdx = Idx + lhs.matched();
+        return term_impl<NextIdx>(lhs, src);
+    }
+
+    template <std::size_t Idx, typename Res, typename Src>
+    [[nodiscard]] static constexpr auto term_impl(Res res, Src src) noexcept {
+        if constexpr (src().size() <= Idx) {
+            return res;
+        }
+        else {
             constexpr auto lhs = factor<Idx>(src);
             if constexpr (is_failure(lhs)) {
                 return res;
             }
-            else {
-                constexpr std::size_t NextIdx = Idx + lhs.matched();
-                return term_impl<NextIdx>(
-                    success(
-                        res.value() & lhs.value(),
-                        res.matched() + lhs.matched()
-                    ),
-                    src
+            else {
+                constexpr std::size_t NextIdx = Idx + lhs.matched();
+                return term_impl<NextIdx>(
+                    success(
+                        res.value() & lhs.value(),
+                        res.matched() + lhs.matched()
+                    ),
+                    src
+                );
+            }
+        }
+    }
+
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto factor(Src src) noexcept {
+        constexpr auto lhs = atom<Idx>(src);
+        if constexpr (is_failure(lhs)) {
+            return failure();
+        }
+        else {
+            constexpr std::size_t NextIdx = Idx + lhs.matched();
+            constexpr char curr = char_at<NextIdx>(src);
+            if constexpr (curr == '*') {
+                return success(star(lhs.value()), lhs.matched() + 1);
+            }
+            else if constexpr (curr == '+') {
+                return success(plus(lhs.value()), lhs.matched() + 1);
+            }
+            else if constexpr (curr == '?') {
+                return success(qmark(lhs.value()), lhs.matched() + 1);
+            }
+            else {
+                return lhs;
+            }
+        }
+    }
+
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto atom(Src src) noexcept {
+        if constexpr (Idx < src().size()) {
+            constexpr char curr = char_at<Idx>(src);
+            if constexpr (curr == '(') {
+                // Grouping
+                constexpr auto sub = top<Idx + 1>(src);
+                static_assert(!is_failure(sub));
+                constexpr std::size_t NextIdx = Idx + 1 + sub.matched();
+                static_assert(char_at<NextIdx>(src) == ')');
+                if constexpr (Capture) {
+                    constexpr std::size_t I = count_groups(src, Idx) + 1;
+                    using sub_t = remove_cvref_t<decltype(sub.value())>;
+                    return success(
+                        group<I, sub_t>(sub.value()),
+                        sub.matched() + 2
+                    );
+                }
+                else {
+                    return success(sub.value(), sub.matched() + 2);
+                }
+            }
+            else if constexpr (curr == '[') {
+                // Character classes
+                if constexpr (char_at<Idx + 1>(src) == '^') {
+                    // Negated group
+                    constexpr auto sub = char_grouping<Idx + 2>(src);
+                    static_assert(!is_failure(sub));
+                    constexpr std::size_t NextIdx = Idx + 2 + sub.matched();
+                    static_assert(char_at<NextIdx>(src) == ']');
+                    return success(not_char(sub.value()), sub.matched() + 3);
+                }
+                else {
+                    constexpr auto sub = char_grouping<Idx + 1>(src);
+                    static_assert(!is_failure(sub));
+                    constexpr std::size_t NextIdx = Idx + 1 + sub.matched();
+                    static_assert(char_at<NextIdx>(src) == ']');
+                    return success(sub.value(), sub.matched() + 2);
+                }
+            }
+            else {
+                return literal<Idx>(src);
+            }
+        }
+        else {
+            return failure();
+        }
+    }
+
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto char_grouping(Src src) noexcept {
+        constexpr auto lhs = group_element<Idx>(src);
+        static_assert(!is_failure(lhs));
+        return char_grouping_impl<Idx + lhs.matched()>(lhs, src);
+    }
+
+    template <std::size_t Idx, typename Res, typename Src>
+    [[nodiscard]]
+    static constexpr auto char_grouping_impl(Res res, Src src) noexcept {
+        constexpr auto lhs = group_element<Idx>(src);
+        if constexpr (is_failure(lhs)) {
+            return res;
+        }
+        else {
+            return char_grouping_impl<Idx + lhs.matched()>(
+                success(
+                    res.value() | lhs.value(),
+                    res.matched() + lhs.matched()
+                ),
+                src
+            );
+        }
+    }
+
+    // XXX(LPeter1997): Clang bug here...
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto group_element(Src src) noexcept {
+        if constexpr (char_at<Idx>(src) == '\\'
+                   && char_at<Idx + 1>(src) == '-') {
+            return success(ch<'-'>, 2);
+        }
+        else {
+            constexpr auto lit = literal_ch<Idx>(src);
+            if constexpr (is_failure(lit)) {
+                return failure();
+            }
+            else {
+                constexpr std::size_t NextIdx = Idx + lit.matched();
+                if constexpr (char_at<NextIdx>(src) == '-') {
+                    constexpr auto lit2 = literal_ch<NextIdx + 1>(src);
+                    if constexpr (is_failure(lit2)) {
+                        // No right-hand-side, only consumed lit
+                        return success(ch<lit.value()>, lit.matched());
+                    }
+                    else {
+                        // Char range
+                        return success(
+                            range<lit.value(), lit2.value()>,
+                            lit.matched() + 1 + lit2.matched()
+                        );
+                    }
+                }
+                else {
+                    return success(ch<lit.value()>, lit.matched());
+                }
+            }
+        }
+        // NOLINTNEXTLINE
+    } // NOLINT
+
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto literal(Src src) noexcept {
+        constexpr auto lc = literal_ch<Idx>(src);
+        if constexpr (is_failure(lc)) {
+            return failure();
+        }
+        else {
+            return success(ch<lc.value()>, lc.matched());
+        }
+    }
+
+    template <std::size_t Idx, typename Src>
+    [[nodiscard]] static constexpr auto literal_ch(Src src) noexcept {
+        constexpr char curr = char_at<Idx>(src);
+        if constexpr (curr == '\\') {
+            // Escaped
+            constexpr char nxt = char_at<Idx + 1>(src);
+            static_assert(is_special(nxt));
+            return success(nxt, 2);
+        }
+        else if constexpr (is_special(curr)) {
+            // Special characters
+            return failure();
+        }
+        else {
+            // Literal match
+            return success(curr, 1);
+        }
+    }
+};
+
+using parser = basic_parser<false>;
+
+} /* namespace regex */
+} /* namespace detail */
+
+/**
+ * A way to define compile-time strings.
+ */
+#define cppcmb_str(str) ([] { return ::std::basic_string_view(str); })
+
+template <typename Str>
+[[nodiscard]] constexpr auto regex(Str str) noexcept {
+    constexpr auto res = detail::regex::parser::top<0>(str);
+    static_assert(
+        !detail::regex::parser::is_failure(res),
+        "Invalid regular-expression!"
+    );
+    return res.value();
+}
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename CharT, typename Tag>
+class token {
+private:
+    std::basic_string_view<CharT> m_Content;
+    Tag                           m_Type;
+
+public:
+    constexpr token(std::basic_string_view<CharT> cont, Tag ty) noexcept
+        : m_Content(cont), m_Type(ty) {
+    }
+
+    [[nodiscard]] constexpr auto const& content() const noexcept {
+        return m_Content;
+    }
+
+    [[nodiscard]] constexpr auto const& type() const noexcept {
+        return m_Type;
+    }
+};
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * Signal that we want to skip these characters instead of making a token out of
+ * them.
+ */
+struct skip_t {};
+
+inline constexpr auto skip = skip_t();
+
+/**
+ * Signal that the token rule should ignore ASCII case. The regex of such rules
+ * has to be written in lower-case.
+ */
+struct icase_t {};
+
+inline constexpr auto icase = icase_t();
+
+/**
+ * Lexer mode actions of token rules, only a modal_lexer supports them. A rule
+ * can push a new mode on the mode stack, or pop the current one.
+ */
+struct no_mode_t {};
+
+template <std::size_t Mode>
+struct push_mode_t {
+    static constexpr std::size_t mode = Mode;
+};
+
+struct pop_mode_t {};
+
+template <std::size_t Mode>
+inline constexpr auto push_mode = push_mode_t<Mode>();
+
+inline constexpr auto pop_mode = pop_mode_t();
+
+namespace detail {
+
+// XXX(LPeter1997): This implementation blocks incremental features
+template <typename P, typename Tag>
+class token_parser : public combinator<token_parser<P, Tag>> {
+private:
+    P m_Parser;
+    Tag m_Tag;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    constexpr token_parser(PFwd&& p, Tag t)
+        : m_Parser(cppcmb_fwd(p)), m_Tag(t) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<maybe<token<typename reader<Src>::value_type, Tag>>> {
+
+        using maybe_t = maybe<token<typename reader<Src>::value_type, Tag>>;
+        using result_t = result<maybe_t>;
+
+        auto t = m_Parser.apply(r);
+        if (t.is_success()) {
+            auto src = std::basic_string_view(r.source());
+            std::size_t len = t.success().matched();
+            auto tok = token(src.substr(r.cursor(), len), m_Tag);
+
+            return result_t(
+                success(maybe_t(some(std::move(tok))), len),
+                t.furthest()
+            );
+        }
+        return result_t(std::move(t).failure(), t.furthest());
+    }
+};
+
+template <typename P, typename Tag>
+class skip_token_parser : public combinator<skip_token_parser<P, Tag>> {
+private:
+    P m_Parser;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    constexpr skip_token_parser(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<maybe<token<typename reader<Src>::value_type, Tag>>> {
+
+        using maybe_t = maybe<token<typename reader<Src>::value_type, Tag>>;
+        using result_t = result<maybe_t>;
+
+        auto t = m_Parser.apply(r);
+        if (t.is_success()) {
+            return result_t(
+                success(maybe_t(none()), t.success().matched()),
+                t.furthest()
+            );
+        }
+        return result_t(std::move(t).failure(), t.furthest());
+    }
+};
+
+// XXX(LPeter1997): Noexcept specifier
+template <bool ICase, typename Src>
+[[nodiscard]] constexpr auto str_to_rule_parser(Src src) {
+    if constexpr (ICase) {
+        static_assert(
+            !ascii_has_upper(src()),
+            "The regex of a case-insensitive token rule must be written in "
+            "lower-case!"
+        );
+        return ignore_case_t(::cppcmb::regex(src));
+    }
+    else {
+        return ::cppcmb::regex(src);
+    }
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename Tag, bool ICase, typename Src, typename TTag>
+[[nodiscard]] constexpr auto str_to_token_parser(Src src, TTag t) {
+    ((void)t); // Unused warning
+    auto p = str_to_rule_parser<ICase>(src);
+    using parser_type = decltype(p);
+    if constexpr (std::is_same_v<TTag, skip_t>) {
+        // We want to skip this
+        return skip_token_parser<parser_type, Tag>(std::move(p));
+    }
+    else {
+        // Keep it
+        static_assert(std::is_same_v<Tag, TTag>);
+        return token_parser<parser_type, Tag>(std::move(p), t);
+    }
+}
+
+/**
+ * Trait to find the first not skip-type in the type-list.
+ */
+template <typename...>
+struct first_not_skip;
+
+// If there is none, we signal failure with defining skip_t
+template <>
+struct first_not_skip<> {
+    using type = skip_t;
+};
+
+template <typename Head, typename... Tail>
+struct first_not_skip<Head, Tail...> {
+    using type = std::conditional_t<
+        std::is_same_v<Head, skip_t>,
+        typename first_not_skip<Tail...>::type,
+        Head
+    >;
+};
+
+template <typename... Ts>
+using first_not_skip_t = typename first_not_skip<Ts...>::type;
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename... Rs>
+[[nodiscard]] constexpr auto make_lexer_parser(Rs&&... rules) {
+    using token_type = first_not_skip_t<
+        typename remove_cvref_t<Rs>::tag_type...
+    >;
+    static_assert(
+        (... && std::is_same_v<typename remove_cvref_t<Rs>::action_type,
+            no_mode_t>),
+        "Mode actions can only be used with a modal_lexer!"
+    );
+    // XXX(LPeter1997): Or we could just allow it
+    static_assert(
+        !std::is_same_v<token_type, skip_t>,
+        "There must be at least one token rule that doesn't skip!"
+    );
+    // XXX(LPeter1997): We could do a check if the tokenizer succeeds for an
+    // empty string. If it does, tell the user it's a BAD idea.
+    return (... | str_to_token_parser<
+        token_type,
+        remove_cvref_t<Rs>::case_insensitive
+    >(
+        cppcmb_fwd(rules).source(),
+        cppcmb_fwd(rules).tag()
+    ));
+}
+
+} /* namespace detail */
+
+template <typename Lexer, typename Src>
+class token_iterator {
+public:
+    using token_type        = detail::remove_cvref_t<decltype(
+        std::declval<Lexer const&>()
+            .rule()
+            .apply(std::declval<reader<Src> const&>())
+            .success()
+            .value()
+            .some()
+            .value()
+            .type()
+    )>;
+    using value_type        =
+        result<token<typename reader<Src>::value_type, token_type>>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = value_type const*;
+    using reference         = value_type const&;
+    using iterator_category = std::forward_iterator_tag;
+
+private:
+    Lexer const*              m_Lexer;
+    reader<Src>               m_Reader;
+    std::optional<value_type> m_Last;
+
+public:
+    constexpr token_iterator() noexcept
+        : m_Lexer(nullptr), m_Reader(), m_Last(std::nullopt) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_iterator(Lexer const& l, Src const& src)
+        : m_Lexer(::std::addressof(l)), m_Reader(src) {
+        find_token();
+    }
+
+    template <typename Src2>
+    [[nodiscard]]
+    constexpr bool
+    operator==(token_iterator<Lexer, Src2> const& o) const noexcept {
+        // A null-source in the reader indicates the end
+        if (m_Reader.source_ptr() == nullptr) {
+            if (o.m_Reader.source_ptr() == nullptr) {
+                return true;
+            }
+            if (o.m_Reader.is_end()) {
+                return true;
+            }
+        }
+        if (o.m_Reader.source_ptr() == nullptr) {
+            if (m_Reader.is_end()) {
+                return true;
+            }
+        }
+        // Both readers have sources
+        return m_Reader.source_ptr() == o.m_Reader.source_ptr()
+            && m_Reader.cursor()     == o.m_Reader.cursor();
+    }
+
+    template <typename Src2>
+    [[nodiscard]]
+    constexpr bool
+    operator!=(token_iterator<Lexer, Src2> const& o) const noexcept {
+        return !operator==(o);
+    }
+
+    [[nodiscard]] constexpr reference operator*() const noexcept {
+        cppcmb_assert(
+            "A value must be present for de-referencing!",
+            m_Last.has_value()
+        );
+        return *m_Last;
+    }
+
+    [[nodiscard]] constexpr pointer operator->() const noexcept {
+        return ::std::addressof(operator*());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    // NOLINTNEXTLINE(cert-dcl21-cpp)
+    constexpr token_iterator& operator++() & {
+        cppcmb_assert(
+            "A token iterator without a source can't be incremented!",
+            m_Reader.source_ptr() != nullptr
+        );
+        cppcmb_assert(
+            "A token iterator at the end can't be incremented!",
+            !m_Reader.is_end()
+        );
+        cppcmb_assert(
+            "Precondition of increment is dereferenceable!",
+            m_Last.has_value()
+        );
+        auto const& last = *m_Last;
+        if (last.is_success()) {
+            // For success we skip the entire thing
+            m_Reader.seek(m_Reader.cursor() + last.success().matched());
+        }
+        else {
+            // XXX(LPeter1997): Is this the best strategy?
+            // For failures we skip a single character
+            m_Reader.seek(m_Reader.cursor() + 1);
+        }
+        find_token();
+        return *this;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    // NOLINTNEXTLINE(cert-dcl21-cpp)
+    constexpr token_iterator operator++(int) & {
+        auto cpy = *this;
+        operator++();
+        return cpy;
+    }
+
+private:
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr void find_token() {
+        while (true) {
+            if (m_Reader.is_end()) {
+                return;
+            }
+            auto res = m_Lexer->rule().apply(m_Reader);
+            if (res.is_success()) {
+                auto succ = std::move(res).success();
+                if (succ.value().is_some()) {
+                    // Token, store it
+                    m_Last = value_type(
+                        success(
+                            std::move(succ).value().some().value(),
+                            succ.matched()
+                        ),
+                        res.furthest()
+                    );
+                    return;
+                }
+                // Skip
+                m_Reader.seek(m_Reader.cursor() + succ.matched());
+            }
+            else {
+                // Error, store it
+                m_Last = value_type(std::move(res).failure(), res.furthest());
+                return;
+            }
+        }
+    }
+};
+
+template <typename Src, typename Tag, bool ICase = false,
+    typename Action = no_mode_t>
+class token_rule {
+private:
+    Src m_Src;
+    Tag m_Tag;
+
+public:
+    using tag_type = Tag;
+    using action_type = Action;
+
+    static constexpr bool case_insensitive = ICase;
+
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_rule(Src src, Tag t)
+        : m_Src(src), m_Tag(t) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_rule(Src src, Tag t, icase_t)
+        : m_Src(src), m_Tag(t) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_rule(Src src, Tag t, Action)
+        : m_Src(src), m_Tag(t) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_rule(Src src, Tag t, icase_t, Action)
+        : m_Src(src), m_Tag(t) {
+    }
+
+    // XXX(LPeter1997): Possibly don't need
+    cppcmb_getter(source, m_Src)
+    cppcmb_getter(tag, m_Tag)
+};
+
+template <typename Src, typename Tag>
+token_rule(Src, Tag, icase_t) -> token_rule<Src, Tag, true>;
+
+template <typename Src, typename Tag, std::size_t Mode>
+token_rule(Src, Tag, push_mode_t<Mode>)
+    -> token_rule<Src, Tag, false, push_mode_t<Mode>>;
+
+template <typename Src, typename Tag>
+token_rule(Src, Tag, pop_mode_t) -> token_rule<Src, Tag, false, pop_mode_t>;
+
+template <typename Src, typename Tag, typename Action>
+token_rule(Src, Tag, icase_t, Action) -> token_rule<Src, Tag, true, Action>;
+
+#define cppcmb_token(rx, ...) ::cppcmb::token_rule(cppcmb_str(rx), __VA_ARGS__)
+
+template <typename MainRule>
+class lexer {
+private:
+    MainRule m_Rule;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... Rs>
+    constexpr lexer(Rs&&... rules)
+        : m_Rule(detail::make_lexer_parser(cppcmb_fwd(rules)...)) {
+    }
+
+    [[nodiscard]] constexpr auto const& rule() const noexcept { return m_Rule; }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto begin(Src const& src) const {
+        return token_iterator<lexer, Src>(*this, src);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] constexpr auto end() const {
+        // The kind of std::basic_string_view doesn't matter
+        return token_iterator<lexer, std::string_view>();
+    }
+};
+
+template <typename... Rs>
+lexer(Rs&&...)
+    -> lexer<decltype(detail::make_lexer_parser(std::declval<Rs&&>()...))>;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename P1, typename P2>
+class eager_alt_t : public combinator<eager_alt_t<P1, P2>> {
+private:
+    template <typename Src>
+    using value_t = sum_values_t<
+        parser_value_t<P1, Src>,
+        parser_value_t<P2, Src>
+    >;
+
+    P1 m_First;
+    P2 m_Second;
+
+public:
+    template <typename P1Fwd, typename P2Fwd>
+    constexpr eager_alt_t(P1Fwd&& p1, P2Fwd&& p2)
+        noexcept(
+            std::is_nothrow_constructible_v<P1, P1Fwd&&>
+         && std::is_nothrow_constructible_v<P2, P2Fwd&&>
+        )
+        : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
+    }
+
+    cppcmb_getter(first, m_First)
+    cppcmb_getter(second, m_Second)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P1, Src);
+        cppcmb_assert_parser(P2, Src);
+
+        using result_t = result<value_t<Src>>;
+
+        // Try to apply both alternatives, from the same state
+        auto first = detail::branch_scope(r);
+        auto p1_inv = m_First.apply(r);
+        // If the first one changed the state, the change is undone for the
+        // second one, and the first one is applied again, if it's taken
+        bool const reapply = first.changed_state();
+        if (reapply || p1_inv.is_failure()) {
+            first.backtrack();
+        }
+        auto second = detail::branch_scope(r);
+        auto p2_inv = m_Second.apply(r);
+
+        auto furthest = std::max(p1_inv.furthest(), p2_inv.furthest());
+
+        auto take = [&](auto&& inv) {
+            auto succ = std::move(inv).success();
+            return result_t(success(
+                sum_values<value_t<Src>>(std::move(succ).value()),
+                succ.matched()
+            ), furthest);
+        };
+
+        // Return the one that got further
+        // If they both got the same distance, return the first one
+        if (p1_inv.is_success() && (p2_inv.is_failure()
+         || p1_inv.success().matched() >= p2_inv.success().matched())) {
+            second.backtrack();
+            if (reapply) {
+                return take(m_First.apply(r));
+            }
+            return take(std::move(p1_inv));
+        }
+        if (p2_inv.is_success()) {
+            first.backtrack_until(second);
+            return take(std::move(p2_inv));
+        }
+
+        second.backtrack();
+
+        // Both failed, return the error which got further
+        auto p1_err = std::move(p1_inv).failure();
+        auto p2_err = std::move(p2_inv).failure();
+
+        if (p1_inv.furthest() > p2_inv.furthest()) {
+            return result_t(std::move(p1_err), furthest);
+        }
+        if (p1_inv.furthest() < p2_inv.furthest()) {
+            return result_t(std::move(p2_err), furthest);
+        }
+        // They got to the same distance, need to merge errors
+        // XXX(LPeter1997): Implement, for now we just return the first
+        return result_t(std::move(p1_err), furthest);
+    }
+};
+
+template <typename P1Fwd, typename P2Fwd>
+eager_alt_t(P1Fwd, P2Fwd) -> eager_alt_t<P1Fwd, P2Fwd>;
+
+/**
+ * Operator for making eager alternatives.
+ */
+template <typename P1, typename P2,
+    cppcmb_requires_t(detail::all_combinators_cvref_v<P1, P2>)>
+[[nodiscard]] constexpr auto operator||(P1&& p1, P2&& p2)
+    cppcmb_return(eager_alt_t(cppcmb_fwd(p1), cppcmb_fwd(p2)))
+
+/**
+ * Ignore pass.
+ */
+template <typename P2,
+    cppcmb_requires_t(detail::is_combinator_cvref_v<P2>)>
+[[nodiscard]] constexpr auto operator||(pass_t, P2&& p2)
+    cppcmb_return(cppcmb_fwd(p2))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename P>
+class opt_t : public combinator<opt_t<P>> {
+private:
+    cppcmb_self_check(opt_t);
+
+    template <typename Src>
+    using value_t = maybe<parser_value_t<P, Src>>;
+
+    P m_Parser;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr opt_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = result<value_t<Src>>;
+
+        auto branch = detail::branch_scope(r);
+        auto p_inv = m_Parser.apply(r);
+        if (p_inv.is_failure()) {
+            branch.backtrack();
+            return result_t(
+                success(value_t<Src>(none()), 0U),
+                p_inv.furthest()
+            );
+        }
+        auto succ = std::move(p_inv).success();
+        return result_t(
+            success(
+                value_t<Src>(some(std::move(succ).value())),
+                succ.matched()
+            ),
+            p_inv.furthest()
+        );
+    }
+};
+
+template <typename PFwd>
+opt_t(PFwd) -> opt_t<PFwd>;
+
+/**
+ * Operator for making optional parser.
+ */
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+[[nodiscard]] constexpr auto operator-(P&& p)
+    cppcmb_return(opt_t(cppcmb_fwd(p)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+namespace detail {
+
+/**
+ * True, if the function of the action returns a maybe, so the action can fail
+ * on a value. The DFA only knows the characters, it can't fail like that.
+ * DFAs are applied to characters, so the values are the ones parsed from
+ * strings.
+ */
+template <typename P, typename Fn>
+struct is_failing_action : is_maybe<remove_cvref_t<std::invoke_result_t<
+    action_apply_helper, Fn const&, parser_value_t<P, std::string_view>
+>>> {};
+
+/**
+ * A combinator that consumes exactly one character of a set.
+ */
+template <typename P>
+struct is_char_class : std::false_type {};
+
+template <typename P>
+inline constexpr bool is_char_class_v =
+    is_char_class<remove_cvref_t<P>>::value;
+
+template <>
+struct is_char_class<one_t> : std::true_type {};
+
+template <typename Pred>
+struct is_char_class<action_t<one_t, filter<Pred>>> : std::true_type {};
+
+// Any other filter rejects based on the values, that's not a character class
+template <typename P, typename Pred>
+struct is_char_class<action_t<P, filter<Pred>>> : std::false_type {};
+
+template <typename P, typename Fn>
+struct is_char_class<action_t<P, Fn>> : std::conjunction<
+    is_char_class<P>, std::negation<is_failing_action<P, Fn>>
+> {};
+
+template <typename P1, typename P2>
+struct is_char_class<alt_t<P1, P2>>
+    : std::bool_constant<is_char_class_v<P1> && is_char_class_v<P2>> {};
+
+template <typename P1, typename P2>
+struct is_char_class<eager_alt_t<P1, P2>>
+    : std::bool_constant<is_char_class_v<P1> && is_char_class_v<P2>> {};
+
+template <typename P>
+struct is_char_class<regex::not_char<P>> : is_char_class<P> {};
+
+/**
+ * The regular combinators. Actions are looked through, as only the matched
+ * length matters for a DFA, except for the ones that can fail. Filters are
+ * only allowed on single characters.
+ */
+template <typename P>
+struct is_regular : is_char_class<P> {};
+
+template <typename P1, typename P2>
+struct is_regular<seq_t<P1, P2>>
+    : std::bool_constant<
+        is_regular<remove_cvref_t<P1>>::value
+     && is_regular<remove_cvref_t<P2>>::value> {};
+
+template <typename P1, typename P2>
+struct is_regular<alt_t<P1, P2>>
+    : std::bool_constant<
+        is_regular<remove_cvref_t<P1>>::value
+     && is_regular<remove_cvref_t<P2>>::value> {};
+
+template <typename P1, typename P2>
+struct is_regular<eager_alt_t<P1, P2>>
+    : std::bool_constant<
+        is_regular<remove_cvref_t<P1>>::value
+     && is_regular<remove_cvref_t<P2>>::value> {};
+
+template <typename P, typename Fn>
+struct is_regular<action_t<P, Fn>> : std::conjunction<
+    is_regular<remove_cvref_t<P>>, std::negation<is_failing_action<P, Fn>>
+> {};
+
+template <typename P, typename Pred>
+struct is_regular<action_t<P, filter<Pred>>> : is_char_class<P> {};
+
+template <typename P>
+struct is_regular<opt_t<P>> : is_regular<remove_cvref_t<P>> {};
+
+template <typename P, typename To>
+struct is_regular<many_t<P, To>> : is_regular<remove_cvref_t<P>> {};
+
+template <typename P, typename To>
+struct is_regular<many1_t<P, To>> : is_regular<remove_cvref_t<P>> {};
+
+template <std::size_t I, typename P>
+struct is_regular<regex::group<I, P>> : is_regular<remove_cvref_t<P>> {};
+
+template <typename P>
+struct is_regular<ignore_case_t<P>> : is_regular<remove_cvref_t<P>> {};
+
+/**
+ * Builds the NFA of a regular combinator. Filter predicates are evaluated
+ * for every byte value, so they must not depend on anything else.
+ */
+struct nfa_builder {
+    // XXX(LPeter1997): Noexcept specifier
+    static byte_set char_set(one_t const&) {
+        return byte_set().set();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Pred>
+    static byte_set char_set(action_t<one_t, filter<Pred>> const& p) {
+        byte_set set;
+        for (std::size_t b = 0; b < 256; ++b) {
+            auto ch = static_cast<char>(static_cast<unsigned char>(b));
+            if (p.function().predicate()(ch)) {
+                set.set(b);
+            }
+        }
+        return set;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename Fn>
+    static byte_set char_set(action_t<P, Fn> const& p) {
+        return char_set(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static byte_set char_set(alt_t<P1, P2> const& p) {
+        return char_set(p.first()) | char_set(p.second());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static byte_set char_set(eager_alt_t<P1, P2> const& p) {
+        return char_set(p.first()) | char_set(p.second());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static byte_set char_set(regex::not_char<P> const& p) {
+        return ~char_set(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static nfa::fragment build(nfa& n, P const& p) {
+        if constexpr (is_char_class_v<P>) {
+            return n.bytes(char_set(p));
+        }
+        else {
+            return build_composite(n, p);
+        }
+    }
+
+private:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static nfa::fragment build_composite(nfa& n, seq_t<P1, P2> const& p) {
+        auto a = build(n, p.first());
+        auto b = build(n, p.second());
+        return n.sequence(a, b);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static nfa::fragment build_composite(nfa& n, alt_t<P1, P2> const& p) {
+        auto a = build(n, p.first());
+        auto b = build(n, p.second());
+        return n.choice(a, b);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static nfa::fragment build_composite(nfa& n,
+        eager_alt_t<P1, P2> const& p) {
+        auto a = build(n, p.first());
+        auto b = build(n, p.second());
+        return n.choice(a, b);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename Fn>
+    static nfa::fragment build_composite(nfa& n, action_t<P, Fn> const& p) {
+        return build(n, p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static nfa::fragment build_composite(nfa& n, opt_t<P> const& p) {
+        return n.optional(build(n, p.underlying()));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static nfa::fragment build_composite(nfa& n, many_t<P, To> const& p) {
+        return n.repeat(build(n, p.underlying()));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t I, typename P>
+    static nfa::fragment build_composite(nfa& n,
+        regex::group<I, P> const& p) {
+        // Group I is recorded by the tags 2I and 2I + 1
+        return n.tagged(build(n, p.underlying()), 2 * I, 2 * I + 1);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static nfa::fragment build_composite(nfa& n, ignore_case_t<P> const& p) {
+        auto first = n.size();
+        auto f = build(n, p.underlying());
+        n.fold_case(first);
+        return f;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static nfa::fragment build_composite(nfa& n, many1_t<P, To> const& p) {
+        auto first = build(n, p.underlying());
+        auto rest = n.repeat(build(n, p.underlying()));
+        return n.sequence(first, rest);
+    }
+};
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Compiles a regular combinator.
+ */
+template <typename P>
+[[nodiscard]] dfa compile_dfa(P const& p) {
+    static_assert(
+        is_regular<remove_cvref_t<P>>::value,
+        "Only regular combinators can be compiled to a DFA!"
+    );
+    nfa n;
+    auto f = nfa_builder::build(n, p);
+    return dfa(n, f);
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * The bytes that can start a non-empty match of the DFA.
+ */
+[[nodiscard]] inline byte_set first_bytes(dfa const& d) {
+    auto live = d.live_states();
+    byte_set set;
+    for (std::size_t b = 0; b < 256; ++b) {
+        if (live[d.next(d.start(), static_cast<unsigned char>(b))]) {
+            set.set(b);
+        }
+    }
+    return set;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * The bytes that can extend a match of the DFA towards a longer one.
+ */
+[[nodiscard]] inline byte_set extension_bytes(dfa const& d) {
+    auto live = d.live_states();
+    byte_set set;
+    for (dfa::state_type s = 1; s < d.state_count(); ++s) {
+        if (!d.accepting(s)) {
+            continue;
+        }
+        for (std::size_t b = 0; b < 256; ++b) {
+            if (live[d.next(s, static_cast<unsigned char>(b))]) {
+                set.set(b);
+            }
+        }
+    }
+    return set;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * True, if a match of shorter is a proper prefix of a match of longer.
+ */
+[[nodiscard]] inline bool extends_prefix(dfa const& shorter,
+    dfa const& longer) {
+    auto live1 = shorter.live_states();
+    auto live2 = longer.live_states();
+    auto n2 = longer.state_count();
+    std::vector<bool> seen(shorter.state_count() * n2);
+    std::vector<std::pair<dfa::state_type, dfa::state_type>> stack;
+    stack.emplace_back(shorter.start(), longer.start());
+    seen[shorter.start() * n2 + longer.start()] = true;
+    while (!stack.empty()) {
+        auto [s1, s2] = stack.back();
+        stack.pop_back();
+        for (std::size_t b = 0; b < 256; ++b) {
+            auto t1 = shorter.next(s1, static_cast<unsigned char>(b));
+            auto t2 = longer.next(s2, static_cast<unsigned char>(b));
+            if (!live2[t2]) {
+                continue;
+            }
+            if (shorter.accepting(s1)) {
+                return true;
+            }
+            if (live1[t1] && !seen[t1 * n2 + t2]) {
+                seen[t1 * n2 + t2] = true;
+                stack.emplace_back(t1, t2);
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks, if a regular combinator always matches the longest prefix in its
+ * language, like its DFA. Ordered choice and greedy repetitions never give
+ * up a match they made, so this holds, if
+ *  - no match of an alternative is a proper prefix of a later one's,
+ *  - no match of the first part of a sequence can be extended by a byte
+ *    that starts the second part,
+ *  - a repeated parser can't match empty, and no match of it can be extended
+ *    by a byte that starts the next repetition.
+ * Case folding only merges bytes, so it's checked without the folding.
+ */
+struct longest_match_check {
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check(P const& p) {
+        if constexpr (is_char_class_v<P>) {
+            return true;
+        }
+        else {
+            return check_composite(p);
+        }
+    }
+
+private:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static bool check_composite(seq_t<P1, P2> const& p) {
+        if (!check(p.first()) || !check(p.second())) {
+            return false;
+        }
+        auto ext = extension_bytes(compile_dfa(p.first()));
+        return (ext & first_bytes(compile_dfa(p.second()))).none();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static bool check_composite(alt_t<P1, P2> const& p) {
+        return check(p.first()) && check(p.second())
+            && !extends_prefix(compile_dfa(p.first()), compile_dfa(p.second()));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static bool check_composite(eager_alt_t<P1, P2> const& p) {
+        // Takes the longer one anyway
+        return check(p.first()) && check(p.second());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename Fn>
+    static bool check_composite(action_t<P, Fn> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check_composite(opt_t<P> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static bool check_composite(many_t<P, To> const& p) {
+        return check_repeated(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static bool check_composite(many1_t<P, To> const& p) {
+        return check_repeated(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t I, typename P>
+    static bool check_composite(regex::group<I, P> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check_composite(ignore_case_t<P> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check_repeated(P const& p) {
+        if (!check(p)) {
+            return false;
+        }
+        auto d = compile_dfa(p);
+        return !d.accepting(d.start())
+            && (extension_bytes(d) & first_bytes(d)).none();
+    }
+};
+
+} /* namespace detail */
+
+/**
+ * True, if the combinator describes a regular language, so it can be
+ * compiled with dfa.
+ */
+template <typename P>
+inline constexpr bool is_regular_v =
+    detail::is_regular<detail::remove_cvref_t<P>>::value;
+
+/**
+ * A regular combinator compiled into a DFA. The DFA matches the longest
+ * prefix that is in the language of the combinator, and the result is the
+ * matched part of the source. Ordered choice and greedy repetitions can
+ * match less (like "in" | "int" on "int"), these combinators are not
+ * compiled, but applied as they are, so the result never changes. Values of
+ * actions are dropped.
+ */
+template <typename P>
+class dfa_t : public combinator<dfa_t<P>> {
+private:
+    cppcmb_self_check(dfa_t);
+
+    P                                  m_Parser;
+    std::shared_ptr<detail::dfa const> m_Dfa;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    dfa_t(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)),
+          m_Dfa(detail::longest_match_check::check(m_Parser)
+              ? std::make_shared<detail::dfa const>(
+                  detail::compile_dfa(m_Parser))
+              : nullptr) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * True, if the combinator could be compiled without changing what it
+     * matches.
+     */
+    [[nodiscard]] bool compiled() const noexcept {
+        return m_Dfa != nullptr;
+    }
+
+    /**
+     * The compiled automaton.
+     */
+    [[nodiscard]] detail::dfa const& automaton() const noexcept {
+        cppcmb_assert("The combinator is not compiled!", compiled());
+        return *m_Dfa;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "DFAs can only be applied to contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
+
+        auto const* data = std::data(r.source()) + r.cursor();
+        if (!compiled()) {
+            auto inv = m_Parser.apply(r);
+            if (inv.is_failure()) {
+                return result_t(std::move(inv).failure(), inv.furthest());
+            }
+            auto n = inv.success().matched();
+            return result_t(success(string_t(data, n), n), inv.furthest());
+        }
+        auto const len = std::size(r.source()) - r.cursor();
+        std::size_t furthest = 0;
+        auto matched = m_Dfa->longest_match(data, len, furthest);
+        if (matched < 0) {
+            return result_t(failure(), furthest);
+        }
+        auto n = std::size_t(matched);
+        return result_t(success(string_t(data, n), n), furthest);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Validates many records, each one has to match as a whole. Bit i % 64
+     * of word i / 64 of the result is set, if the i-th record matches. The
+     * records are matched in batches of detail::dfa::batch_lanes, or one by
+     * one, if the combinator is not compiled.
+     */
+    template <typename It>
+    [[nodiscard]] std::vector<std::uint64_t> validate(It first, It last)
+        const {
+        using record_t = detail::remove_cvref_t<decltype(*first)>;
+        using char_t = detail::remove_cvref_t<
+            decltype(*std::data(std::declval<record_t const&>()))
+        >;
+        constexpr auto lanes = detail::dfa::batch_lanes;
+
+        std::vector<std::uint64_t> bits;
+        if (!compiled()) {
+            for (std::size_t i = 0; first != last; ++first, ++i) {
+                if (i % 64 == 0) {
+                    bits.push_back(0);
+                }
+                auto rec = std::basic_string_view<char_t>(
+                    std::data(*first), std::size(*first)
+                );
+                auto inv = m_Parser.apply(reader(rec));
+                if (inv.is_success() && inv.success().matched() == rec.size()) {
+                    bits[i / 64] |= std::uint64_t(1) << (i % 64);
+                }
+            }
+            return bits;
+        }
+        std::array<char_t const*, lanes> data{};
+        std::array<std::size_t, lanes> lens{};
+        std::size_t n = 0;
+        std::size_t count = 0;
+        auto flush = [&] {
+            auto batch = m_Dfa->full_match_batch(data.data(), lens.data(), n);
+            auto at = count - n;
+            if (bits.size() * 64 < count) {
+                bits.push_back(0);
+            }
+            // A batch never straddles two words, as 64 % lanes == 0
+            bits[at / 64] |= std::uint64_t(batch) << (at % 64);
+            n = 0;
+        };
+        for (; first != last; ++first) {
+            data[n] = std::data(*first);
+            lens[n] = std::size(*first);
+            ++n;
+            ++count;
+            if (n == lanes) {
+                flush();
+            }
+        }
+        if (n != 0) {
+            flush();
+        }
+        return bits;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Range>
+    [[nodiscard]] std::vector<std::uint64_t> validate(Range const& records)
+        const {
+        return validate(std::begin(records), std::end(records));
+    }
+};
+
+template <typename PFwd>
+dfa_t(PFwd) -> dfa_t<PFwd>;
+
+/**
+ * Compiles a regular combinator into a DFA.
+ */
+template <typename PFwd>
+[[nodiscard]] auto dfa(PFwd&& p)
+    cppcmb_return(dfa_t(cppcmb_fwd(p)))
+
+struct as_dfa_t {};
+
+inline constexpr auto as_dfa = as_dfa_t();
+
+// DFA compilation
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+auto operator%=(P&& parser, as_dfa_t)
+    cppcmb_return(dfa(cppcmb_fwd(parser)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * The token rules of a mode.
+ */
+template <typename... Rs>
+class lexer_mode_t {
+private:
+    std::tuple<Rs...> m_Rules;
+
+public:
+    // Might be skip_t, if the mode only skips
+    using token_type = detail::first_not_skip_t<typename Rs::tag_type...>;
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... RFwd>
+    constexpr lexer_mode_t(RFwd&&... rules)
+        : m_Rules(cppcmb_fwd(rules)...) {
+    }
+
+    cppcmb_getter(rules, m_Rules)
+};
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename... RFwd>
+[[nodiscard]] constexpr auto lexer_mode(RFwd&&... rules) {
+    return lexer_mode_t<detail::remove_cvref_t<RFwd>...>(
+        cppcmb_fwd(rules)...
+    );
+}
+
+template <typename Lexer, typename Src>
+class modal_token_iterator;
+
+/**
+ * The first mode is the initial one. The longest match wins in a mode, and
+ * from the rules that match the same length, the first one. Note that this is
+ * different from lexer, where the first rule that matches wins, even if a
+ * later one would match more.
+ */
+template <typename Tag>
+class modal_lexer {
+public:
+    using token_type = Tag;
+
+private:
+    enum class action { none, push, pop };
+
+    struct rule_info {
+        // Empty for skipped rules
+        std::optional<Tag> tag;
+        action             act = action::none;
+        std::size_t        target = 0;
+    };
+
+    struct mode_info {
+        detail::dfa            automaton;
+        std::vector<rule_info> rules;
+    };
+
+    std::vector<mode_info> m_Modes;
+
+    template <typename Action>
+    static constexpr action action_of() noexcept {
+        if constexpr (std::is_same_v<Action, pop_mode_t>) {
+            return action::pop;
+        }
+        else if constexpr (std::is_same_v<Action, no_mode_t>) {
+            return action::none;
+        }
+        else {
+            return action::push;
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename R>
+    static void add_rule(detail::nfa& n, std::size_t start,
+        std::vector<std::size_t>& ends, mode_info& mode, R const& r) {
+        using action_type = typename R::action_type;
+
+        auto p = detail::str_to_rule_parser<R::case_insensitive>(r.source());
+        auto f = detail::nfa_builder::build(n, p);
+        n.add_epsilon(start, f.start);
+        ends.push_back(f.end);
+
+        rule_info info;
+        if constexpr (!std::is_same_v<typename R::tag_type, skip_t>) {
+            info.tag = r.tag();
+        }
+        info.act = action_of<action_type>();
+        if constexpr (action_of<action_type>() == action::push) {
+            info.target = action_type::mode;
+        }
+        mode.rules.push_back(std::move(info));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... Rs>
+    static mode_info compile_mode(lexer_mode_t<Rs...> const& m) {
+        mode_info mode;
+        detail::nfa n;
+        auto start = n.add_state();
+        std::vector<std::size_t> ends;
+        std::apply([&](auto const&... rules) {
+            (add_rule(n, start, ends, mode, rules), ...);
+        }, m.rules());
+        mode.automaton = detail::dfa(n, start, ends);
+        return mode;
+    }
+
+    [[nodiscard]] bool pushed_modes_exist() const noexcept {
+        for (auto const& m : m_Modes) {
+            for (auto const& r : m.rules) {
+                if (r.act == action::push && r.target >= m_Modes.size()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... Ms>
+    explicit modal_lexer(Ms const&... modes)
+        : m_Modes{ compile_mode(modes)... } {
+        cppcmb_assert("A pushed mode must exist!", pushed_modes_exist());
+    }
+
+    [[nodiscard]] std::size_t mode_count() const noexcept {
+        return m_Modes.size();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto begin(Src const& src) const {
+        return modal_token_iterator<modal_lexer, Src>(*this, src);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Starts lexing in the middle of the source, in the given mode stack.
+     */
+    template <typename Src>
+    [[nodiscard]] auto begin(Src const& src, std::size_t offset,
+        std::vector<std::size_t> modes) const {
+        return modal_token_iterator<modal_lexer, Src>(
+            *this, src, offset, std::move(modes)
+        );
+    }
+
+    // Just to avoid nasty bugs
+    template <typename Src>
+    auto begin(Src const&& src) const = delete;
+
+    template <typename Src>
+    auto begin(Src const&& src, std::size_t offset,
+        std::vector<std::size_t> modes) const = delete;
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] auto end() const {
+        return modal_token_iterator<modal_lexer, std::string_view>();
+    }
+
+private:
+    template <typename, typename>
+    friend class modal_token_iterator;
+};
+
+template <typename... Ms>
+modal_lexer(Ms const&...) -> modal_lexer<
+    detail::first_not_skip_t<typename Ms::token_type...>
+>;
+
+/**
+ * Iterates over the tokens, keeping the stack of modes. Popping the initial
+ * mode is ignored. Like with lexer, errors are reported as failures, and
+ * incrementing skips a single character.
+ */
+template <typename Lexer, typename Src>
+class modal_token_iterator {
+public:
+    using token_type        = typename Lexer::token_type;
+    using value_type        =
+        result<token<typename reader<Src>::value_type, token_type>>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = value_type const*;
+    using reference         = value_type const&;
+    using iterator_category = std::forward_iterator_tag;
+
+    static_assert(
+        !std::is_same_v<token_type, skip_t>,
+        "There must be at least one token rule that doesn't skip!"
+    );
+
+private:
+    Lexer const*              m_Lexer = nullptr;
+    reader<Src>               m_Reader;
+    std::vector<std::size_t>  m_Modes;
+    std::optional<value_type> m_Last;
+    std::size_t               m_Reach = 0;
+
+    [[nodiscard]] bool at_end() const noexcept {
+        return m_Reader.source_ptr() == nullptr || m_Reader.is_end();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void find_token() {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "The modal lexer only works on contiguous sources!"
+        );
+        using action = typename Lexer::action;
+        using char_t = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<char_t>;
+
+        m_Last.reset();
+        while (!m_Reader.is_end()) {
+            auto const& mode = m_Lexer->m_Modes[m_Modes.back()];
+            auto const& src = m_Reader.source();
+            auto const* data = std::data(src) + m_Reader.cursor();
+            auto const len = std::size(src) - m_Reader.cursor();
+            std::size_t furthest = 0;
+            std::size_t rule = 0;
+            auto matched = mode.automaton.longest_match(
+                data, len, furthest, rule
+            );
+            if (m_Reader.cursor() + furthest > m_Reach) {
+                m_Reach = m_Reader.cursor() + furthest;
+            }
+            if (matched <= 0) {
+                // An empty match would make no progress
+                m_Last = value_type(failure(), furthest);
+                return;
+            }
+
+            auto const& info = mode.rules[rule];
+            if (info.act == action::push) {
+                m_Modes.push_back(info.target);
+            }
+            else if (info.act == action::pop && m_Modes.size() > 1) {
+                m_Modes.pop_back();
+            }
+
+            auto n = std::size_t(matched);
+            if (info.tag) {
+                auto tok = token(string_t(data, n), *info.tag);
+                m_Last = value_type(success(std::move(tok), n), furthest);
+                return;
+            }
+            m_Reader.seek(m_Reader.cursor() + n);
+        }
+    }
+
+public:
+    modal_token_iterator() = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    modal_token_iterator(Lexer const& l, Src const& src)
+        : modal_token_iterator(l, src, 0, { 0 }) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Starts lexing at the offset, with the given mode stack, that must not
+     * be empty.
+     */
+    modal_token_iterator(Lexer const& l, Src const& src, std::size_t offset,
+        std::vector<std::size_t> modes)
+        : m_Lexer(::std::addressof(l)), m_Reader(src, offset),
+          m_Modes(std::move(modes)), m_Reach(offset) {
+        cppcmb_assert("The mode stack can't be empty!", !m_Modes.empty());
+        find_token();
+    }
+
+    /**
+     * The offset of the current token (or error) in the source.
+     */
+    [[nodiscard]] std::size_t position() const noexcept {
+        return m_Reader.cursor();
+    }
+
+    /**
+     * The mode stack, after the current token.
+     */
+    [[nodiscard]] std::vector<std::size_t> const& modes() const noexcept {
+        return m_Modes;
+    }
+
+    /**
+     * The end of the furthest part of the source that was looked at so far.
+     * Changes at or after this offset don't affect the tokens up to now.
+     */
+    [[nodiscard]] std::size_t reach() const noexcept {
+        return m_Reach;
+    }
+
+    /**
+     * The current mode, after the current token.
+     */
+    [[nodiscard]] std::size_t mode() const noexcept {
+        return m_Modes.empty() ? 0 : m_Modes.back();
+    }
+
+    /**
+     * The number of modes on the stack.
+     */
+    [[nodiscard]] std::size_t depth() const noexcept {
+        return m_Modes.size();
+    }
+
+    template <typename Src2>
+    [[nodiscard]] bool operator==(modal_token_iterator<Lexer, Src2> const& o)
+        const noexcept {
+        if (at_end() || o.at_end()) {
+            return at_end() && o.at_end();
+        }
+        void const* src = m_Reader.source_ptr();
+        void const* other = o.m_Reader.source_ptr();
+        return src == other && m_Reader.cursor() == o.m_Reader.cursor();
+    }
+
+    template <typename Src2>
+    [[nodiscard]] bool operator!=(modal_token_iterator<Lexer, Src2> const& o)
+        const noexcept {
+        return !operator==(o);
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+        cppcmb_assert(
+            "A value must be present for de-referencing!",
+            m_Last.has_value()
+        );
+        return *m_Last;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+        return ::std::addressof(operator*());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    // NOLINTNEXTLINE(cert-dcl21-cpp)
+    modal_token_iterator& operator++() & {
+        cppcmb_assert(
+            "A token iterator at the end can't be incremented!",
+            !at_end() && m_Last.has_value()
+        );
+        auto const& last = *m_Last;
+        if (last.is_success()) {
+            m_Reader.seek(m_Reader.cursor() + last.success().matched());
+        }
+        else {
+            // For failures we skip a single character
+            m_Reader.seek(m_Reader.cursor() + 1);
+        }
+        find_token();
+        return *this;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    // NOLINTNEXTLINE(cert-dcl21-cpp)
+    modal_token_iterator operator++(int) & {
+        auto cpy = *this;
+        operator++();
+        return cpy;
+    }
+
+private:
+    template <typename, typename>
+    friend class modal_token_iterator;
+};
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * A saved lexer state at a token boundary.
+ */
+struct lexer_checkpoint {
+    std::size_t              offset = 0;
+    // The number of line breaks before the offset
+    std::size_t              line   = 0;
+    // The source from this offset on wasn't looked at to get here
+    std::size_t              reach  = 0;
+    std::vector<std::size_t> modes  = { 0 };
+};
+
+/**
+ * The lexer is referenced, it has to outlive the service. The source isn't
+ * stored, it's passed to every query, and every edit has to be reported.
+ */
+template <typename Lexer>
+class lexing_service {
+private:
+    Lexer const*                  m_Lexer;
+    std::size_t                   m_Lines;
+    std::vector<lexer_checkpoint> m_Checkpoints;
+
+    template <typename CharT>
+    [[nodiscard]] static std::size_t count_lines(CharT const* data,
+        std::size_t len) noexcept {
+        return std::size_t(std::count(data, data + len, CharT('\n')));
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * A checkpoint is saved after every lines_per_checkpoint lines.
+     */
+    explicit lexing_service(Lexer const& l,
+        std::size_t lines_per_checkpoint = 64)
+        : m_Lexer(::std::addressof(l)), m_Lines(lines_per_checkpoint),
+          m_Checkpoints(1) {
+        cppcmb_assert(
+            "There must be at least one line between checkpoints!",
+            m_Lines > 0
+        );
+    }
+
+    // Just to avoid nasty bugs
+    lexing_service(Lexer const&& l, std::size_t lines = 64) = delete;
+
+    [[nodiscard]] std::vector<lexer_checkpoint> const& checkpoints()
+        const noexcept {
+        return m_Checkpoints;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Calls fn(result, offset) for every token and error that overlaps the
+     * range [from, to) of the source, in order. New checkpoints are saved
+     * while lexing.
+     */
+    template <typename Src, typename Fn>
+    void lex_range(Src const& src, std::size_t from, std::size_t to, Fn&& fn) {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Only contiguous sources can be lexed by the service!"
+        );
+
+        auto cp = std::upper_bound(
+            m_Checkpoints.begin(), m_Checkpoints.end(), from,
+            [](std::size_t off, lexer_checkpoint const& c) {
+                return off < c.offset;
+            }
+        ) - 1;
+        auto const* data = std::data(src);
+        auto pos = cp->offset;
+        auto line = cp->line;
+        auto reach = cp->reach;
+
+        auto it = m_Lexer->begin(src, cp->offset, cp->modes);
+        for (; it != m_Lexer->end(); ++it) {
+            auto start = it.position();
+            if (start >= to) {
+                break;
+            }
+            auto const& res = *it;
+            auto end = start + (res.is_success() ? res.success().matched() : 1);
+            if (end > from) {
+                fn(res, start);
+            }
+
+            // Only save new checkpoints after the last one
+            line += count_lines(data + pos, end - pos);
+            pos = end;
+            auto const& last = m_Checkpoints.back();
+            if (end > last.offset && line >= last.line + m_Lines) {
+                reach = std::max(reach, it.reach());
+                m_Checkpoints.push_back({ end, line, reach, it.modes() });
+            }
+        }
+    }
+
+    /**
+     * Reports that the source was edited from the offset on. The checkpoints
+     * that might depend on the changed part are dropped, the ones before it
+     * are kept, as nothing before the edit moves.
+     */
+    void edit(std::size_t offset) noexcept {
+        // The first checkpoint at the start is always valid
+        while (m_Checkpoints.size() > 1
+            && m_Checkpoints.back().reach >= offset) {
+            m_Checkpoints.pop_back();
+        }
+    }
+};
+
+template <typename Lexer>
+lexing_service(Lexer const&) -> lexing_service<Lexer>;
+
+template <typename Lexer>
+lexing_service(Lexer const&, std::size_t) -> lexing_service<Lexer>;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * Describes how a value is written to and read from bytes. Specialize this
+ * for your own types with the members:
+ *  - static void write(std::string& out, T const& val)
+ *  - static std::optional<T> read(std::string_view& in)
+ * The read function must consume what it reads from the front of in.
+ * Values that point to memory (like views of the source) must not be
+ * persisted, because the memory won't be there in the next process.
+ */
+template <typename T, typename = void>
+struct persist_traits {};
+
+template <typename T>
+struct persist_traits<T,
+    std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>> {
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(std::string& out, T const& val) {
+        char buf[sizeof(T)];
+        std::memcpy(buf, &val, sizeof(T));
+        out.append(buf, sizeof(T));
+    }
+
+    [[nodiscard]] static std::optional<T> read(std::string_view& in) noexcept {
+        if (in.size() < sizeof(T)) {
+            return std::nullopt;
+        }
+        T val;
+        std::memcpy(&val, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return val;
+    }
+};
+
+namespace detail {
+
+template <typename T>
+using persist_write_t = decltype(persist_traits<T>::write(
+    std::declval<std::string&>(), std::declval<T const&>()
+));
+
+} /* namespace detail */
+
+template <typename T>
+inline constexpr bool is_persistable_v =
+    detail::is_detected_v<detail::persist_write_t, T>;
+
+template <typename... Ts>
+struct persist_traits<product<Ts...>,
+    std::enable_if_t<(... && is_persistable_v<Ts>)>> {
+
+private:
+    template <std::size_t... Is>
+    static void write_impl(std::string& out, product<Ts...> const& val,
+        std::index_sequence<Is...>) {
+        (persist_traits<Ts>::write(out, val.template get<Is>()), ...);
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(std::string& out, product<Ts...> const& val) {
+        write_impl(out, val, product<Ts...>::index_sequence);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static std::optional<product<Ts...>>
+    read(std::string_view& in) {
+        // Braced initialization keeps the order of reads
+        auto elems = std::tuple<std::optional<Ts>...>{
+            persist_traits<Ts>::read(in)...
+        };
+        if (!std::apply([](auto const&... e) { return (true && ... && e); },
+            elems)) {
+            return std::nullopt;
+        }
+        return std::apply([](auto&&... e) {
+            return product<Ts...>(std::move(*e)...);
+        }, std::move(elems));
+    }
+};
+
+template <typename T>
+struct persist_traits<result<T>, std::enable_if_t<is_persistable_v<T>>> {
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(std::string& out, result<T> const& val) {
+        using size_traits = persist_traits<std::uint64_t>;
+
+        size_traits::write(out, std::uint64_t(val.furthest()));
+        if (val.is_failure()) {
+            out.push_back('\0');
+            return;
+        }
+        out.push_back('\1');
+        auto const& succ = val.success();
+        size_traits::write(out, std::uint64_t(succ.matched()));
+        persist_traits<T>::write(out, succ.value());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static std::optional<result<T>> read(std::string_view& in) {
+        using size_traits = persist_traits<std::uint64_t>;
+
+        auto furthest = size_traits::read(in);
+        if (!furthest || in.empty()) {
+            return std::nullopt;
+        }
+        auto tag = in.front();
+        in.remove_prefix(1);
+        if (tag == '\0') {
+            return result<T>(failure(), std::size_t(*furthest));
+        }
+        auto matched = size_traits::read(in);
+        if (!matched) {
+            return std::nullopt;
+        }
+        auto val = persist_traits<T>::read(in);
+        if (!val) {
+            return std::nullopt;
+        }
+        return result<T>(
+            success(std::move(*val), std::size_t(*matched)),
+            std::size_t(*furthest)
+        );
+    }
+};
+
+namespace detail {
+
+/**
+ * An identifier for a type that is the same across processes, as long as the
+ * program doesn't change. Only the type, not the state of a value.
+ */
+template <typename T>
+[[nodiscard]] std::uint64_t stable_type_id() noexcept {
+    static auto const id = [] {
+        auto const* name = typeid(T).name();
+        return hash_bytes(name, std::strlen(name)).low;
+    }();
+    return id;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename T>
+void persist_any(std::any const& val, std::string& out) {
+    persist_traits<T>::write(out, std::any_cast<T const&>(val));
+}
+
+template <typename Src>
+[[nodiscard]] hash128 source_hash(Src const& src) noexcept {
+    static_assert(
+        is_contiguous_source_v<Src>,
+        "Only contiguous sources can be hashed for persistence!"
+    );
+    using elem_t = remove_cvref_t<decltype(*std::data(src))>;
+    return hash_bytes(std::data(src), std::size(src) * sizeof(elem_t));
+}
+
+inline constexpr char          memo_magic[4]       = { 'C', 'C', 'M', 'B' };
+inline constexpr std::uint32_t memo_format_version = 2;
+// Written in native byte order, so a foreign file can be recognized
+inline constexpr std::uint32_t memo_byte_order     = 0x01020304;
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename T>
+void write_raw(std::ostream& os, T const& val) {
+    std::string buf;
+    persist_traits<T>::write(buf, val);
+    os.write(buf.data(), std::streamsize(buf.size()));
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename T>
+[[nodiscard]] std::optional<T> read_raw(std::istream& is) {
+    char buf[sizeof(T)];
+    if (!is.read(buf, sizeof(T))) {
+        return std::nullopt;
+    }
+    auto view = std::string_view(buf, sizeof(T));
+    return persist_traits<T>::read(view);
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Reads len bytes. The length comes from the file, so the buffer only grows
+ * with what is actually read, a corrupt length can't allocate much more than
+ * what the stream holds.
+ */
+[[nodiscard]] inline bool read_bytes(std::istream& is, std::uint64_t len,
+    std::string& out) {
+
+    constexpr std::uint64_t chunk = 4096;
+    out.clear();
+    while (len > 0) {
+        auto n = std::size_t(len < chunk ? len : chunk);
+        auto old = out.size();
+        out.resize(old + n);
+        if (!is.read(out.data() + old, std::streamsize(n))) {
+            return false;
+        }
+        len -= n;
+    }
+    return true;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Writes every persistable entry of the context.
+ */
+inline void save_memo(memo_context const& ctx, std::ostream& os,
+    std::uint64_t grammar, std::uint64_t version, hash128 source) {
+
+    os.write(memo_magic, sizeof(memo_magic));
+    write_raw(os, memo_format_version);
+    write_raw(os, memo_byte_order);
+    write_raw(os, grammar);
+    write_raw(os, version);
+    write_raw(os, source.low);
+    write_raw(os, source.high);
+
+    std::uint64_t count = 0;
+    ctx.memo().for_each_persistent([&](auto, auto, auto, auto const&) {
+        ++count;
+    });
+    write_raw(os, count);
+
+    ctx.memo().for_each_persistent([&](std::uint64_t sid, std::size_t pos,
+        std::size_t furthest, std::string const& data) {
+        write_raw(os, sid);
+        write_raw(os, std::uint64_t(pos));
+        write_raw(os, std::uint64_t(furthest));
+        write_raw(os, std::uint64_t(data.size()));
+        os.write(data.data(), std::streamsize(data.size()));
+    });
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Reads the entries written by save_memo into the context. The entries are
+ * only decoded when their parser asks for them. Returns false (and leaves the
+ * context empty) if the data doesn't match the grammar or the source.
+ */
+inline bool load_memo(memo_context& ctx, std::istream& is,
+    std::uint64_t grammar, std::uint64_t version, hash128 source) {
+
+    ctx.clear();
+
+    char magic[sizeof(memo_magic)];
+    if (!is.read(magic, sizeof(magic))
+     || std::memcmp(magic, memo_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    if (read_raw<std::uint32_t>(is) != memo_format_version
+     || read_raw<std::uint32_t>(is) != memo_byte_order
+     || read_raw<std::uint64_t>(is) != grammar
+     || read_raw<std::uint64_t>(is) != version
+     || read_raw<std::uint64_t>(is) != source.low
+     || read_raw<std::uint64_t>(is) != source.high) {
+        return false;
+    }
+
+    auto count = read_raw<std::uint64_t>(is);
+    if (!count) {
+        return false;
+    }
+    for (std::uint64_t i = 0; i < *count; ++i) {
+        auto sid = read_raw<std::uint64_t>(is);
+        auto pos = read_raw<std::uint64_t>(is);
+        auto furthest = read_raw<std::uint64_t>(is);
+        auto len = read_raw<std::uint64_t>(is);
+        if (!sid || !pos || !furthest || !len) {
+            ctx.clear();
+            return false;
+        }
+        std::string data;
+        if (!read_bytes(is, *len, data)) {
+            ctx.clear();
+            return false;
+        }
+        ctx.memo().add_pending(*sid, std::size_t(*pos),
+            pending_entry{ std::move(data), std::size_t(*furthest) });
+    }
+    return true;
+}
+
+} /* namespace detail */
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * rem elements were replaced by ins new ones at start.
+ */
+struct text_edit {
+    std::size_t start = 0;
+    std::size_t rem   = 0;
+    std::size_t ins   = 0;
+};
+
+/**
+ * The smallest single edit that turns old_src into new_src: everything
+ * outside of it is the common prefix and suffix of the two. If the sources
+ * are equal, the edit is empty and at the end.
+ */
+template <typename Src1, typename Src2>
+[[nodiscard]] text_edit detect_edit(Src1 const& old_src, Src2 const& new_src)
+    noexcept {
+    static_assert(
+        detail::is_contiguous_source_v<Src1>
+     && detail::is_contiguous_source_v<Src2>,
+        "Edits can only be detected between contiguous sources!"
+    );
+
+    auto const* o = std::data(old_src);
+    auto const* n = std::data(new_src);
+    auto const o_len = std::size(old_src);
+    auto const n_len = std::size(new_src);
+    auto const shorter = std::min(o_len, n_len);
+
+    auto prefix = detail::common_prefix(o, n, shorter);
+    // The suffix can't overlap the prefix
+    auto suffix = detail::common_suffix(
+        o + o_len, n + n_len, shorter - prefix
+    );
+    return text_edit{
+        prefix, o_len - prefix - suffix, n_len - prefix - suffix
+    };
+}
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename P>
+class parser {
+private:
+    cppcmb_self_check(parser);
+
+    P                          m_Parser;
+    memo_context               m_Context;
+    std::optional<std::size_t> m_AutoCompact;
+    compaction_stats           m_LastCompaction;
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Res>
+    void after_parse(Res const& res) {
+        if (m_AutoCompact && res.is_success()) {
+            m_LastCompaction = m_Context.memo().compact(*m_AutoCompact);
+        }
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr parser(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr decltype(auto) parse(Src const& src) {
+        m_Context.clear();
+        m_Context.reset_state();
+        auto r = reader(src, m_Context);
+        decltype(auto) res = m_Parser.apply(r);
+        after_parse(res);
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Sets the parse state, that the stateful combinators can read and
+     * change. Every parse and reparse starts from a copy of init.
+     */
+    template <typename T>
+    void set_state(T init) {
+        m_Context.set_state(std::move(init));
+    }
+
+    /**
+     * The state at the end of the last parse.
+     */
+    template <typename T>
+    [[nodiscard]] T const& state() const noexcept {
+        return m_Context.template peek_state<T>();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr decltype(auto)
+    reparse(Src const& src,
+        std::size_t start, std::size_t rem, std::size_t ins) {
+
+        m_Context.memo().invalidate(start, rem, ins);
+        m_Context.reset_state();
+        auto r = reader(src, m_Context);
+        decltype(auto) res = m_Parser.apply(r);
+        after_parse(res);
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Like reparse, but the edit is detected from the previous version of
+     * the source, for clients that only know the whole new text.
+     */
+    template <typename Src1, typename Src2>
+    [[nodiscard]] constexpr decltype(auto)
+    reparse_from(Src1 const& old_src, Src2 const& new_src) {
+        return reparse(new_src, detect_edit(old_src, new_src));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Reparse with an edit of elements of the source, like the token edit
+     * that token_stream::relex reports.
+     */
+    template <typename Src>
+    [[nodiscard]] constexpr decltype(auto)
+    reparse(Src const& src, text_edit const& edit) {
+        return reparse(src, edit.start, edit.rem, edit.ins);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Re-parses only the smallest memorized parser application that contains
+     * the edit, instead of the whole source. A block is only accepted, if its
+     * new match ends at the shifted end of the old one. The memorized parsers
+     * enclosing it are then re-derived from the inside out, they reuse the
+     * new block and every other result the edit didn't touch, and each of
+     * them has to keep its length too. Every memorized result that looked at
+     * the edit has to be computed again by these. Otherwise the edit could
+     * change a decision outside of them, so the next smallest enclosing block
+     * is tried. Returns nothing if none of them fit, then reparse is needed.
+     * The parser must not be moved since the previous parse.
+     */
+    template <typename Src>
+    [[nodiscard]] std::optional<reparsed_block>
+    reparse_block(Src const& src,
+        std::size_t start, std::size_t rem, std::size_t ins) {
+
+        auto& memo = m_Context.memo();
+        auto const end = start + rem;
+        auto dropped = memo.overlapping(start, rem);
+        memo.invalidate(start, rem, ins);
+
+        // The blocks containing the edit, from the smallest
+        std::vector<detail::overlapping_entry const*> blocks;
+        for (auto const& e : dropped) {
+            if (e.is_block && e.pos <= start && end <= e.pos + e.matched) {
+                blocks.push_back(&e);
+            }
+        }
+        std::sort(blocks.begin(), blocks.end(),
+            [](auto const* l, auto const* r) {
+                return l->matched < r->matched
+                    || (l->matched == r->matched && l->pos > r->pos);
+            }
+        );
+
+        // Where a dropped entry is expected after the edit, the entries
+        // starting in the removed part start at the edit
+        auto moved = [&](std::size_t pos) {
+            return pos < end ? std::min(pos, start) : pos + ins - rem;
+        };
+        auto rebuilt = [&](detail::overlapping_entry const& e) {
+            return memo.contains(e.pid, moved(e.pos))
+                || (e.pos == start && memo.contains(e.pid, start));
+        };
+        auto reapply = [&](detail::overlapping_entry const& b) {
+            auto res = b.block.reapply(
+                b.block.self, ::std::addressof(src), typeid(Src),
+                b.pos, m_Context
+            );
+            if (res && res->length != b.matched - rem + ins) {
+                res.reset();
+            }
+            return res;
+        };
+        auto encloses = [](detail::overlapping_entry const& outer,
+            detail::overlapping_entry const& inner) {
+            return outer.pos <= inner.pos
+                && inner.pos + inner.matched <= outer.pos + outer.matched;
+        };
+
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+            auto const& b = *blocks[i];
+            auto res = reapply(b);
+            bool fits = res.has_value();
+            // The memorized parents along the spine
+            auto const* top = &b;
+            for (auto j = i + 1; fits && j < blocks.size(); ++j) {
+                if (encloses(*blocks[j], *top)) {
+                    top = blocks[j];
+                    fits = reapply(*top).has_value();
+                }
+            }
+            for (auto it = dropped.begin(); fits && it != dropped.end(); ++it) {
+                fits = encloses(*top, *it) && rebuilt(*it);
+            }
+            if (fits) {
+                res->rule = b.pid;
+                return res;
+            }
+            // The next block has to compute them by itself
+            for (auto const& e : dropped) {
+                memo.erase(e.pid, moved(e.pos));
+                if (e.pos == start) {
+                    memo.erase(e.pid, start);
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Applies p, usually a rule of the grammar, at the offset of the source.
+     * The memo context is shared with parse and reparse, so the results that
+     * are memorized already are reused. It's not cleared, and neither is the
+     * parse state reset.
+     */
+    template <typename Q, typename Src>
+    [[nodiscard]] constexpr decltype(auto)
+    parse_at(Q const& p, Src const& src, std::size_t offset) {
+        cppcmb_assert_parser(Q, Src);
+
+        auto r = reader(src, offset, m_Context);
+        return p.apply(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Like parse_at, but the source is treated as if it ended at end. The
+     * memorized results that looked at the end are dropped before and after,
+     * as they see a different source with and without the bound.
+     */
+    template <typename Q, typename CharT, typename Traits>
+    [[nodiscard]] constexpr auto
+    parse_at(Q const& p, std::basic_string_view<CharT, Traits> const& src,
+        std::size_t offset, std::size_t end) {
+
+        using string_t = std::basic_string_view<CharT, Traits>;
+        cppcmb_assert_parser(Q, string_t);
+        cppcmb_assert(
+            "The bounds must be inside the source!",
+            offset <= end && end <= src.size()
+        );
+
+        auto& memo = m_Context.memo();
+        memo.invalidate(end, 0, 0);
+        auto bounded = src.substr(0, end);
+        auto r = reader(bounded, offset, m_Context);
+        // Copied, the invalidation might drop the entry it refers to
+        auto res = p.apply(r);
+        memo.invalidate(end, 0, 0);
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Drops the memorized results that the last parse didn't derive its
+     * result from, unless they start at most neighborhood elements away from
+     * one it did. These are mostly failed alternatives and the results under
+     * them, that later parses are unlikely to ask for again.
+     */
+    compaction_stats compact(std::size_t neighborhood = 0) {
+        m_LastCompaction = m_Context.memo().compact(neighborhood);
+        return m_LastCompaction;
+    }
+
+    /**
+     * Compacts the memo table after every successful parse and reparse.
+     */
+    void enable_auto_compact(std::size_t neighborhood = 0) noexcept {
+        m_AutoCompact = neighborhood;
+    }
+
+    void disable_auto_compact() noexcept {
+        m_AutoCompact = std::nullopt;
+    }
+
+    [[nodiscard]] compaction_stats const& last_compaction()
+        const noexcept {
+        return m_LastCompaction;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Saves the persistable memo entries of the last parse of src, the ones
+     * of the parsers memorized with a key. The version identifies the
+     * grammar, it must be changed whenever the grammar behaves differently,
+     * even if it's type doesn't change, like when an action calls a different
+     * function.
+     */
+    template <typename Src>
+    void save_memo(std::ostream& os, Src const& src,
+        std::uint64_t version) const {
+
+        detail::save_memo(
+            m_Context, os, detail::stable_type_id<P>(), version,
+            detail::source_hash(src)
+        );
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Loads memo entries saved by save_memo for the same grammar, version and
+     * source. Use reparse afterwards (with the edits since saving, if any),
+     * parse would discard the loaded entries. Returns false if nothing was
+     * loaded.
+     */
+    template <typename Src>
+    bool load_memo(std::istream& is, Src const& src, std::uint64_t version) {
+        return detail::load_memo(
+            m_Context, is, detail::stable_type_id<P>(), version,
+            detail::source_hash(src)
+        );
+    }
+};
+
+template <typename PFwd>
+parser(PFwd) -> parser<PFwd>;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * Usage statistics of a parse_cache.
+ */
+struct parse_cache_stats {
+    std::size_t hits      = 0;
+    std::size_t misses    = 0;
+    std::size_t evictions = 0;
+    std::size_t entries   = 0;
+    std::size_t bytes     = 0;
+};
+
+template <typename P, typename CharT = char>
+class parse_cache {
+private:
+    cppcmb_self_check(parse_cache);
+
+    using view_type = std::basic_string_view<CharT>;
+
+public:
+    using result_type = detail::remove_cvref_t<decltype(
+        std::declval<parser<P>&>().parse(std::declval<view_type const&>())
+    )>;
+
+private:
+    /**
+     * The input and the result parsed from it, allocated together so the
+     * result can't outlive the input.
+     */
+    struct payload {
+        std::basic_string<CharT>   input;
+        std::optional<result_type> value;
+    };
+
+    struct entry {
+        detail::hash128          key;
+        std::shared_ptr<payload> data;
+        std::size_t              bytes;
+    };
+
+    using lru_list = std::list<entry>;
+
+    parser<P>         m_Parser;
+    std::size_t       m_Budget;
+    lru_list          m_Entries;
+    std::unordered_map<
+        detail::hash128,
+        typename lru_list::iterator,
+        detail::hash128_hasher
+    >                 m_Index;
+    parse_cache_stats m_Stats;
+
+    // XXX(LPeter1997): Noexcept specifier
+    void evict_until(std::size_t budget) {
+        while (m_Stats.bytes > budget && !m_Entries.empty()) {
+            auto& last = m_Entries.back();
+            m_Stats.bytes -= last.bytes;
+            m_Index.erase(last.key);
+            m_Entries.pop_back();
+            ++m_Stats.evictions;
+        }
+        m_Stats.entries = m_Entries.size();
+    }
+
+    [[nodiscard]] static std::shared_ptr<result_type const>
+    alias(std::shared_ptr<payload> const& data) noexcept {
+        return std::shared_ptr<result_type const>(data, &*data->value);
+    }
+
+public:
+    /**
+     * Creates a cache that holds at most budget bytes worth of entries. An
+     * entry is accounted with the size of it's input and it's bookkeeping.
+     */
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    parse_cache(PFwd&& p, std::size_t budget)
+        : m_Parser(cppcmb_fwd(p)), m_Budget(budget) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Parses the input, or returns the cached result if the same input has
+     * been parsed before.
+     */
+    [[nodiscard]] std::shared_ptr<result_type const> parse(view_type src) {
+        auto key = detail::hash_string(src);
+
+        auto it = m_Index.find(key);
+        if (it != m_Index.end() && it->second->data->input == src) {
+            // Hit, move it to the front
+            m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+            ++m_Stats.hits;
+            return alias(it->second->data);
+        }
+        ++m_Stats.misses;
+
+        auto data = std::make_shared<payload>();
+        data->input.assign(src.data(), src.size());
+        data->value.emplace(m_Parser.parse(view_type(data->input)));
+
+        auto bytes = sizeof(payload) + sizeof(entry)
+                   + data->input.size() * sizeof(CharT);
+        if (bytes > m_Budget) {
+            // Would never fit, don't disturb the cache
+            return alias(data);
+        }
+
+        if (it != m_Index.end()) {
+            // Hash collision with a different input, replace the old entry
+            m_Stats.bytes -= it->second->bytes;
+            m_Entries.erase(it->second);
+            m_Index.erase(it);
+        }
+        evict_until(m_Budget - bytes);
+        m_Entries.push_front(entry{ key, data, bytes });
+        m_Index[key] = m_Entries.begin();
+        m_Stats.bytes += bytes;
+        m_Stats.entries = m_Entries.size();
+        return alias(data);
+    }
+
+    [[nodiscard]] parse_cache_stats const& stats() const noexcept {
+        return m_Stats;
+    }
+
+    [[nodiscard]] std::size_t budget() const noexcept {
+        return m_Budget;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Changes the byte budget, evicting entries if needed.
+     */
+    void set_budget(std::size_t budget) {
+        m_Budget = budget;
+        evict_until(m_Budget);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void clear() {
+        m_Entries.clear();
+        m_Index.clear();
+        m_Stats.bytes = 0;
+        m_Stats.entries = 0;
+    }
+};
+
+template <typename PFwd>
+parse_cache(PFwd, std::size_t) -> parse_cache<PFwd>;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * The block_reapply_fn of the parser P on sources of type Src. Failures are
+ * not reported, the enclosing block has to be tried then.
+ */
+template <typename P, typename Src>
+std::optional<reparsed_block> reapply_block(void const* self,
+    void const* src, std::type_info const& src_type,
+    std::size_t pos, memo_context& ctx) {
+
+    if (src_type != typeid(Src)) {
+        return std::nullopt;
+    }
+    auto const& p = *static_cast<P const*>(self);
+    auto r = reader(*static_cast<Src const*>(src), pos, ctx);
+    auto res = p.apply(r);
+    if (res.is_failure()) {
+        return std::nullopt;
+    }
+    auto len = res.success().matched();
+    return reparsed_block{ 0, pos, len, std::any(std::move(res)) };
+}
+
+template <typename Self>
+class packrat_base : public combinator<Self> {
+private:
+    std::uintptr_t m_ID;
+
+protected:
+    constexpr packrat_base() noexcept
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        : m_ID(reinterpret_cast<std::uintptr_t>(this)) {
+    }
+
+    [[nodiscard]] constexpr auto const& original_id() const noexcept {
+        return m_ID;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src, typename TFwd>
+    constexpr auto& put_memo(reader<Src> const& r,
+        TFwd&& val, std::size_t furth,
+        memo_block block = memo_block()) const {
+
+        auto& table = r.context().memo();
+        return table.put(original_id(), r, cppcmb_fwd(val), furth, block);
+    }
+
+    /**
+     * Makes the entries put with it re-parsable by themselves.
+     */
+    template <typename Src>
+    [[nodiscard]] constexpr memo_block block_of(reader<Src> const&)
+        const noexcept {
+        return memo_block{
+            static_cast<Self const*>(this), &reapply_block<Self, Src>
+        };
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr std::any* get_memo(reader<Src> const& r) const {
+        auto& table = r.context().memo();
+        return table.get(original_id(), r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Like put_memo, but the entry will be saved with the memo context, under
+     * the stable ID of the parser.
+     */
+    template <typename Src, typename TFwd>
+    auto& put_persistent_memo(reader<Src> const& r, std::uint64_t sid,
+        TFwd&& val, std::size_t furth,
+        memo_block block = memo_block()) const {
+
+        using raw_type = remove_cvref_t<TFwd>;
+        auto& table = r.context().memo();
+        table.register_persistent(original_id(), persistent_rule{
+            sid, &persist_any<raw_type>
+        });
+        return table.put(original_id(), r, cppcmb_fwd(val), furth, block);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Decodes the entry at the reader position that has been loaded from a
+     * previous process, if there is one.
+     */
+    template <typename Result, typename Src>
+    [[nodiscard]] Result* restore_memo(reader<Src> const& r,
+        std::uint64_t sid) const {
+
+        auto& table = r.context().memo();
+        auto e = table.take_pending(sid, r.cursor());
+        if (!e) {
+            return nullptr;
+        }
+        auto data = std::string_view(e->data);
+        auto res = persist_traits<Result>::read(data);
+        if (!res) {
+            return nullptr;
+        }
+        return &put_persistent_memo(r, sid, std::move(*res), e->furthest);
+    }
+};
+
+} /* namespace detail */
+
+template <typename P>
+class packrat_t : public detail::packrat_base<packrat_t<P>> {
+private:
+    cppcmb_self_check(packrat_t);
+
+    P                            m_Parser;
+    // Only the results of parsers with a key are persisted
+    std::optional<std::uint64_t> m_Key;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr packrat_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    template <typename PFwd>
+    packrat_t(PFwd&& p, std::string_view key)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)), m_Key(detail::hash_string(key).low) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = parser_result_t<P, Src>;
+
+        auto* entry = this->get_memo(r);
+        if (entry == nullptr) {
+            auto frame = detail::state_frame_scope(r.context().memo());
+            if constexpr (is_persistable_v<result_t>) {
+                if (m_Key) {
+                    auto* res =
+                        this->template restore_memo<result_t>(r, *m_Key);
+                    if (res != nullptr) {
+                        return *res;
+                    }
+                    auto fresh = m_Parser.apply(r);
+                    auto furth = fresh.furthest();
+                    return this->put_persistent_memo(
+                        r, *m_Key, std::move(fresh), furth, this->block_of(r)
+                    );
+                }
+            }
+            auto res = m_Parser.apply(r);
+            auto furth = res.furthest();
+            return this->put_memo(r, std::move(res), furth, this->block_of(r));
+        }
+        return std::any_cast<result_t&>(*entry);
+    }
+};
+
+template <typename PFwd>
+packrat_t(PFwd) -> packrat_t<PFwd>;
+
+template <typename PFwd>
+packrat_t(PFwd, std::string_view) -> packrat_t<PFwd>;
+
+/**
+ * Wrapper to make any combinator a packrat parser.
+ */
+template <typename PFwd>
+[[nodiscard]] constexpr auto memo(PFwd&& p)
+    cppcmb_return(packrat_t(cppcmb_fwd(p)))
+
+/**
+ * Like memo, but the results are saved and loaded with the memo table (see
+ * parser::save_memo), if they have persist_traits. The key identifies the
+ * rule across processes, it must be unique in the grammar.
+ */
+template <typename PFwd>
+[[nodiscard]] auto memo(PFwd&& p, std::string_view key)
+    cppcmb_return(packrat_t(cppcmb_fwd(p), key))
+
+struct as_self_t {};
+struct as_memo_t {};
+
+inline constexpr auto as_self = as_self_t();
+inline constexpr auto as_memo = as_memo_t();
+
+// Identity
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+constexpr auto operator%=(P&& parser, as_self_t)
+    cppcmb_return(cppcmb_fwd(parser))
+
+// Simple packrat
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+constexpr auto operator%=(P&& parser, as_memo_t)
+    cppcmb_return(memo(cppcmb_fwd(parser)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename P>
+class auto_packrat_t : public detail::packrat_base<auto_packrat_t<P>> {
+private:
+    cppcmb_self_check(auto_packrat_t);
+
+    P           m_Parser;
+    std::size_t m_MinSamples = 16;
+    std::size_t m_Percent    = 20;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr auto_packrat_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    /**
+     * Memorization is turned on after at least min_samples sampled
+     * evaluations, if at least percent% of them were re-evaluations.
+     */
+    template <typename PFwd>
+    constexpr auto_packrat_t(PFwd&& p,
+        std::size_t min_samples, std::size_t percent)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)),
+          m_MinSamples(min_samples), m_Percent(percent) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * The ID to look up the statistics of this rule in a memo context.
+     */
+    [[nodiscard]] constexpr auto const& id() const noexcept {
+        return this->original_id();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> parser_result_t<P, Src> {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = parser_result_t<P, Src>;
+
+        auto& stats = r.context().rule_stats()[this->original_id()];
+        if (stats.memoized()) {
+            auto* entry = this->get_memo(r);
+            if (entry != nullptr) {
+                return std::any_cast<result_t&>(*entry);
+            }
+            auto frame = detail::state_frame_scope(r.context().memo());
+            auto res = m_Parser.apply(r);
+            auto furth = res.furthest();
+            return this->put_memo(
+                r, std::move(res), furth, this->block_of(r)
+            );
+        }
+        stats.record(r.cursor(), m_MinSamples, m_Percent);
+        return m_Parser.apply(r);
+    }
+};
+
+template <typename PFwd>
+auto_packrat_t(PFwd) -> auto_packrat_t<PFwd>;
+
+template <typename PFwd>
+auto_packrat_t(PFwd, std::size_t, std::size_t) -> auto_packrat_t<PFwd>;
+
+/**
+ * Wrapper to make any combinator an adaptive packrat parser.
+ */
+template <typename PFwd>
+[[nodiscard]] constexpr auto memo_auto(PFwd&& p)
+    cppcmb_return(auto_packrat_t(cppcmb_fwd(p)))
+
+template <typename PFwd>
+[[nodiscard]] constexpr auto memo_auto(PFwd&& p,
+    std::size_t min_samples, std::size_t percent)
+    cppcmb_return(auto_packrat_t(cppcmb_fwd(p), min_samples, percent))
+
+struct as_memo_auto_t {};
+
+inline constexpr auto as_memo_auto = as_memo_auto_t();
+
+// Adaptive packrat
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+constexpr auto operator%=(P&& parser, as_memo_auto_t)
+    cppcmb_return(memo_auto(cppcmb_fwd(parser)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+// XXX(LPeter1997): This is a more generic structure, shouldn't be here!
+template <typename T, typename Tag>
+class tagged_wrapper {
+private:
+    cppcmb_self_check(tagged_wrapper);
+
+    T m_Value;
+
+public:
+    template <typename TFwd>
+    constexpr tagged_wrapper(TFwd&& val)
+        noexcept(std::is_nothrow_constructible_v<T, TFwd&&>)
+        : m_Value(cppcmb_fwd(val)) {
+    }
+
+    cppcmb_getter(value, m_Value)
+};
+
+} /* namespace detail */
+
+template <typename P>
+class drec_packrat_t : public detail::packrat_base<drec_packrat_t<P>> {
+private:
+    cppcmb_self_check(drec_packrat_t);
+
+    template <typename T>
+    using base_recursion = detail::tagged_wrapper<T, struct drec_base_tag>;
+
+    template <typename T>
+    using in_recursion = detail::tagged_wrapper<T, struct drec_in_tag>;
+
+    P m_Parser;
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]]
+    constexpr decltype(auto) grow(
+        reader<Src> const& r,
+        parser_result_t<P, Src>& old_res
+    ) const {
+
+        // XXX(LPeter1997): Right now the max_furthest is explicitly written
+        // back into the cache (redundantly). We could always ask the result
+        // directly.
+        // That way we don't have to put_memo the old values just to update
+        // 'furthest'
+
+        using in_rec = in_recursion<parser_result_t<P, Src>>;
+
+        if (old_res.is_failure()) {
+            return old_res;
+        }
+        auto& old_succ = old_res.success();
+
+        auto tmp_res = m_Parser.apply(r);
+        auto max_furthest = std::max(old_res.furthest(), tmp_res.furthest());
+
+        // Update the furthest value in both entries
+        old_res.m_Furthest = max_furthest;
+        tmp_res.m_Furthest = max_furthest;
+
+        if (tmp_res.is_success()) {
+            auto& tmp_succ = tmp_res.success();
+            if (old_succ.matched() < tmp_succ.matched()) {
+                // We successfully grew the seed
+                auto& new_old = this->put_memo(
+                    r, in_rec(tmp_res), max_furthest
+                ).value();
+                return grow(r, new_old);
+            }
+            // We need to overwrite max-furthest in the memo-table!
+            // That's why we don't simply return old_res
+            return this->put_memo(
+                r, in_rec(old_res), max_furthest
+            ).value();
+        }
+        // We need to overwrite max-furthest in the memo-table!
+        // That's why we don't simply return old_res
+        return this->put_memo(
+            r, in_rec(old_res), max_furthest
+        ).value();
+    }
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr drec_packrat_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = parser_result_t<P, Src>;
+        using base_rec = std::pair<base_recursion<result_t>, bool>;
+        using in_rec = in_recursion<result_t>;
+
+        auto* entry = this->get_memo(r);
+        if (entry == nullptr) {
+            // Nothing is in the cache yet, write a dummy error
+            this->put_memo(r, base_rec(result_t(failure(), 0U), true), 0U);
+            // Now invoke the parser
+            // If it's recursive, the entry must have changed
+            auto tmp_res = m_Parser.apply(r);
+            // Refresh entry
+            entry = this->get_memo(r);
+            cppcmb_assert(
+                "The entry cannot be nullptr here!",
+                entry != nullptr
+            );
+
+            // Check for change
+            if (auto* inr = std::any_cast<in_rec>(entry)) {
+                // We are in recursion
+                auto& res = this->put_memo(
+                    r, in_rec(std::move(tmp_res)), tmp_res.furthest()
+                ).value();
+                return grow(r, res);
+            }
+            // Base-thing, no progress
+            // Overwrite the base-type to contain the result
+            auto* br = std::any_cast<base_rec>(entry);
+            cppcmb_assert(
+                "A direct-packrat parser must either enter a "
+                "'base' or 'in'-recursion entry!",
+                br != nullptr
+            );
+            return this->put_memo(
+                r,
+                base_rec(std::move(tmp_res), false),
+                tmp_res.furthest()
+            ).first.value();
+        }
+        // Something is in the cache
+        if (auto* br_p = std::any_cast<base_rec>(entry)) {
+            auto& br = *br_p;
+            if (br.second) {
+                // Recursion signal
+                return this->put_memo(
+                    r,
+                    in_rec(result_t(failure(), 0U)),
+                    0U
+                ).value();
+            }
+            return br.first.value();
+        }
+        auto* inr = std::any_cast<in_rec>(entry);
+        cppcmb_assert(
+            "A direct-packrat parser must either enter a "
+            "'base' or 'in'-recursion entry!",
+            inr != nullptr
+        );
+        return inr->value();
+    }
+};
+
+template <typename PFwd>
+drec_packrat_t(PFwd) -> drec_packrat_t<PFwd>;
+
+/**
+ * Wrapper to make any combinator a direct-left-recursive packrat parser.
+ */
+template <typename PFwd>
+[[nodiscard]] constexpr auto memo_d(PFwd&& p)
+    cppcmb_return(drec_packrat_t(cppcmb_fwd(p)))
+
+struct as_memo_d_t {};
+
+inline constexpr auto as_memo_d = as_memo_d_t();
+
+// Direct-left-recursive packrat
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+constexpr auto operator%=(P&& parser, as_memo_d_t)
+    cppcmb_return(memo_d(cppcmb_fwd(parser)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+class end_t : public combinator<end_t> {
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<product<>> {
+
+        if (r.is_end()) {
+            // XXX(LPeter1997): GCC bug
+            return result<product<>>(success(product<>(), 0U), 0U);
+        }
+        return result<product<>>(failure(), 0U);
+    }
+};
+
+// Value for 'end' parser
+inline constexpr end_t end = end_t();
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+class epsilon_t : public combinator<epsilon_t> {
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& /* r */) const
+        -> result<product<>> {
+
+        // XXX(LPeter1997): GCC bug
+        return result<product<>>(success(product<>(), 0U), 0U);
+    }
+};
+
+// Value for 'epsilon' parser
+inline constexpr auto epsilon = epsilon_t();
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+namespace detail {
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Compiles a regular combinator into a DFA, with its prefilter.
+ */
+template <typename P>
+[[nodiscard]] dfa_searcher compile_searcher(P const& p) {
+    return dfa_searcher(compile_dfa(p));
+}
+
+} /* namespace detail */
+
+/**
+ * Finds the first (leftmost-longest) match of a regular combinator from the
+ * cursor on. The result is the matched part of the source, the skipped part
+ * is consumed too. Fails, if there's no match until the end of the source.
+ */
+template <typename P>
+class find_t : public combinator<find_t<P>> {
+private:
+    cppcmb_self_check(find_t);
+
+    P                                           m_Parser;
+    std::shared_ptr<detail::dfa_searcher const> m_Searcher;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    find_t(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)),
+          m_Searcher(std::make_shared<detail::dfa_searcher const>(
+              detail::compile_searcher(m_Parser)
+          )) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * The compiled automaton and its prefilter.
+     */
+    [[nodiscard]] detail::dfa_searcher const& searcher() const noexcept {
+        return *m_Searcher;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Searching only works in contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
+
+        auto const* data = std::data(r.source()) + r.cursor();
+        auto const len = std::size(r.source()) - r.cursor();
+        std::size_t furthest = 0;
+        auto m = m_Searcher->search(data, len, 0, furthest);
+        if (m.begin == detail::prefilter::npos) {
+            return result_t(failure(), furthest);
+        }
+        auto matched = m.begin + m.length;
+        return result_t(
+            success(string_t(data + m.begin, m.length), matched), furthest
+        );
+    }
+};
+
+template <typename PFwd>
+find_t(PFwd) -> find_t<PFwd>;
+
+/**
+ * Scans forward for the first match of a regular combinator.
+ */
+template <typename PFwd>
+[[nodiscard]] auto find(PFwd&& p)
+    cppcmb_return(find_t(cppcmb_fwd(p)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * The pool is referenced, it has to outlive the parser. Memorizing the
+ * hash-consed parser instead of the underlying one makes the memo table share
+ * the values too.
+ */
+template <typename P, typename Pool>
+class hash_cons_t : public combinator<hash_cons_t<P, Pool>> {
+private:
+    P     m_Parser;
+    Pool* m_Pool;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    hash_cons_t(PFwd&& p, Pool& pool)
+        : m_Parser(cppcmb_fwd(p)), m_Pool(::std::addressof(pool)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    [[nodiscard]] Pool& pool() const noexcept {
+        return *m_Pool;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = result<typename Pool::pointer_type>;
+
+        auto res = m_Parser.apply(r);
+        if (res.is_failure()) {
+            return result_t(std::move(res).failure(), res.furthest());
+        }
+        auto len = res.success().matched();
+        auto shared = m_Pool->intern(std::move(res).success().value());
+        return result_t(success(std::move(shared), len), res.furthest());
+    }
+};
+
+template <typename PFwd, typename Pool>
+hash_cons_t(PFwd, Pool&) -> hash_cons_t<PFwd, Pool>;
+
+/**
+ * Hash-conses what p produces in the pool.
+ */
+template <typename PFwd, typename Pool>
+[[nodiscard]] auto hash_cons(PFwd&& p, Pool& pool)
+    cppcmb_return(hash_cons_t(cppcmb_fwd(p), pool))
+
+// The pool would be destroyed before the parser is used
+template <typename PFwd, typename Pool>
+void hash_cons(PFwd&& p, Pool const&& pool) = delete;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+using symbol_id = std::uint32_t;
+
+inline constexpr symbol_id no_symbol = symbol_id(-1);
+
+/**
+ * An open-addressed hash table from strings to ids. The ids are given out
+ * consecutively from 0. The strings are copied into arena blocks that never
+ * move, so the views returned by name() stay valid as long as the table.
+ */
+template <typename CharT>
+class basic_symbol_table {
+public:
+    using string_type = std::basic_string_view<CharT>;
+
+    // The size of an arena block, longer strings get their own
+    static constexpr std::size_t block_size = 4096;
+
+private:
+    struct slot {
+        symbol_id     id   = no_symbol;
+        // The low bits of the hash, to skip most string comparisons
+        std::uint32_t hash = 0;
+    };
+
+    std::vector<slot>                     m_Slots;
+    std::vector<string_type>              m_Names;
+    std::vector<std::unique_ptr<CharT[]>> m_Blocks;
+    std::vector<std::unique_ptr<CharT[]>> m_Large;
+    std::size_t                           m_BlockUsed = block_size;
+
+    [[nodiscard]] static std::uint64_t hash_of(string_type str) noexcept {
+        return detail::hash_string(str).low;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    string_type store(string_type str) {
+        if (str.empty()) {
+            return string_type();
+        }
+        CharT* mem;
+        if (str.size() > block_size / 4) {
+            // Long strings would waste most of a block
+            mem = m_Large.emplace_back(new CharT[str.size()]).get();
+        }
+        else {
+            if (block_size - m_BlockUsed < str.size()) {
+                m_Blocks.emplace_back(new CharT[block_size]);
+                m_BlockUsed = 0;
+            }
+            mem = m_Blocks.back().get() + m_BlockUsed;
+            m_BlockUsed += str.size();
+        }
+        std::copy(str.begin(), str.end(), mem);
+        return string_type(mem, str.size());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void grow() {
+        auto slots = std::vector<slot>(
+            m_Slots.empty() ? 64 : m_Slots.size() * 2
+        );
+        auto const mask = slots.size() - 1;
+        for (auto const& s : m_Slots) {
+            if (s.id == no_symbol) {
+                continue;
+            }
+            auto i = std::size_t(hash_of(m_Names[s.id])) & mask;
+            while (slots[i].id != no_symbol) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = s;
+        }
+        m_Slots = std::move(slots);
+    }
+
+    /**
+     * The slot of the string, or the empty slot where it would be inserted.
+     */
+    [[nodiscard]] std::size_t probe(string_type str, std::uint64_t h)
+        const noexcept {
+        auto const mask = m_Slots.size() - 1;
+        auto i = std::size_t(h) & mask;
+        while (true) {
+            auto const& s = m_Slots[i];
+            if (s.id == no_symbol
+                || (s.hash == std::uint32_t(h) && m_Names[s.id] == str)) {
+                return i;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+public:
+    basic_symbol_table() = default;
+
+    basic_symbol_table(basic_symbol_table const&) = delete;
+    basic_symbol_table& operator=(basic_symbol_table const&) = delete;
+
+    basic_symbol_table(basic_symbol_table&&) noexcept = default;
+    basic_symbol_table& operator=(basic_symbol_table&&) noexcept = default;
+
+    /**
+     * The number of distinct strings.
+     */
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_Names.size();
+    }
+
+    /**
+     * The string of the id.
+     */
+    [[nodiscard]] string_type name(symbol_id id) const noexcept {
+        cppcmb_assert("Unknown symbol!", id < m_Names.size());
+        return m_Names[id];
+    }
+
+    /**
+     * The id of the string, or no_symbol, if it was never interned.
+     */
+    [[nodiscard]] symbol_id find(string_type str) const noexcept {
+        if (m_Slots.empty()) {
+            return no_symbol;
+        }
+        return m_Slots[probe(str, hash_of(str))].id;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The id of the string, a new one if it wasn't interned yet.
+     */
+    symbol_id intern(string_type str) {
+        // Keep the load factor under 1/2
+        if (2 * (m_Names.size() + 1) > m_Slots.size()) {
+            grow();
+        }
+        auto h = hash_of(str);
+        auto& s = m_Slots[probe(str, h)];
+        if (s.id == no_symbol) {
+            cppcmb_assert(
+                "Too many symbols!", m_Names.size() < std::size_t(no_symbol)
+            );
+            s.id = symbol_id(m_Names.size());
+            s.hash = std::uint32_t(h);
+            m_Names.push_back(store(str));
+        }
+        return s.id;
+    }
+};
+
+using symbol_table = basic_symbol_table<char>;
+
+/**
+ * A symbol table that can be used from multiple threads. Strings are
+ * distributed between independently locked shards by their hash, the low
+ * bits of an id tell its shard. Ids are unique, but not consecutive.
+ */
+template <typename CharT, std::size_t Shards = 16>
+class basic_concurrent_symbol_table {
+public:
+    using string_type = std::basic_string_view<CharT>;
+
+    static_assert(
+        Shards > 0 && (Shards & (Shards - 1)) == 0,
+        "The number of shards must be a power of 2!"
+    );
+
+private:
+    static constexpr std::size_t shard_bits = detail::bit_count(Shards - 1);
+
+    struct shard {
+        std::mutex                mutex;
+        basic_symbol_table<CharT> table;
+    };
+
+    std::array<shard, Shards> m_Shards;
+
+    [[nodiscard]] static std::size_t shard_of(string_type str) noexcept {
+        // The high bits, the tables use the low ones
+        return std::size_t(detail::hash_string(str).high) & (Shards - 1);
+    }
+
+public:
+    /**
+     * The number of distinct strings.
+     */
+    [[nodiscard]] std::size_t size() {
+        std::size_t n = 0;
+        for (auto& s : m_Shards) {
+            std::lock_guard lock(s.mutex);
+            n += s.table.size();
+        }
+        return n;
+    }
+
+    /**
+     * The string of the id.
+     */
+    [[nodiscard]] string_type name(symbol_id id) {
+        auto& s = m_Shards[id & (Shards - 1)];
+        std::lock_guard lock(s.mutex);
+        return s.table.name(id >> shard_bits);
+    }
+
+    /**
+     * The id of the string, or no_symbol, if it was never interned.
+     */
+    [[nodiscard]] symbol_id find(string_type str) {
+        auto index = shard_of(str);
+        auto& s = m_Shards[index];
+        std::lock_guard lock(s.mutex);
+        auto id = s.table.find(str);
+        return id == no_symbol
+            ? no_symbol
+            : symbol_id((id << shard_bits) | index);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The id of the string, a new one if it wasn't interned yet.
+     */
+    symbol_id intern(string_type str) {
+        auto index = shard_of(str);
+        auto& s = m_Shards[index];
+        std::lock_guard lock(s.mutex);
+        cppcmb_assert(
+            "Too many symbols!",
+            s.table.size() < (std::size_t(no_symbol) >> shard_bits)
+        );
+        auto id = s.table.intern(str);
+        return symbol_id((id << shard_bits) | index);
+    }
+};
+
+using concurrent_symbol_table = basic_concurrent_symbol_table<char>;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * The table is referenced, it has to outlive the parser. Works with any table
+ * that has an intern member function, like symbol_table or
+ * concurrent_symbol_table.
+ */
+template <typename P, typename Table>
+class intern_t : public combinator<intern_t<P, Table>> {
+private:
+    P      m_Parser;
+    Table* m_Table;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    intern_t(PFwd&& p, Table& table)
+        : m_Parser(cppcmb_fwd(p)), m_Table(::std::addressof(table)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    [[nodiscard]] Table& table() const noexcept {
+        return *m_Table;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Only contiguous sources can be interned!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<symbol_id>;
+
+        auto res = m_Parser.apply(r);
+        if (res.is_failure()) {
+            return result_t(std::move(res).failure(), res.furthest());
+        }
+        auto len = res.success().matched();
+        auto span = string_t(std::data(r.source()) + r.cursor(), len);
+        return result_t(success(m_Table->intern(span), len), res.furthest());
+    }
+};
+
+template <typename PFwd, typename Table>
+intern_t(PFwd, Table&) -> intern_t<PFwd, Table>;
+
+/**
+ * Interns what p matches in the table.
+ */
+template <typename PFwd, typename Table>
+[[nodiscard]] auto intern(PFwd&& p, Table& table)
+    cppcmb_return(intern_t(cppcmb_fwd(p), table))
+
+// The table would be destroyed before the parser is used
+template <typename PFwd, typename Table>
+void intern(PFwd&& p, Table const&& table) = delete;
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+// Defined in left_recursion.hpp, it needs every combinator
+template <typename P>
+struct in_left_cycle;
+
+} /* namespace detail */
+
+template <typename P>
+class irec_packrat_t : public detail::packrat_base<irec_packrat_t<P>> {
+private:
+    cppcmb_self_check(irec_packrat_t);
+
+    using head = detail::irec_head;
+    using left_recursive = detail::irec_left_recursive;
+
+    P m_Parser;
+
+    // XXX(LPeter1997): decltype(auto) where possible
+
+    // XXX(LPeter1997): Noexcept specifier
+    // XXX(LPeter1997): This could be static
+    template <typename T>
+    constexpr decltype(auto) to_result(std::any& a) const {
+        if (auto* r = std::any_cast<std::shared_ptr<left_recursive>>(&a)) {
+            return std::any_cast<T&>((*r)->seed());
+        }
+        return std::any_cast<T&>(a);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    /* constexpr */ auto recall(reader<Src> const& r) const
+        -> std::optional<std::any> {
+        using return_t = parser_result_t<P, Src>;
+
+        auto& heads = r.context().call_heads();
+
+        auto* cached = this->get_memo(r);
+        auto* in_heads = heads.get(r);
+
+        if (in_heads == nullptr) {
+            if (cached == nullptr) {
+                return std::nullopt;
+            }
+            return *cached;
+        }
+        auto& h = *in_heads;
+
+        if (cached == nullptr && !(
+               this->original_id() == h.head_id()
+            || detail::contains(h.involved_set(), this->original_id())
+        )) {
+            return return_t(failure(), 0U);
+        }
+
+        auto it = h.eval_set().cend();
+        if (detail::contains(h.eval_set(), this->original_id(), it)) {
+            // Remove the rule id from the evaluation id set of the head
+            h.eval_set().erase(it);
+            auto tmp_res = m_Parser.apply(r);
+            // Put, so the entry knows how far the new result looked
+            this->put_memo(r, tmp_res, tmp_res.furthest());
+            return std::any(std::move(tmp_res));
+        }
+
+        return *cached;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    constexpr void setup_lr(
+        reader<Src> const& r,
+        left_recursive& rec_detect) const {
+
+        if (!rec_detect.head()) {
+            rec_detect.head() = head(this->original_id());
+        }
+        auto& lr_stack = r.context().call_stack();
+        for (
+            auto it = lr_stack.begin();
+            it != lr_stack.end() && (*it)->parser_id() != this->original_id();
+            ++it) {
+
+            (*it)->head() = rec_detect.head();
+            rec_detect.head()->involved_set().insert((*it)->parser_id());
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    constexpr auto lr_answer(
+        reader<Src> const& r,
+        left_recursive& growable) const {
+
+        using return_t = parser_result_t<P, Src>;
+        cppcmb_assert(
+            "The growable must contain a head!",
+            growable.head().has_value()
+        );
+
+        auto& h = *growable.head();
+        auto& seed = to_result<return_t>(growable.seed());
+
+        if (h.head_id() != this->original_id()) {
+            return seed;
+        }
+        auto& s = this->put_memo(r, seed, seed.furthest());
+        if (s.is_failure()) {
+            return s;
+        }
+        return grow(r, s, h);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    constexpr auto grow(
+        reader<Src> const& r,
+        parser_result_t<P, Src>& old_res,
+        head& h) const -> parser_result_t<P, Src> {
+
+        // XXX(LPeter1997): Right now the max_furthest is explicitly written
+        // back into the cache (redundantly). We could always ask the result
+        // directly.
+        // That way we don't have to put_memo the old values just to update
+        // 'furthest'
+        // Same comment and TODO as in drec_packrat_t::grow
+
+        auto& rec_heads = r.context().call_heads();
+
+        rec_heads[r] = &h;
+        h.eval_set() = h.involved_set();
+
+        std::size_t old_cur = 0U;
+        if (old_res.is_success()) {
+            old_cur = old_res.success().matched();
+        }
+
+        auto tmp_res = m_Parser.apply(r);
+        auto max_furthest = std::max(old_res.furthest(), tmp_res.furthest());
+
+        // Update the furthest value in both entries
+        old_res.m_Furthest = max_furthest;
+        tmp_res.m_Furthest = max_furthest;
+
+        if (tmp_res.is_success()) {
+            auto& tmp_succ = tmp_res.success();
+            if (old_cur < tmp_succ.matched()) {
+                auto& new_old = this->put_memo(
+                    r, tmp_res, max_furthest
                 );
+                return grow(r, new_old, h);
+            }
+            // We need to overwrite max-furthest in the memo-table!
+            // That's why we don't simply return old_res
+
+            auto it = rec_heads.find(r);
+            cppcmb_assert("", it != rec_heads.end());
+            rec_heads.erase(it);
+
+            // auto* val = this->get_memo(r);
+            // cppcmb_assert("", val != nullptr);
+
+            // return this-> template to_result<return_t>(*val);
+            return this->put_memo(r, std::move(old_res), max_furthest);
+        }
+
+        // We need to overwrite max-furthest in the memo-table!
+        // That's why we don't simply return old_res
+
+        auto it = rec_heads.find(r);
+        cppcmb_assert("", it != rec_heads.end());
+        rec_heads.erase(it);
+
+        return this->put_memo(r, std::move(old_res), max_furthest);
+    }
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr irec_packrat_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]]
+    constexpr auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        using return_t = parser_result_t<P, Src>;
+
+        if constexpr (!detail::in_left_cycle<irec_packrat_t>::value) {
+            // Can't be part of a left-recursion, no heads to track
+            auto* entry = this->get_memo(r);
+            if (entry != nullptr) {
+                return this-> template to_result<return_t>(*entry);
+            }
+            auto frame = detail::state_frame_scope(r.context().memo());
+            auto res = m_Parser.apply(r);
+            auto furth = res.furthest();
+            return this->put_memo(
+                r, std::move(res), furth, this->block_of(r)
+            );
+        }
+        else {
+            return apply_lr(r);
+        }
+    }
+
+private:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    constexpr auto apply_lr(reader<Src> const& r) const {
+        using return_t = parser_result_t<P, Src>;
+
+        auto& lr_stack = r.context().call_stack();
+
+        auto m = recall(r);
+        if (!m) {
+            auto base = std::make_shared<left_recursive>(
+                return_t(failure(), 0U), this->original_id()
+            );
+            lr_stack.push_front(base);
+            this->put_memo(r, base, 0U);
+            auto tmp_res = m_Parser.apply(r);
+            lr_stack.pop_front();
+
+            if (!base->head()) {
+                return this->put_memo(r, tmp_res, tmp_res.furthest());
+            }
+            base->seed() = tmp_res;
+            return lr_answer(r, *base);
+        }
+        auto& entry = *m;
+        if (auto* lr = std::any_cast<std::shared_ptr<left_recursive>>(&entry)) {
+            setup_lr(r, **lr);
+            return this-> template to_result<return_t>((*lr)->seed());
+        }
+        return this-> template to_result<return_t>(entry);
+    }
+};
+
+template <typename PFwd>
+irec_packrat_t(PFwd) -> irec_packrat_t<PFwd>;
+
+/**
+ * Wrapper to make any combinator an indirect-left-recursive packrat parser.
+ */
+template <typename PFwd>
+[[nodiscard]] constexpr auto memo_i(PFwd&& p)
+    cppcmb_return(irec_packrat_t(cppcmb_fwd(p)))
+
+struct as_memo_i_t {};
+
+inline constexpr auto as_memo_i = as_memo_i_t();
+
+// Indirect-left-recursive packrat
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+constexpr auto operator%=(P&& parser, as_memo_i_t)
+    cppcmb_return(memo_i(cppcmb_fwd(parser)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+/**
+ * The first elements of a source, so a parser can't look past them. The
+ * positions stay the same as in the whole source.
+ */
+template <typename Src>
+class source_prefix {
+private:
+    Src const*  m_Source;
+    std::size_t m_Size;
+
+public:
+    constexpr source_prefix(Src const& src, std::size_t size) noexcept
+        : m_Source(::std::addressof(src)), m_Size(size) {
+    }
+
+    [[nodiscard]] constexpr decltype(auto) operator[](std::size_t idx)
+        const noexcept {
+        return (*m_Source)[idx];
+    }
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept {
+        return m_Size;
+    }
+
+    // Only for contiguous sources
+    template <typename S = Src>
+    [[nodiscard]] constexpr auto data() const noexcept
+        -> decltype(std::data(std::declval<S const&>())) {
+        return std::data(*m_Source);
+    }
+};
+
+} /* namespace detail */
+
+/**
+ * A handle to a region that hasn't been parsed yet. Copies share the parsed
+ * result. The source has to outlive the handle, just like for any result that
+ * refers to the source. Handles are not thread-safe.
+ */
+template <typename P, typename Src>
+class lazy_handle {
+public:
+    using source_type = detail::source_prefix<Src>;
+    using result_type = parser_result_t<P, source_type>;
+
+private:
+    struct state {
+        std::shared_ptr<P const>    parser;
+        // Kept here, nested handles refer to it
+        source_type                 source;
+        std::size_t                 start;
+        std::size_t                 length;
+        // Only created for the bodies that are parsed
+        std::optional<memo_context> context;
+        std::optional<result_type>  value;
+
+        state(std::shared_ptr<P const> p, Src const& src,
+            std::size_t start, std::size_t len)
+            : parser(std::move(p)), source(src, start + len),
+              start(start), length(len) {
+        }
+    };
+
+    std::shared_ptr<state> m_State;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    lazy_handle(std::shared_ptr<P const> p, Src const& src,
+        std::size_t start, std::size_t len)
+        : m_State(std::make_shared<state>(std::move(p), src, start, len)) {
+    }
+
+    /**
+     * The position of the region in the source.
+     */
+    [[nodiscard]] std::size_t start() const noexcept {
+        return m_State->start;
+    }
+
+    /**
+     * The number of elements the skipper consumed.
+     */
+    [[nodiscard]] std::size_t length() const noexcept {
+        return m_State->length;
+    }
+
+    [[nodiscard]] bool is_parsed() const noexcept {
+        return m_State->value.has_value();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Parses the region, if it hasn't been parsed yet. The parser starts at
+     * the beginning of the region, it's positions are relative to the whole
+     * source. It can't look past the region, and it fails if it doesn't
+     * consume exactly what the skipper did.
+     */
+    [[nodiscard]] result_type const& get() const {
+        auto& st = *m_State;
+        if (!st.value) {
+            auto r = reader(st.source, st.start, st.context.emplace());
+            auto res = st.parser->apply(r);
+            if (res.is_success() && res.success().matched() != st.length) {
+                st.value.emplace(failure(), res.furthest());
+            }
+            else {
+                st.value.emplace(std::move(res));
             }
+            // The body won't be parsed again
+            st.context.reset();
         }
+        return *st.value;
     }
 
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto factor(Src src) noexcept {
-        constexpr auto lhs = atom<Idx>(src);
-        if constexpr (is_failure(lhs)) {
-            return failure();
+    [[nodiscard]] result_type const& operator*() const { return get(); }
+    [[nodiscard]] result_type const* operator->() const { return &get(); }
+};
+
+template <typename P, typename Skip>
+class lazy_t : public combinator<lazy_t<P, Skip>> {
+private:
+    std::shared_ptr<P const> m_Parser;
+    Skip                     m_Skipper;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, typename SkipFwd>
+    lazy_t(PFwd&& p, SkipFwd&& skip)
+        : m_Parser(std::make_shared<P const>(cppcmb_fwd(p))),
+          m_Skipper(cppcmb_fwd(skip)) {
+    }
+
+    [[nodiscard]] P const& underlying() const noexcept {
+        return *m_Parser;
+    }
+
+    cppcmb_getter(skipper, m_Skipper)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const
+        -> result<lazy_handle<P, Src>> {
+        cppcmb_assert_parser(P, Src);
+        cppcmb_assert_parser(Skip, Src);
+
+        using result_t = result<lazy_handle<P, Src>>;
+
+        auto s_inv = m_Skipper.apply(r);
+        if (s_inv.is_failure()) {
+            return result_t(failure(), s_inv.furthest());
         }
-        else {
-            constexpr std::size_t NextIdx = Idx + lhs.matched();
-            constexpr char curr = char_at<NextIdx>(src);
-            if constexpr (curr == '*') {
-                return success(star(lhs.value()), lhs.matched() + 1);
+        auto matched = s_inv.success().matched();
+        return result_t(
+            success(
+                lazy_handle<P, Src>(m_Parser, r.source(), r.cursor(), matched),
+                matched
+            ),
+            s_inv.furthest()
+        );
+    }
+};
+
+template <typename PFwd, typename SkipFwd>
+lazy_t(PFwd, SkipFwd) -> lazy_t<PFwd, SkipFwd>;
+
+/**
+ * Skips a region with skip, and parses it with p only when the result is
+ * accessed.
+ */
+template <typename PFwd, typename SkipFwd>
+[[nodiscard]] auto lazy(PFwd&& p, SkipFwd&& skip)
+    cppcmb_return(lazy_t(cppcmb_fwd(p), cppcmb_fwd(skip)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+namespace detail {
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Compiles a regular combinator with capture group markers.
+ */
+template <typename P>
+[[nodiscard]] capture_automaton compile_captures(P const& p) {
+    static_assert(
+        is_regular<remove_cvref_t<P>>::value,
+        "Only regular combinators can be compiled to an automaton!"
+    );
+    nfa n;
+    auto f = nfa_builder::build(n, p);
+    return capture_automaton(std::move(n), f);
+}
+
+} /* namespace detail */
+
+/**
+ * Matches the longest prefix, like dfa. The result has the whole match at
+ * index 0, and the I-th group at index I. A group that didn't take part in
+ * the match is an empty view with a null data pointer. When a group matched
+ * multiple times (in a repetition), the last one is returned.
+ */
+template <typename P, std::size_t N>
+class capture_t : public combinator<capture_t<P, N>> {
+private:
+    static constexpr std::size_t tags = 2 * (N + 1);
+
+    static_assert(
+        tags <= detail::capture_automaton::max_tags,
+        "Too many capture groups!"
+    );
+
+    P                                               m_Parser;
+    std::shared_ptr<detail::capture_automaton const> m_Automaton;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    explicit capture_t(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)),
+          m_Automaton(std::make_shared<detail::capture_automaton const>(
+              detail::compile_captures(m_Parser)
+          )) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * True, if the pattern is matched in one deterministic pass. Otherwise
+     * the tagged NFA is simulated, which needs some memory for each match.
+     */
+    [[nodiscard]] bool one_pass() const noexcept {
+        return m_Automaton->one_pass();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Captures can only be matched in contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using groups_t = std::array<string_t, N + 1>;
+        using result_t = result<groups_t>;
+
+        auto const* data = std::data(r.source()) + r.cursor();
+        auto const len = std::size(r.source()) - r.cursor();
+        std::size_t furthest = 0;
+        detail::tag_positions<tags> pos;
+        auto matched = m_Automaton->longest_match(data, len, pos, furthest);
+        if (matched < 0) {
+            return result_t(failure(), furthest);
+        }
+
+        auto n = std::size_t(matched);
+        groups_t groups;
+        groups[0] = string_t(data, n);
+        for (std::size_t i = 1; i <= N; ++i) {
+            auto open = pos[2 * i];
+            auto close = pos[2 * i + 1];
+            if (open != detail::npos_tag && close != detail::npos_tag
+                && open <= close) {
+                groups[i] = string_t(data + open, close - open);
             }
-            else if constexpr (curr == '+') {
-                return success(plus(lhs.value()), lhs.matched() + 1);
+        }
+        return result_t(success(std::move(groups), n), furthest);
+    }
+};
+
+/**
+ * Creates a parser from a compile-time RegEx string, that returns the
+ * capture groups. Use cppcmb_str to create the string.
+ */
+template <typename Str>
+[[nodiscard]] auto regex_capture(Str str) {
+    using parser_t = detail::regex::basic_parser<true>;
+
+    constexpr auto res = parser_t::top<0>(str);
+    static_assert(
+        !parser_t::is_failure(res),
+        "Invalid regular-expression!"
+    );
+    constexpr auto n = detail::regex::count_groups(str, str().size());
+    return capture_t<detail::remove_cvref_t<decltype(res.value())>, n>(
+        res.value()
+    );
+}
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * Quote and Escape can be '\0' to disable them. Like in JSON, escapes are
+ * recognized everywhere, an escaped quote never starts or ends a string. The
+ * result is the skipped part of the source, including the delimiters.
+ */
+template <char Open, char Close, char Quote = '\0', char Escape = '\0'>
+class skip_balanced_t
+    : public combinator<skip_balanced_t<Open, Close, Quote, Escape>> {
+private:
+    static_assert(Open != Close, "The delimiters must be different!");
+    static_assert(Open != '\0' && Close != '\0', "Delimiters can't be '\\0'!");
+    static_assert(
+        Escape == '\0' || Quote != '\0',
+        "Escapes are only meaningful inside quotes!"
+    );
+
+    static constexpr auto to_byte(char c) noexcept {
+        return static_cast<unsigned char>(c);
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Balanced regions can only be skipped in contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
+
+        static_assert(
+            sizeof(value_type) == 1,
+            "Balanced regions can only be skipped in byte sources!"
+        );
+
+        auto const* data = std::data(r.source());
+        auto const size = std::size(r.source());
+        auto const start = r.cursor();
+
+        if (start >= size) {
+            return result_t(failure(), 0U);
+        }
+        if (data[start] != value_type(Open)) {
+            return result_t(failure(), 1U);
+        }
+
+        // Start after the opening delimiter
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto const* bytes = reinterpret_cast<unsigned char const*>(data);
+        std::size_t depth = 1;
+        auto escapes = detail::escape_scanner();
+        auto quotes = detail::quote_scanner();
+        for (auto pos = start + 1; pos < size; pos += detail::block_width) {
+            auto block = detail::byte_block(bytes + pos, size - pos);
+
+            auto outside = ~std::uint64_t(0);
+            if constexpr (Quote != '\0') {
+                auto quote = block.eq(to_byte(Quote));
+                if constexpr (Escape != '\0') {
+                    quote &= ~escapes.next(block.eq(to_byte(Escape)));
+                }
+                outside = ~quotes.next(quote);
             }
-            else if constexpr (curr == '?') {
-                return success(qmark(lhs.value()), lhs.matched() + 1);
+            auto opens = block.eq(to_byte(Open)) & outside;
+            auto closes = block.eq(to_byte(Close)) & outside;
+
+            if (detail::bit_count(closes) < depth) {
+                // Can't reach depth 0 in this block
+                depth += detail::bit_count(opens);
+                depth -= detail::bit_count(closes);
+                continue;
             }
-            else {
-                return lhs;
+
+            auto marks = opens | closes;
+            while (marks != 0) {
+                auto bit = detail::bit_ctz(marks);
+                marks &= marks - 1;
+                if ((opens >> bit) & 1U) {
+                    ++depth;
+                }
+                else if (--depth == 0) {
+                    auto matched = pos + bit + 1 - start;
+                    return result_t(
+                        success(string_t(data + start, matched), matched),
+                        matched
+                    );
+                }
             }
         }
+        // Unterminated
+        return result_t(failure(), size - start);
     }
+};
 
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto atom(Src src) noexcept {
-        if constexpr (Idx < src().size()) {
-            constexpr char curr = char_at<Idx>(src);
-            if constexpr (curr == '(') {
-                // Grouping
-                constexpr auto sub = top<Idx + 1>(src);
-                static_assert(!is_failure(sub));
-                constexpr std::size_t NextIdx = Idx + 1 + sub.matched();
-                static_assert(char_at<NextIdx>(src) == ')');
-                return success(sub.value(), sub.matched() + 2);
+template <char Open, char Close, char Quote = '\0', char Escape = '\0'>
+inline constexpr auto skip_balanced =
+    skip_balanced_t<Open, Close, Quote, Escape>();
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+/**
+ * Calls fn(state, value) on the success of p, the value is passed through.
+ * The change is undone, if an enclosing alternative, optional or repetition
+ * fails later. The state is copied for that at most once per open branch.
+ */
+template <typename State, typename P, typename Fn>
+class state_action_t : public combinator<state_action_t<State, P, Fn>> {
+private:
+    P  m_Parser;
+    Fn m_Fn;
+
+public:
+    template <typename PFwd, typename FnFwd>
+    constexpr state_action_t(PFwd&& p, FnFwd&& fn)
+        noexcept(
+            std::is_nothrow_constructible_v<P, PFwd&&>
+         && std::is_nothrow_constructible_v<Fn, FnFwd&&>
+        )
+        : m_Parser(cppcmb_fwd(p)), m_Fn(cppcmb_fwd(fn)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+    cppcmb_getter(function, m_Fn)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        auto res = m_Parser.apply(r);
+        if (res.is_success()) {
+            auto const& val = res.success().value();
+            r.context().template update_state<State>([&](State& st) {
+                m_Fn(st, val);
+            });
+        }
+        return res;
+    }
+};
+
+/**
+ * Succeeds, if p succeeds and pred(state, value) is true.
+ */
+template <typename State, typename P, typename Pred>
+class state_filter_t : public combinator<state_filter_t<State, P, Pred>> {
+private:
+    P    m_Parser;
+    Pred m_Pred;
+
+public:
+    template <typename PFwd, typename PredFwd>
+    constexpr state_filter_t(PFwd&& p, PredFwd&& pred)
+        noexcept(
+            std::is_nothrow_constructible_v<P, PFwd&&>
+         && std::is_nothrow_constructible_v<Pred, PredFwd&&>
+        )
+        : m_Parser(cppcmb_fwd(p)), m_Pred(cppcmb_fwd(pred)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+    cppcmb_getter(predicate, m_Pred)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = parser_result_t<P, Src>;
+
+        auto res = m_Parser.apply(r);
+        if (res.is_failure()) {
+            return res;
+        }
+        auto const& st = r.context().template read_state<State>();
+        if (!m_Pred(st, res.success().value())) {
+            return result_t(failure(), res.furthest());
+        }
+        return res;
+    }
+};
+
+/**
+ * Changes the parse state of type State with fn on the success of p.
+ */
+template <typename State, typename PFwd, typename FnFwd>
+[[nodiscard]] constexpr auto state_action(PFwd&& p, FnFwd&& fn)
+    cppcmb_return(state_action_t<
+        State, detail::remove_cvref_t<PFwd>, detail::remove_cvref_t<FnFwd>
+    >(cppcmb_fwd(p), cppcmb_fwd(fn)))
+
+/**
+ * Filters the successes of p with a predicate on the parse state of type
+ * State.
+ */
+template <typename State, typename PFwd, typename PredFwd>
+[[nodiscard]] constexpr auto state_filter(PFwd&& p, PredFwd&& pred)
+    cppcmb_return(state_filter_t<
+        State, detail::remove_cvref_t<PFwd>, detail::remove_cvref_t<PredFwd>
+    >(cppcmb_fwd(p), cppcmb_fwd(pred)))
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+namespace detail {
+
+/**
+ * Checks if the code point has the property described by the table.
+ */
+template <typename Table>
+[[nodiscard]] constexpr bool has_unicode_property(char32_t cp) noexcept {
+    if (cp < 0x80) {
+        // ASCII fast-path
+        return ((Table::ascii[cp >> 6] >> (cp & 63)) & 1U) != 0;
+    }
+    auto hi = std::size_t(cp >> unicode_block_bits);
+    if (hi >= std::size(Table::stage1)) {
+        return false;
+    }
+    auto const& block = Table::stage2[Table::stage1[hi]];
+    auto lo = cp & ((char32_t(1) << unicode_block_bits) - 1);
+    return ((block[lo >> 6] >> (lo & 63)) & 1U) != 0;
+}
+
+/**
+ * The ASCII part of a property table as ranges of bytes, so the ASCII words
+ * can be tested with a few SWAR range compares, instead of byte by byte.
+ */
+template <typename Table>
+struct ascii_ranges {
+    static constexpr std::size_t capacity = 8;
+
+    unsigned char lo[capacity] = {};
+    unsigned char hi[capacity] = {};
+    std::size_t   count = 0;
+    // False, if the table has more ranges than the capacity
+    bool          fits = true;
+
+    constexpr ascii_ranges() noexcept {
+        for (char32_t cp = 0; cp < 0x80; ++cp) {
+            if (!has_unicode_property<Table>(cp)) {
+                continue;
             }
-            else if constexpr (curr == '[') {
-                // Character classes
-                if constexpr (char_at<Idx + 1>(src) == '^') {
-                    // Negated group
-                    constexpr auto sub = char_grouping<Idx + 2>(src);
-                    static_assert(!is_failure(sub));
-                    constexpr std::size_t NextIdx = Idx + 2 + sub.matched();
-                    static_assert(char_at<NextIdx>(src) == ']');
-                    return success(not_char(sub.value()), sub.matched() + 3);
-                }
-                else {
-                    constexpr auto sub = char_grouping<Idx + 1>(src);
-                    static_assert(!is_failure(sub));
-                    constexpr std::size_t NextIdx = Idx + 1 + sub.matched();
-                    static_assert(char_at<NextIdx>(src) == ']');
-                    return success(sub.value(), sub.matched() + 2);
-                }
+            auto b = static_cast<unsigned char>(cp);
+            if (count > 0 && hi[count - 1] + 1 == b) {
+                hi[count - 1] = b;
+            }
+            else if (count < capacity) {
+                lo[count] = b;
+                hi[count] = b;
+                ++count;
             }
             else {
-                return literal<Idx>(src);
+                fits = false;
             }
         }
-        else {
-            return failure();
+    }
+};
+
+template <typename Table>
+inline constexpr auto ascii_ranges_v = ascii_ranges<Table>();
+
+/**
+ * Returns a word, where the high bit of lane i is set if byte i of the ASCII
+ * word has the property described by the table.
+ */
+template <typename Table>
+[[nodiscard]] constexpr std::uint64_t ascii_property_lanes(std::uint64_t word)
+    noexcept {
+    constexpr auto const& ranges = ascii_ranges_v<Table>;
+
+    std::uint64_t lanes = 0;
+    if constexpr (ranges.fits) {
+        for (std::size_t i = 0; i < ranges.count; ++i) {
+            lanes |= swar_in_range(word, ranges.lo[i], ranges.hi[i]);
+        }
+    }
+    else {
+        for (std::size_t i = 0; i < swar_width; ++i) {
+            auto b = char32_t((word >> (8 * i)) & 0xFF);
+            if (has_unicode_property<Table>(b)) {
+                lanes |= std::uint64_t(0x80) << (8 * i);
+            }
         }
     }
+    return lanes;
+}
+
+/**
+ * The result of decoding a code point.
+ * A length of 0 means that the input was malformed, in that case peeked tells
+ * how many elements had to be looked at to find that out.
+ */
+struct decoded_codepoint {
+    char32_t    value  = 0;
+    std::size_t length = 0;
+    std::size_t peeked = 0;
+};
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename Src>
+[[nodiscard]] constexpr decoded_codepoint
+decode_codepoint(Src const& src, std::size_t idx) {
+    using elem_t = remove_cvref_t<decltype(src[idx])>;
 
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto char_grouping(Src src) noexcept {
-        constexpr auto lhs = group_element<Idx>(src);
-        static_assert(!is_failure(lhs));
-        return char_grouping_impl<Idx + lhs.matched()>(lhs, src);
+    auto const size = std::size(src);
+    if (idx >= size) {
+        return { 0, 0, 0 };
     }
 
-    template <std::size_t Idx, typename Res, typename Src>
-    [[nodiscard]]
-    static constexpr auto char_grouping_impl(Res res, Src src) noexcept {
-        constexpr auto lhs = group_element<Idx>(src);
-        if constexpr (is_failure(lhs)) {
-            return res;
-        }
-        else {
-            return char_grouping_impl<Idx + lhs.matched()>(
-                success(
-                    res.value() | lhs.value(),
-                    res.matched() + lhs.matched()
-                ),
-                src
-            );
+    if constexpr (sizeof(elem_t) == 1) {
+        // UTF-8
+        auto b0 = static_cast<unsigned char>(src[idx]);
+        if (b0 < 0x80) {
+            return { b0, 1, 1 };
         }
-    }
 
-    // XXX(LPeter1997): Clang bug here...
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto group_element(Src src) noexcept {
-        if constexpr (char_at<Idx>(src) == '\\'
-                   && char_at<Idx + 1>(src) == '-') {
-            return success(ch<'-'>, 2);
+        std::size_t len = 0;
+        char32_t cp = 0;
+        char32_t min = 0;
+        if ((b0 & 0xE0) == 0xC0) {
+            len = 2;
+            cp = b0 & 0x1F;
+            min = 0x80;
+        }
+        else if ((b0 & 0xF0) == 0xE0) {
+            len = 3;
+            cp = b0 & 0x0F;
+            min = 0x800;
+        }
+        else if ((b0 & 0xF8) == 0xF0) {
+            len = 4;
+            cp = b0 & 0x07;
+            min = 0x10000;
         }
         else {
-            constexpr auto lit = literal_ch<Idx>(src);
-            if constexpr (is_failure(lit)) {
-                return failure();
+            // Stray continuation or invalid lead byte
+            return { 0, 0, 1 };
+        }
+
+        for (std::size_t i = 1; i < len; ++i) {
+            if (idx + i >= size) {
+                return { 0, 0, i };
             }
-            else {
-                constexpr std::size_t NextIdx = Idx + lit.matched();
-                if constexpr (char_at<NextIdx>(src) == '-') {
-                    constexpr auto lit2 = literal_ch<NextIdx + 1>(src);
-                    if constexpr (is_failure(lit2)) {
-                        // No right-hand-side, only consumed lit
-                        return success(ch<lit.value()>, lit.matched());
-                    }
-                    else {
-                        // Char range
-                        return success(
-                            range<lit.value(), lit2.value()>,
-                            lit.matched() + 1 + lit2.matched()
-                        );
-                    }
-                }
-                else {
-                    return success(ch<lit.value()>, lit.matched());
-                }
+            auto b = static_cast<unsigned char>(src[idx + i]);
+            if ((b & 0xC0) != 0x80) {
+                return { 0, 0, i + 1 };
             }
+            cp = (cp << 6) | (b & 0x3F);
         }
-        // NOLINTNEXTLINE
-    } // NOLINT
 
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto literal(Src src) noexcept {
-        constexpr auto lc = literal_ch<Idx>(src);
-        if constexpr (is_failure(lc)) {
-            return failure();
-        }
-        else {
-            return success(ch<lc.value()>, lc.matched());
+        // Overlong encodings, surrogates and out-of-range values
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return { 0, 0, len };
         }
+        return { cp, len, len };
     }
-
-    template <std::size_t Idx, typename Src>
-    [[nodiscard]] static constexpr auto literal_ch(Src src) noexcept {
-        constexpr char curr = char_at<Idx>(src);
-        if constexpr (curr == '\\') {
-            // Escaped
-            constexpr char nxt = char_at<Idx + 1>(src);
-            static_assert(is_special(nxt));
-            return success(nxt, 2);
+    else if constexpr (sizeof(elem_t) == 2) {
+        // UTF-16
+        auto w0 = char32_t(static_cast<char16_t>(src[idx]));
+        if (w0 < 0xD800 || w0 > 0xDFFF) {
+            return { w0, 1, 1 };
         }
-        else if constexpr (is_special(curr)) {
-            // Special characters
-            return failure();
+        if (w0 > 0xDBFF) {
+            // Unpaired low surrogate
+            return { 0, 0, 1 };
         }
-        else {
-            // Literal match
-            return success(curr, 1);
+        if (idx + 1 >= size) {
+            return { 0, 0, 1 };
         }
+        auto w1 = char32_t(static_cast<char16_t>(src[idx + 1]));
+        if (w1 < 0xDC00 || w1 > 0xDFFF) {
+            return { 0, 0, 2 };
+        }
+        return { 0x10000 + ((w0 - 0xD800) << 10) + (w1 - 0xDC00), 2, 2 };
     }
-};
+    else {
+        // UTF-32
+        auto cp = char32_t(src[idx]);
+        if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return { 0, 0, 1 };
+        }
+        return { cp, 1, 1 };
+    }
+}
 
-} /* namespace regex */
 } /* namespace detail */
 
 /**
- * A way to define compile-time strings.
+ * Matches a single code point that has the property described by Table.
  */
-#define cppcmb_str(str) ([] { return ::std::basic_string_view(str); })
-
-template <typename Str>
-[[nodiscard]] constexpr auto regex(Str str) noexcept {
-    constexpr auto res = detail::regex::parser::top<0>(str);
-    static_assert(
-        !detail::regex::parser::is_failure(res),
-        "Invalid regular-expression!"
-    );
-    return res.value();
-}
+template <typename Table>
+class unicode_class_t : public combinator<unicode_class_t<Table>> {
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<char32_t> {
 
-} /* namespace cppcmb */
+        using result_t = result<char32_t>;
 
-namespace cppcmb {
+        auto cp = detail::decode_codepoint(r.source(), r.cursor());
+        if (cp.length == 0 || !detail::has_unicode_property<Table>(cp.value)) {
+            return result_t(failure(), cp.peeked);
+        }
+        return result_t(success(cp.value, cp.length), cp.length);
+    }
+};
 
-template <typename CharT, typename Tag>
-class token {
-private:
-    std::basic_string_view<CharT> m_Content;
-    Tag                           m_Type;
+// Values for the supported properties
+inline constexpr auto xid_start =
+    unicode_class_t<detail::xid_start_table>();
+inline constexpr auto xid_continue =
+    unicode_class_t<detail::xid_continue_table>();
+inline constexpr auto unicode_letter =
+    unicode_class_t<detail::letter_table>();
+inline constexpr auto unicode_digit =
+    unicode_class_t<detail::digit_table>();
+inline constexpr auto unicode_space =
+    unicode_class_t<detail::space_table>();
 
+/**
+ * Matches a code point from the First class, followed by as many code points
+ * from the Rest class as possible. The result is the matched part of the
+ * source. Runs of ASCII characters are scanned 8 bytes at a time.
+ */
+template <typename First, typename Rest>
+class unicode_word_t : public combinator<unicode_word_t<First, Rest>> {
 public:
-    constexpr token(std::basic_string_view<CharT> cont, Tag ty) noexcept
-        : m_Content(cont), m_Type(ty) {
-    }
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Unicode words can only be matched in contiguous sources!"
+        );
 
-    [[nodiscard]] constexpr auto const& content() const noexcept {
-        return m_Content;
-    }
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
 
-    [[nodiscard]] constexpr auto const& type() const noexcept {
-        return m_Type;
+        auto const& src = r.source();
+        auto const* data = std::data(src);
+        auto const size = std::size(src);
+        auto const start = r.cursor();
+
+        auto first = detail::decode_codepoint(src, start);
+        if (first.length == 0
+        || !detail::has_unicode_property<First>(first.value)) {
+            return result_t(failure(), first.peeked);
+        }
+
+        std::size_t idx = start + first.length;
+        std::size_t peeked = 0;
+        while (true) {
+            if constexpr (sizeof(value_type) == 1) {
+                // Bulk-scan ASCII runs
+                while (idx + detail::swar_width <= size) {
+                    auto word = detail::swar_load(data + idx);
+                    if (!detail::swar_is_ascii(word)) {
+                        break;
+                    }
+                    auto outside =
+                        ~detail::ascii_property_lanes<Rest>(word)
+                        & detail::swar_highs;
+                    if (outside != 0) {
+                        // Found the end of the word
+                        idx += detail::bit_ctz(outside) / 8;
+                        peeked = 1;
+                        break;
+                    }
+                    idx += detail::swar_width;
+                }
+                if (peeked != 0) {
+                    break;
+                }
+            }
+            // Slow-path for non-ASCII and the tail of the input
+            auto cp = detail::decode_codepoint(src, idx);
+            if (cp.length == 0
+            || !detail::has_unicode_property<Rest>(cp.value)) {
+                peeked = cp.peeked;
+                break;
+            }
+            idx += cp.length;
+        }
+
+        auto matched = idx - start;
+        return result_t(
+            success(string_t(data + start, matched), matched),
+            matched + peeked
+        );
     }
 };
 
+// Value for Unicode identifiers (UAX #31 default identifiers)
+inline constexpr auto xid_identifier = unicode_word_t<
+    detail::xid_start_table,
+    detail::xid_continue_table
+>();
+
 } /* namespace cppcmb */
 
 namespace cppcmb {
+namespace detail {
 
-/**
- * Signal that we want to skip these characters instead of making a token out of
- * them.
- */
-struct skip_t {};
+template <typename P>
+struct min_width : std::integral_constant<std::size_t, 0> {};
 
-inline constexpr auto skip = skip_t();
+template <typename P>
+inline constexpr std::size_t min_width_v = min_width<remove_cvref_t<P>>::value;
 
-namespace detail {
+template <>
+struct min_width<one_t> : std::integral_constant<std::size_t, 1> {};
 
-// XXX(LPeter1997): This implementation blocks incremental features
-template <typename P, typename Tag>
-class token_parser : public combinator<token_parser<P, Tag>> {
-private:
-    P m_Parser;
-    Tag m_Tag;
+template <typename Table>
+struct min_width<unicode_class_t<Table>>
+    : std::integral_constant<std::size_t, 1> {};
 
-public:
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename PFwd>
-    constexpr token_parser(PFwd&& p, Tag t)
-        : m_Parser(cppcmb_fwd(p)), m_Tag(t) {
-    }
+template <typename First, typename Rest>
+struct min_width<unicode_word_t<First, Rest>>
+    : std::integral_constant<std::size_t, 1> {};
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<maybe<token<typename reader<Src>::value_type, Tag>>> {
+template <char Open, char Close, char Quote, char Escape>
+struct min_width<skip_balanced_t<Open, Close, Quote, Escape>>
+    : std::integral_constant<std::size_t, 2> {};
 
-        using maybe_t = maybe<token<typename reader<Src>::value_type, Tag>>;
-        using result_t = result<maybe_t>;
+template <typename P1, typename P2>
+struct min_width<seq_t<P1, P2>>
+    : std::integral_constant<std::size_t,
+        min_width_v<P1> + min_width_v<P2>> {};
 
-        auto t = m_Parser.apply(r);
-        if (t.is_success()) {
-            auto src = std::basic_string_view(r.source());
-            std::size_t len = t.success().matched();
-            auto tok = token(src.substr(r.cursor(), len), m_Tag);
+template <typename P1, typename P2>
+struct min_width<alt_t<P1, P2>>
+    : std::integral_constant<std::size_t,
+        std::min(min_width_v<P1>, min_width_v<P2>)> {};
 
-            return result_t(
-                success(maybe_t(some(std::move(tok))), len),
-                t.furthest()
-            );
-        }
-        return result_t(std::move(t).failure(), t.furthest());
-    }
-};
+template <typename P1, typename P2>
+struct min_width<eager_alt_t<P1, P2>>
+    : std::integral_constant<std::size_t,
+        std::min(min_width_v<P1>, min_width_v<P2>)> {};
 
-template <typename P, typename Tag>
-class skip_token_parser : public combinator<skip_token_parser<P, Tag>> {
+// Wrappers that don't change what their parser consumes
+
+template <typename P, typename Fn>
+struct min_width<action_t<P, Fn>> : min_width<P> {};
+
+template <typename P, typename To>
+struct min_width<many1_t<P, To>> : min_width<P> {};
+
+template <typename P>
+struct min_width<ignore_case_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<dfa_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<find_t<P>> : min_width<P> {};
+
+template <typename P, typename Pool>
+struct min_width<hash_cons_t<P, Pool>> : min_width<P> {};
+
+template <typename P, std::size_t N>
+struct min_width<capture_t<P, N>> : min_width<P> {};
+
+template <typename P, typename Table>
+struct min_width<intern_t<P, Table>> : min_width<P> {};
+
+template <typename State, typename P, typename Fn>
+struct min_width<state_action_t<State, P, Fn>> : min_width<P> {};
+
+template <typename State, typename P, typename Pred>
+struct min_width<state_filter_t<State, P, Pred>> : min_width<P> {};
+
+template <typename P>
+struct min_width<packrat_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<auto_packrat_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<drec_packrat_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<irec_packrat_t<P>> : min_width<P> {};
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename P, std::size_t N, std::size_t M>
+class repeat_t : public combinator<repeat_t<P, N, M>> {
 private:
+    static_assert(N <= M, "The minimum repetition can't exceed the maximum!");
+
+    cppcmb_self_check(repeat_t);
+
+    template <typename Src>
+    using element_t = parser_value_t<P, Src>;
+
+    template <typename Src>
+    using value_t = std::conditional_t<N == M,
+        std::array<element_t<Src>, N>,
+        inline_vector<element_t<Src>, M>
+    >;
+
     P m_Parser;
 
-public:
     // XXX(LPeter1997): Noexcept specifier
-    template <typename PFwd>
-    constexpr skip_token_parser(PFwd&& p)
+    template <typename T, std::size_t... Is>
+    [[nodiscard]] static constexpr auto to_array(
+        inline_vector<T, M>& coll, std::index_sequence<Is...>) {
+        return std::array<T, N>{ std::move(coll[Is])... };
+    }
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr repeat_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
         : m_Parser(cppcmb_fwd(p)) {
     }
 
+    cppcmb_getter(underlying, m_Parser)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<maybe<token<typename reader<Src>::value_type, Tag>>> {
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P, Src);
 
-        using maybe_t = maybe<token<typename reader<Src>::value_type, Tag>>;
-        using result_t = result<maybe_t>;
+        using result_t = result<value_t<Src>>;
+
+        if constexpr (N > 0 && detail::min_width_v<P> > 0) {
+            // The input can't possibly hold N elements, don't even try
+            auto rem = std::size(r.source()) - r.cursor();
+            if (rem < N * detail::min_width_v<P>) {
+                return result_t(failure(), rem);
+            }
+        }
+
+        std::size_t furthest = 0U;
+        std::size_t matched = 0U;
+        auto coll = inline_vector<element_t<Src>, M>();
+        auto rr = r;
+        while (!coll.full()) {
+            auto branch = detail::branch_scope(rr);
+            auto p_inv = m_Parser.apply(rr);
+            furthest = std::max(furthest, matched + p_inv.furthest());
+            if (p_inv.is_failure()) {
+                // Stop applying
+                branch.backtrack();
+                break;
+            }
+            auto p_succ = std::move(p_inv).success();
+            matched += p_succ.matched();
+            // Add to collection
+            coll.push_back(std::move(p_succ).value());
+            // Move reader
+            rr.seek(rr.cursor() + p_succ.matched());
+        }
 
-        auto t = m_Parser.apply(r);
-        if (t.is_success()) {
+        if (coll.size() < N) {
+            return result_t(failure(), furthest);
+        }
+        if constexpr (N == M) {
             return result_t(
-                success(maybe_t(none()), t.success().matched()),
-                t.furthest()
+                success(to_array(coll, std::make_index_sequence<N>()), matched),
+                furthest
             );
         }
-        return result_t(std::move(t).failure(), t.furthest());
+        else {
+            return result_t(success(std::move(coll), matched), furthest);
+        }
     }
 };
 
-// XXX(LPeter1997): Noexcept specifier
-template <typename Tag, typename Src, typename TTag>
-[[nodiscard]] constexpr auto str_to_token_parser(Src src, TTag t) {
-    ((void)t); // Unused warning
-    auto p = ::cppcmb::regex(src);
-    using parser_type = decltype(p);
-    if constexpr (std::is_same_v<TTag, skip_t>) {
-        // We want to skip this
-        return skip_token_parser<parser_type, Tag>(std::move(p));
-    }
-    else {
-        // Keep it
-        static_assert(std::is_same_v<Tag, TTag>);
-        return token_parser<parser_type, Tag>(std::move(p), t);
-    }
-}
+/**
+ * Creates a parser that applies p exactly N times.
+ */
+template <std::size_t N, typename PFwd>
+[[nodiscard]] constexpr auto repeat(PFwd&& p)
+    cppcmb_return(repeat_t<detail::remove_cvref_t<PFwd>, N, N>(cppcmb_fwd(p)))
 
 /**
- * Trait to find the first not skip-type in the type-list.
+ * Creates a parser that applies p at least N and at most M times.
  */
-template <typename...>
-struct first_not_skip;
+template <std::size_t N, std::size_t M, typename PFwd>
+[[nodiscard]] constexpr auto repeat(PFwd&& p)
+    cppcmb_return(repeat_t<detail::remove_cvref_t<PFwd>, N, M>(cppcmb_fwd(p)))
 
-// If there is none, we signal failure with defining skip_t
-template <>
-struct first_not_skip<> {
-    using type = skip_t;
-};
+namespace detail {
 
-template <typename Head, typename... Tail>
-struct first_not_skip<Head, Tail...> {
-    using type = std::conditional_t<
-        std::is_same_v<Head, skip_t>,
-        typename first_not_skip<Tail...>::type,
-        Head
-    >;
-};
+template <typename P, std::size_t N, std::size_t M>
+struct min_width<repeat_t<P, N, M>>
+    : std::integral_constant<std::size_t, N * min_width_v<P>> {};
 
-template <typename... Ts>
-using first_not_skip_t = typename first_not_skip<Ts...>::type;
+} /* namespace detail */
 
-// XXX(LPeter1997): Noexcept specifier
-template <typename... Rs>
-[[nodiscard]] constexpr auto make_lexer_parser(Rs&&... rules) {
-    using token_type = first_not_skip_t<
-        typename remove_cvref_t<Rs>::tag_type...
-    >;
-    // XXX(LPeter1997): Or we could just allow it
-    static_assert(
-        !std::is_same_v<token_type, skip_t>,
-        "There must be at least one token rule that doesn't skip!"
-    );
-    // XXX(LPeter1997): We could do a check if the tokenizer succeeds for an
-    // empty string. If it does, tell the user it's a BAD idea.
-    return (... | str_to_token_parser<token_type>(
-        cppcmb_fwd(rules).source(),
-        cppcmb_fwd(rules).tag()
-    ));
-}
+} /* namespace cppcmb */
 
-} /* namespace detail */
+namespace cppcmb {
 
-template <typename Lexer, typename Src>
-class token_iterator {
-public:
-    using token_type        = detail::remove_cvref_t<decltype(
-        std::declval<Lexer const&>()
-            .rule()
-            .apply(std::declval<reader<Src> const&>())
-            .success()
-            .value()
-            .some()
-            .value()
-            .type()
-    )>;
-    using value_type        =
-        result<token<typename reader<Src>::value_type, token_type>>;
-    using difference_type   = std::ptrdiff_t;
-    using pointer           = value_type const*;
-    using reference         = value_type const&;
-    using iterator_category = std::forward_iterator_tag;
+namespace detail {
 
-private:
-    Lexer const*              m_Lexer;
-    reader<Src>               m_Reader;
-    std::optional<value_type> m_Last;
+// XXX(LPeter1997): Can this be constexpr?
+/**
+ * This is where all the rules are stored internally.
+ * They allow us to do a nice assignment-syntax.
+ */
+template <typename>
+inline /* constexpr */ auto rule_set = 0;
 
-public:
-    constexpr token_iterator() noexcept
-        : m_Lexer(nullptr), m_Reader(), m_Last(std::nullopt) {
-    }
+template <typename, typename U>
+struct second {
+    using type = U;
+};
 
-    // XXX(LPeter1997): Noexcept specifier
-    constexpr token_iterator(Lexer const& l, Src const& src)
-        : m_Lexer(::std::addressof(l)), m_Reader(src) {
-        find_token();
-    }
+} /* namespace detail */
 
-    template <typename Src2>
-    [[nodiscard]]
-    constexpr bool
-    operator==(token_iterator<Lexer, Src2> const& o) const noexcept {
-        // A null-source in the reader indicates the end
-        if (m_Reader.source_ptr() == nullptr) {
-            if (o.m_Reader.source_ptr() == nullptr) {
-                return true;
-            }
-            if (o.m_Reader.is_end()) {
-                return true;
-            }
-        }
-        if (o.m_Reader.source_ptr() == nullptr) {
-            if (m_Reader.is_end()) {
-                return true;
-            }
-        }
-        // Both readers have sources
-        return m_Reader.source_ptr() == o.m_Reader.source_ptr()
-            && m_Reader.cursor()     == o.m_Reader.cursor();
-    }
+template <typename Val, typename Tag>
+class rule_t : public combinator<rule_t<Val, Tag>> {
+public:
+    using tag_type = Tag;
 
-    template <typename Src2>
-    [[nodiscard]]
-    constexpr bool
-    operator!=(token_iterator<Lexer, Src2> const& o) const noexcept {
-        return !operator==(o);
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<Val> {
+        return cppcmb_parse_rule(*this, r);
     }
+};
 
-    [[nodiscard]] constexpr reference operator*() const noexcept {
-        cppcmb_assert(
-            "A value must be present for de-referencing!",
-            m_Last.has_value()
-        );
-        return *m_Last;
-    }
+/**
+ * Used to declare rules.
+ */
+#define cppcmb_decl(name, ...) \
+auto const name =              \
+::cppcmb::rule_t<__VA_ARGS__, struct cppcmb_unique_id(cppcmb_rule_tag)>()
 
-    [[nodiscard]] constexpr pointer operator->() const noexcept {
-        return ::std::addressof(operator*());
-    }
+// XXX(LPeter1997): The use of the inline variable like this is IFNDR...
+// We need an alternative solution!
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Used to define rules.
+ * Generates the function that does the indirect-call.
+ */
+#define cppcmb_def(name)                                            \
+template <typename Src>                                             \
+[[nodiscard]] constexpr auto                                        \
+cppcmb_parse_rule(decltype(name), ::cppcmb::reader<Src> const& r) { \
+    using tag_type = typename decltype(name)::tag_type;             \
+    auto const& p = ::cppcmb::detail::rule_set<                     \
+        typename ::cppcmb::detail::second<Src, tag_type>::type      \
+    >;                                                              \
+    return p.apply(r);                                              \
+}                                                                   \
+template <>                                                         \
+inline /* constexpr */ auto                                         \
+::cppcmb::detail::rule_set<typename decltype(name)::tag_type>
 
-    // XXX(LPeter1997): Noexcept specifier
-    // NOLINTNEXTLINE(cert-dcl21-cpp)
-    constexpr token_iterator& operator++() & {
-        cppcmb_assert(
-            "A token iterator without a source can't be incremented!",
-            m_Reader.source_ptr() != nullptr
-        );
-        cppcmb_assert(
-            "A token iterator at the end can't be incremented!",
-            !m_Reader.is_end()
-        );
-        cppcmb_assert(
-            "Precondition of increment is dereferenceable!",
-            m_Last.has_value()
-        );
-        auto const& last = *m_Last;
-        if (last.is_success()) {
-            // For success we skip the entire thing
-            m_Reader.seek(m_Reader.cursor() + last.success().matched());
-        }
-        else {
-            // XXX(LPeter1997): Is this the best strategy?
-            // For failures we skip a single character
-            m_Reader.seek(m_Reader.cursor() + 1);
-        }
-        find_token();
-        return *this;
-    }
+} /* namespace cppcmb */
 
-    // XXX(LPeter1997): Noexcept specifier
-    // NOLINTNEXTLINE(cert-dcl21-cpp)
-    constexpr token_iterator operator++(int) & {
-        auto cpy = *this;
-        operator++();
-        return cpy;
-    }
+namespace cppcmb {
+namespace detail {
 
-private:
-    // XXX(LPeter1997): Noexcept specifier
-    constexpr void find_token() {
-        while (true) {
-            if (m_Reader.is_end()) {
-                return;
-            }
-            auto res = m_Lexer->rule().apply(m_Reader);
-            if (res.is_success()) {
-                auto succ = std::move(res).success();
-                if (succ.value().is_some()) {
-                    // Token, store it
-                    m_Last = value_type(
-                        success(
-                            std::move(succ).value().some().value(),
-                            succ.matched()
-                        ),
-                        res.furthest()
-                    );
-                    return;
-                }
-                // Skip
-                m_Reader.seek(m_Reader.cursor() + succ.matched());
-            }
-            else {
-                // Error, store it
-                m_Last = value_type(std::move(res).failure(), res.furthest());
-                return;
-            }
-        }
-    }
-};
+template <typename... Ts>
+struct type_list {};
 
-template <typename Src, typename Tag>
-class token_rule {
-private:
-    Src m_Src;
-    Tag m_Tag;
+template <typename L1, typename L2>
+struct concat_lists;
 
-public:
-    using tag_type = Tag;
+template <typename... Ts, typename... Us>
+struct concat_lists<type_list<Ts...>, type_list<Us...>> {
+    using type = type_list<Ts..., Us...>;
+};
 
-    // XXX(LPeter1997): Noexcept specifier
-    constexpr token_rule(Src src, Tag t)
-        : m_Src(src), m_Tag(t) {
-    }
+template <typename L1, typename L2>
+using concat_lists_t = typename concat_lists<L1, L2>::type;
 
-    // XXX(LPeter1997): Possibly don't need
-    cppcmb_getter(source, m_Src)
-    cppcmb_getter(tag, m_Tag)
+/**
+ * What a combinator calls at the position it's applied at: the tags of the
+ * rules and if it might call the target itself. Unknown combinators are
+ * assumed to call the target, so the analysis stays conservative.
+ */
+template <typename Rules, bool Cyclic>
+struct left_info {
+    using rules = Rules;
+    static constexpr bool cyclic = Cyclic;
 };
 
-#define cppcmb_token(rx, ...) ::cppcmb::token_rule(cppcmb_str(rx), __VA_ARGS__)
+using left_leaf = left_info<type_list<>, false>;
+using left_cycle = left_info<type_list<>, true>;
 
-template <typename MainRule>
-class lexer {
-private:
-    MainRule m_Rule;
+template <typename Target, typename P>
+struct left_calls : left_cycle {};
 
-public:
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename... Rs>
-    constexpr lexer(Rs&&... rules)
-        : m_Rule(detail::make_lexer_parser(cppcmb_fwd(rules)...)) {
-    }
+template <typename Target, typename P>
+using left_calls_t = std::conditional_t<
+    std::is_same_v<Target, remove_cvref_t<P>>,
+    left_cycle,
+    left_calls<Target, remove_cvref_t<P>>
+>;
 
-    [[nodiscard]] constexpr auto const& rule() const noexcept { return m_Rule; }
+template <typename I1, typename I2>
+using merge_left_t = left_info<
+    concat_lists_t<typename I1::rules, typename I2::rules>,
+    I1::cyclic || I2::cyclic
+>;
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto begin(Src const& src) const {
-        return token_iterator<lexer, Src>(*this, src);
-    }
+// Rules are resolved lazily, the first call tells the tag
 
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] constexpr auto end() const {
-        // The kind of std::basic_string_view doesn't matter
-        return token_iterator<lexer, std::string_view>();
-    }
-};
+template <typename Target, typename Val, typename Tag>
+struct left_calls<Target, rule_t<Val, Tag>>
+    : left_info<type_list<Tag>, false> {};
 
-template <typename... Rs>
-lexer(Rs&&...)
-    -> lexer<decltype(detail::make_lexer_parser(std::declval<Rs&&>()...))>;
+// Combinators that call nothing at their position
 
-} /* namespace cppcmb */
+template <typename Target>
+struct left_calls<Target, one_t> : left_leaf {};
 
-// XXX(LPeter1997): Move operations from the parsers to here
-// The structures should be aware of their usage, they shouldn't be just
-// wrappers around STL containers...
+template <typename Target>
+struct left_calls<Target, end_t> : left_leaf {};
 
-namespace cppcmb {
+template <typename Target>
+struct left_calls<Target, epsilon_t> : left_leaf {};
 
-namespace detail {
+template <typename Target, typename P>
+struct left_calls<Target, dfa_t<P>> : left_leaf {};
 
-// XXX(LPeter1997): Noexcept specifier
-/**
- * Functionality for hashing a pair. Straight from Boost.
- */
-template <typename T>
-constexpr void hash_combine(std::size_t& seed, T const& v) {
-    // NOLINTNEXTLINE
-    seed ^= std::hash<T>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-}
+template <typename Target, typename P>
+struct left_calls<Target, find_t<P>> : left_leaf {};
 
-struct pair_hasher {
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename T1, typename T2>
-    constexpr auto operator()(std::pair<T1, T2> const& p) const {
-        std::size_t seed = 0;
-        hash_combine(seed, p.first);
-        hash_combine(seed, p.second);
-        return seed;
-    }
-};
+template <typename Target, typename P, std::size_t N>
+struct left_calls<Target, capture_t<P, N>> : left_leaf {};
 
-/**
- * Memorization table for packrat parsers.
- */
-class memo_table {
-private:
-    // pair<parser identifier, position>
-    using key_type = std::pair<std::uintptr_t, std::size_t>;
-    // pair<result, furthest>
-    using value_type = std::pair<std::any, std::size_t>;
+template <typename Target, typename CharT>
+struct left_calls<Target, ilit_t<CharT>> : left_leaf {};
 
-    std::unordered_map<key_type, value_type, pair_hasher> m_Cache;
+template <typename Target, typename CharT, std::size_t N>
+struct left_calls<Target, ikeyword_set_t<CharT, N>> : left_leaf {};
 
-public:
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]]
-    /* constexpr */ std::any* get(std::uintptr_t pid, std::size_t pos) {
-        auto it = m_Cache.find({ pid, pos });
-        if (it == m_Cache.end()) {
-            return nullptr;
-        }
-        return &it->second.first;
-    }
+template <typename Target, typename Table>
+struct left_calls<Target, unicode_class_t<Table>> : left_leaf {};
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]]
-    constexpr std::any* get(std::uintptr_t pid, reader<Src> const& r) {
-        return get(pid, r.cursor());
-    }
+template <typename Target, typename First, typename Rest>
+struct left_calls<Target, unicode_word_t<First, Rest>> : left_leaf {};
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename TFwd>
-    constexpr auto& put(std::uintptr_t pid, std::size_t pos,
-        TFwd&& val, std::size_t furth) {
+template <typename Target, char Open, char Close, char Quote, char Escape>
+struct left_calls<Target, skip_balanced_t<Open, Close, Quote, Escape>>
+    : left_leaf {};
 
-        using raw_type = remove_cvref_t<TFwd>;
-        auto id = std::pair(pid, pos);
-        auto& a = (m_Cache[id] = std::pair(cppcmb_fwd(val), furth));
-        return std::any_cast<raw_type&>(a.first);
-    }
+// Composite combinators
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src, typename TFwd>
-    constexpr auto& put(std::uintptr_t pid, reader<Src> const& r,
-        TFwd&& val, std::size_t furth) {
+template <typename Target, typename P1, typename P2>
+struct left_calls<Target, seq_t<P1, P2>> : merge_left_t<
+    left_calls_t<Target, P1>,
+    std::conditional_t<
+        min_width_v<P1> == 0, left_calls_t<Target, P2>, left_leaf
+    >
+> {};
 
-        return put(pid, r.cursor(), cppcmb_fwd(val), furth);
-    }
+template <typename Target, typename P1, typename P2>
+struct left_calls<Target, alt_t<P1, P2>>
+    : merge_left_t<left_calls_t<Target, P1>, left_calls_t<Target, P2>> {};
 
-    // XXX(LPeter1997): Noexcept specifier
-    /* constexpr */ void clear() {
-        m_Cache.clear();
-    }
+template <typename Target, typename P1, typename P2>
+struct left_calls<Target, eager_alt_t<P1, P2>>
+    : merge_left_t<left_calls_t<Target, P1>, left_calls_t<Target, P2>> {};
 
-    // XXX(LPeter1997): Noexcept specifier
-    void invalidate(std::size_t start, std::size_t rem, std::size_t ins) {
-        // start: Position of the source we are manipulating
-        // rem: Removed length
-        // ins: Inserted length
+// Wrappers that call their parser at their own position
 
-        auto end = start + rem;
+template <typename Target, typename P, typename Fn>
+struct left_calls<Target, action_t<P, Fn>> : left_calls_t<Target, P> {};
 
-        // XXX(LPeter1997): Going through every entry is not very effective
-        // we would need some helper structure to search by interval
+template <typename Target, typename P>
+struct left_calls<Target, opt_t<P>> : left_calls_t<Target, P> {};
 
-        for (auto it = m_Cache.begin(); it != m_Cache.end();) {
-            auto r_from = it->first.second;
-            // XXX(LPeter1997): Solve this
-            // Maybe redundantly store it
-            auto r_furthest = it->second.second;
-            auto r_to = r_from + r_furthest;
-
-            // [f_from; r_to) is the entry's interval
-            // Need to check overlap with [start; end)
-            // If they overlap, remove entry
-
-            // XXX(LPeter1997): Allow equality?
-            if (start > r_to || r_from > end) {
-                // No overlap
-                ++it;
-            }
-            else {
-                // Overlapping
-                it = m_Cache.erase(it);
-            }
-        }
+template <typename Target, typename P, typename To>
+struct left_calls<Target, many_t<P, To>> : left_calls_t<Target, P> {};
 
-        // XXX(LPeter1997): THIS IS HORRIBLE FOR PERFORMANCE
-        // WE ARE REMOVING THEN PUTTING BACK EVERY ENTRY THAT IS AFTER THE
-        // EDIT
-        // XXX(LPeter1997): This is a very ineffective implementation right
-        // now. It's just to test the algorithm itself
-        std::intptr_t diff = std::intptr_t(ins) - std::intptr_t(rem);
-        // Collect and erase entries that need to be shifted
-        std::vector<std::pair<key_type, value_type>> to_shift;
-        for (auto it = m_Cache.begin(); it != m_Cache.end();) {
-            auto r_from = it->first.second;
-            if (r_from >= start) {
-                to_shift.push_back({
-                    { it->first.first, it->first.second },
-                    std::move(it->second)
-                });
-                it = m_Cache.erase(it);
-            }
-            else {
-                ++it;
-            }
-        }
-        // Re-insert the entries
-        for (auto& [k, v] : to_shift) {
-            auto& [p_id, pos] = k;
-            m_Cache.insert({ { p_id, pos + diff }, std::move(v) });
-        }
-        // END OF UNGODLY INEFFICIENT CODE
-    }
-};
+template <typename Target, typename P, typename To>
+struct left_calls<Target, many1_t<P, To>> : left_calls_t<Target, P> {};
 
-class irec_head {
-private:
-    std::uintptr_t                     m_HeadID;
-    std::unordered_set<std::uintptr_t> m_InvolvedIDSet;
-    std::unordered_set<std::uintptr_t> m_EvalIDSet;
+template <typename Target, typename P, std::size_t N, std::size_t M>
+struct left_calls<Target, repeat_t<P, N, M>> : left_calls_t<Target, P> {};
 
-public:
-    // XXX(LPeter1997): Noexcept specifier
-    explicit /* constexpr */ irec_head(std::uintptr_t hid)
-        : m_HeadID(hid) {
-    }
+template <typename Target, typename P>
+struct left_calls<Target, ignore_case_t<P>> : left_calls_t<Target, P> {};
 
-    [[nodiscard]] constexpr std::uintptr_t head_id() const noexcept {
-        return m_HeadID;
-    }
+template <typename Target, typename P, typename Table>
+struct left_calls<Target, intern_t<P, Table>> : left_calls_t<Target, P> {};
 
-    cppcmb_getter(involved_set, m_InvolvedIDSet)
-    cppcmb_getter(eval_set, m_EvalIDSet)
-};
+template <typename Target, typename P, typename Pool>
+struct left_calls<Target, hash_cons_t<P, Pool>> : left_calls_t<Target, P> {};
 
-class irec_left_recursive {
-private:
-    std::any                 m_Seed;
-    std::uintptr_t           m_ParserID;
-    std::optional<irec_head> m_Head;
+template <typename Target, typename State, typename P, typename Fn>
+struct left_calls<Target, state_action_t<State, P, Fn>>
+    : left_calls_t<Target, P> {};
 
-public:
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename TFwd>
-    constexpr irec_left_recursive(TFwd&& seed, std::uintptr_t pid)
-        : m_Seed(cppcmb_fwd(seed)), m_ParserID(pid) {
-    }
+template <typename Target, typename State, typename P, typename Pred>
+struct left_calls<Target, state_filter_t<State, P, Pred>>
+    : left_calls_t<Target, P> {};
 
-    cppcmb_getter(seed, m_Seed)
-    cppcmb_getter(head, m_Head)
+template <typename Target, typename P>
+struct left_calls<Target, packrat_t<P>> : left_calls_t<Target, P> {};
 
-    [[nodiscard]] constexpr std::uintptr_t parser_id() const noexcept {
-        return m_ParserID;
+template <typename Target, typename P>
+struct left_calls<Target, auto_packrat_t<P>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, drec_packrat_t<P>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, irec_packrat_t<P>> : left_calls_t<Target, P> {};
+
+/**
+ * The combinator a rule is defined as.
+ */
+template <typename Tag>
+using rule_body_t = remove_cvref_t<decltype(rule_set<Tag>)>;
+
+/**
+ * Visits every rule reachable through left calls once, a worklist instead of
+ * recursion keeps cyclic rule graphs finite.
+ */
+template <typename Target, typename Seen, typename Todo>
+struct left_closure;
+
+template <typename Target, typename Seen, typename Info, typename Todo>
+struct left_expand : std::conditional_t<
+    Info::cyclic,
+    std::true_type,
+    left_closure<Target, Seen, concat_lists_t<Todo, typename Info::rules>>
+> {};
+
+template <typename Target, typename... Seen>
+struct left_closure<Target, type_list<Seen...>, type_list<>>
+    : std::false_type {};
+
+template <typename Target, typename... Seen, typename Tag, typename... Todo>
+struct left_closure<Target, type_list<Seen...>, type_list<Tag, Todo...>>
+    : std::conditional_t<
+        (std::is_same_v<Tag, Seen> || ...),
+        left_closure<Target, type_list<Seen...>, type_list<Todo...>>,
+        left_expand<
+            Target, type_list<Seen..., Tag>,
+            left_calls_t<Target, rule_body_t<Tag>>, type_list<Todo...>
+        >
+    > {};
+
+/**
+ * True, if P might call itself at the same position, through any number of
+ * rules. Rules that aren't defined yet count as cyclic.
+ */
+template <typename P>
+struct in_left_cycle : left_expand<
+    P, type_list<>, left_calls<P, P>, type_list<>
+> {};
+
+template <typename P>
+inline constexpr bool in_left_cycle_v =
+    in_left_cycle<remove_cvref_t<P>>::value;
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+template <typename T>
+struct todo_t  {
+    template <typename... Ts>
+    [[nodiscard]] constexpr T operator()(Ts&&...) const noexcept {
+        cppcmb_panic("Unimplemented feature! (TODO used)");
+        return *(T*)nullptr;
     }
 };
 
+// Value template
+template <typename T>
+inline constexpr auto todo = todo_t<T>();
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
+// XXX(LPeter1997): Maybe it's better to explicitly implement the parser for
+// better error messages?
+
+template <typename T>
+inline constexpr auto todo_parser = epsilon[todo<T>];
+
+} /* namespace cppcmb */
+
+namespace cppcmb {
+
 /**
- * A type to track call-heads.
+ * Iterates over the matches, from left to right. Each match is the longest
+ * one that starts at the leftmost possible position after the previous one.
+ * After an empty match the search continues one character later.
  */
-class call_head_table {
+template <typename CharT>
+class match_iterator {
+public:
+    using value_type        = std::basic_string_view<CharT>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = value_type const*;
+    using reference         = value_type const&;
+    using iterator_category = std::forward_iterator_tag;
+
 private:
-    std::unordered_map<std::size_t, irec_head*> m_Heads;
+    detail::dfa_searcher const* m_Searcher = nullptr;
+    CharT const*                m_Data = nullptr;
+    std::size_t                 m_Size = 0;
+    value_type                  m_Match;
 
-public:
     // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]]
-    /* constexpr */ irec_head* get(std::size_t n) const {
-        auto it = m_Heads.find(n);
-        if (it == m_Heads.end()) {
-            return nullptr;
+    void find_from(std::size_t from) {
+        std::size_t furthest = 0;
+        auto m = from > m_Size
+            ? detail::match_span()
+            : m_Searcher->search(m_Data, m_Size, from, furthest);
+        if (m.begin == detail::prefilter::npos) {
+            m_Searcher = nullptr;
+            m_Match = value_type();
+        }
+        else {
+            m_Match = value_type(m_Data + m.begin, m.length);
         }
-        return it->second;
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]]
-    /* constexpr */ irec_head* get(reader<Src> const& r) const {
-        return get(r.cursor());
-    }
+public:
+    match_iterator() = default;
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    constexpr decltype(auto) operator[](reader<Src> const& r) {
-        return m_Heads[r.cursor()];
+    match_iterator(detail::dfa_searcher const& searcher,
+        CharT const* data, std::size_t size)
+        : m_Searcher(&searcher), m_Data(data), m_Size(size) {
+        find_from(0);
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto find(reader<Src> const& r) {
-        return m_Heads.find(r.cursor());
+    [[nodiscard]] reference operator*() const noexcept {
+        return m_Match;
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto find(reader<Src> const& r) const {
-        return m_Heads.find(r.cursor());
+    [[nodiscard]] pointer operator->() const noexcept {
+        return &m_Match;
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto begin() { return m_Heads.begin(); }
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto begin() const { return m_Heads.begin(); }
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto end() { return m_Heads.end(); }
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto end() const { return m_Heads.end(); }
+    /**
+     * The offset of the current match in the source.
+     */
+    [[nodiscard]] std::size_t position() const noexcept {
+        return std::size_t(m_Match.data() - m_Data);
+    }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename It>
-    constexpr void erase(It it) {
-        m_Heads.erase(it);
+    match_iterator& operator++() {
+        auto end = position() + m_Match.size();
+        find_from(m_Match.empty() ? end + 1 : end);
+        return *this;
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    void clear() {
-        m_Heads.clear();
+    match_iterator operator++(int) {
+        auto tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    [[nodiscard]] friend bool operator==(match_iterator const& l,
+        match_iterator const& r) noexcept {
+        if (l.m_Searcher == nullptr || r.m_Searcher == nullptr) {
+            return l.m_Searcher == r.m_Searcher;
+        }
+        return l.m_Match.data() == r.m_Match.data()
+            && l.m_Match.size() == r.m_Match.size();
+    }
+
+    [[nodiscard]] friend bool operator!=(match_iterator const& l,
+        match_iterator const& r) noexcept {
+        return !(l == r);
     }
 };
 
-class call_stack {
+/**
+ * The matches of a search. The source isn't copied, it has to outlive the
+ * range.
+ */
+template <typename CharT>
+class match_range {
 private:
-    std::deque<std::shared_ptr<irec_left_recursive>> m_Stack;
+    std::shared_ptr<detail::dfa_searcher const> m_Searcher;
+    CharT const*                                m_Data;
+    std::size_t                                 m_Size;
 
 public:
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename TFwd>
-    constexpr void push_front(TFwd&& val) {
-        m_Stack.push_front(val);
+    match_range(std::shared_ptr<detail::dfa_searcher const> searcher,
+        CharT const* data, std::size_t size) noexcept
+        : m_Searcher(std::move(searcher)), m_Data(data), m_Size(size) {
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    /* constexpr */ void pop_front() {
-        m_Stack.pop_front();
+    [[nodiscard]] match_iterator<CharT> begin() const {
+        return match_iterator<CharT>(*m_Searcher, m_Data, m_Size);
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto begin() { return m_Stack.begin(); }
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto begin() const { return m_Stack.begin(); }
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto end() { return m_Stack.end(); }
-    // XXX(LPeter1997): Noexcept specifier
-    [[nodiscard]] /* constexpr */ auto end() const { return m_Stack.end(); }
-
-    // XXX(LPeter1997): Noexcept specifier
-    void clear() {
-        m_Stack.clear();
+    [[nodiscard]] match_iterator<CharT> end() const noexcept {
+        return match_iterator<CharT>();
     }
 };
 
-// XXX(LPeter1997): These are not really helper structures and don't belong to
-// the memo context.
-// Furthermore, they should belong to a structure instead.
-
-template <typename Coll, typename Val, typename It>
-constexpr bool contains(Coll const& coll, Val const& v, It& it) {
-    it = coll.find(v);
-    return it != coll.end();
-}
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * All the matches of a regular combinator (like the ones created by regex) in
+ * the source.
+ */
+template <typename Src, typename P>
+[[nodiscard]] auto regex_search(Src const& src, P const& pattern) {
+    static_assert(
+        detail::is_contiguous_source_v<Src>,
+        "Searching only works in contiguous sources!"
+    );
+    using char_t = detail::remove_cvref_t<decltype(*std::data(src))>;
 
-template <typename Coll, typename Val>
-constexpr bool contains(Coll const& coll, Val const& v) {
-    auto it = coll.end();
-    return contains(coll, v, it);
+    return match_range<char_t>(
+        std::make_shared<detail::dfa_searcher const>(
+            detail::compile_searcher(pattern)
+        ),
+        std::data(src), std::size(src)
+    );
 }
 
-} /* namespace detail */
+} /* namespace cppcmb */
 
-// XXX(LPeter1997): Probably don't need a full getter with all qualifiers
-// Only need a mutable-lvalue getter for all 3 helpers
-class memo_context {
-private:
-    detail::memo_table      m_MemoTable;
-    detail::call_head_table m_RecursionHeads;
-    detail::call_stack      m_LrStack;
+namespace cppcmb {
 
+/**
+ * Works with lexers that can start in the middle of a source, like
+ * modal_lexer. Lexing errors are left out of the stream. The lexer is
+ * referenced, it has to outlive the stream.
+ */
+template <typename Lexer, typename CharT = char>
+class token_stream {
 public:
-    cppcmb_getter(memo, m_MemoTable)
-    cppcmb_getter(call_heads, m_RecursionHeads)
-    cppcmb_getter(call_stack, m_LrStack)
+    using string_type = std::basic_string_view<CharT>;
+    using tag_type    = typename Lexer::token_type;
+    using token_type  = token<CharT, tag_type>;
 
-    // XXX(LPeter1997): Noexcept specifier
-    void clear() {
-        m_MemoTable.clear();
-        m_RecursionHeads.clear();
-        m_LrStack.clear();
-    }
-};
+    /**
+     * The tokens of the stream, with their contents in the current source.
+     * They are made on access, so a relex doesn't have to touch them.
+     */
+    class tokens_view {
+    private:
+        token_stream const* m_Stream;
 
-} /* namespace cppcmb */
+    public:
+        explicit tokens_view(token_stream const& s) noexcept
+            : m_Stream(::std::addressof(s)) {
+        }
 
-namespace cppcmb {
+        [[nodiscard]] token_type operator[](std::size_t i) const noexcept {
+            auto t = m_Stream->at(i);
+            return token_type(
+                m_Stream->m_Source.substr(t.offset, t.length), t.type
+            );
+        }
 
-template <typename P>
-class parser {
-private:
-    cppcmb_self_check(parser);
+        [[nodiscard]] std::size_t size() const noexcept {
+            return m_Stream->size();
+        }
+    };
 
-    P            m_Parser;
-    memo_context m_Context;
+private:
+    struct token_info {
+        std::size_t offset;
+        std::size_t length;
+        // The furthest offset looked at up to and including this token
+        std::size_t reach;
+        // The index of the mode stack after this token
+        std::size_t modes;
+        tag_type    type;
+    };
+
+    Lexer const*                                       m_Lexer;
+    string_type                                        m_Source;
+    // The tokens are kept in a gap buffer, with the gap at the last edit.
+    // The ones after the gap store their offset and reach from the end of
+    // the source, so they stay valid, when the source before them changes
+    std::vector<token_info>                            m_Info;
+    std::size_t                                        m_GapBegin = 0;
+    std::size_t                                        m_GapEnd = 0;
+    std::vector<std::vector<std::size_t>>              m_ModeStacks;
+    std::map<std::vector<std::size_t>, std::size_t>    m_ModeIds;
 
-public:
     // XXX(LPeter1997): Noexcept specifier
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr parser(PFwd&& p)
-        : m_Parser(cppcmb_fwd(p)) {
+    std::size_t intern_modes(std::vector<std::size_t> const& modes) {
+        auto [it, inserted] = m_ModeIds.try_emplace(modes, m_ModeStacks.size());
+        if (inserted) {
+            m_ModeStacks.push_back(modes);
+        }
+        return it->second;
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr decltype(auto) parse(Src const& src) {
-        m_Context.clear();
-        auto r = reader(src, m_Context);
-        return m_Parser.apply(r);
+    /**
+     * Switches a token between offsets from the start and from the end of
+     * the source.
+     */
+    [[nodiscard]] token_info flip(token_info t) const noexcept {
+        t.offset = m_Source.size() - t.offset;
+        t.reach = m_Source.size() - t.reach;
+        return t;
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr decltype(auto)
-    reparse(Src const& src,
-        std::size_t start, std::size_t rem, std::size_t ins) {
-
-        m_Context.memo().invalidate(start, rem, ins);
-        auto r = reader(src, m_Context);
-        return m_Parser.apply(r);
+    [[nodiscard]] token_info at(std::size_t i) const noexcept {
+        if (i < m_GapBegin) {
+            return m_Info[i];
+        }
+        return flip(m_Info[i + (m_GapEnd - m_GapBegin)]);
     }
-};
-
-template <typename PFwd>
-parser(PFwd) -> parser<PFwd>;
 
-} /* namespace cppcmb */
-
-namespace cppcmb {
-
-namespace detail {
-
-template <typename Self>
-class packrat_base : public combinator<Self> {
-private:
-    std::uintptr_t m_ID;
-
-protected:
-    constexpr packrat_base() noexcept
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-        : m_ID(reinterpret_cast<std::uintptr_t>(this)) {
+    /**
+     * The mode stack after the token at the physical index i.
+     */
+    [[nodiscard]] std::size_t modes_after(std::size_t i) const noexcept {
+        return m_Info[i].modes;
     }
 
-    [[nodiscard]] constexpr auto const& original_id() const noexcept {
-        return m_ID;
+    /**
+     * Moves the gap before the i-th token.
+     */
+    void move_gap(std::size_t i) noexcept {
+        while (m_GapBegin > i) {
+            --m_GapBegin;
+            --m_GapEnd;
+            m_Info[m_GapEnd] = flip(m_Info[m_GapBegin]);
+        }
+        while (m_GapBegin < i) {
+            m_Info[m_GapBegin] = flip(m_Info[m_GapEnd]);
+            ++m_GapBegin;
+            ++m_GapEnd;
+        }
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src, typename TFwd>
-    constexpr auto& put_memo(reader<Src> const& r,
-        TFwd&& val, std::size_t furth) const {
-
-        auto& table = r.context().memo();
-        return table.put(original_id(), r, cppcmb_fwd(val), furth);
+    /**
+     * Adds a token into the gap.
+     */
+    void push(token_info const& t) {
+        if (m_GapBegin == m_GapEnd) {
+            auto grow = std::max(std::size_t(16), m_Info.size() / 2);
+            m_Info.insert(
+                m_Info.begin() + std::ptrdiff_t(m_GapEnd), grow, t
+            );
+            m_GapEnd += grow;
+        }
+        m_Info[m_GapBegin++] = t;
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr std::any* get_memo(reader<Src> const& r) const {
-        auto& table = r.context().memo();
-        return table.get(original_id(), r);
+    /**
+     * Lexes from the offset into the gap, until the end, or until the lexer
+     * is in sync with the old tokens after the gap again. The old tokens
+     * before that point are dropped, returns their count. first is the
+     * index of the first old token after the gap.
+     */
+    std::size_t lex(std::size_t from, std::size_t first,
+        std::vector<std::size_t> const& modes, text_edit const& edit) {
+        auto prev_modes = modes;
+        auto it = m_Lexer->begin(m_Source, from, modes);
+        for (; it != m_Lexer->end(); ++it) {
+            auto pos = it.position();
+            if (pos >= edit.start + edit.ins) {
+                // Past the edit, the old tokens follow, if the lexer is at
+                // the start of one in the same state
+                auto back = m_Info.begin() + std::ptrdiff_t(m_GapEnd);
+                auto j = std::lower_bound(
+                    back, m_Info.end(), m_Source.size() - pos,
+                    [](token_info const& t, std::size_t from_end) {
+                        return t.offset > from_end;
+                    }
+                );
+                if (j != m_Info.end() && m_Source.size() - j->offset == pos) {
+                    auto k = std::size_t(j - m_Info.begin());
+                    auto before = k == m_GapEnd
+                        ? (first == 0 ? std::size_t(0) : modes_after(first - 1))
+                        : modes_after(k - 1);
+                    if (m_ModeStacks[before] == prev_modes) {
+                        auto dropped = k - m_GapEnd;
+                        m_GapEnd = k;
+                        return dropped;
+                    }
+                }
+            }
+            auto const& res = *it;
+            if (res.is_success()) {
+                push({
+                    pos, res.success().matched(), it.reach(),
+                    intern_modes(it.modes()), res.success().value().type()
+                });
+            }
+            prev_modes = it.modes();
+        }
+        auto dropped = m_Info.size() - m_GapEnd;
+        m_GapEnd = m_Info.size();
+        return dropped;
     }
-};
-
-} /* namespace detail */
-
-template <typename P>
-class packrat_t : public detail::packrat_base<packrat_t<P>> {
-private:
-    cppcmb_self_check(packrat_t);
-
-    P m_Parser;
 
 public:
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr packrat_t(PFwd&& p)
-        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
-        : m_Parser(cppcmb_fwd(p)) {
-    }
-
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& r) const {
-        cppcmb_assert_parser(P, Src);
+    token_stream(Lexer const& l, string_type src)
+        : m_Lexer(::std::addressof(l)), m_Source(src) {
+        intern_modes({ 0 });
+        for (auto it = l.begin(m_Source); it != l.end(); ++it) {
+            if (it->is_success()) {
+                push({
+                    it.position(), it->success().matched(), it.reach(),
+                    intern_modes(it.modes()), it->success().value().type()
+                });
+            }
+        }
+    }
 
-        using result_t = parser_result_t<P, Src>;
+    // Just to avoid nasty bugs
+    token_stream(Lexer const&& l, string_type src) = delete;
 
-        auto* entry = this->get_memo(r);
-        if (entry == nullptr) {
-            auto res = m_Parser.apply(r);
-            return this->put_memo(r, std::move(res), res.furthest());
-        }
-        return std::any_cast<result_t&>(*entry);
+    /**
+     * The tokens, this is what the parser should be applied to.
+     */
+    [[nodiscard]] tokens_view tokens() const noexcept {
+        return tokens_view(*this);
     }
-};
 
-template <typename PFwd>
-packrat_t(PFwd) -> packrat_t<PFwd>;
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_Info.size() - (m_GapEnd - m_GapBegin);
+    }
 
-/**
- * Wrapper to make any combinator a packrat parser.
- */
-template <typename PFwd>
-[[nodiscard]] constexpr auto memo(PFwd&& p)
-    cppcmb_return(packrat_t(cppcmb_fwd(p)))
+    /**
+     * The offset of the i-th token in the source.
+     */
+    [[nodiscard]] std::size_t offset(std::size_t i) const noexcept {
+        return at(i).offset;
+    }
 
-struct as_self_t {};
-struct as_memo_t {};
+    /**
+     * The number of different mode stacks seen.
+     */
+    [[nodiscard]] std::size_t mode_stack_count() const noexcept {
+        return m_ModeStacks.size();
+    }
 
-inline constexpr auto as_self = as_self_t();
-inline constexpr auto as_memo = as_memo_t();
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Updates the tokens for the edited source, given the edit in
+     * characters. Returns the edit in tokens, that can be passed to reparse.
+     * Only the tokens that looked at the edited part are lexed again, until
+     * the lexer gets back to the start of an old token in the same state.
+     * The work is proportional to the relexed tokens and the distance from
+     * the previous edit, the tokens after the edit are not touched.
+     */
+    text_edit relex(string_type src, text_edit const& edit) {
+        // The first token that could see the edit
+        std::size_t first = 0;
+        for (auto last = size(); first < last;) {
+            auto mid = first + (last - first) / 2;
+            if (at(mid).reach < edit.start) {
+                first = mid + 1;
+            }
+            else {
+                last = mid;
+            }
+        }
+        auto from = std::size_t(0);
+        auto modes = m_ModeStacks[0];
+        if (first != 0) {
+            auto prev = at(first - 1);
+            from = prev.offset + prev.length;
+            modes = m_ModeStacks[prev.modes];
+        }
 
-// Identity
-template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
-constexpr auto operator%=(P&& parser, as_self_t)
-    cppcmb_return(cppcmb_fwd(parser))
+        move_gap(first);
+        // The tokens after the gap are in the new source from now on
+        m_Source = src;
+        auto rem = lex(from, first, modes, edit);
+        return text_edit{ first, rem, m_GapBegin - first };
+    }
+};
 
-// Simple packrat
-template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
-constexpr auto operator%=(P&& parser, as_memo_t)
-    cppcmb_return(memo(cppcmb_fwd(parser)))
+template <typename Lexer, typename CharT>
+token_stream(Lexer const&, std::basic_string_view<CharT>)
+    -> token_stream<Lexer, CharT>;
 
 } /* namespace cppcmb */
 
@@ -2842,712 +11516,1082 @@ namespace cppcmb {
 
 namespace detail {
 
-// XXX(LPeter1997): This is a more generic structure, shouldn't be here!
-template <typename T, typename Tag>
-class tagged_wrapper {
-private:
-    cppcmb_self_check(tagged_wrapper);
-
-    T m_Value;
-
-public:
-    template <typename TFwd>
-    constexpr tagged_wrapper(TFwd&& val)
-        noexcept(std::is_nothrow_constructible_v<T, TFwd&&>)
-        : m_Value(cppcmb_fwd(val)) {
-    }
-
-    cppcmb_getter(value, m_Value)
-};
-
-} /* namespace detail */
+inline constexpr char          tree_magic[4]  = { 'C', 'C', 'M', 'T' };
+inline constexpr unsigned char tree_version   = 2;
+inline constexpr std::size_t   tree_header_size = sizeof(tree_magic) + 2;
 
-template <typename P>
-class drec_packrat_t : public detail::packrat_base<drec_packrat_t<P>> {
+/**
+ * Builds the encoded form of a value.
+ */
+class tree_writer {
 private:
-    cppcmb_self_check(drec_packrat_t);
+    std::string                                    m_Body;
+    std::vector<std::string>                       m_Strings;
+    std::unordered_map<std::string, std::uint32_t> m_StringIDs;
 
-    template <typename T>
-    using base_recursion = detail::tagged_wrapper<T, struct drec_base_tag>;
+    // XXX(LPeter1997): Noexcept specifier
+    static void put_u32(std::string& out, std::uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(char((v >> (8 * i)) & 0xFF));
+        }
+    }
 
-    template <typename T>
-    using in_recursion = detail::tagged_wrapper<T, struct drec_in_tag>;
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    void varint(std::uint64_t v) {
+        while (v >= 0x80) {
+            m_Body.push_back(char((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        m_Body.push_back(char(v));
+    }
 
-    P m_Parser;
+    // XXX(LPeter1997): Noexcept specifier
+    void raw(void const* data, std::size_t len) {
+        m_Body.append(static_cast<char const*>(data), len);
+    }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]]
-    constexpr decltype(auto) grow(
-        reader<Src> const& r,
-        parser_result_t<P, Src>& old_res
-    ) const {
+    [[nodiscard]] std::uint32_t intern(std::string_view str) {
+        auto [it, inserted] = m_StringIDs.insert({
+            std::string(str), std::uint32_t(m_Strings.size())
+        });
+        if (inserted) {
+            m_Strings.push_back(it->first);
+        }
+        return it->second;
+    }
 
-        // XXX(LPeter1997): Right now the max_furthest is explicitly written
-        // back into the cache (redundantly). We could always ask the result
-        // directly.
-        // That way we don't have to put_memo the old values just to update
-        // 'furthest'
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Reserves room for a relative offset, that is filled by end_span.
+     */
+    [[nodiscard]] std::size_t begin_span() {
+        put_u32(m_Body, 0);
+        return m_Body.size();
+    }
 
-        using in_rec = in_recursion<parser_result_t<P, Src>>;
+    void end_span(std::size_t start) noexcept {
+        auto len = std::uint32_t(m_Body.size() - start);
+        for (std::size_t i = 0; i < 4; ++i) {
+            m_Body[start - 4 + i] = char((len >> (8 * i)) & 0xFF);
+        }
+    }
 
-        if (old_res.is_failure()) {
-            return old_res;
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] std::string finish() const {
+        std::string out;
+        out.append(tree_magic, sizeof(tree_magic));
+        out.push_back(char(tree_version));
+        out.push_back('\0');
+        put_u32(out, std::uint32_t(m_Strings.size()));
+        std::uint32_t offs = 0;
+        for (auto const& s : m_Strings) {
+            put_u32(out, offs);
+            offs += std::uint32_t(s.size());
         }
-        auto& old_succ = old_res.success();
+        put_u32(out, offs);
+        for (auto const& s : m_Strings) {
+            out += s;
+        }
+        out += m_Body;
+        return out;
+    }
+};
 
-        auto tmp_res = m_Parser.apply(r);
-        auto max_furthest = std::max(old_res.furthest(), tmp_res.furthest());
+/**
+ * A cursor into an encoded document. Every read is bounds-checked.
+ */
+class tree_reader {
+private:
+    char const*   m_Pos     = nullptr;
+    char const*   m_End     = nullptr;
+    char const*   m_Offsets = nullptr;
+    char const*   m_Strings = nullptr;
+    std::uint32_t m_StringCount = 0;
+
+    [[nodiscard]] static std::uint32_t get_u32(char const* p) noexcept {
+        std::uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            v |= std::uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+        return v;
+    }
 
-        // Update the furthest value in both entries
-        old_res.m_Furthest = max_furthest;
-        tmp_res.m_Furthest = max_furthest;
+public:
+    constexpr tree_reader() noexcept = default;
 
-        if (tmp_res.is_success()) {
-            auto& tmp_succ = tmp_res.success();
-            if (old_succ.matched() < tmp_succ.matched()) {
-                // We successfully grew the seed
-                auto& new_old = this->put_memo(
-                    r, in_rec(tmp_res), max_furthest
-                ).value();
-                return grow(r, new_old);
+    /**
+     * Reads the header, leaves the cursor at the root value.
+     */
+    [[nodiscard]] bool open(std::string_view bytes) noexcept {
+        m_Pos = bytes.data();
+        m_End = bytes.data() + bytes.size();
+        if (bytes.size() < tree_header_size + 4
+         || std::memcmp(m_Pos, tree_magic, sizeof(tree_magic)) != 0
+         || static_cast<unsigned char>(m_Pos[4]) != tree_version) {
+            return false;
+        }
+        m_Pos += tree_header_size;
+        m_StringCount = get_u32(m_Pos);
+        m_Pos += 4;
+        if (std::size_t(m_End - m_Pos) / 4 < std::size_t(m_StringCount) + 1) {
+            return false;
+        }
+        m_Offsets = m_Pos;
+        m_Pos += (std::size_t(m_StringCount) + 1) * 4;
+        m_Strings = m_Pos;
+        // Offsets must be increasing and inside the buffer
+        std::uint32_t prev = 0;
+        for (std::uint32_t i = 0; i <= m_StringCount; ++i) {
+            auto o = get_u32(m_Offsets + 4 * std::size_t(i));
+            if (o < prev) {
+                return false;
             }
-            // We need to overwrite max-furthest in the memo-table!
-            // That's why we don't simply return old_res
-            return this->put_memo(
-                r, in_rec(old_res), max_furthest
-            ).value();
+            prev = o;
         }
-        // We need to overwrite max-furthest in the memo-table!
-        // That's why we don't simply return old_res
-        return this->put_memo(
-            r, in_rec(old_res), max_furthest
-        ).value();
+        if (std::size_t(m_End - m_Pos) < prev) {
+            return false;
+        }
+        m_Pos += prev;
+        return true;
     }
 
-public:
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr drec_packrat_t(PFwd&& p)
-        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
-        : m_Parser(cppcmb_fwd(p)) {
+    [[nodiscard]] bool at_end() const noexcept {
+        return m_Pos == m_End;
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& r) const {
-        cppcmb_assert_parser(P, Src);
+    [[nodiscard]] char const* position() const noexcept {
+        return m_Pos;
+    }
 
-        using result_t = parser_result_t<P, Src>;
-        using base_rec = std::pair<base_recursion<result_t>, bool>;
-        using in_rec = in_recursion<result_t>;
+    [[nodiscard]] bool varint(std::uint64_t& out) noexcept {
+        out = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (m_Pos == m_End) {
+                return false;
+            }
+            auto b = static_cast<unsigned char>(*m_Pos++);
+            out |= std::uint64_t(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-        auto* entry = this->get_memo(r);
-        if (entry == nullptr) {
-            // Nothing is in the cache yet, write a dummy error
-            this->put_memo(r, base_rec(result_t(failure(), 0U), true), 0U);
-            // Now invoke the parser
-            // If it's recursive, the entry must have changed
-            auto tmp_res = m_Parser.apply(r);
-            // Refresh entry
-            entry = this->get_memo(r);
-            cppcmb_assert(
-                "The entry cannot be nullptr here!",
-                entry != nullptr
-            );
+    [[nodiscard]] bool raw(void* out, std::size_t len) noexcept {
+        if (std::size_t(m_End - m_Pos) < len) {
+            return false;
+        }
+        std::memcpy(out, m_Pos, len);
+        m_Pos += len;
+        return true;
+    }
 
-            // Check for change
-            if (auto* inr = std::any_cast<in_rec>(entry)) {
-                // We are in recursion
-                auto& res = this->put_memo(
-                    r, in_rec(std::move(tmp_res)), tmp_res.furthest()
-                ).value();
-                return grow(r, res);
-            }
-            // Base-thing, no progress
-            // Overwrite the base-type to contain the result
-            auto* br = std::any_cast<base_rec>(entry);
-            cppcmb_assert(
-                "A direct-packrat parser must either enter a "
-                "'base' or 'in'-recursion entry!",
-                br != nullptr
-            );
-            return this->put_memo(
-                r,
-                base_rec(std::move(tmp_res), false),
-                tmp_res.furthest()
-            ).first.value();
+    [[nodiscard]] bool u32(std::uint32_t& out) noexcept {
+        if (m_End - m_Pos < 4) {
+            return false;
         }
-        // Something is in the cache
-        if (auto* br_p = std::any_cast<base_rec>(entry)) {
-            auto& br = *br_p;
-            if (br.second) {
-                // Recursion signal
-                return this->put_memo(
-                    r,
-                    in_rec(result_t(failure(), 0U)),
-                    0U
-                ).value();
-            }
-            return br.first.value();
+        out = get_u32(m_Pos);
+        m_Pos += 4;
+        return true;
+    }
+
+    [[nodiscard]] bool skip(std::size_t len) noexcept {
+        if (std::size_t(m_End - m_Pos) < len) {
+            return false;
         }
-        auto* inr = std::any_cast<in_rec>(entry);
-        cppcmb_assert(
-            "A direct-packrat parser must either enter a "
-            "'base' or 'in'-recursion entry!",
-            inr != nullptr
-        );
-        return inr->value();
+        m_Pos += len;
+        return true;
     }
-};
 
-template <typename PFwd>
-drec_packrat_t(PFwd) -> drec_packrat_t<PFwd>;
+    [[nodiscard]] bool string(std::uint64_t idx, std::string_view& out)
+        const noexcept {
+        if (idx >= m_StringCount) {
+            return false;
+        }
+        auto from = get_u32(m_Offsets + 4 * std::size_t(idx));
+        auto to = get_u32(m_Offsets + 4 * std::size_t(idx + 1));
+        out = std::string_view(m_Strings + from, to - from);
+        return true;
+    }
+};
 
-/**
- * Wrapper to make any combinator a direct-left-recursive packrat parser.
- */
-template <typename PFwd>
-[[nodiscard]] constexpr auto memo_d(PFwd&& p)
-    cppcmb_return(drec_packrat_t(cppcmb_fwd(p)))
+template <typename T>
+inline constexpr bool is_tree_integral_v =
+    (std::is_integral_v<T> || std::is_enum_v<T>);
 
-struct as_memo_d_t {};
+template <typename T>
+struct is_tree_string : std::false_type {};
 
-inline constexpr auto as_memo_d = as_memo_d_t();
+template <typename Traits, typename Alloc>
+struct is_tree_string<std::basic_string<char, Traits, Alloc>>
+    : std::true_type {};
 
-// Direct-left-recursive packrat
-template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
-constexpr auto operator%=(P&& parser, as_memo_d_t)
-    cppcmb_return(memo_d(cppcmb_fwd(parser)))
+template <typename Traits>
+struct is_tree_string<std::basic_string_view<char, Traits>>
+    : std::true_type {};
 
-} /* namespace cppcmb */
+} /* namespace detail */
 
-namespace cppcmb {
+/**
+ * Describes how a type is encoded. Specializations provide:
+ *  - decoded_type: the type the value is decoded into
+ *  - static void write(detail::tree_writer&, T const&)
+ *  - static bool validate(detail::tree_reader&): validates and steps over a
+ *    value
+ *  - static void skip(detail::tree_reader&): steps over a validated value,
+ *    collections are skipped in constant time
+ *  - static decoded_type read(detail::tree_reader&): reads a validated value
+ *  - static constexpr std::size_t min_width: the fewest bytes a value is
+ *    encoded in, 1 if not given. Collections with more elements than their
+ *    span can hold are rejected with it, so it must be at least 1.
+ */
+template <typename T, typename = void>
+struct tree_codec {};
 
-template <typename P1, typename P2>
-class eager_alt_t : public combinator<eager_alt_t<P1, P2>> {
-private:
-    template <typename Src>
-    using value_t = sum_values_t<
-        parser_value_t<P1, Src>,
-        parser_value_t<P2, Src>
-    >;
+template <typename T>
+using tree_decoded_t = typename tree_codec<T>::decoded_type;
 
-    P1 m_First;
-    P2 m_Second;
+namespace detail {
 
-public:
-    template <typename P1Fwd, typename P2Fwd>
-    constexpr eager_alt_t(P1Fwd&& p1, P2Fwd&& p2)
-        noexcept(
-            std::is_nothrow_constructible_v<P1, P1Fwd&&>
-         && std::is_nothrow_constructible_v<P2, P2Fwd&&>
-        )
-        : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
-    }
+template <typename T, typename = void>
+struct tree_min_width : std::integral_constant<std::size_t, 1> {};
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<value_t<Src>> {
-        cppcmb_assert_parser(P1, Src);
-        cppcmb_assert_parser(P2, Src);
+template <typename T>
+struct tree_min_width<T, std::void_t<decltype(tree_codec<T>::min_width)>>
+    : std::integral_constant<std::size_t, tree_codec<T>::min_width> {};
 
-        using result_t = result<value_t<Src>>;
+template <typename T>
+inline constexpr std::size_t tree_min_width_v = tree_min_width<T>::value;
 
-        // Try to apply both alternatives
-        auto p1_inv = m_First.apply(r);
-        auto p2_inv = m_Second.apply(r);
+/**
+ * True, if this host stores numbers with the most significant byte first.
+ */
+[[nodiscard]] inline bool big_endian_host() noexcept {
+    std::uint16_t const one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+}
 
-        auto furthest = std::max(p1_inv.furthest(), p2_inv.furthest());
+} /* namespace detail */
 
-        // Both succeeded
-        if (p1_inv.is_success() && p2_inv.is_success()) {
-            // Return the one that got further
-            // If they both got the same distance, return the first one
-            auto p1_succ = std::move(p1_inv).success();
-            auto p2_succ = std::move(p2_inv).success();
+// Integers, characters, booleans and enums
+template <typename T>
+struct tree_codec<T, std::enable_if_t<detail::is_tree_integral_v<T>>> {
+private:
+    using int_type = std::conditional_t<std::is_enum_v<T>,
+        std::underlying_type<T>,
+        std::enable_if<true, T>
+    >;
+    using repr_type = typename int_type::type;
 
-            if (p1_succ.matched() >= p2_succ.matched()) {
-                return result_t(success(
-                    sum_values<value_t<Src>>(std::move(p1_succ).value()),
-                    p1_succ.matched()
-                ), furthest);
-            }
-            return result_t(success(
-                sum_values<value_t<Src>>(std::move(p2_succ).value()),
-                p2_succ.matched()
-            ), furthest);
+    [[nodiscard]] static bool read_repr(detail::tree_reader& r, repr_type& out)
+        noexcept {
+        std::uint64_t v;
+        if (!r.varint(v)) {
+            return false;
         }
-        // LHS succeeded
-        if (p1_inv.is_success()) {
-            auto p1_succ = std::move(p1_inv).success();
-            return result_t(success(
-                sum_values<value_t<Src>>(std::move(p1_succ).value()),
-                p1_succ.matched()
-            ), furthest);
+        if constexpr (std::is_signed_v<repr_type>) {
+            // Zig-zag decoding
+            auto s = std::int64_t(v >> 1) ^ -std::int64_t(v & 1);
+            if (s < std::numeric_limits<repr_type>::min()
+             || s > std::numeric_limits<repr_type>::max()) {
+                return false;
+            }
+            out = repr_type(s);
         }
-        // RHS succeeded
-        if (p2_inv.is_success()) {
-            auto p2_succ = std::move(p2_inv).success();
-            return result_t(success(
-                sum_values<value_t<Src>>(std::move(p2_succ).value()),
-                p2_succ.matched()
-            ), furthest);
+        else {
+            if (v > std::uint64_t(std::numeric_limits<repr_type>::max())) {
+                return false;
+            }
+            out = repr_type(v);
         }
+        return true;
+    }
 
-        // Both failed, return the error which got further
-        auto p1_err = std::move(p1_inv).failure();
-        auto p2_err = std::move(p2_inv).failure();
+public:
+    using decoded_type = T;
 
-        if (p1_inv.furthest() > p2_inv.furthest()) {
-            return result_t(std::move(p1_err), furthest);
+    static constexpr std::size_t min_width = 1;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, T const& val) {
+        auto v = repr_type(val);
+        if constexpr (std::is_signed_v<repr_type>) {
+            // Zig-zag encoding, so small negative numbers stay short
+            auto s = std::int64_t(v);
+            w.varint((std::uint64_t(s) << 1) ^ std::uint64_t(s >> 63));
         }
-        if (p1_inv.furthest() < p2_inv.furthest()) {
-            return result_t(std::move(p2_err), furthest);
+        else {
+            w.varint(std::uint64_t(v));
         }
-        // They got to the same distance, need to merge errors
-        // XXX(LPeter1997): Implement, for now we just return the first
-        return result_t(std::move(p1_err), furthest);
     }
-};
 
-template <typename P1Fwd, typename P2Fwd>
-eager_alt_t(P1Fwd, P2Fwd) -> eager_alt_t<P1Fwd, P2Fwd>;
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        repr_type v;
+        return read_repr(r, v);
+    }
 
-/**
- * Operator for making eager alternatives.
- */
-template <typename P1, typename P2,
-    cppcmb_requires_t(detail::all_combinators_cvref_v<P1, P2>)>
-[[nodiscard]] constexpr auto operator||(P1&& p1, P2&& p2)
-    cppcmb_return(eager_alt_t(cppcmb_fwd(p1), cppcmb_fwd(p2)))
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t v;
+        (void)r.varint(v);
+    }
 
-/**
- * Ignore pass.
- */
-template <typename P2,
-    cppcmb_requires_t(detail::is_combinator_cvref_v<P2>)>
-[[nodiscard]] constexpr auto operator||(pass_t, P2&& p2)
-    cppcmb_return(cppcmb_fwd(p2))
+    [[nodiscard]] static T read(detail::tree_reader& r) noexcept {
+        repr_type v{};
+        (void)read_repr(r, v);
+        return T(v);
+    }
+};
 
-} /* namespace cppcmb */
+// Floating-point numbers
+template <typename T>
+struct tree_codec<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+private:
+    using bytes_type = std::array<unsigned char, sizeof(T)>;
 
-namespace cppcmb {
+    /**
+     * Swaps between the native and the little-endian byte order.
+     */
+    static void to_little(bytes_type& bytes) noexcept {
+        if (detail::big_endian_host()) {
+            for (std::size_t i = 0; i < sizeof(T) / 2; ++i) {
+                std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+            }
+        }
+    }
 
-class end_t : public combinator<end_t> {
 public:
+    using decoded_type = T;
+
+    static constexpr std::size_t min_width = sizeof(T);
+
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<product<>> {
+    static void write(detail::tree_writer& w, T const& val) {
+        bytes_type bytes;
+        std::memcpy(bytes.data(), &val, sizeof(T));
+        to_little(bytes);
+        w.raw(bytes.data(), sizeof(T));
+    }
 
-        if (r.is_end()) {
-            // XXX(LPeter1997): GCC bug
-            return result<product<>>(success(product<>(), 0U), 0U);
-        }
-        return result<product<>>(failure(), 0U);
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        return r.skip(sizeof(T));
     }
-};
 
-// Value for 'end' parser
-inline constexpr end_t end = end_t();
+    static void skip(detail::tree_reader& r) noexcept {
+        (void)r.skip(sizeof(T));
+    }
 
-} /* namespace cppcmb */
+    [[nodiscard]] static T read(detail::tree_reader& r) noexcept {
+        bytes_type bytes{};
+        (void)r.raw(bytes.data(), sizeof(T));
+        to_little(bytes);
+        T val;
+        std::memcpy(&val, bytes.data(), sizeof(T));
+        return val;
+    }
+};
 
-namespace cppcmb {
+// Strings decode into views of the document
+template <typename T>
+struct tree_codec<T, std::enable_if_t<detail::is_tree_string<T>::value>> {
+    using decoded_type = std::string_view;
+
+    static constexpr std::size_t min_width = 1;
 
-class epsilon_t : public combinator<epsilon_t> {
-public:
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& /* r */) const
-        -> result<product<>> {
+    static void write(detail::tree_writer& w, T const& val) {
+        w.varint(w.intern(std::string_view(val)));
+    }
 
-        // XXX(LPeter1997): GCC bug
-        return result<product<>>(success(product<>(), 0U), 0U);
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t idx;
+        std::string_view str;
+        return r.varint(idx) && r.string(idx, str);
     }
-};
 
-// Value for 'epsilon' parser
-inline constexpr auto epsilon = epsilon_t();
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t idx;
+        (void)r.varint(idx);
+    }
 
-} /* namespace cppcmb */
+    [[nodiscard]] static std::string_view read(detail::tree_reader& r)
+        noexcept {
+        std::uint64_t idx = 0;
+        std::string_view str;
+        (void)(r.varint(idx) && r.string(idx, str));
+        return str;
+    }
+};
 
-namespace cppcmb {
+template <typename... Ts>
+struct tree_codec<product<Ts...>> {
+    using decoded_type = product<tree_decoded_t<Ts>...>;
 
-template <typename P>
-class irec_packrat_t : public detail::packrat_base<irec_packrat_t<P>> {
-private:
-    cppcmb_self_check(irec_packrat_t);
+    static constexpr std::size_t min_width =
+        (std::size_t(0) + ... + detail::tree_min_width_v<Ts>);
 
-    using head = detail::irec_head;
-    using left_recursive = detail::irec_left_recursive;
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, product<Ts...> const& val) {
+        write_impl(w, val, product<Ts...>::index_sequence);
+    }
 
-    P m_Parser;
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        return (true && ... && tree_codec<Ts>::validate(r));
+    }
 
-    // XXX(LPeter1997): decltype(auto) where possible
+    static void skip(detail::tree_reader& r) noexcept {
+        (..., tree_codec<Ts>::skip(r));
+    }
 
     // XXX(LPeter1997): Noexcept specifier
-    // XXX(LPeter1997): This could be static
-    template <typename T>
-    constexpr decltype(auto) to_result(std::any& a) const {
-        if (auto* r = std::any_cast<std::shared_ptr<left_recursive>>(&a)) {
-            return std::any_cast<T&>((*r)->seed());
-        }
-        return std::any_cast<T&>(a);
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        // Braced initialization keeps the order of reads
+        return decoded_type{ tree_codec<Ts>::read(r)... };
+    }
+
+private:
+    template <std::size_t... Is>
+    static void write_impl(detail::tree_writer& w,
+        product<Ts...> const& val, std::index_sequence<Is...>) {
+        (tree_codec<Ts>::write(w, val.template get<Is>()), ...);
     }
+};
+
+// The empty product is a zero byte, so every value takes up room
+template <>
+struct tree_codec<product<>> {
+    using decoded_type = product<>;
+
+    static constexpr std::size_t min_width = 1;
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    /* constexpr */ auto recall(reader<Src> const& r) const
-        -> std::optional<std::any> {
-        using return_t = parser_result_t<P, Src>;
+    static void write(detail::tree_writer& w, product<> const&) {
+        w.varint(0);
+    }
 
-        auto& heads = r.context().call_heads();
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t v;
+        return r.varint(v) && v == 0;
+    }
 
-        auto* cached = this->get_memo(r);
-        auto* in_heads = heads.get(r);
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t v;
+        (void)r.varint(v);
+    }
 
-        if (in_heads == nullptr) {
-            if (cached == nullptr) {
-                return std::nullopt;
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) noexcept {
+        skip(r);
+        return decoded_type();
+    }
+};
+
+template <typename... Ts>
+struct tree_codec<sum<Ts...>> {
+private:
+    using types = std::tuple<Ts...>;
+
+    template <std::size_t I>
+    using alt_t = std::tuple_element_t<I, types>;
+
+    template <std::size_t I>
+    [[nodiscard]] static bool validate_alt(std::uint64_t idx,
+        detail::tree_reader& r) noexcept {
+        if constexpr (I == sizeof...(Ts)) {
+            return false;
+        }
+        else {
+            if (idx == I) {
+                return tree_codec<alt_t<I>>::validate(r);
             }
-            return *cached;
+            return validate_alt<I + 1>(idx, r);
         }
-        auto& h = *in_heads;
+    }
 
-        if (cached == nullptr && !(
-               this->original_id() == h.head_id()
-            || detail::contains(h.involved_set(), this->original_id())
-        )) {
-            return return_t(failure(), 0U);
+    template <std::size_t I>
+    static void skip_alt(std::uint64_t idx, detail::tree_reader& r) noexcept {
+        if constexpr (I < sizeof...(Ts)) {
+            if (idx == I) {
+                tree_codec<alt_t<I>>::skip(r);
+            }
+            else {
+                skip_alt<I + 1>(idx, r);
+            }
         }
+    }
 
-        auto it = h.eval_set().cend();
-        if (detail::contains(h.eval_set(), this->original_id(), it)) {
-            // Remove the rule id from the evaluation id set of the head
-            h.eval_set().erase(it);
-            auto tmp_res = m_Parser.apply(r);
-            *cached = tmp_res;
-        }
+public:
+    using decoded_type = sum<tree_decoded_t<Ts>...>;
 
-        return *cached;
-    }
+    static constexpr std::size_t min_width = 1;
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    constexpr void setup_lr(
-        reader<Src> const& r,
-        left_recursive& rec_detect) const {
+    static void write(detail::tree_writer& w, sum<Ts...> const& val) {
+        auto const& var = val.as_variant();
+        w.varint(var.index());
+        std::visit([&](auto const& alt) {
+            tree_codec<detail::remove_cvref_t<decltype(alt)>>::write(w, alt);
+        }, var);
+    }
 
-        if (!rec_detect.head()) {
-            rec_detect.head() = head(this->original_id());
-        }
-        auto& lr_stack = r.context().call_stack();
-        for (
-            auto it = lr_stack.begin();
-            it != lr_stack.end() && (*it)->parser_id() != this->original_id();
-            ++it) {
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t idx;
+        return r.varint(idx) && validate_alt<0>(idx, r);
+    }
 
-            (*it)->head() = rec_detect.head();
-            rec_detect.head()->involved_set().insert((*it)->parser_id());
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t idx = 0;
+        (void)r.varint(idx);
+        skip_alt<0>(idx, r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t I = 0>
+    [[nodiscard]] static decoded_type read_alt(std::uint64_t idx,
+        detail::tree_reader& r) {
+        if constexpr (I + 1 == sizeof...(Ts)) {
+            return decoded_type(tree_codec<alt_t<I>>::read(r));
+        }
+        else {
+            if (idx == I) {
+                return decoded_type(tree_codec<alt_t<I>>::read(r));
+            }
+            return read_alt<I + 1>(idx, r);
         }
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    constexpr auto lr_answer(
-        reader<Src> const& r,
-        left_recursive& growable) const {
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t idx = 0;
+        (void)r.varint(idx);
+        return read_alt(idx, r);
+    }
+};
 
-        using return_t = parser_result_t<P, Src>;
-        cppcmb_assert(
-            "The growable must contain a head!",
-            growable.head().has_value()
-        );
+template <typename T>
+struct tree_codec<maybe<T>> {
+    using decoded_type = maybe<tree_decoded_t<T>>;
 
-        auto& h = *growable.head();
-        auto& seed = to_result<return_t>(growable.seed());
+    static constexpr std::size_t min_width = 1;
 
-        if (h.head_id() != this->original_id()) {
-            return seed;
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, maybe<T> const& val) {
+        w.varint(val.is_some() ? 1 : 0);
+        if (val.is_some()) {
+            tree_codec<T>::write(w, val.some().value());
         }
-        auto& s = this->put_memo(r, seed, seed.furthest());
-        if (s.is_failure()) {
-            return s;
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t tag;
+        if (!r.varint(tag) || tag > 1) {
+            return false;
+        }
+        return tag == 0 || tree_codec<T>::validate(r);
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t tag = 0;
+        (void)r.varint(tag);
+        if (tag == 1) {
+            tree_codec<T>::skip(r);
         }
-        return grow(r, s, h);
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    constexpr auto grow(
-        reader<Src> const& r,
-        parser_result_t<P, Src>& old_res,
-        head& h) const -> parser_result_t<P, Src> {
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t tag = 0;
+        (void)r.varint(tag);
+        if (tag == 0) {
+            return decoded_type(none());
+        }
+        return decoded_type(some<tree_decoded_t<T>>(tree_codec<T>::read(r)));
+    }
+};
 
-        // XXX(LPeter1997): Right now the max_furthest is explicitly written
-        // back into the cache (redundantly). We could always ask the result
-        // directly.
-        // That way we don't have to put_memo the old values just to update
-        // 'furthest'
-        // Same comment and TODO as in drec_packrat_t::grow
+namespace detail {
 
-        auto& rec_heads = r.context().call_heads();
+/**
+ * Common encoding of collections: element count, relative offset to the end
+ * and the elements.
+ */
+template <typename Coll, typename T>
+struct tree_collection_codec {
+    static_assert(
+        tree_min_width_v<T> > 0,
+        "Collection elements must be encoded in at least a byte!"
+    );
 
-        rec_heads[r] = &h;
-        h.eval_set() = h.involved_set();
+    // The count is at least a byte, the span is 4
+    static constexpr std::size_t min_width = 5;
 
-        std::size_t old_cur = 0U;
-        if (old_res.is_success()) {
-            old_cur = old_res.success().matched();
-        }
+    /**
+     * The most elements a span of len bytes can hold.
+     */
+    [[nodiscard]] static constexpr std::uint64_t capacity(std::uint32_t len)
+        noexcept {
+        return len / tree_min_width_v<T>;
+    }
 
-        auto tmp_res = m_Parser.apply(r);
-        auto max_furthest = std::max(old_res.furthest(), tmp_res.furthest());
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(tree_writer& w, Coll const& val) {
+        w.varint(std::size(val));
+        auto span = w.begin_span();
+        for (auto const& e : val) {
+            tree_codec<T>::write(w, e);
+        }
+        w.end_span(span);
+    }
 
-        // Update the furthest value in both entries
-        old_res.m_Furthest = max_furthest;
-        tmp_res.m_Furthest = max_furthest;
+    /**
+     * Reads the header of the collection.
+     */
+    [[nodiscard]] static bool header(tree_reader& r,
+        std::uint64_t& count, std::uint32_t& len) noexcept {
+        return r.varint(count) && r.u32(len);
+    }
 
-        if (tmp_res.is_success()) {
-            auto& tmp_succ = tmp_res.success();
-            if (old_cur < tmp_succ.matched()) {
-                auto& new_old = this->put_memo(
-                    r, tmp_res, max_furthest
-                );
-                return grow(r, new_old, h);
+    [[nodiscard]] static bool validate(tree_reader& r) noexcept {
+        std::uint64_t count;
+        std::uint32_t len;
+        if (!header(r, count, len)) {
+            return false;
+        }
+        auto elems = r;
+        if (count > capacity(len) || !r.skip(len)) {
+            return false;
+        }
+        // Validate the elements too, they must fill the span exactly
+        for (std::uint64_t i = 0; i < count; ++i) {
+            if (!tree_codec<T>::validate(elems)) {
+                return false;
             }
-            // We need to overwrite max-furthest in the memo-table!
-            // That's why we don't simply return old_res
-
-            auto it = rec_heads.find(r);
-            cppcmb_assert("", it != rec_heads.end());
-            rec_heads.erase(it);
+        }
+        return elems.position() == r.position();
+    }
 
-            // auto* val = this->get_memo(r);
-            // cppcmb_assert("", val != nullptr);
+    static void skip(tree_reader& r) noexcept {
+        std::uint64_t count;
+        std::uint32_t len = 0;
+        (void)(header(r, count, len) && r.skip(len));
+    }
+};
 
-            // return this-> template to_result<return_t>(*val);
-            return this->put_memo(r, std::move(old_res), max_furthest);
-        }
+} /* namespace detail */
 
-        // We need to overwrite max-furthest in the memo-table!
-        // That's why we don't simply return old_res
+template <typename T, typename Alloc>
+struct tree_codec<std::vector<T, Alloc>>
+    : detail::tree_collection_codec<std::vector<T, Alloc>, T> {
 
-        auto it = rec_heads.find(r);
-        cppcmb_assert("", it != rec_heads.end());
-        rec_heads.erase(it);
+    using decoded_type = std::vector<tree_decoded_t<T>>;
 
-        return this->put_memo(r, std::move(old_res), max_furthest);
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t count = 0;
+        std::uint32_t len = 0;
+        (void)tree_codec::header(r, count, len);
+        decoded_type res;
+        // Never reserve more than the span can hold
+        res.reserve(std::size_t(
+            std::min<std::uint64_t>(count, tree_codec::capacity(len))
+        ));
+        for (std::uint64_t i = 0; i < count; ++i) {
+            res.push_back(tree_codec<T>::read(r));
+        }
+        return res;
     }
+};
 
-public:
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr irec_packrat_t(PFwd&& p)
-        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
-        : m_Parser(cppcmb_fwd(p)) {
+template <typename T, std::size_t N>
+struct tree_codec<std::array<T, N>>
+    : detail::tree_collection_codec<std::array<T, N>, T> {
+
+    using decoded_type = std::array<tree_decoded_t<T>, N>;
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        auto rr = r;
+        std::uint64_t count;
+        std::uint32_t len;
+        return tree_codec::header(rr, count, len) && count == N
+            && detail::tree_collection_codec<std::array<T, N>, T>::validate(r);
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]]
-    constexpr auto apply(reader<Src> const& r) const {
-        cppcmb_assert_parser(P, Src);
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t count = 0;
+        std::uint32_t len = 0;
+        (void)tree_codec::header(r, count, len);
+        return read_impl(r, std::make_index_sequence<N>());
+    }
 
-        using return_t = parser_result_t<P, Src>;
+private:
+    template <std::size_t... Is>
+    [[nodiscard]] static decoded_type read_impl(detail::tree_reader& r,
+        std::index_sequence<Is...>) {
+        // Braced initialization keeps the order of reads
+        return decoded_type{ ((void)Is, tree_codec<T>::read(r))... };
+    }
+};
 
-        auto& lr_stack = r.context().call_stack();
+template <typename T, std::size_t N>
+struct tree_codec<inline_vector<T, N>>
+    : detail::tree_collection_codec<inline_vector<T, N>, T> {
 
-        auto m = recall(r);
-        if (!m) {
-            auto base = std::make_shared<left_recursive>(
-                return_t(failure(), 0U), this->original_id()
-            );
-            lr_stack.push_front(base);
-            this->put_memo(r, base, 0U);
-            auto tmp_res = m_Parser.apply(r);
-            lr_stack.pop_front();
+    using decoded_type = inline_vector<tree_decoded_t<T>, N>;
 
-            if (!base->head()) {
-                return this->put_memo(r, tmp_res, tmp_res.furthest());
-            }
-            base->seed() = tmp_res;
-            return lr_answer(r, *base);
-        }
-        auto& entry = *m;
-        if (auto* lr = std::any_cast<std::shared_ptr<left_recursive>>(&entry)) {
-            setup_lr(r, **lr);
-            return this-> template to_result<return_t>((*lr)->seed());
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        auto rr = r;
+        std::uint64_t count;
+        std::uint32_t len;
+        using base_t = detail::tree_collection_codec<inline_vector<T, N>, T>;
+        return tree_codec::header(rr, count, len) && count <= N
+            && base_t::validate(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t count = 0;
+        std::uint32_t len = 0;
+        (void)tree_codec::header(r, count, len);
+        decoded_type res;
+        for (std::uint64_t i = 0; i < count; ++i) {
+            res.push_back(tree_codec<T>::read(r));
         }
-        return this-> template to_result<return_t>(entry);
+        return res;
     }
 };
 
-template <typename PFwd>
-irec_packrat_t(PFwd) -> irec_packrat_t<PFwd>;
+/**
+ * Encodes a value into a self-contained document.
+ */
+template <typename T>
+[[nodiscard]] std::string encode_tree(T const& val) {
+    auto w = detail::tree_writer();
+    tree_codec<T>::write(w, val);
+    return w.finish();
+}
 
 /**
- * Wrapper to make any combinator an indirect-left-recursive packrat parser.
+ * A read-only cursor to an encoded value of type T. Nothing is decoded until
+ * it's asked for.
  */
-template <typename PFwd>
-[[nodiscard]] constexpr auto memo_i(PFwd&& p)
-    cppcmb_return(irec_packrat_t(cppcmb_fwd(p)))
+template <typename T>
+class tree_view {
+private:
+    detail::tree_reader m_Reader;
 
-struct as_memo_i_t {};
+public:
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
 
-inline constexpr auto as_memo_i = as_memo_i_t();
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Decodes the whole value. Strings will still be views of the document.
+     */
+    [[nodiscard]] tree_decoded_t<T> decode() const {
+        auto r = m_Reader;
+        return tree_codec<T>::read(r);
+    }
+};
 
-// Indirect-left-recursive packrat
-template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
-constexpr auto operator%=(P&& parser, as_memo_i_t)
-    cppcmb_return(memo_i(cppcmb_fwd(parser)))
+template <typename... Ts>
+class tree_view<product<Ts...>> {
+private:
+    detail::tree_reader m_Reader;
 
-} /* namespace cppcmb */
+public:
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
 
-namespace cppcmb {
+    /**
+     * The view of the Idx-th element.
+     */
+    template <std::size_t Idx>
+    [[nodiscard]] auto get() const noexcept {
+        auto r = m_Reader;
+        skip_to(r, std::make_index_sequence<Idx>());
+        using elem_t = std::tuple_element_t<Idx, std::tuple<Ts...>>;
+        return tree_view<elem_t>(r);
+    }
 
-template <typename P>
-class opt_t : public combinator<opt_t<P>> {
-private:
-    cppcmb_self_check(opt_t);
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<product<Ts...>> decode() const {
+        auto r = m_Reader;
+        return tree_codec<product<Ts...>>::read(r);
+    }
 
-    template <typename Src>
-    using value_t = maybe<parser_value_t<P, Src>>;
+private:
+    template <std::size_t... Is>
+    static void skip_to(detail::tree_reader& r, std::index_sequence<Is...>)
+        noexcept {
+        (..., tree_codec<std::tuple_element_t<Is, std::tuple<Ts...>>>::skip(r));
+    }
+};
 
-    P m_Parser;
+template <typename... Ts>
+class tree_view<sum<Ts...>> {
+private:
+    detail::tree_reader m_Reader;
 
 public:
-    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
-    constexpr opt_t(PFwd&& p)
-        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
-        : m_Parser(cppcmb_fwd(p)) {
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
     }
 
-    // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<value_t<Src>> {
-        cppcmb_assert_parser(P, Src);
+    /**
+     * The index of the alternative that is stored.
+     */
+    [[nodiscard]] std::size_t index() const noexcept {
+        auto r = m_Reader;
+        std::uint64_t idx = 0;
+        (void)r.varint(idx);
+        return std::size_t(idx);
+    }
 
-        using result_t = result<value_t<Src>>;
+    /**
+     * The view of the Idx-th alternative. Only valid if index() == Idx.
+     */
+    template <std::size_t Idx>
+    [[nodiscard]] auto get() const noexcept {
+        cppcmb_assert("Wrong alternative of sum!", index() == Idx);
+        auto r = m_Reader;
+        std::uint64_t idx;
+        (void)r.varint(idx);
+        using alt_t = std::tuple_element_t<Idx, std::tuple<Ts...>>;
+        return tree_view<alt_t>(r);
+    }
 
-        auto p_inv = m_Parser.apply(r);
-        if (p_inv.is_failure()) {
-            return result_t(
-                success(value_t<Src>(none()), 0U),
-                p_inv.furthest()
-            );
-        }
-        auto succ = std::move(p_inv).success();
-        return result_t(
-            success(
-                value_t<Src>(some(std::move(succ).value())),
-                succ.matched()
-            ),
-            p_inv.furthest()
-        );
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<sum<Ts...>> decode() const {
+        auto r = m_Reader;
+        return tree_codec<sum<Ts...>>::read(r);
     }
 };
 
-template <typename PFwd>
-opt_t(PFwd) -> opt_t<PFwd>;
+template <typename T>
+class tree_view<maybe<T>> {
+private:
+    detail::tree_reader m_Reader;
 
-/**
- * Operator for making optional parser.
- */
-template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
-[[nodiscard]] constexpr auto operator-(P&& p)
-    cppcmb_return(opt_t(cppcmb_fwd(p)))
+public:
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
 
-} /* namespace cppcmb */
+    [[nodiscard]] bool is_some() const noexcept {
+        auto r = m_Reader;
+        std::uint64_t tag = 0;
+        (void)r.varint(tag);
+        return tag == 1;
+    }
 
-namespace cppcmb {
+    [[nodiscard]] bool is_none() const noexcept {
+        return !is_some();
+    }
+
+    /**
+     * The view of the contained value. Only valid if is_some().
+     */
+    [[nodiscard]] tree_view<T> some() const noexcept {
+        cppcmb_assert("some() on an empty maybe!", is_some());
+        auto r = m_Reader;
+        std::uint64_t tag;
+        (void)r.varint(tag);
+        return tree_view<T>(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<maybe<T>> decode() const {
+        auto r = m_Reader;
+        return tree_codec<maybe<T>>::read(r);
+    }
+};
 
 namespace detail {
 
-// XXX(LPeter1997): Can this be constexpr?
 /**
- * This is where all the rules are stored internally.
- * They allow us to do a nice assignment-syntax.
+ * The view of a collection. Elements are visited in order, whole
+ * collections are skipped in constant time.
  */
-template <typename>
-inline /* constexpr */ auto rule_set = 0;
-
-template <typename, typename U>
-struct second {
-    using type = U;
-};
+template <typename Coll, typename T>
+class tree_collection_view {
+private:
+    detail::tree_reader m_Reader;
 
-} /* namespace detail */
+    [[nodiscard]] detail::tree_reader elements(std::uint64_t& count)
+        const noexcept {
+        auto r = m_Reader;
+        std::uint32_t len;
+        (void)(r.varint(count) && r.u32(len));
+        return r;
+    }
 
-template <typename Val, typename Tag>
-class rule_t : public combinator<rule_t<Val, Tag>> {
 public:
-    using tag_type = Tag;
+    class iterator {
+    private:
+        detail::tree_reader m_Reader;
+        std::uint64_t       m_Remaining = 0;
+
+    public:
+        using value_type = tree_view<T>;
+
+        constexpr iterator() noexcept = default;
+
+        constexpr iterator(detail::tree_reader r, std::uint64_t rem) noexcept
+            : m_Reader(r), m_Remaining(rem) {
+        }
+
+        [[nodiscard]] tree_view<T> operator*() const noexcept {
+            return tree_view<T>(m_Reader);
+        }
+
+        iterator& operator++() noexcept {
+            tree_codec<T>::skip(m_Reader);
+            --m_Remaining;
+            return *this;
+        }
+
+        [[nodiscard]] bool operator==(iterator const& o) const noexcept {
+            return m_Remaining == o.m_Remaining;
+        }
+
+        [[nodiscard]] bool operator!=(iterator const& o) const noexcept {
+            return !(*this == o);
+        }
+    };
+
+    constexpr explicit tree_collection_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        std::uint64_t count = 0;
+        (void)elements(count);
+        return std::size_t(count);
+    }
+
+    [[nodiscard]] bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    [[nodiscard]] iterator begin() const noexcept {
+        std::uint64_t count = 0;
+        auto r = elements(count);
+        return iterator(r, count);
+    }
+
+    [[nodiscard]] iterator end() const noexcept {
+        return iterator();
+    }
+
+    /**
+     * The view of the idx-th element. This steps over the previous elements.
+     */
+    [[nodiscard]] tree_view<T> operator[](std::size_t idx) const noexcept {
+        cppcmb_assert("Index out of bounds!", idx < size());
+        auto it = begin();
+        for (std::size_t i = 0; i < idx; ++i) {
+            ++it;
+        }
+        return *it;
+    }
 
     // XXX(LPeter1997): Noexcept specifier
-    template <typename Src>
-    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
-        -> result<Val> {
-        return cppcmb_parse_rule(*this, r);
+    [[nodiscard]] tree_decoded_t<Coll> decode() const {
+        auto r = m_Reader;
+        return tree_codec<Coll>::read(r);
     }
 };
 
-/**
- * Used to declare rules.
- */
-#define cppcmb_decl(name, ...) \
-auto const name =              \
-::cppcmb::rule_t<__VA_ARGS__, struct cppcmb_unique_id(cppcmb_rule_tag)>()
+} /* namespace detail */
 
-// XXX(LPeter1997): The use of the inline variable like this is IFNDR...
-// We need an alternative solution!
-// XXX(LPeter1997): Noexcept specifier
-/**
- * Used to define rules.
- * Generates the function that does the indirect-call.
- */
-#define cppcmb_def(name)                                            \
-template <typename Src>                                             \
-[[nodiscard]] constexpr auto                                        \
-cppcmb_parse_rule(decltype(name), ::cppcmb::reader<Src> const& r) { \
-    using tag_type = typename decltype(name)::tag_type;             \
-    auto const& p = ::cppcmb::detail::rule_set<                     \
-        typename ::cppcmb::detail::second<Src, tag_type>::type      \
-    >;                                                              \
-    return p.apply(r);                                              \
-}                                                                   \
-template <>                                                         \
-inline /* constexpr */ auto                                         \
-::cppcmb::detail::rule_set<typename decltype(name)::tag_type>
+template <typename T, typename Alloc>
+class tree_view<std::vector<T, Alloc>>
+    : public detail::tree_collection_view<std::vector<T, Alloc>, T> {
+public:
+    using detail::tree_collection_view<
+        std::vector<T, Alloc>, T
+    >::tree_collection_view;
+};
 
-} /* namespace cppcmb */
+template <typename T, std::size_t N>
+class tree_view<std::array<T, N>>
+    : public detail::tree_collection_view<std::array<T, N>, T> {
+public:
+    using detail::tree_collection_view<
+        std::array<T, N>, T
+    >::tree_collection_view;
+};
 
-namespace cppcmb {
+template <typename T, std::size_t N>
+class tree_view<inline_vector<T, N>>
+    : public detail::tree_collection_view<inline_vector<T, N>, T> {
+public:
+    using detail::tree_collection_view<
+        inline_vector<T, N>, T
+    >::tree_collection_view;
+};
 
+/**
+ * An encoded document over a byte buffer that it doesn't own. The buffer is
+ * validated once when opening, every view of it is safe to use afterwards.
+ */
 template <typename T>
-struct todo_t  {
-    template <typename... Ts>
-    [[nodiscard]] constexpr T operator()(Ts&&...) const noexcept {
-        cppcmb_panic("Unimplemented feature! (TODO used)");
-        return *(T*)nullptr;
+class tree_document {
+private:
+    detail::tree_reader m_Root;
+
+    constexpr explicit tree_document(detail::tree_reader r) noexcept
+        : m_Root(r) {
     }
-};
 
-// Value template
-template <typename T>
-inline constexpr auto todo = todo_t<T>();
+public:
+    /**
+     * Opens a document. Returns nothing if the bytes are not a valid encoding
+     * of a T.
+     */
+    [[nodiscard]] static std::optional<tree_document> open(
+        std::string_view bytes) noexcept {
 
-} /* namespace cppcmb */
+        auto r = detail::tree_reader();
+        if (!r.open(bytes)) {
+            return std::nullopt;
+        }
+        auto end = r;
+        if (!tree_codec<T>::validate(end) || !end.at_end()) {
+            return std::nullopt;
+        }
+        return tree_document(r);
+    }
 
-namespace cppcmb {
+    [[nodiscard]] tree_view<T> root() const noexcept {
+        return tree_view<T>(m_Root);
+    }
 
-// XXX(LPeter1997): Maybe it's better to explicitly implement the parser for
-// better error messages?
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<T> decode() const {
+        return root().decode();
+    }
+};
 
+/**
+ * Decodes an encoded document. Strings are views of the bytes.
+ */
 template <typename T>
-inline constexpr auto todo_parser = epsilon[todo<T>];
+[[nodiscard]] std::optional<tree_decoded_t<T>> decode_tree(
+    std::string_view bytes) {
+
+    auto doc = tree_document<T>::open(bytes);
+    if (!doc) {
+        return std::nullopt;
+    }
+    return doc->decode();
+}
 
 } /* namespace cppcmb */
 
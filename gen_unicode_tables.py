@@ -0,0 +1,119 @@
+import datetime
+import unicodedata
+
+TARGET_PATH = 'source/detail/unicode_tables.hpp'
+
+# Number of low bits of a code point that index into a second-stage block
+BLOCK_BITS = 8
+BLOCK_SIZE = 1 << BLOCK_BITS
+MAX_CODEPOINT = 0x110000
+
+FILE_PREFIX = f"""
+/**
+ * unicode_tables.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Two-stage lookup tables for Unicode character properties.
+ * This file has been generated by gen_unicode_tables.py, do not edit it!
+ * Unicode version: {unicodedata.unidata_version}
+ * Generation date: {datetime.datetime.now()}
+ */
+"""
+
+def is_xid_start(ch):
+    # Python identifiers are XID_Start XID_Continue*, plus the underscore
+    return ch != '_' and ch.isidentifier()
+
+def is_xid_continue(ch):
+    return ('a' + ch).isidentifier()
+
+def is_letter(ch):
+    return unicodedata.category(ch).startswith('L')
+
+def is_digit(ch):
+    return unicodedata.category(ch) == 'Nd'
+
+def is_space(ch):
+    return unicodedata.category(ch) == 'Zs'
+
+PROPERTIES = [
+    ('xid_start',    'XID_Start',                    is_xid_start),
+    ('xid_continue', 'XID_Continue',                 is_xid_continue),
+    ('letter',       'General_Category=L',           is_letter),
+    ('digit',        'General_Category=Nd',          is_digit),
+    ('space',        'General_Category=Zs',          is_space),
+]
+
+def to_words(block):
+    words = []
+    for w in range(0, BLOCK_SIZE, 64):
+        value = 0
+        for i, bit in enumerate(block[w:w + 64]):
+            if bit:
+                value |= 1 << i
+        words.append(value)
+    return words
+
+def format_array(values, per_line, fmt):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('        ' + ', '.join(fmt(v) for v in values[i:i + per_line]) + ',')
+    return '\n'.join(lines)
+
+def generate_table(name, desc, pred):
+    bits = [pred(chr(cp)) for cp in range(MAX_CODEPOINT)]
+    blocks = [tuple(bits[i:i + BLOCK_SIZE]) for i in range(0, MAX_CODEPOINT, BLOCK_SIZE)]
+    # Trailing empty blocks are cut off, the lookup handles them
+    last = max(i for i, b in enumerate(blocks) if any(b))
+    blocks = blocks[:last + 1]
+
+    unique = {}
+    # The empty block always gets index 0
+    unique[tuple([False] * BLOCK_SIZE)] = 0
+    stage1 = []
+    for b in blocks:
+        if b not in unique:
+            unique[b] = len(unique)
+        stage1.append(unique[b])
+    if len(unique) > 256:
+        raise Exception(f'Too many unique blocks for "{name}"!')
+
+    stage2 = [None] * len(unique)
+    for b, idx in unique.items():
+        stage2[idx] = to_words(b)
+
+    ascii_words = to_words(bits[:128] + [False] * (BLOCK_SIZE - 128))[:2]
+
+    result = f'/**\n * {desc}\n */\n'
+    result += f'struct {name}_table {{\n'
+    result += f'    static constexpr std::uint64_t ascii[2] = {{\n'
+    result += format_array(ascii_words, 2, lambda v: f'0x{v:016x}U') + '\n'
+    result += f'    }};\n\n'
+    result += f'    static constexpr std::uint8_t stage1[{len(stage1)}] = {{\n'
+    result += format_array(stage1, 16, lambda v: f'{v:3d}') + '\n'
+    result += f'    }};\n\n'
+    result += f'    static constexpr std::uint64_t stage2[{len(stage2)}][4] = {{\n'
+    for words in stage2:
+        result += '        { ' + ', '.join(f'0x{w:016x}U' for w in words) + ' },\n'
+    result += f'    }};\n'
+    result += f'}};\n'
+    return result
+
+def main():
+    content = FILE_PREFIX.strip() + '\n\n'
+    content += '#ifndef CPPCMB_DETAIL_UNICODE_TABLES_HPP\n'
+    content += '#define CPPCMB_DETAIL_UNICODE_TABLES_HPP\n\n'
+    content += '#include <cstdint>\n\n'
+    content += 'namespace cppcmb {\nnamespace detail {\n\n'
+    content += f'inline constexpr unsigned unicode_block_bits = {BLOCK_BITS};\n\n'
+    content += '\n'.join(generate_table(*p) for p in PROPERTIES)
+    content += '\n} /* namespace detail */\n} /* namespace cppcmb */\n\n'
+    content += '#endif /* CPPCMB_DETAIL_UNICODE_TABLES_HPP */\n'
+    with open(TARGET_PATH, 'w') as file:
+        file.write(content)
+    print(f'Tables generated successfully into "{TARGET_PATH}"!')
+
+if __name__ == "__main__":
+    main()
@@ -12,16 +12,27 @@
 
 #include "apply_value.hpp"
 #include "detail.hpp"
+#include "hash_cons_pool.hpp"
+#include "inline_vector.hpp"
 #include "lexer.hpp"
+#include "lexing_service.hpp"
 #include "maybe.hpp"
 #include "memo_context.hpp"
+#include "modal_lexer.hpp"
+#include "parse_cache.hpp"
 #include "parser.hpp"
 #include "parsers.hpp"
+#include "persistence.hpp"
 #include "product.hpp"
 #include "reader.hpp"
 #include "result.hpp"
+#include "search.hpp"
 #include "sum.hpp"
+#include "symbol_table.hpp"
+#include "text_edit.hpp"
 #include "token.hpp"
+#include "token_stream.hpp"
 #include "transformations.hpp"
+#include "tree_encoding.hpp"
 
 #endif /* CPPCMB_CPPCMB_HPP */
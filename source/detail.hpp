@@ -10,10 +10,17 @@
 #ifndef CPPCMB_DETAIL_HPP
 #define CPPCMB_DETAIL_HPP
 
+#include "detail/block_scan.hpp"
+#include "detail/capture_automaton.hpp"
 #include "detail/crtp.hpp"
+#include "detail/dfa.hpp"
+#include "detail/hash.hpp"
 #include "detail/is_detected.hpp"
 #include "detail/is_specialization.hpp"
 #include "detail/macros.hpp"
+#include "detail/prefilter.hpp"
 #include "detail/remove_cvref.hpp"
+#include "detail/swar.hpp"
+#include "detail/unicode_tables.hpp"
 
 #endif /* CPPCMB_DETAIL_HPP */
@@ -0,0 +1,143 @@
+/**
+ * block_scan.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Classification of 64 byte blocks into bitmasks, in the style of simdjson's
+ * first stage. A block is turned into one 64-bit mask per interesting
+ * character, escapes and quoted regions are then resolved with bit-parallel
+ * arithmetic, so the scanners only look at the few structural positions.
+ */
+
+#ifndef CPPCMB_DETAIL_BLOCK_SCAN_HPP
+#define CPPCMB_DETAIL_BLOCK_SCAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "swar.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+inline constexpr std::size_t block_width = 64;
+
+/**
+ * A block of input. The last block of the input is copied into a zero-padded
+ * buffer, valid() tells which bytes are part of the input.
+ */
+class byte_block {
+private:
+    unsigned char const* m_Data;
+    std::size_t          m_Length;
+    unsigned char        m_Padded[block_width];
+
+public:
+    byte_block(unsigned char const* data, std::size_t len) noexcept
+        : m_Data(data), m_Length(len < block_width ? len : block_width) {
+        if (len < block_width) {
+            std::memset(m_Padded, 0, block_width);
+            std::memcpy(m_Padded, data, len);
+            m_Data = m_Padded;
+        }
+    }
+
+    byte_block(byte_block const&) = delete;
+    byte_block& operator=(byte_block const&) = delete;
+
+    [[nodiscard]] std::size_t length() const noexcept {
+        return m_Length;
+    }
+
+    [[nodiscard]] std::uint64_t valid() const noexcept {
+        return m_Length == block_width
+            ? ~std::uint64_t(0)
+            : (std::uint64_t(1) << m_Length) - 1;
+    }
+
+    /**
+     * The mask of the bytes equal to c.
+     */
+    [[nodiscard]] std::uint64_t eq(unsigned char c) const noexcept {
+        std::uint64_t mask = 0;
+        for (std::size_t i = 0; i < block_width / swar_width; ++i) {
+            auto word = swar_load(m_Data + i * swar_width);
+            mask |= std::uint64_t(swar_eq_bits(word, c)) << (i * swar_width);
+        }
+        return mask & valid();
+    }
+
+    /**
+     * The mask of the bytes equal to any of the n bytes of set.
+     */
+    [[nodiscard]] std::uint64_t eq_any(unsigned char const* set,
+        std::size_t n) const noexcept {
+        std::uint64_t mask = 0;
+        for (std::size_t i = 0; i < block_width / swar_width; ++i) {
+            auto word = swar_load(m_Data + i * swar_width);
+            std::uint64_t lanes = 0;
+            for (std::size_t j = 0; j < n; ++j) {
+                lanes |= swar_eq_lanes(word, set[j]);
+            }
+            mask |= std::uint64_t(swar_gather_highs(lanes)) << (i * swar_width);
+        }
+        return mask & valid();
+    }
+};
+
+/**
+ * Finds the escaped characters, given the masks of escape characters of
+ * consecutive blocks. An escaped escape character is not reported, only the
+ * characters after odd-length runs of escape characters.
+ */
+class escape_scanner {
+private:
+    static constexpr std::uint64_t even_bits = 0x5555555555555555U;
+    static constexpr std::uint64_t odd_bits = ~even_bits;
+
+    // 1, if the first character of the next block is escaped
+    std::uint64_t m_Carry = 0;
+
+public:
+    [[nodiscard]] std::uint64_t next(std::uint64_t esc) noexcept {
+        auto start_edges = esc & ~(esc << 1);
+        // A run that continues from the previous block starts "one earlier"
+        auto even_start_mask = even_bits ^ m_Carry;
+        auto even_starts = start_edges & even_start_mask;
+        auto odd_starts = start_edges & ~even_start_mask;
+
+        auto even_carries = esc + even_starts;
+        auto odd_carries = esc + odd_starts;
+        auto overflow = odd_carries < esc;
+        odd_carries |= m_Carry;
+        m_Carry = overflow ? 1 : 0;
+
+        auto even_carry_ends = even_carries & ~esc;
+        auto odd_carry_ends = odd_carries & ~esc;
+        return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+    }
+};
+
+/**
+ * Finds the quoted regions, given the masks of unescaped quotes of
+ * consecutive blocks. The opening quote is part of the region, the closing
+ * one is not.
+ */
+class quote_scanner {
+private:
+    // All ones, if the next block starts inside a string
+    std::uint64_t m_InString = 0;
+
+public:
+    [[nodiscard]] std::uint64_t next(std::uint64_t quotes) noexcept {
+        auto in_string = prefix_xor(quotes) ^ m_InString;
+        m_InString = std::uint64_t(0) - (in_string >> 63);
+        return in_string;
+    }
+};
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_DETAIL_BLOCK_SCAN_HPP */
@@ -0,0 +1,300 @@
+/**
+ * capture_automaton.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Matching with capture groups, without backtracking. Most patterns are
+ * one-pass: the next byte always decides which way the match goes, so a
+ * single deterministic walk can record the group boundaries. Other patterns
+ * are matched by simulating the tagged NFA (a Pike VM).
+ */
+
+#ifndef CPPCMB_DETAIL_CAPTURE_AUTOMATON_HPP
+#define CPPCMB_DETAIL_CAPTURE_AUTOMATON_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "dfa.hpp"
+#include "swar.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+/**
+ * Tag positions, npos for the tags that weren't recorded.
+ */
+template <std::size_t Tags>
+using tag_positions = std::array<std::size_t, Tags>;
+
+inline constexpr std::size_t npos_tag = std::size_t(-1);
+
+class capture_automaton {
+public:
+    using tag_mask = std::uint64_t;
+
+    static constexpr std::size_t max_tags = 64;
+
+private:
+    static constexpr std::uint32_t no_node = std::uint32_t(-1);
+
+    // A step of the one-pass automaton
+    struct step {
+        std::uint32_t next = no_node;
+        tag_mask      tags = 0;
+    };
+
+    nfa                        m_Nfa;
+    nfa::fragment              m_Fragment{};
+    byte_classes               m_Classes;
+    bool                       m_OnePass = true;
+
+    // One-pass tables, indexed by node
+    std::vector<step>          m_Steps;
+    std::vector<std::uint8_t>  m_Accepting;
+    std::vector<tag_mask>      m_AcceptTags;
+
+    template <std::size_t Tags>
+    static void apply_tags(tag_positions<Tags>& pos, tag_mask tags,
+        std::size_t at) noexcept {
+        while (tags != 0) {
+            pos[bit_ctz(tags)] = at;
+            tags &= tags - 1;
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Builds the one-pass tables. Every state after a byte transition (and
+     * the start) is a node. From a node, every byte class must lead to at
+     * most one byte transition, through one set of tags, and the final
+     * state must be reachable through at most one set of tags.
+     */
+    void build_one_pass() {
+        auto const repr = m_Classes.representatives();
+        auto const cc = m_Classes.count;
+
+        std::vector<std::uint32_t> node_of(m_Nfa.size(), no_node);
+        std::vector<std::size_t> nodes;
+        auto intern = [&](std::size_t s) {
+            if (node_of[s] == no_node) {
+                node_of[s] = std::uint32_t(nodes.size());
+                nodes.push_back(s);
+                m_Steps.resize(m_Steps.size() + cc);
+                m_Accepting.push_back(0);
+                m_AcceptTags.push_back(0);
+            }
+            return node_of[s];
+        };
+        intern(m_Fragment.start);
+
+        std::vector<tag_mask> seen_tags(m_Nfa.size());
+        std::vector<std::uint8_t> seen(m_Nfa.size());
+        std::vector<std::pair<std::size_t, tag_mask>> stack;
+        for (std::size_t node = 0; node < nodes.size(); ++node) {
+            std::fill(seen.begin(), seen.end(), 0);
+            stack.assign(1, { nodes[node], 0 });
+            while (!stack.empty()) {
+                auto [s, tags] = stack.back();
+                stack.pop_back();
+                if (m_Nfa.tag_of(s) != nfa::no_tag) {
+                    tags |= tag_mask(1) << m_Nfa.tag_of(s);
+                }
+                if (seen[s]) {
+                    if (seen_tags[s] != tags) {
+                        // Two ways to the same state
+                        m_OnePass = false;
+                        return;
+                    }
+                    continue;
+                }
+                seen[s] = 1;
+                seen_tags[s] = tags;
+
+                if (s == m_Fragment.end) {
+                    m_Accepting[node] = 1;
+                    m_AcceptTags[node] = tags;
+                }
+                auto const& bytes = m_Nfa.bytes_of(s);
+                if (bytes.any()) {
+                    auto next = intern(m_Nfa.next_of(s));
+                    for (std::size_t c = 0; c < cc; ++c) {
+                        if (!bytes[repr[c]]) {
+                            continue;
+                        }
+                        auto& st = m_Steps[node * cc + c];
+                        if (st.next != no_node) {
+                            // The byte doesn't decide the way
+                            m_OnePass = false;
+                            return;
+                        }
+                        st = step{ next, tags };
+                    }
+                }
+                for (auto t : m_Nfa.epsilon_of(s)) {
+                    stack.emplace_back(t, tags);
+                }
+            }
+        }
+    }
+
+    template <std::size_t Tags, typename CharT>
+    [[nodiscard]] std::ptrdiff_t match_one_pass(CharT const* data,
+        std::size_t len, tag_positions<Tags>& out, std::size_t& furthest)
+        const noexcept {
+        auto const cc = m_Classes.count;
+        tag_positions<Tags> pos;
+        pos.fill(npos_tag);
+        std::ptrdiff_t last = -1;
+        std::uint32_t node = 0;
+        std::size_t i = 0;
+        while (true) {
+            if (m_Accepting[node]) {
+                last = std::ptrdiff_t(i);
+                out = pos;
+                apply_tags(out, m_AcceptTags[node], i);
+            }
+            if (i == len) {
+                break;
+            }
+            auto b = static_cast<unsigned char>(data[i]);
+            auto const& st = m_Steps[node * cc + m_Classes.of[b]];
+            ++i;
+            if (st.next == no_node) {
+                break;
+            }
+            apply_tags(pos, st.tags, i - 1);
+            node = st.next;
+        }
+        furthest = i;
+        return last;
+    }
+
+    template <std::size_t Tags>
+    struct thread {
+        std::size_t         state;
+        tag_positions<Tags> pos;
+    };
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Adds the state and everything reachable with epsilon moves, in
+     * priority order. The first thread to reach a state wins.
+     */
+    template <std::size_t Tags>
+    void add_thread(std::vector<thread<Tags>>& list,
+        std::vector<std::size_t>& mark, std::size_t gen,
+        std::size_t s, tag_positions<Tags> pos, std::size_t at) const {
+        if (mark[s] == gen) {
+            return;
+        }
+        mark[s] = gen;
+        if (m_Nfa.tag_of(s) != nfa::no_tag) {
+            pos[m_Nfa.tag_of(s)] = at;
+        }
+        list.push_back({ s, pos });
+        for (auto t : m_Nfa.epsilon_of(s)) {
+            add_thread(list, mark, gen, t, pos, at);
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t Tags, typename CharT>
+    [[nodiscard]] std::ptrdiff_t match_nfa(CharT const* data,
+        std::size_t len, tag_positions<Tags>& out,
+        std::size_t& furthest) const {
+        std::vector<thread<Tags>> curr;
+        std::vector<thread<Tags>> next;
+        std::vector<std::size_t> mark(m_Nfa.size(), 0);
+        std::size_t gen = 1;
+
+        tag_positions<Tags> init;
+        init.fill(npos_tag);
+        add_thread(curr, mark, gen, m_Fragment.start, init, 0);
+
+        std::ptrdiff_t last = -1;
+        std::size_t i = 0;
+        while (!curr.empty()) {
+            bool accepted = false;
+            for (auto const& th : curr) {
+                if (th.state == m_Fragment.end && !accepted) {
+                    // Longest match, the first thread at the same length
+                    last = std::ptrdiff_t(i);
+                    out = th.pos;
+                    accepted = true;
+                }
+            }
+            if (i == len) {
+                break;
+            }
+            auto b = static_cast<std::size_t>(
+                static_cast<unsigned char>(data[i])
+            );
+            ++gen;
+            next.clear();
+            for (auto const& th : curr) {
+                if (m_Nfa.bytes_of(th.state)[b]) {
+                    add_thread(
+                        next, mark, gen, m_Nfa.next_of(th.state), th.pos, i + 1
+                    );
+                }
+            }
+            ++i;
+            std::swap(curr, next);
+        }
+        furthest = i;
+        return last;
+    }
+
+public:
+    capture_automaton() = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The fragment's end is the accepting state. Tags must be less than
+     * max_tags.
+     */
+    capture_automaton(nfa n, nfa::fragment f)
+        : m_Nfa(std::move(n)), m_Fragment(f), m_Classes(m_Nfa) {
+        build_one_pass();
+        if (!m_OnePass) {
+            m_Steps.clear();
+            m_Accepting.clear();
+            m_AcceptTags.clear();
+        }
+    }
+
+    /**
+     * True, if the pattern can be matched in one deterministic pass.
+     */
+    [[nodiscard]] bool one_pass() const noexcept {
+        return m_OnePass;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The length of the longest accepted prefix, or -1 if there's none. The
+     * tag positions are the ones of that match. furthest is set to the number
+     * of bytes looked at.
+     */
+    template <std::size_t Tags, typename CharT>
+    [[nodiscard]] std::ptrdiff_t longest_match(CharT const* data,
+        std::size_t len, tag_positions<Tags>& tags,
+        std::size_t& furthest) const {
+        static_assert(sizeof(CharT) == 1, "Automata only work on bytes!");
+        static_assert(Tags <= max_tags, "Too many tags!");
+
+        if (m_OnePass) {
+            return match_one_pass(data, len, tags, furthest);
+        }
+        return match_nfa(data, len, tags, furthest);
+    }
+};
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_DETAIL_CAPTURE_AUTOMATON_HPP */
@@ -0,0 +1,494 @@
+/**
+ * dfa.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Byte-level automata. A Thompson-style NFA is built from the structure of a
+ * regular grammar, then turned into a DFA with the subset construction. The
+ * DFA works on byte classes (bytes that no transition tells apart), which
+ * keeps the transition table small.
+ */
+
+#ifndef CPPCMB_DETAIL_DFA_HPP
+#define CPPCMB_DETAIL_DFA_HPP
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace cppcmb {
+namespace detail {
+
+using byte_set = std::bitset<256>;
+
+/**
+ * An NFA with epsilon moves. Every state has at most one byte transition.
+ * States can carry a tag, that is recorded when a path goes through them,
+ * these mark the boundaries of capture groups. Tags don't change the
+ * language, the DFA ignores them.
+ */
+class nfa {
+public:
+    static constexpr std::size_t no_tag = std::size_t(-1);
+
+    /**
+     * A piece of the automaton with a single entry and a single exit.
+     */
+    struct fragment {
+        std::size_t start;
+        std::size_t end;
+    };
+
+private:
+    struct state {
+        std::vector<std::size_t> epsilon;
+        byte_set                 bytes;
+        std::size_t              next = 0;
+        std::size_t              tag  = no_tag;
+    };
+
+    std::vector<state> m_States;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    std::size_t add_state() {
+        m_States.emplace_back();
+        return m_States.size() - 1;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void add_epsilon(std::size_t from, std::size_t to) {
+        m_States[from].epsilon.push_back(to);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * A fragment that consumes one byte of the set.
+     */
+    fragment bytes(byte_set const& set) {
+        auto s = add_state();
+        auto e = add_state();
+        m_States[s].bytes = set;
+        m_States[s].next = e;
+        return { s, e };
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    fragment epsilon() {
+        auto s = add_state();
+        auto e = add_state();
+        add_epsilon(s, e);
+        return { s, e };
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    fragment sequence(fragment a, fragment b) {
+        add_epsilon(a.end, b.start);
+        return { a.start, b.end };
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    fragment choice(fragment a, fragment b) {
+        auto s = add_state();
+        auto e = add_state();
+        add_epsilon(s, a.start);
+        add_epsilon(s, b.start);
+        add_epsilon(a.end, e);
+        add_epsilon(b.end, e);
+        return { s, e };
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    fragment optional(fragment a) {
+        return choice(a, epsilon());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Records open before, and close after the fragment.
+     */
+    fragment tagged(fragment a, std::size_t open, std::size_t close) {
+        auto s = add_state();
+        auto e = add_state();
+        m_States[s].tag = open;
+        m_States[e].tag = close;
+        add_epsilon(s, a.start);
+        add_epsilon(a.end, e);
+        return { s, e };
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    fragment repeat(fragment a) {
+        auto s = add_state();
+        auto e = add_state();
+        add_epsilon(s, a.start);
+        add_epsilon(s, e);
+        add_epsilon(a.end, a.start);
+        add_epsilon(a.end, e);
+        return { s, e };
+    }
+
+    /**
+     * Makes the states from the first one on ignore ASCII case, every byte
+     * behaves like its lower-case version.
+     */
+    void fold_case(std::size_t first) noexcept {
+        for (auto s = first; s < m_States.size(); ++s) {
+            auto& bytes = m_States[s].bytes;
+            for (std::size_t b = 'A'; b <= 'Z'; ++b) {
+                bytes[b] = bytes[b - 'A' + 'a'];
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_States.size();
+    }
+
+    [[nodiscard]] byte_set const& bytes_of(std::size_t s) const noexcept {
+        return m_States[s].bytes;
+    }
+
+    [[nodiscard]] std::size_t next_of(std::size_t s) const noexcept {
+        return m_States[s].next;
+    }
+
+    [[nodiscard]] std::vector<std::size_t> const& epsilon_of(std::size_t s)
+        const noexcept {
+        return m_States[s].epsilon;
+    }
+
+    [[nodiscard]] std::size_t tag_of(std::size_t s) const noexcept {
+        return m_States[s].tag;
+    }
+};
+
+/**
+ * Byte classes of an NFA: bytes get the same class if no byte transition
+ * tells them apart.
+ */
+struct byte_classes {
+    std::array<std::uint8_t, 256> of{};
+    std::size_t                   count = 1;
+
+    byte_classes() = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    explicit byte_classes(nfa const& n) {
+        // Split the classes by every byte set of the NFA
+        for (std::size_t s = 0; s < n.size(); ++s) {
+            auto const& set = n.bytes_of(s);
+            if (set.none()) {
+                continue;
+            }
+            std::map<std::pair<std::uint8_t, bool>, std::uint8_t> split;
+            for (std::size_t b = 0; b < 256; ++b) {
+                auto key = std::make_pair(of[b], bool(set[b]));
+                auto it = split.try_emplace(
+                    key, std::uint8_t(split.size())
+                ).first;
+                of[b] = it->second;
+            }
+            count = split.size();
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * A byte of every class.
+     */
+    [[nodiscard]] std::vector<std::size_t> representatives() const {
+        std::vector<std::size_t> repr(count);
+        for (std::size_t b = 256; b-- > 0;) {
+            repr[of[b]] = b;
+        }
+        return repr;
+    }
+};
+
+/**
+ * A DFA over byte classes. State 0 is the dead state, it has no way out. A
+ * DFA can have multiple accepting NFA states (rules), a DFA state accepts the
+ * first rule it contains.
+ */
+class dfa {
+public:
+    using state_type = std::uint32_t;
+
+    static constexpr state_type dead = 0;
+    static constexpr std::size_t no_rule = std::size_t(-1);
+    // The number of records matched at once
+    static constexpr std::size_t batch_lanes = 16;
+
+private:
+    std::array<std::uint8_t, 256> m_Classes{};
+    std::size_t                   m_ClassCount = 1;
+    std::vector<state_type>       m_Table;
+    // The accepted rule plus one, 0 if the state doesn't accept
+    std::vector<std::uint32_t>    m_Accepting;
+    state_type                    m_Start = dead;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void close(nfa const& n, std::vector<std::size_t>& set) {
+        std::vector<std::size_t> stack = set;
+        std::vector<bool> seen(n.size());
+        for (auto s : set) {
+            seen[s] = true;
+        }
+        while (!stack.empty()) {
+            auto s = stack.back();
+            stack.pop_back();
+            for (auto t : n.epsilon_of(s)) {
+                if (!seen[t]) {
+                    seen[t] = true;
+                    set.push_back(t);
+                    stack.push_back(t);
+                }
+            }
+        }
+        std::sort(set.begin(), set.end());
+    }
+
+public:
+    dfa() = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The subset construction. The fragment's end is the accepting state.
+     */
+    dfa(nfa const& n, nfa::fragment f)
+        : dfa(n, f.start, std::vector<std::size_t>{ f.end }) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The subset construction with multiple rules, rule i is accepted in the
+     * NFA state ends[i].
+     */
+    dfa(nfa const& n, std::size_t start,
+        std::vector<std::size_t> const& ends) {
+        auto classes = byte_classes(n);
+        m_Classes = classes.of;
+        m_ClassCount = classes.count;
+        auto repr = classes.representatives();
+
+        std::map<std::vector<std::size_t>, state_type> ids;
+        std::vector<std::vector<std::size_t>> sets;
+        auto intern = [&](std::vector<std::size_t> set) {
+            if (set.empty()) {
+                return dead;
+            }
+            auto [it, inserted] = ids.try_emplace(set, state_type(sets.size()));
+            if (inserted) {
+                std::uint32_t accepting = 0;
+                for (std::size_t i = 0; i < ends.size(); ++i) {
+                    if (std::binary_search(set.begin(), set.end(), ends[i])) {
+                        accepting = std::uint32_t(i + 1);
+                        break;
+                    }
+                }
+                sets.push_back(std::move(set));
+                m_Accepting.push_back(accepting);
+                m_Table.resize(m_Table.size() + m_ClassCount, dead);
+            }
+            return it->second;
+        };
+
+        // The dead state
+        sets.emplace_back();
+        m_Accepting.push_back(0);
+        m_Table.resize(m_ClassCount, dead);
+
+        std::vector<std::size_t> init = { start };
+        close(n, init);
+        m_Start = intern(std::move(init));
+
+        for (std::size_t id = 1; id < sets.size(); ++id) {
+            for (std::size_t c = 0; c < m_ClassCount; ++c) {
+                std::vector<std::size_t> target;
+                for (auto s : sets[id]) {
+                    if (n.bytes_of(s)[repr[c]]) {
+                        target.push_back(n.next_of(s));
+                    }
+                }
+                close(n, target);
+                target.erase(
+                    std::unique(target.begin(), target.end()), target.end()
+                );
+                auto to = intern(std::move(target));
+                m_Table[id * m_ClassCount + c] = to;
+            }
+        }
+    }
+
+    [[nodiscard]] state_type start() const noexcept {
+        return m_Start;
+    }
+
+    [[nodiscard]] std::size_t state_count() const noexcept {
+        return m_Accepting.size();
+    }
+
+    [[nodiscard]] std::size_t class_count() const noexcept {
+        return m_ClassCount;
+    }
+
+    [[nodiscard]] std::uint8_t class_of(unsigned char b) const noexcept {
+        return m_Classes[b];
+    }
+
+    [[nodiscard]] bool accepting(state_type s) const noexcept {
+        return m_Accepting[s] != 0;
+    }
+
+    /**
+     * The rule accepted in the state, or no_rule.
+     */
+    [[nodiscard]] std::size_t rule(state_type s) const noexcept {
+        return m_Accepting[s] == 0 ? no_rule : m_Accepting[s] - 1;
+    }
+
+    [[nodiscard]] state_type next(state_type s, unsigned char b)
+        const noexcept {
+        return m_Table[s * m_ClassCount + m_Classes[b]];
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The states that can still reach an accepting state.
+     */
+    [[nodiscard]] std::vector<bool> live_states() const {
+        std::vector<bool> live(state_count());
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (std::size_t s = 1; s < live.size(); ++s) {
+                if (live[s]) {
+                    continue;
+                }
+                bool l = m_Accepting[s] != 0;
+                for (std::size_t c = 0; !l && c < m_ClassCount; ++c) {
+                    l = live[m_Table[s * m_ClassCount + c]];
+                }
+                if (l) {
+                    live[s] = true;
+                    changed = true;
+                }
+            }
+        }
+        return live;
+    }
+
+    /**
+     * The length of the longest prefix of the bytes that is accepted, or -1
+     * if there's none. furthest is set to the number of bytes looked at.
+     */
+    template <typename CharT>
+    [[nodiscard]] std::ptrdiff_t longest_match(CharT const* data,
+        std::size_t len, std::size_t& furthest) const noexcept {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        auto s = m_Start;
+        std::ptrdiff_t last = accepting(s) ? 0 : -1;
+        std::size_t i = 0;
+        while (i < len) {
+            s = next(s, static_cast<unsigned char>(data[i]));
+            ++i;
+            if (s == dead) {
+                break;
+            }
+            if (accepting(s)) {
+                last = std::ptrdiff_t(i);
+            }
+        }
+        furthest = i;
+        return last;
+    }
+
+    /**
+     * Like longest_match, but also tells the rule accepted at the end of the
+     * match.
+     */
+    template <typename CharT>
+    [[nodiscard]] std::ptrdiff_t longest_match(CharT const* data,
+        std::size_t len, std::size_t& furthest, std::size_t& matched_rule)
+        const noexcept {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        auto s = m_Start;
+        std::ptrdiff_t last = accepting(s) ? 0 : -1;
+        matched_rule = rule(s);
+        std::size_t i = 0;
+        while (i < len) {
+            s = next(s, static_cast<unsigned char>(data[i]));
+            ++i;
+            if (s == dead) {
+                break;
+            }
+            if (accepting(s)) {
+                last = std::ptrdiff_t(i);
+                matched_rule = rule(s);
+            }
+        }
+        furthest = i;
+        return last;
+    }
+
+    /**
+     * Matches at most batch_lanes records at once, record i is data[i] with
+     * length lens[i]. Bit i of the result is set, if the whole record is
+     * accepted. The lanes step in lockstep, so the independent table loads
+     * overlap (and can be compiled into gathers), instead of waiting for each
+     * other one record at a time.
+     */
+    template <typename CharT>
+    [[nodiscard]] std::uint32_t full_match_batch(CharT const* const* data,
+        std::size_t const* lens, std::size_t n) const noexcept {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        std::array<unsigned char const*, batch_lanes> bytes{};
+        std::array<std::size_t, batch_lanes> len{};
+        std::array<state_type, batch_lanes> s{};
+        std::size_t longest = 0;
+        for (std::size_t l = 0; l < n; ++l) {
+            bytes[l] = reinterpret_cast<unsigned char const*>(data[l]);
+            len[l] = lens[l];
+            s[l] = m_Start;
+            longest = len[l] > longest ? len[l] : longest;
+        }
+
+        auto const* table = m_Table.data();
+        auto const* classes = m_Classes.data();
+        auto const cc = m_ClassCount;
+        for (std::size_t i = 0; i < longest; ++i) {
+            state_type alive = 0;
+            for (std::size_t l = 0; l < batch_lanes; ++l) {
+                // Finished lanes read a dummy byte and keep their state
+                bool active = i < len[l];
+                auto b = active ? bytes[l][i] : 0;
+                auto next = table[s[l] * cc + classes[b]];
+                s[l] = active ? next : s[l];
+                alive |= s[l];
+            }
+            if (alive == dead) {
+                break;
+            }
+        }
+
+        std::uint32_t bits = 0;
+        for (std::size_t l = 0; l < n; ++l) {
+            bits |= std::uint32_t(m_Accepting[s[l]] != 0) << l;
+        }
+        return bits;
+    }
+};
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_DETAIL_DFA_HPP */
@@ -0,0 +1,176 @@
+/**
+ * hash.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A fast, non-cryptographic 128-bit hash for byte sequences. It follows the
+ * structure of xxHash64: the input is consumed in 32 byte stripes by 4
+ * independent accumulator lanes, which the compiler is free to vectorize.
+ */
+
+#ifndef CPPCMB_DETAIL_HASH_HPP
+#define CPPCMB_DETAIL_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace cppcmb {
+namespace detail {
+
+/**
+ * A 128-bit hash value.
+ */
+struct hash128 {
+    std::uint64_t low  = 0;
+    std::uint64_t high = 0;
+
+    [[nodiscard]] constexpr bool operator==(hash128 const& o) const noexcept {
+        return low == o.low && high == o.high;
+    }
+
+    [[nodiscard]] constexpr bool operator!=(hash128 const& o) const noexcept {
+        return !(*this == o);
+    }
+};
+
+/**
+ * Hasher for using hash128 as a key in unordered containers.
+ */
+struct hash128_hasher {
+    [[nodiscard]] constexpr std::size_t operator()(hash128 const& h)
+        const noexcept {
+        // The bits are already well mixed
+        return std::size_t(h.low ^ h.high);
+    }
+};
+
+namespace hash_impl {
+
+inline constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87U;
+inline constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FU;
+inline constexpr std::uint64_t prime3 = 0x165667B19E3779F9U;
+inline constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63U;
+inline constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5U;
+
+[[nodiscard]] constexpr std::uint64_t rotl(std::uint64_t x, unsigned r)
+    noexcept {
+    return (x << r) | (x >> (64U - r));
+}
+
+[[nodiscard]] inline std::uint64_t read64(unsigned char const* p) noexcept {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+[[nodiscard]] inline std::uint64_t read32(unsigned char const* p) noexcept {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+[[nodiscard]] constexpr std::uint64_t mix_round(
+    std::uint64_t acc, std::uint64_t in) noexcept {
+    acc += in * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+[[nodiscard]] constexpr std::uint64_t merge(std::uint64_t acc, std::uint64_t v)
+    noexcept {
+    acc ^= mix_round(0, v);
+    return acc * prime1 + prime4;
+}
+
+[[nodiscard]] constexpr std::uint64_t avalanche(std::uint64_t h) noexcept {
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+} /* namespace hash_impl */
+
+/**
+ * Hashes len bytes starting at data.
+ */
+[[nodiscard]] inline hash128 hash_bytes(
+    void const* data, std::size_t len, std::uint64_t seed = 0) noexcept {
+
+    using namespace hash_impl;
+
+    auto const* p = static_cast<unsigned char const*>(data);
+    auto const* const end = p + len;
+
+    std::uint64_t h1;
+    std::uint64_t h2;
+    if (len >= 32) {
+        std::uint64_t v1 = seed + prime1 + prime2;
+        std::uint64_t v2 = seed + prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - prime1;
+        // Main loop, the 4 lanes don't depend on each other
+        auto const* const limit = end - 32;
+        do {
+            v1 = mix_round(v1, read64(p));
+            v2 = mix_round(v2, read64(p + 8));
+            v3 = mix_round(v3, read64(p + 16));
+            v4 = mix_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h1 = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h1 = merge(merge(merge(merge(h1, v1), v2), v3), v4);
+        // The second half combines the lanes in a different order
+        h2 = rotl(v4, 1) + rotl(v3, 7) + rotl(v2, 12) + rotl(v1, 18);
+        h2 = merge(merge(merge(merge(h2, v4), v3), v2), v1);
+    }
+    else {
+        h1 = seed + prime5;
+        h2 = seed + prime4;
+    }
+
+    h1 += std::uint64_t(len);
+    h2 ^= std::uint64_t(len) * prime1;
+
+    // Tail
+    for (; end - p >= 8; p += 8) {
+        auto k = mix_round(0, read64(p));
+        h1 = rotl(h1 ^ k, 27) * prime1 + prime4;
+        h2 = rotl(h2 + k, 31) * prime2 + prime3;
+    }
+    if (end - p >= 4) {
+        auto k = read32(p) * prime1;
+        h1 = rotl(h1 ^ k, 23) * prime2 + prime3;
+        h2 = rotl(h2 + k, 29) * prime3 + prime5;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        auto k = std::uint64_t(*p) * prime5;
+        h1 = rotl(h1 ^ k, 11) * prime1;
+        h2 = rotl(h2 + k, 13) * prime2;
+    }
+
+    h1 = avalanche(h1);
+    h2 = avalanche(h2 ^ h1);
+    return { h1, h2 };
+}
+
+/**
+ * Hashes the contents of a string view.
+ */
+template <typename CharT>
+[[nodiscard]] hash128 hash_string(
+    std::basic_string_view<CharT> str, std::uint64_t seed = 0) noexcept {
+    return hash_bytes(str.data(), str.size() * sizeof(CharT), seed);
+}
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_DETAIL_HASH_HPP */
@@ -0,0 +1,306 @@
+/**
+ * prefilter.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Unanchored DFA search. Running the automaton from every position is slow,
+ * so the runs from the candidate positions are advanced together, and a
+ * prefilter derived from the automaton skips the positions where no match
+ * can start: a required literal prefix is found with memchr on its
+ * rarest byte, a small set of first bytes with block scanning.
+ */
+
+#ifndef CPPCMB_DETAIL_PREFILTER_HPP
+#define CPPCMB_DETAIL_PREFILTER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "block_scan.hpp"
+#include "dfa.hpp"
+#include "swar.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+/**
+ * A rough rank of how common a byte is in text, higher is more common.
+ */
+[[nodiscard]] constexpr int byte_rank(unsigned char b) noexcept {
+    if (b == ' ') {
+        return 6;
+    }
+    if (b >= 'a' && b <= 'z') {
+        auto frequent = std::string_view("etaoinsr");
+        return frequent.find(char(b)) != std::string_view::npos ? 5 : 4;
+    }
+    if ((b >= '0' && b <= '9') || (b >= 'A' && b <= 'Z')
+        || b == '\n' || b == '\t' || b == ',' || b == '.') {
+        return 3;
+    }
+    if (b >= 0x20 && b < 0x7f) {
+        return 2;
+    }
+    return 1;
+}
+
+/**
+ * Finds the positions where a match of an automaton can start.
+ */
+class prefilter {
+public:
+    static constexpr std::size_t npos = std::size_t(-1);
+    // Longer prefixes don't skip more
+    static constexpr std::size_t max_prefix = 32;
+    // Larger first byte sets are looked up in a table
+    static constexpr std::size_t max_scan_bytes = 4;
+
+private:
+    enum class kind { any, literal, bytes };
+
+    kind                                      m_Kind = kind::any;
+    std::string                               m_Prefix;
+    std::size_t                               m_Rare = 0;
+    std::array<bool, 256>                     m_First{};
+    std::array<unsigned char, max_scan_bytes> m_Scan{};
+    std::size_t                               m_ScanCount = 0;
+
+    [[nodiscard]] std::size_t find_literal(unsigned char const* data,
+        std::size_t len, std::size_t from) const noexcept {
+        auto const plen = m_Prefix.size();
+        auto const* prefix = m_Prefix.data();
+        auto const rare = static_cast<unsigned char>(m_Prefix[m_Rare]);
+        while (from + plen <= len) {
+            auto const* hit = static_cast<unsigned char const*>(std::memchr(
+                data + from + m_Rare, rare, len - plen - from + 1
+            ));
+            if (hit == nullptr) {
+                return npos;
+            }
+            auto cand = std::size_t(hit - data) - m_Rare;
+            if (std::memcmp(data + cand, prefix, plen) == 0) {
+                return cand;
+            }
+            from = cand + 1;
+        }
+        return npos;
+    }
+
+    [[nodiscard]] std::size_t find_bytes(unsigned char const* data,
+        std::size_t len, std::size_t from) const noexcept {
+        if (m_ScanCount == 0) {
+            for (; from < len; ++from) {
+                if (m_First[data[from]]) {
+                    return from;
+                }
+            }
+            return npos;
+        }
+        for (; from < len; from += block_width) {
+            auto block = byte_block(data + from, len - from);
+            auto mask = block.eq_any(m_Scan.data(), m_ScanCount);
+            if (mask != 0) {
+                return from + bit_ctz(mask);
+            }
+        }
+        return npos;
+    }
+
+public:
+    prefilter() = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    explicit prefilter(dfa const& d) {
+        if (d.accepting(d.start())) {
+            // Matches the empty string anywhere
+            return;
+        }
+
+        // Follow the start while exactly one byte leads on
+        auto s = d.start();
+        while (m_Prefix.size() < max_prefix && !d.accepting(s)) {
+            std::size_t count = 0;
+            unsigned char only = 0;
+            for (std::size_t b = 0; b < 256 && count < 2; ++b) {
+                if (d.next(s, static_cast<unsigned char>(b)) != dfa::dead) {
+                    only = static_cast<unsigned char>(b);
+                    ++count;
+                }
+            }
+            if (count != 1) {
+                break;
+            }
+            m_Prefix.push_back(static_cast<char>(only));
+            s = d.next(s, only);
+        }
+        if (!m_Prefix.empty()) {
+            m_Kind = kind::literal;
+            for (std::size_t i = 1; i < m_Prefix.size(); ++i) {
+                auto rank = [&](std::size_t j) {
+                    return byte_rank(static_cast<unsigned char>(m_Prefix[j]));
+                };
+                if (rank(i) < rank(m_Rare)) {
+                    m_Rare = i;
+                }
+            }
+            return;
+        }
+
+        m_Kind = kind::bytes;
+        std::size_t count = 0;
+        for (std::size_t b = 0; b < 256; ++b) {
+            auto ch = static_cast<unsigned char>(b);
+            m_First[b] = d.next(d.start(), ch) != dfa::dead;
+            if (m_First[b] && count++ < max_scan_bytes) {
+                m_Scan[count - 1] = ch;
+            }
+        }
+        m_ScanCount = count <= max_scan_bytes ? count : 0;
+    }
+
+    /**
+     * The required literal prefix of every match, might be empty.
+     */
+    [[nodiscard]] std::string const& prefix() const noexcept {
+        return m_Prefix;
+    }
+
+    /**
+     * The first position from 'from' where a match can start, or npos. For
+     * patterns that can match the empty string, every position up to and
+     * including len is a candidate.
+     */
+    [[nodiscard]] std::size_t next(unsigned char const* data,
+        std::size_t len, std::size_t from) const noexcept {
+        switch (m_Kind) {
+        case kind::literal: return find_literal(data, len, from);
+        case kind::bytes:   return find_bytes(data, len, from);
+        default:            return from <= len ? from : npos;
+        }
+    }
+};
+
+/**
+ * A match found by searching, npos begin if there's none.
+ */
+struct match_span {
+    std::size_t begin  = prefilter::npos;
+    std::size_t length = 0;
+};
+
+/**
+ * A DFA with its prefilter, finds the leftmost-longest match.
+ */
+class dfa_searcher {
+private:
+    /**
+     * An anchored run of the DFA that is still alive.
+     */
+    struct run {
+        dfa::state_type state;
+        std::size_t     begin;
+    };
+
+    dfa       m_Dfa;
+    prefilter m_Prefilter;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    explicit dfa_searcher(dfa d)
+        : m_Dfa(std::move(d)), m_Prefilter(m_Dfa) {
+    }
+
+    [[nodiscard]] dfa const& automaton() const noexcept {
+        return m_Dfa;
+    }
+
+    [[nodiscard]] prefilter const& filter() const noexcept {
+        return m_Prefilter;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Finds the first match that starts at 'from' or later. furthest is set
+     * to the number of bytes looked at.
+     *
+     * The runs from every candidate start are advanced together in one
+     * forward pass, ordered by their start. Runs that reach the same state
+     * have the same future, so only the earliest one is kept. This bounds the
+     * live runs by the number of states, so the search is linear in the
+     * input, instead of re-scanning from every failed candidate.
+     */
+    template <typename CharT>
+    [[nodiscard]] match_span search(CharT const* chars, std::size_t len,
+        std::size_t from, std::size_t& furthest) const {
+        static_assert(sizeof(CharT) == 1, "DFAs only work on bytes!");
+
+        auto const* data = reinterpret_cast<unsigned char const*>(chars);
+        auto best = match_span();
+        std::vector<run> runs;
+        std::vector<run> next_runs;
+        // The position, at which a state was last taken by a run
+        std::vector<std::size_t> taken(m_Dfa.state_count(), prefilter::npos);
+
+        auto pos = from;
+        furthest = from;
+        while (true) {
+            if (runs.empty()) {
+                if (best.begin != prefilter::npos) {
+                    break;
+                }
+                pos = m_Prefilter.next(data, len, pos);
+                if (pos == prefilter::npos) {
+                    furthest = len;
+                    break;
+                }
+            }
+            // A new run starts here, unless a match started before
+            auto start = m_Dfa.start();
+            if (best.begin == prefilter::npos && taken[start] != pos) {
+                taken[start] = pos;
+                runs.push_back({ start, pos });
+                if (m_Dfa.accepting(start)) {
+                    best = { pos, 0 };
+                }
+            }
+            if (pos == len) {
+                break;
+            }
+
+            auto b = data[pos++];
+            furthest = pos;
+            next_runs.clear();
+            for (auto const& r : runs) {
+                if (best.begin != prefilter::npos && r.begin > best.begin) {
+                    // Can't be leftmost anymore, the later runs neither
+                    break;
+                }
+                auto s = m_Dfa.next(r.state, b);
+                if (s == dfa::dead || taken[s] == pos) {
+                    continue;
+                }
+                taken[s] = pos;
+                next_runs.push_back({ s, r.begin });
+                if (m_Dfa.accepting(s) && (best.begin == prefilter::npos
+                    || r.begin < best.begin
+                    || (r.begin == best.begin
+                        && pos - r.begin > best.length))) {
+                    best = { r.begin, pos - r.begin };
+                }
+            }
+            std::swap(runs, next_runs);
+        }
+        return best;
+    }
+};
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_DETAIL_PREFILTER_HPP */
@@ -0,0 +1,194 @@
+/**
+ * swar.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * SIMD-within-a-register helpers. These let the bulk-scanning parsers process
+ * 8 bytes at a time without depending on platform-specific intrinsics.
+ */
+
+#ifndef CPPCMB_DETAIL_SWAR_HPP
+#define CPPCMB_DETAIL_SWAR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace cppcmb {
+namespace detail {
+
+inline constexpr std::size_t swar_width = sizeof(std::uint64_t);
+
+inline constexpr std::uint64_t swar_ones = 0x0101010101010101U;
+inline constexpr std::uint64_t swar_highs = 0x8080808080808080U;
+
+/**
+ * Loads 8 bytes from an arbitrarily aligned address.
+ */
+template <typename CharT>
+[[nodiscard]] inline std::uint64_t swar_load(CharT const* p) noexcept {
+    static_assert(sizeof(CharT) == 1, "SWAR loads only work on bytes!");
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+/**
+ * Broadcasts a byte to every lane of the word.
+ */
+[[nodiscard]] constexpr std::uint64_t swar_broadcast(unsigned char b) noexcept {
+    return swar_ones * b;
+}
+
+/**
+ * True, if every byte of the word is 7-bit ASCII.
+ */
+[[nodiscard]] constexpr bool swar_is_ascii(std::uint64_t word) noexcept {
+    return (word & swar_highs) == 0;
+}
+
+/**
+ * Converts every ASCII upper-case letter in the word to lower-case, leaving
+ * every other byte untouched.
+ */
+[[nodiscard]] constexpr std::uint64_t swar_to_lower(std::uint64_t word)
+    noexcept {
+    // Only look at the low 7 bits, so the additions can't carry between lanes
+    auto low7 = word & ~swar_highs;
+    // The high bit of the lanes is set where the byte is >= 'A' and > 'Z'
+    auto ge_a = low7 + swar_broadcast(0x80 - 'A');
+    auto gt_z = low7 + swar_broadcast(0x80 - 'Z' - 1);
+    auto is_upper = (ge_a ^ gt_z) & ~word & swar_highs;
+    // 0x80 >> 2 is 0x20, the ASCII case bit
+    return word | (is_upper >> 2);
+}
+
+/**
+ * Returns a word, where the high bit of lane i is set if byte i of the word is
+ * in [lo; hi]. Every other bit is zero. Only works on 7-bit ASCII words and
+ * bounds.
+ */
+[[nodiscard]] constexpr std::uint64_t swar_in_range(std::uint64_t word,
+    unsigned char lo, unsigned char hi) noexcept {
+    // Like in swar_to_lower, the high bit of the lanes is set where the byte
+    // is >= lo and > hi, the additions can't carry between lanes
+    auto ge_lo = word + swar_broadcast(static_cast<unsigned char>(0x80 - lo));
+    auto gt_hi = word + swar_broadcast(
+        static_cast<unsigned char>(0x80 - hi - 1)
+    );
+    return ge_lo & ~gt_hi & swar_highs;
+}
+
+/**
+ * Returns a word, where the high bit of lane i is set if byte i of the word
+ * equals b. Every other bit is zero.
+ */
+[[nodiscard]] constexpr std::uint64_t swar_eq_lanes(std::uint64_t word,
+    unsigned char b) noexcept {
+    auto x = word ^ swar_broadcast(b);
+    // The high bit of every lane is set where the lane is zero
+    auto low7 = ~swar_highs;
+    return ~(((x & low7) + low7) | x) & swar_highs;
+}
+
+/**
+ * Gathers the high bits of the lanes into a byte, bit i from lane i.
+ */
+[[nodiscard]] constexpr unsigned swar_gather_highs(std::uint64_t highs)
+    noexcept {
+    // Gather the high bits into the top byte
+    return unsigned((((highs & swar_highs) >> 7) * 0x0102040810204080U) >> 56);
+}
+
+/**
+ * Returns a byte, where bit i is set if byte i of the word equals b.
+ */
+[[nodiscard]] constexpr unsigned swar_eq_bits(std::uint64_t word,
+    unsigned char b) noexcept {
+    return swar_gather_highs(swar_eq_lanes(word, b));
+}
+
+/**
+ * Number of set bits.
+ */
+[[nodiscard]] constexpr unsigned bit_count(std::uint64_t x) noexcept {
+    x = x - ((x >> 1) & 0x5555555555555555U);
+    x = (x & 0x3333333333333333U) + ((x >> 2) & 0x3333333333333333U);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FU;
+    return unsigned((x * swar_ones) >> 56);
+}
+
+/**
+ * Index of the lowest set bit. x must not be 0.
+ */
+[[nodiscard]] constexpr unsigned bit_ctz(std::uint64_t x) noexcept {
+    // The isolated lowest bit times a de Bruijn sequence has a distinct top
+    // 6 bits for every bit index
+    constexpr unsigned char index[64] = {
+         0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6,
+    };
+    return index[((x & (~x + 1)) * 0x03F79D71B4CB0A89U) >> 58];
+}
+
+/**
+ * Bit i of the result is the XOR of bits 0..i of x.
+ */
+[[nodiscard]] constexpr std::uint64_t prefix_xor(std::uint64_t x) noexcept {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/**
+ * The length of the common prefix of [a; a + n) and [b; b + n). Bytes are
+ * compared a word at a time, only the first differing word byte by byte.
+ */
+template <typename CharT>
+[[nodiscard]] inline std::size_t common_prefix(CharT const* a,
+    CharT const* b, std::size_t n) noexcept {
+    std::size_t i = 0;
+    if constexpr (sizeof(CharT) == 1) {
+        while (i + swar_width <= n && swar_load(a + i) == swar_load(b + i)) {
+            i += swar_width;
+        }
+    }
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+/**
+ * The length of the common suffix of [a_end - n; a_end) and
+ * [b_end - n; b_end), like common_prefix, but backwards.
+ */
+template <typename CharT>
+[[nodiscard]] inline std::size_t common_suffix(CharT const* a_end,
+    CharT const* b_end, std::size_t n) noexcept {
+    std::size_t i = 0;
+    if constexpr (sizeof(CharT) == 1) {
+        while (i + swar_width <= n
+            && swar_load(a_end - i - swar_width)
+            == swar_load(b_end - i - swar_width)) {
+            i += swar_width;
+        }
+    }
+    while (i < n && a_end[-std::ptrdiff_t(i) - 1]
+        == b_end[-std::ptrdiff_t(i) - 1]) {
+        ++i;
+    }
+    return i;
+}
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_DETAIL_SWAR_HPP */
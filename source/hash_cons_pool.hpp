@@ -0,0 +1,137 @@
+/**
+ * hash_cons_pool.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Hash-consing of values, like the nodes of a syntax tree. Equal values are
+ * stored once and shared, so repetitive inputs take less memory, and shared
+ * values can be compared by their address.
+ */
+
+#ifndef CPPCMB_HASH_CONS_POOL_HPP
+#define CPPCMB_HASH_CONS_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "detail.hpp"
+
+namespace cppcmb {
+
+/**
+ * An open-addressed hash table of shared, immutable values. The values stay
+ * alive as long as anything refers to them, even after the pool is cleared
+ * or destroyed.
+ */
+template <typename T, typename Hash = std::hash<T>,
+    typename Eq = std::equal_to<T>>
+class hash_cons_pool {
+public:
+    using value_type   = T;
+    using pointer_type = std::shared_ptr<T const>;
+
+private:
+    static constexpr std::size_t empty = std::size_t(-1);
+
+    struct slot {
+        std::size_t   index = empty;
+        // The low bits of the hash, to skip most comparisons
+        std::uint32_t hash  = 0;
+    };
+
+    std::vector<slot>         m_Slots;
+    std::vector<pointer_type> m_Values;
+    std::vector<std::size_t>  m_Hashes;
+    Hash                      m_Hash;
+    Eq                        m_Eq;
+
+    // XXX(LPeter1997): Noexcept specifier
+    void grow() {
+        auto slots = std::vector<slot>(
+            m_Slots.empty() ? 64 : m_Slots.size() * 2
+        );
+        auto const mask = slots.size() - 1;
+        for (auto const& s : m_Slots) {
+            if (s.index == empty) {
+                continue;
+            }
+            auto i = m_Hashes[s.index] & mask;
+            while (slots[i].index != empty) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = s;
+        }
+        m_Slots = std::move(slots);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The slot of the value, or the empty slot where it would be inserted.
+     */
+    [[nodiscard]] std::size_t probe(T const& value, std::size_t h) const {
+        auto const mask = m_Slots.size() - 1;
+        auto i = h & mask;
+        while (true) {
+            auto const& s = m_Slots[i];
+            if (s.index == empty || (s.hash == std::uint32_t(h)
+                && m_Eq(*m_Values[s.index], value))) {
+                return i;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    explicit hash_cons_pool(Hash hash = Hash(), Eq eq = Eq())
+        : m_Hash(std::move(hash)), m_Eq(std::move(eq)) {
+    }
+
+    /**
+     * The number of distinct values.
+     */
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_Values.size();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The shared value equal to the argument, it's only copied into the pool
+     * if it's not there yet.
+     */
+    template <typename TFwd>
+    pointer_type intern(TFwd&& value) {
+        // Keep the load factor under 1/2
+        if (2 * (m_Values.size() + 1) > m_Slots.size()) {
+            grow();
+        }
+        auto h = std::size_t(m_Hash(value));
+        auto& s = m_Slots[probe(value, h)];
+        if (s.index == empty) {
+            s.index = m_Values.size();
+            s.hash = std::uint32_t(h);
+            m_Values.push_back(std::make_shared<T const>(cppcmb_fwd(value)));
+            m_Hashes.push_back(h);
+        }
+        return m_Values[s.index];
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Forgets every value, like between parses. The values that are still
+     * referenced stay valid.
+     */
+    void clear() {
+        m_Slots.clear();
+        m_Values.clear();
+        m_Hashes.clear();
+    }
+};
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_HASH_CONS_POOL_HPP */
@@ -0,0 +1,156 @@
+/**
+ * inline_vector.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A vector-like container with a fixed capacity that stores its elements
+ * inline, so it never allocates.
+ */
+
+#ifndef CPPCMB_INLINE_VECTOR_HPP
+#define CPPCMB_INLINE_VECTOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "detail.hpp"
+
+namespace cppcmb {
+
+template <typename T, std::size_t Capacity>
+class inline_vector {
+public:
+    using value_type     = T;
+    using size_type      = std::size_t;
+    using iterator       = T*;
+    using const_iterator = T const*;
+
+private:
+    // Zero-sized arrays are not allowed
+    static constexpr std::size_t storage_count = Capacity > 0 ? Capacity : 1;
+
+    alignas(T) unsigned char m_Storage[sizeof(T) * storage_count];
+    std::size_t m_Size = 0;
+
+public:
+    inline_vector() noexcept = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    inline_vector(inline_vector const& o) {
+        for (auto const& e : o) {
+            push_back(e);
+        }
+    }
+
+    inline_vector(inline_vector&& o)
+        noexcept(std::is_nothrow_move_constructible_v<T>) {
+        for (auto& e : o) {
+            push_back(std::move(e));
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    inline_vector& operator=(inline_vector const& o) {
+        if (this != &o) {
+            clear();
+            for (auto const& e : o) {
+                push_back(e);
+            }
+        }
+        return *this;
+    }
+
+    inline_vector& operator=(inline_vector&& o)
+        noexcept(std::is_nothrow_move_constructible_v<T>) {
+        if (this != &o) {
+            clear();
+            for (auto& e : o) {
+                push_back(std::move(e));
+            }
+        }
+        return *this;
+    }
+
+    ~inline_vector() {
+        clear();
+    }
+
+    [[nodiscard]] static constexpr std::size_t capacity() noexcept {
+        return Capacity;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_Size; }
+    [[nodiscard]] bool empty() const noexcept { return m_Size == 0; }
+    [[nodiscard]] bool full() const noexcept { return m_Size == Capacity; }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    [[nodiscard]] T* data() noexcept {
+        return std::launder(reinterpret_cast<T*>(m_Storage));
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    [[nodiscard]] T const* data() const noexcept {
+        return std::launder(reinterpret_cast<T const*>(m_Storage));
+    }
+
+    [[nodiscard]] iterator begin() noexcept { return data(); }
+    [[nodiscard]] const_iterator begin() const noexcept { return data(); }
+    [[nodiscard]] iterator end() noexcept { return data() + m_Size; }
+    [[nodiscard]] const_iterator end() const noexcept {
+        return data() + m_Size;
+    }
+
+    [[nodiscard]] T& operator[](std::size_t idx) noexcept {
+        cppcmb_assert("Index out of bounds!", idx < m_Size);
+        return data()[idx];
+    }
+    [[nodiscard]] T const& operator[](std::size_t idx) const noexcept {
+        cppcmb_assert("Index out of bounds!", idx < m_Size);
+        return data()[idx];
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename TFwd>
+    void push_back(TFwd&& val) {
+        cppcmb_assert("push_back() on a full inline_vector!", !full());
+        ::new (static_cast<void*>(m_Storage + sizeof(T) * m_Size))
+            T(cppcmb_fwd(val));
+        ++m_Size;
+    }
+
+    void clear() noexcept {
+        for (std::size_t i = 0; i < m_Size; ++i) {
+            data()[i].~T();
+        }
+        m_Size = 0;
+    }
+};
+
+template <typename T, std::size_t C1, std::size_t C2>
+[[nodiscard]] bool operator==(
+    inline_vector<T, C1> const& l,
+    inline_vector<T, C2> const& r) {
+
+    if (l.size() != r.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < l.size(); ++i) {
+        if (!(l[i] == r[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T, std::size_t C1, std::size_t C2>
+[[nodiscard]] bool operator!=(
+    inline_vector<T, C1> const& l,
+    inline_vector<T, C2> const& r) {
+
+    return !(l == r);
+}
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_INLINE_VECTOR_HPP */
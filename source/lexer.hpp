@@ -18,6 +18,7 @@
 #include <utility>
 #include "detail.hpp"
 #include "parsers/combinator.hpp"
+#include "parsers/ilit.hpp"
 #include "parsers/regex.hpp"
 #include "reader.hpp"
 #include "result.hpp"
@@ -33,6 +34,32 @@ struct skip_t {};
 
 inline constexpr auto skip = skip_t();
 
+/**
+ * Signal that the token rule should ignore ASCII case. The regex of such rules
+ * has to be written in lower-case.
+ */
+struct icase_t {};
+
+inline constexpr auto icase = icase_t();
+
+/**
+ * Lexer mode actions of token rules, only a modal_lexer supports them. A rule
+ * can push a new mode on the mode stack, or pop the current one.
+ */
+struct no_mode_t {};
+
+template <std::size_t Mode>
+struct push_mode_t {
+    static constexpr std::size_t mode = Mode;
+};
+
+struct pop_mode_t {};
+
+template <std::size_t Mode>
+inline constexpr auto push_mode = push_mode_t<Mode>();
+
+inline constexpr auto pop_mode = pop_mode_t();
+
 namespace detail {
 
 // XXX(LPeter1997): This implementation blocks incremental features
@@ -104,10 +131,26 @@ public:
 };
 
 // XXX(LPeter1997): Noexcept specifier
-template <typename Tag, typename Src, typename TTag>
+template <bool ICase, typename Src>
+[[nodiscard]] constexpr auto str_to_rule_parser(Src src) {
+    if constexpr (ICase) {
+        static_assert(
+            !ascii_has_upper(src()),
+            "The regex of a case-insensitive token rule must be written in "
+            "lower-case!"
+        );
+        return ignore_case_t(::cppcmb::regex(src));
+    }
+    else {
+        return ::cppcmb::regex(src);
+    }
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename Tag, bool ICase, typename Src, typename TTag>
 [[nodiscard]] constexpr auto str_to_token_parser(Src src, TTag t) {
     ((void)t); // Unused warning
-    auto p = ::cppcmb::regex(src);
+    auto p = str_to_rule_parser<ICase>(src);
     using parser_type = decltype(p);
     if constexpr (std::is_same_v<TTag, skip_t>) {
         // We want to skip this
@@ -150,6 +193,11 @@ template <typename... Rs>
     using token_type = first_not_skip_t<
         typename remove_cvref_t<Rs>::tag_type...
     >;
+    static_assert(
+        (... && std::is_same_v<typename remove_cvref_t<Rs>::action_type,
+            no_mode_t>),
+        "Mode actions can only be used with a modal_lexer!"
+    );
     // XXX(LPeter1997): Or we could just allow it
     static_assert(
         !std::is_same_v<token_type, skip_t>,
@@ -157,7 +205,10 @@ template <typename... Rs>
     );
     // XXX(LPeter1997): We could do a check if the tokenizer succeeds for an
     // empty string. If it does, tell the user it's a BAD idea.
-    return (... | str_to_token_parser<token_type>(
+    return (... | str_to_token_parser<
+        token_type,
+        remove_cvref_t<Rs>::case_insensitive
+    >(
         cppcmb_fwd(rules).source(),
         cppcmb_fwd(rules).tag()
     ));
@@ -313,7 +364,8 @@ private:
     }
 };
 
-template <typename Src, typename Tag>
+template <typename Src, typename Tag, bool ICase = false,
+    typename Action = no_mode_t>
 class token_rule {
 private:
     Src m_Src;
@@ -321,17 +373,48 @@ private:
 
 public:
     using tag_type = Tag;
+    using action_type = Action;
+
+    static constexpr bool case_insensitive = ICase;
 
     // XXX(LPeter1997): Noexcept specifier
     constexpr token_rule(Src src, Tag t)
         : m_Src(src), m_Tag(t) {
     }
 
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_rule(Src src, Tag t, icase_t)
+        : m_Src(src), m_Tag(t) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_rule(Src src, Tag t, Action)
+        : m_Src(src), m_Tag(t) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    constexpr token_rule(Src src, Tag t, icase_t, Action)
+        : m_Src(src), m_Tag(t) {
+    }
+
     // XXX(LPeter1997): Possibly don't need
     cppcmb_getter(source, m_Src)
     cppcmb_getter(tag, m_Tag)
 };
 
+template <typename Src, typename Tag>
+token_rule(Src, Tag, icase_t) -> token_rule<Src, Tag, true>;
+
+template <typename Src, typename Tag, std::size_t Mode>
+token_rule(Src, Tag, push_mode_t<Mode>)
+    -> token_rule<Src, Tag, false, push_mode_t<Mode>>;
+
+template <typename Src, typename Tag>
+token_rule(Src, Tag, pop_mode_t) -> token_rule<Src, Tag, false, pop_mode_t>;
+
+template <typename Src, typename Tag, typename Action>
+token_rule(Src, Tag, icase_t, Action) -> token_rule<Src, Tag, true, Action>;
+
 #define cppcmb_token(rx, ...) ::cppcmb::token_rule(cppcmb_str(rx), __VA_ARGS__)
 
 template <typename MainRule>
@@ -0,0 +1,146 @@
+/**
+ * lexing_service.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Lexing of ranges of a document that is being edited, like the visible part
+ * in an editor. The lexer state is saved every few lines, so a range is lexed
+ * from the closest saved state before it, instead of from the start.
+ */
+
+#ifndef CPPCMB_LEXING_SERVICE_HPP
+#define CPPCMB_LEXING_SERVICE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "detail.hpp"
+#include "modal_lexer.hpp"
+
+namespace cppcmb {
+
+/**
+ * A saved lexer state at a token boundary.
+ */
+struct lexer_checkpoint {
+    std::size_t              offset = 0;
+    // The number of line breaks before the offset
+    std::size_t              line   = 0;
+    // The source from this offset on wasn't looked at to get here
+    std::size_t              reach  = 0;
+    std::vector<std::size_t> modes  = { 0 };
+};
+
+/**
+ * The lexer is referenced, it has to outlive the service. The source isn't
+ * stored, it's passed to every query, and every edit has to be reported.
+ */
+template <typename Lexer>
+class lexing_service {
+private:
+    Lexer const*                  m_Lexer;
+    std::size_t                   m_Lines;
+    std::vector<lexer_checkpoint> m_Checkpoints;
+
+    template <typename CharT>
+    [[nodiscard]] static std::size_t count_lines(CharT const* data,
+        std::size_t len) noexcept {
+        return std::size_t(std::count(data, data + len, CharT('\n')));
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * A checkpoint is saved after every lines_per_checkpoint lines.
+     */
+    explicit lexing_service(Lexer const& l,
+        std::size_t lines_per_checkpoint = 64)
+        : m_Lexer(::std::addressof(l)), m_Lines(lines_per_checkpoint),
+          m_Checkpoints(1) {
+        cppcmb_assert(
+            "There must be at least one line between checkpoints!",
+            m_Lines > 0
+        );
+    }
+
+    // Just to avoid nasty bugs
+    lexing_service(Lexer const&& l, std::size_t lines = 64) = delete;
+
+    [[nodiscard]] std::vector<lexer_checkpoint> const& checkpoints()
+        const noexcept {
+        return m_Checkpoints;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Calls fn(result, offset) for every token and error that overlaps the
+     * range [from, to) of the source, in order. New checkpoints are saved
+     * while lexing.
+     */
+    template <typename Src, typename Fn>
+    void lex_range(Src const& src, std::size_t from, std::size_t to, Fn&& fn) {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Only contiguous sources can be lexed by the service!"
+        );
+
+        auto cp = std::upper_bound(
+            m_Checkpoints.begin(), m_Checkpoints.end(), from,
+            [](std::size_t off, lexer_checkpoint const& c) {
+                return off < c.offset;
+            }
+        ) - 1;
+        auto const* data = std::data(src);
+        auto pos = cp->offset;
+        auto line = cp->line;
+        auto reach = cp->reach;
+
+        auto it = m_Lexer->begin(src, cp->offset, cp->modes);
+        for (; it != m_Lexer->end(); ++it) {
+            auto start = it.position();
+            if (start >= to) {
+                break;
+            }
+            auto const& res = *it;
+            auto end = start + (res.is_success() ? res.success().matched() : 1);
+            if (end > from) {
+                fn(res, start);
+            }
+
+            // Only save new checkpoints after the last one
+            line += count_lines(data + pos, end - pos);
+            pos = end;
+            auto const& last = m_Checkpoints.back();
+            if (end > last.offset && line >= last.line + m_Lines) {
+                reach = std::max(reach, it.reach());
+                m_Checkpoints.push_back({ end, line, reach, it.modes() });
+            }
+        }
+    }
+
+    /**
+     * Reports that the source was edited from the offset on. The checkpoints
+     * that might depend on the changed part are dropped, the ones before it
+     * are kept, as nothing before the edit moves.
+     */
+    void edit(std::size_t offset) noexcept {
+        // The first checkpoint at the start is always valid
+        while (m_Checkpoints.size() > 1
+            && m_Checkpoints.back().reach >= offset) {
+            m_Checkpoints.pop_back();
+        }
+    }
+};
+
+template <typename Lexer>
+lexing_service(Lexer const&) -> lexing_service<Lexer>;
+
+template <typename Lexer>
+lexing_service(Lexer const&, std::size_t) -> lexing_service<Lexer>;
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_LEXING_SERVICE_HPP */
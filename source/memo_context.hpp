@@ -10,16 +10,26 @@
 #ifndef CPPCMB_MEMO_CONTEXT_HPP
 #define CPPCMB_MEMO_CONTEXT_HPP
 
+#include <algorithm>
 #include <any>
+#include <array>
+#include <bitset>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <iterator>
+#include <limits>
 #include <optional>
+#include <set>
+#include <string>
+#include <typeinfo>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 #include "detail.hpp"
 #include "reader.hpp"
+#include "result.hpp"
 
 // XXX(LPeter1997): Move operations from the parsers to here
 // The structures should be aware of their usage, they shouldn't be just
@@ -27,6 +37,42 @@
 
 namespace cppcmb {
 
+/**
+ * Statistics of a memo table compaction.
+ */
+struct compaction_stats {
+    std::size_t entries_removed = 0;
+    std::size_t bytes_reclaimed = 0;
+};
+
+class memo_context;
+
+/**
+ * A point in the parse, that it can backtrack to, when a branch of a choice
+ * fails.
+ */
+struct choice_point {
+    // The length of the trail at the start of the branch
+    std::size_t trail = 0;
+    // The length of the state log at the start of the branch
+    std::size_t log   = 0;
+    // The length of the state log when the enclosing branch started
+    std::size_t outer = 0;
+};
+
+/**
+ * A memorized parser application that has been re-parsed in place.
+ */
+struct reparsed_block {
+    // The memo ID of the parser
+    std::uintptr_t rule   = 0;
+    std::size_t    offset = 0;
+    // The matched length in the edited source
+    std::size_t    length = 0;
+    // The result of the parser
+    std::any       result;
+};
+
 namespace detail {
 
 // XXX(LPeter1997): Noexcept specifier
@@ -50,6 +96,92 @@ struct pair_hasher {
     }
 };
 
+/**
+ * Describes how the results of a parser can be written out, so they survive
+ * the process. The stable ID identifies the parser across processes.
+ */
+struct persistent_rule {
+    std::uint64_t stable_id;
+    void (*write)(std::any const&, std::string&);
+};
+
+/**
+ * A persisted entry that hasn't been claimed by it's parser yet.
+ */
+struct pending_entry {
+    std::string data;
+    std::size_t furthest;
+};
+
+/**
+ * The outcome of a memorized value, used for compaction.
+ */
+enum class memo_status {
+    // Not a result, like the bookkeeping of left-recursion
+    unknown,
+    success,
+    failure,
+};
+
+/**
+ * Re-applies the memorizing parser self at the position of the source, if
+ * the source is of the type the parser was applied to before.
+ */
+using block_reapply_fn = std::optional<reparsed_block> (*)(
+    void const* self, void const* src, std::type_info const& src_type,
+    std::size_t pos, memo_context& ctx
+);
+
+/**
+ * Lets a memorized success be re-parsed by itself.
+ */
+struct memo_block {
+    void const*      self    = nullptr;
+    block_reapply_fn reapply = nullptr;
+};
+
+/**
+ * A memorized entry that an edit overlaps.
+ */
+struct overlapping_entry {
+    std::uintptr_t pid;
+    std::size_t    pos;
+    // A success that can be re-parsed by itself
+    bool           is_block;
+    std::size_t    matched;
+    memo_block     block;
+};
+
+/**
+ * A memorized value with it's bookkeeping.
+ */
+struct memo_entry {
+    std::any    value;
+    std::size_t furthest = 0;
+    memo_status status   = memo_status::unknown;
+    // Estimated size of the value, if it doesn't fit into the std::any
+    std::size_t heap_size = 0;
+    // Entries that depend on the parse state are only valid in the version
+    // of the state they were computed in
+    bool          dependent = false;
+    std::uint64_t version   = 0;
+    // The matched length of a success
+    std::size_t   matched   = 0;
+    memo_block    block;
+    // The entries the evaluation used, pair<parser identifier, offset from
+    // this entry>, so they survive shifting the entries
+    std::vector<std::pair<std::uintptr_t, std::size_t>> children;
+};
+
+/**
+ * The state and trail bookkeeping of a memorizing parser's evaluation.
+ */
+struct state_frame {
+    std::uint64_t version;
+    bool          dependent;
+    std::size_t   trail;
+};
+
 /**
  * Memorization table for packrat parsers.
  */
@@ -57,12 +189,160 @@ class memo_table {
 private:
     // pair<parser identifier, position>
     using key_type = std::pair<std::uintptr_t, std::size_t>;
-    // pair<result, furthest>
-    using value_type = std::pair<std::any, std::size_t>;
+    using value_type = memo_entry;
+    // pair<stable identifier, position>
+    using pending_key_type = std::pair<std::uint64_t, std::size_t>;
+
+    // pair<position, parser identifier>
+    using span_key = std::pair<std::size_t, std::uintptr_t>;
+
+    static constexpr std::size_t span_classes =
+        std::numeric_limits<std::size_t>::digits + 1;
 
     std::unordered_map<key_type, value_type, pair_hasher> m_Cache;
+    // The entries ordered by position, in classes of how far they looked
+    // (see span_class), to find the ones an edit overlaps
+    std::array<std::set<span_key>, span_classes>          m_Spans;
+
+    // Persistence support
+    std::unordered_map<std::uintptr_t, persistent_rule> m_Persistent;
+    std::unordered_map<std::uint64_t, std::uintptr_t>   m_StableIDs;
+    std::unordered_set<std::uint64_t>                   m_Ambiguous;
+    std::unordered_map<
+        pending_key_type, pending_entry, pair_hasher
+    >                                                   m_Pending;
+
+    // Parse state versioning, versions are never reused, not even between
+    // parses
+    std::uint64_t m_StateVersion = 0;
+    std::uint64_t m_FrameVersion = 0;
+    bool          m_Dependent    = false;
+
+    // The entries used by the evaluations in progress and by the ones they
+    // finished, in order. The ones of failed branches are dropped again (see
+    // memo_context::backtrack), so at the end of a parse it holds the
+    // entries the result was derived from directly.
+    std::vector<key_type> m_Trail;
+    std::size_t           m_FrameTrail = 0;
+
+    /**
+     * True, if an entry at r_from that looked at furthest elements overlaps
+     * the edited range [start; end).
+     */
+    [[nodiscard]] static constexpr bool overlaps(std::size_t r_from,
+        std::size_t furthest, std::size_t start, std::size_t end) noexcept {
+        // [r_from; r_to) is the entry's interval
+        // XXX(LPeter1997): Allow equality?
+        auto r_to = r_from + furthest;
+        return !(start > r_to || r_from > end);
+    }
+
+    /**
+     * The class of an entry that looked at furthest elements. The entries
+     * of class k looked at less than 2^k elements.
+     */
+    [[nodiscard]] static constexpr std::size_t span_class(
+        std::size_t furthest) noexcept {
+        std::size_t k = 0;
+        for (; furthest != 0; furthest >>= 1) {
+            ++k;
+        }
+        return k;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The keys of the entries that overlap the edited range [start; end].
+     * Only the entries of each class, that start close enough to the edit
+     * to reach it, are looked at.
+     */
+    [[nodiscard]] std::vector<key_type>
+    overlapping_keys(std::size_t start, std::size_t end) const {
+        std::vector<key_type> res;
+        for (std::size_t k = 0; k < span_classes; ++k) {
+            auto const& spans = m_Spans[k];
+            auto const reach = k < span_classes - 1
+                ? (std::size_t(1) << k) - 1
+                : std::numeric_limits<std::size_t>::max();
+            auto from = start > reach ? start - reach : 0;
+            for (auto it = spans.lower_bound({ from, 0 });
+                it != spans.end() && it->first <= end; ++it) {
+                auto key = key_type(it->second, it->first);
+                auto const& e = m_Cache.find(key)->second;
+                if (overlaps(key.second, e.furthest, start, end)) {
+                    res.push_back(key);
+                }
+            }
+        }
+        return res;
+    }
 
 public:
+    [[nodiscard]] std::uint64_t state_version() const noexcept {
+        return m_StateVersion;
+    }
+
+    /**
+     * Signals that the parse state changed. Entries that depend on the state
+     * are not reused after this.
+     */
+    void bump_state_version() noexcept {
+        ++m_StateVersion;
+    }
+
+    /**
+     * Signals that the current evaluation depends on the parse state.
+     */
+    void note_state_read() noexcept {
+        m_Dependent = true;
+    }
+
+    /**
+     * Starts the evaluation of a memorized parser. The entries put before
+     * leaving the frame depend on the state, if the evaluation read or
+     * changed it.
+     */
+    [[nodiscard]] state_frame enter_state_frame() noexcept {
+        auto f = state_frame{ m_FrameVersion, m_Dependent, m_FrameTrail };
+        m_FrameVersion = m_StateVersion;
+        m_Dependent = false;
+        m_FrameTrail = m_Trail.size();
+        return f;
+    }
+
+    /**
+     * Ends the evaluation, the dependency propagates to the enclosing one.
+     * The entries it used are children of the entry it put last, only that
+     * one stays on the trail.
+     */
+    void leave_state_frame(state_frame const& f) noexcept {
+        m_Dependent = f.dependent || m_Dependent
+            || m_StateVersion != m_FrameVersion;
+        m_FrameVersion = f.version;
+        if (m_Trail.size() > m_FrameTrail) {
+            auto own = m_Trail.back();
+            // Doesn't allocate, the trail only shrinks
+            m_Trail.resize(m_FrameTrail);
+            m_Trail.push_back(own);
+        }
+        m_FrameTrail = f.trail;
+    }
+
+    [[nodiscard]] std::size_t trail_size() const noexcept {
+        return m_Trail.size();
+    }
+
+    /**
+     * Drops the entries used between the two trail sizes, the branch that
+     * used them was not taken.
+     */
+    void drop_trail(std::size_t from, std::size_t to) noexcept {
+        m_Trail.erase(
+            m_Trail.begin() + std::ptrdiff_t(from),
+            m_Trail.begin() + std::ptrdiff_t(to)
+        );
+    }
+
     // XXX(LPeter1997): Noexcept specifier
     [[nodiscard]]
     /* constexpr */ std::any* get(std::uintptr_t pid, std::size_t pos) {
@@ -70,7 +350,16 @@ public:
         if (it == m_Cache.end()) {
             return nullptr;
         }
-        return &it->second.first;
+        auto const& e = it->second;
+        if (e.dependent) {
+            if (e.version != m_StateVersion) {
+                // Stale, the state changed since
+                return nullptr;
+            }
+            m_Dependent = true;
+        }
+        m_Trail.push_back(it->first);
+        return &it->second.value;
     }
 
     // XXX(LPeter1997): Noexcept specifier
@@ -83,87 +372,303 @@ public:
     // XXX(LPeter1997): Noexcept specifier
     template <typename TFwd>
     constexpr auto& put(std::uintptr_t pid, std::size_t pos,
-        TFwd&& val, std::size_t furth) {
+        TFwd&& val, std::size_t furth, memo_block block = memo_block()) {
 
         using raw_type = remove_cvref_t<TFwd>;
         auto id = std::pair(pid, pos);
-        auto& a = (m_Cache[id] = std::pair(cppcmb_fwd(val), furth));
-        return std::any_cast<raw_type&>(a.first);
+        auto status = memo_status::unknown;
+        std::size_t matched = 0;
+        if constexpr (is_specialization_v<raw_type, result>) {
+            status = val.is_success()
+                ? memo_status::success : memo_status::failure;
+            matched = val.is_success() ? val.success().matched() : 0;
+        }
+        // Assume small-buffer optimization for pointer-sized values
+        auto heap = sizeof(raw_type) > sizeof(void*) ? sizeof(raw_type) : 0;
+        // A change in the frame means the result was computed in multiple
+        // versions of the state, it can't be reused in any of them
+        bool dependent = m_Dependent || m_StateVersion != m_FrameVersion;
+        auto [it, fresh] = m_Cache.try_emplace(id);
+        auto cls = span_class(furth);
+        if (fresh) {
+            m_Spans[cls].insert({ pos, pid });
+        }
+        else if (auto old = span_class(it->second.furthest); old != cls) {
+            m_Spans[old].erase({ pos, pid });
+            m_Spans[cls].insert({ pos, pid });
+        }
+        // The entries used since the frame started, except for the entry
+        // itself, like the seed of a left-recursive one
+        std::vector<std::pair<std::uintptr_t, std::size_t>> children;
+        for (auto i = m_FrameTrail; i < m_Trail.size(); ++i) {
+            auto const& [c_pid, c_pos] = m_Trail[i];
+            if (c_pos >= pos && m_Trail[i] != id) {
+                children.push_back({ c_pid, c_pos - pos });
+            }
+        }
+        auto& a = (it->second = memo_entry{
+            std::any(cppcmb_fwd(val)), furth, status, heap,
+            dependent, m_FrameVersion, matched, block, std::move(children)
+        });
+        m_Trail.push_back(id);
+        return std::any_cast<raw_type&>(a.value);
     }
 
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src, typename TFwd>
     constexpr auto& put(std::uintptr_t pid, reader<Src> const& r,
-        TFwd&& val, std::size_t furth) {
+        TFwd&& val, std::size_t furth, memo_block block = memo_block()) {
 
-        return put(pid, r.cursor(), cppcmb_fwd(val), furth);
+        return put(pid, r.cursor(), cppcmb_fwd(val), furth, block);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The entries, that invalidate would drop for the edit. Results that
+     * depend on the parse state are not blocks, the state of their position
+     * isn't known.
+     */
+    [[nodiscard]] std::vector<overlapping_entry>
+    overlapping(std::size_t start, std::size_t rem) const {
+        std::vector<overlapping_entry> res;
+        for (auto const& k : overlapping_keys(start, start + rem)) {
+            auto const& v = m_Cache.find(k)->second;
+            auto is_block = v.block.reapply != nullptr && !v.dependent
+                && v.status == memo_status::success;
+            res.push_back({ k.first, k.second, is_block, v.matched, v.block });
+        }
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] bool contains(std::uintptr_t pid, std::size_t pos) const {
+        return m_Cache.count({ pid, pos }) != 0;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void erase(std::uintptr_t pid, std::size_t pos) {
+        auto it = m_Cache.find({ pid, pos });
+        if (it != m_Cache.end()) {
+            m_Spans[span_class(it->second.furthest)].erase({ pos, pid });
+            m_Cache.erase(it);
+        }
     }
 
     // XXX(LPeter1997): Noexcept specifier
     /* constexpr */ void clear() {
         m_Cache.clear();
+        m_Trail.clear();
+        m_FrameTrail = 0;
+        for (auto& spans : m_Spans) {
+            spans.clear();
+        }
+        m_Pending.clear();
+        m_FrameVersion = m_StateVersion;
+        m_Dependent = false;
     }
 
     // XXX(LPeter1997): Noexcept specifier
-    void invalidate(std::size_t start, std::size_t rem, std::size_t ins) {
-        // start: Position of the source we are manipulating
-        // rem: Removed length
-        // ins: Inserted length
+    /**
+     * Keeps the derivation of the last parse: the entries it used directly,
+     * and the ones the successes among them used, recursively. The other
+     * results are only kept, if they start at most neighborhood elements
+     * away from an entry of the derivation, these are the alternatives a
+     * later reparse is likely to ask for again. Entries that are not results
+     * are kept. The reclaimed bytes are an estimate.
+     */
+    compaction_stats compact(std::size_t neighborhood) {
+        std::unordered_set<key_type, pair_hasher> live;
+        std::vector<std::size_t> starts;
+        auto work = m_Trail;
+        while (!work.empty()) {
+            auto k = work.back();
+            work.pop_back();
+            auto it = m_Cache.find(k);
+            if (it == m_Cache.end() || !live.insert(k).second) {
+                continue;
+            }
+            starts.push_back(k.second);
+            auto const& v = it->second;
+            if (v.status == memo_status::failure) {
+                // Whatever it used didn't end up in the result
+                continue;
+            }
+            for (auto const& [c_pid, c_off] : v.children) {
+                work.push_back({ c_pid, k.second + c_off });
+            }
+        }
+        std::sort(starts.begin(), starts.end());
 
-        auto end = start + rem;
+        auto near_live = [&](std::size_t pos) {
+            auto from = pos > neighborhood ? pos - neighborhood : 0;
+            auto it = std::lower_bound(starts.begin(), starts.end(), from);
+            return it != starts.end() && *it <= pos + neighborhood;
+        };
 
-        // XXX(LPeter1997): Going through every entry is not very effective
-        // we would need some helper structure to search by interval
+        // Rough size of a node in the hash table and in the span set
+        constexpr auto node_size =
+            sizeof(key_type) + sizeof(value_type) + 2 * sizeof(void*)
+            + sizeof(span_key) + 4 * sizeof(void*);
 
+        compaction_stats stats;
         for (auto it = m_Cache.begin(); it != m_Cache.end();) {
-            auto r_from = it->first.second;
-            // XXX(LPeter1997): Solve this
-            // Maybe redundantly store it
-            auto r_furthest = it->second.second;
-            auto r_to = r_from + r_furthest;
-
-            // [f_from; r_to) is the entry's interval
-            // Need to check overlap with [start; end)
-            // If they overlap, remove entry
-
-            // XXX(LPeter1997): Allow equality?
-            if (start > r_to || r_from > end) {
-                // No overlap
-                ++it;
+            auto const& [k, v] = *it;
+            if (v.status != memo_status::unknown && live.count(k) == 0
+             && !near_live(k.second)) {
+                ++stats.entries_removed;
+                stats.bytes_reclaimed += node_size + v.heap_size
+                    + v.children.capacity() * sizeof(v.children[0]);
+                m_Spans[span_class(v.furthest)].erase({ k.second, k.first });
+                it = m_Cache.erase(it);
             }
             else {
-                // Overlapping
-                it = m_Cache.erase(it);
+                ++it;
+            }
+        }
+        return stats;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Marks the entries of the given parser as persistable. If two different
+     * parsers share a stable ID, neither of them is persisted.
+     */
+    void register_persistent(std::uintptr_t pid, persistent_rule rule) {
+        auto [it, inserted] = m_StableIDs.insert({ rule.stable_id, pid });
+        if (!inserted && it->second != pid) {
+            m_Ambiguous.insert(rule.stable_id);
+        }
+        m_Persistent.insert({ pid, rule });
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void add_pending(std::uint64_t sid, std::size_t pos, pending_entry e) {
+        m_Pending.insert_or_assign({ sid, pos }, std::move(e));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Removes and returns the persisted entry of a parser at the position.
+     */
+    [[nodiscard]] std::optional<pending_entry>
+    take_pending(std::uint64_t sid, std::size_t pos) {
+        if (m_Pending.empty()) {
+            return std::nullopt;
+        }
+        auto it = m_Pending.find({ sid, pos });
+        if (it == m_Pending.end() || m_Ambiguous.count(sid) != 0) {
+            return std::nullopt;
+        }
+        auto e = std::move(it->second);
+        m_Pending.erase(it);
+        return e;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Calls fn(stable ID, position, furthest, data) for every entry that can
+     * be persisted, including the ones that haven't been claimed yet.
+     */
+    template <typename Fn>
+    void for_each_persistent(Fn&& fn) const {
+        for (auto const& [k, v] : m_Cache) {
+            if (v.dependent) {
+                // The state isn't saved
+                continue;
+            }
+            auto it = m_Persistent.find(k.first);
+            if (it == m_Persistent.end()
+             || m_Ambiguous.count(it->second.stable_id) != 0) {
+                continue;
+            }
+            std::string data;
+            it->second.write(v.value, data);
+            fn(it->second.stable_id, k.second, v.furthest, data);
+        }
+        for (auto const& [k, v] : m_Pending) {
+            if (m_Ambiguous.count(k.first) == 0) {
+                fn(k.first, k.second, v.furthest, v.data);
             }
         }
+    }
 
-        // XXX(LPeter1997): THIS IS HORRIBLE FOR PERFORMANCE
-        // WE ARE REMOVING THEN PUTTING BACK EVERY ENTRY THAT IS AFTER THE
-        // EDIT
-        // XXX(LPeter1997): This is a very ineffective implementation right
-        // now. It's just to test the algorithm itself
+    // XXX(LPeter1997): Noexcept specifier
+    void invalidate(std::size_t start, std::size_t rem, std::size_t ins) {
+        // start: Position of the source we are manipulating
+        // rem: Removed length
+        // ins: Inserted length
+
+        // The positions on the trail are stale, a new parse starts
+        m_Trail.clear();
+        m_FrameTrail = 0;
+
+        auto end = start + rem;
+        for (auto const& [pid, pos] : overlapping_keys(start, end)) {
+            erase(pid, pos);
+        }
+
+        // The entries after the edit are shifted, the nodes are moved, so
+        // the values are not copied. Every entry that started inside the
+        // edit overlapped it, the order of the entries doesn't change.
+        // XXX(LPeter1997): Still linear in the entries after the edit, that
+        // would need relative positions
         std::intptr_t diff = std::intptr_t(ins) - std::intptr_t(rem);
-        // Collect and erase entries that need to be shifted
-        std::vector<std::pair<key_type, value_type>> to_shift;
-        for (auto it = m_Cache.begin(); it != m_Cache.end();) {
-            auto r_from = it->first.second;
-            if (r_from >= start) {
-                to_shift.push_back({
-                    { it->first.first, it->first.second },
-                    std::move(it->second)
-                });
-                it = m_Cache.erase(it);
+        if (diff != 0) {
+            std::vector<decltype(m_Cache)::node_type> entries;
+            std::vector<std::set<span_key>::node_type> spans;
+            for (auto& cls : m_Spans) {
+                spans.clear();
+                auto it = cls.lower_bound({ start, 0 });
+                while (it != cls.end()) {
+                    spans.push_back(cls.extract(it++));
+                }
+                for (auto& n : spans) {
+                    auto& [pos, pid] = n.value();
+                    entries.push_back(m_Cache.extract({ pid, pos }));
+                    pos = pos + ins - rem;
+                    cls.insert(cls.end(), std::move(n));
+                }
             }
-            else {
-                ++it;
+            for (auto& n : entries) {
+                n.key().second = n.key().second + ins - rem;
+                m_Cache.insert(std::move(n));
             }
         }
-        // Re-insert the entries
-        for (auto& [k, v] : to_shift) {
-            auto& [p_id, pos] = k;
-            m_Cache.insert({ { p_id, pos + diff }, std::move(v) });
+
+        // Persisted entries follow the same rules
+        decltype(m_Pending) pending;
+        for (auto& [k, v] : m_Pending) {
+            auto r_from = k.second;
+            if (overlaps(r_from, v.furthest, start, end)) {
+                // Overlapping
+                continue;
+            }
+            auto pos = r_from >= start ? r_from + diff : r_from;
+            pending.insert({ { k.first, pos }, std::move(v) });
         }
-        // END OF UNGODLY INEFFICIENT CODE
+        m_Pending = std::move(pending);
+    }
+};
+
+/**
+ * Evaluates a memorized parser in a state frame, until the end of the scope.
+ * The results must be put into the table inside the scope.
+ */
+class state_frame_scope {
+private:
+    memo_table& m_Table;
+    state_frame m_Frame;
+
+public:
+    explicit state_frame_scope(memo_table& table) noexcept
+        : m_Table(table), m_Frame(table.enter_state_frame()) {
+    }
+
+    state_frame_scope(state_frame_scope const&) = delete;
+    state_frame_scope& operator=(state_frame_scope const&) = delete;
+
+    ~state_frame_scope() {
+        m_Table.leave_state_frame(m_Frame);
     }
 };
 
@@ -303,6 +808,139 @@ public:
     }
 };
 
+/**
+ * Re-evaluation statistics of a rule for adaptive memoization.
+ * A fixed subset of positions is sampled into a small bitset, a sample that
+ * hits an already set bit is counted as a re-evaluation at the same position.
+ * Distinct positions can share a bit, so this slightly overestimates.
+ */
+class rule_stats {
+private:
+    static constexpr std::size_t sketch_bits = 1024;
+    // Roughly every 4th position is sampled
+    static constexpr std::uint64_t sample_mask = 3;
+
+    std::bitset<sketch_bits> m_Sketch;
+    std::size_t              m_Distinct    = 0;
+    std::size_t              m_Samples     = 0;
+    std::size_t              m_Repeats     = 0;
+    std::size_t              m_Evaluations = 0;
+    bool                     m_Memoized    = false;
+
+public:
+    [[nodiscard]] bool memoized() const noexcept { return m_Memoized; }
+    [[nodiscard]] std::size_t samples() const noexcept { return m_Samples; }
+    [[nodiscard]] std::size_t repeats() const noexcept { return m_Repeats; }
+    [[nodiscard]] std::size_t evaluations() const noexcept {
+        return m_Evaluations;
+    }
+
+    /**
+     * Records an evaluation of the rule at the given position. Turns on
+     * memoization once there are at least min_samples samples and at least
+     * percent% of them are re-evaluations.
+     */
+    void record(std::size_t pos,
+        std::size_t min_samples, std::size_t percent) noexcept {
+
+        ++m_Evaluations;
+        auto h = std::uint64_t(pos) * 0x9E3779B97F4A7C15U;
+        h ^= h >> 29;
+        if ((h & sample_mask) != 0) {
+            return;
+        }
+        auto bit = std::size_t((h >> 2) % sketch_bits);
+        ++m_Samples;
+        if (m_Sketch.test(bit)) {
+            ++m_Repeats;
+        }
+        else {
+            m_Sketch.set(bit);
+            ++m_Distinct;
+        }
+        if (m_Samples >= min_samples
+         && m_Repeats * 100 >= percent * m_Samples) {
+            m_Memoized = true;
+        }
+        if (m_Distinct > sketch_bits / 2) {
+            // The sketch is getting saturated, start a new window
+            reset_sketch();
+            m_Samples /= 2;
+            m_Repeats /= 2;
+        }
+    }
+
+    /**
+     * Forgets the sampled positions, but keeps the decision and counters.
+     */
+    void reset_sketch() noexcept {
+        m_Sketch.reset();
+        m_Distinct = 0;
+    }
+};
+
+/**
+ * Statistics of adaptively memoized rules.
+ */
+class rule_stats_table {
+private:
+    static constexpr std::size_t recent_size = 16;
+
+    struct recent_slot {
+        std::uintptr_t pid   = 0;
+        rule_stats*    stats = nullptr;
+    };
+
+    /**
+     * The stats of the recently looked up rules. The stats are looked up on
+     * every evaluation, a hash lookup would cost more than most rules. The
+     * slots point into the table they belong to, so they are not copied.
+     */
+    struct recent_cache {
+        std::array<recent_slot, recent_size> slots{};
+
+        recent_cache() = default;
+
+        recent_cache(recent_cache const&) noexcept {
+        }
+
+        recent_cache& operator=(recent_cache const&) noexcept {
+            slots = {};
+            return *this;
+        }
+    };
+
+    // The elements of an unordered_map don't move, and stats are never erased
+    std::unordered_map<std::uintptr_t, rule_stats> m_Stats;
+    recent_cache                                   m_Recent;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] rule_stats& operator[](std::uintptr_t pid) {
+        auto h = (std::uint64_t(pid) * 0x9E3779B97F4A7C15U) >> 60;
+        auto& slot = m_Recent.slots[std::size_t(h) % recent_size];
+        if (slot.stats == nullptr || slot.pid != pid) {
+            slot = { pid, &m_Stats[pid] };
+        }
+        return *slot.stats;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] rule_stats const* get(std::uintptr_t pid) const {
+        auto it = m_Stats.find(pid);
+        return it == m_Stats.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * Positions are meaningless for a new input, decisions are kept.
+     */
+    void new_input() noexcept {
+        for (auto& [_, st] : m_Stats) {
+            st.reset_sketch();
+        }
+    }
+};
+
 // XXX(LPeter1997): These are not really helper structures and don't belong to
 // the memo context.
 // Furthermore, they should belong to a structure instead.
@@ -325,23 +963,210 @@ constexpr bool contains(Coll const& coll, Val const& v) {
 // Only need a mutable-lvalue getter for all 3 helpers
 class memo_context {
 private:
-    detail::memo_table      m_MemoTable;
-    detail::call_head_table m_RecursionHeads;
-    detail::call_stack      m_LrStack;
+    detail::memo_table       m_MemoTable;
+    detail::call_head_table  m_RecursionHeads;
+    detail::call_stack       m_LrStack;
+    detail::rule_stats_table m_RuleStats;
+    std::any                 m_State;
+    std::any                 m_InitialState;
+    // The states before the first change in each open branch, that are
+    // restored, when the branch fails
+    std::vector<std::any>    m_StateLog;
+    // The length of the state log when the innermost open branch started
+    std::size_t              m_BranchLog = no_branch;
+
+    static constexpr std::size_t no_branch = std::size_t(-1);
 
 public:
     cppcmb_getter(memo, m_MemoTable)
     cppcmb_getter(call_heads, m_RecursionHeads)
     cppcmb_getter(call_stack, m_LrStack)
+    cppcmb_getter(rule_stats, m_RuleStats)
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Sets the state that every parse starts with.
+     */
+    template <typename T>
+    void set_state(T init) {
+        m_InitialState = std::move(init);
+        m_State = m_InitialState;
+        m_MemoTable.bump_state_version();
+    }
+
+    [[nodiscard]] bool has_state() const noexcept {
+        return m_State.has_value();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Restores the initial state, for a new parse.
+     */
+    void reset_state() {
+        m_StateLog.clear();
+        m_BranchLog = no_branch;
+        if (m_InitialState.has_value()) {
+            m_State = m_InitialState;
+            m_MemoTable.bump_state_version();
+        }
+    }
+
+    /**
+     * The current state, without registering a dependency on it.
+     */
+    template <typename T>
+    [[nodiscard]] T const& peek_state() const noexcept {
+        auto const* st = std::any_cast<T>(&m_State);
+        cppcmb_assert("The parse state is not set or of another type!", st);
+        return *st;
+    }
+
+    /**
+     * The current state. The memorized results computed now depend on it.
+     */
+    template <typename T>
+    [[nodiscard]] T const& read_state() noexcept {
+        m_MemoTable.note_state_read();
+        return peek_state<T>();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Calls fn with the mutable state. The memorized results of the previous
+     * state aren't reused after this. The change is undone, if an enclosing
+     * branch fails.
+     */
+    template <typename T, typename Fn>
+    decltype(auto) update_state(Fn&& fn) {
+        auto* st = std::any_cast<T>(&m_State);
+        cppcmb_assert("The parse state is not set or of another type!", st);
+        if (m_StateLog.size() == m_BranchLog) {
+            // First change in the innermost branch
+            m_StateLog.push_back(m_State);
+        }
+        m_MemoTable.bump_state_version();
+        return cppcmb_fwd(fn)(*st);
+    }
+
+    /**
+     * Marks the start of a branch, that the parse backtracks from, if it
+     * fails. Every branch must be left with leave_branch.
+     */
+    [[nodiscard]] choice_point enter_branch() noexcept {
+        auto cp = choice_point{
+            m_MemoTable.trail_size(), m_StateLog.size(), m_BranchLog
+        };
+        m_BranchLog = cp.log;
+        return cp;
+    }
+
+    /**
+     * True, if the state changed since the start of the innermost open
+     * branch, that started at from.
+     */
+    [[nodiscard]] bool changed_state(choice_point const& from)
+        const noexcept {
+        return m_StateLog.size() > from.log;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Backtracks to the start of the innermost open branch, that started at
+     * from. What it used is not part of the derivation, and the state
+     * changes in it are undone. The branch stays open.
+     */
+    void backtrack(choice_point const& from) {
+        m_MemoTable.drop_trail(from.trail, m_MemoTable.trail_size());
+        if (m_StateLog.size() > from.log) {
+            m_State = std::move(m_StateLog[from.log]);
+            m_StateLog.resize(from.log);
+            m_MemoTable.bump_state_version();
+        }
+    }
+
+    /**
+     * Backtracks from the branch between from and to, that was not taken in
+     * the end, like the shorter one of an eager alternative. Only the
+     * derivation is affected.
+     */
+    void backtrack(choice_point const& from, choice_point const& to)
+        noexcept {
+        m_MemoTable.drop_trail(from.trail, to.trail);
+    }
+
+    /**
+     * Leaves the innermost open branch, that started at from, keeping its
+     * changes. The state before them is kept for the enclosing branch, if
+     * that has no change recorded yet.
+     */
+    void leave_branch(choice_point const& from) noexcept {
+        m_BranchLog = from.outer;
+        auto keep = from.outer == from.log ? from.log + 1 : from.log;
+        if (m_StateLog.size() > keep) {
+            m_StateLog.resize(keep);
+        }
+    }
 
     // XXX(LPeter1997): Noexcept specifier
     void clear() {
         m_MemoTable.clear();
         m_RecursionHeads.clear();
         m_LrStack.clear();
+        m_RuleStats.new_input();
+    }
+};
+
+namespace detail {
+
+/**
+ * A branch of a choice, until the end of the scope. Readers without a memo
+ * context don't backtrack anything.
+ */
+class branch_scope {
+private:
+    memo_context* m_Context;
+    choice_point  m_Point;
+
+public:
+    template <typename Src>
+    explicit branch_scope(reader<Src> const& r) noexcept
+        : m_Context(r.context_ptr()),
+          m_Point(m_Context != nullptr
+              ? m_Context->enter_branch() : choice_point()) {
+    }
+
+    branch_scope(branch_scope const&) = delete;
+    branch_scope& operator=(branch_scope const&) = delete;
+
+    ~branch_scope() {
+        if (m_Context != nullptr) {
+            m_Context->leave_branch(m_Point);
+        }
+    }
+
+    [[nodiscard]] bool changed_state() const noexcept {
+        return m_Context != nullptr && m_Context->changed_state(m_Point);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void backtrack() {
+        if (m_Context != nullptr) {
+            m_Context->backtrack(m_Point);
+        }
+    }
+
+    /**
+     * Drops the derivation of this branch until the start of next.
+     */
+    void backtrack_until(branch_scope const& next) noexcept {
+        if (m_Context != nullptr) {
+            m_Context->backtrack(m_Point, next.m_Point);
+        }
     }
 };
 
+} /* namespace detail */
+
 } /* namespace cppcmb */
 
 #endif /* CPPCMB_MEMO_CONTEXT_HPP */
@@ -0,0 +1,406 @@
+/**
+ * modal_lexer.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A lexer with modes, for context-dependent tokens, like the inside of
+ * interpolated strings or embedded languages. Every mode has its own rules,
+ * compiled into a single DFA, and rules can push or pop modes.
+ */
+
+#ifndef CPPCMB_MODAL_LEXER_HPP
+#define CPPCMB_MODAL_LEXER_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "detail.hpp"
+#include "lexer.hpp"
+#include "parsers/dfa.hpp"
+#include "reader.hpp"
+#include "result.hpp"
+#include "token.hpp"
+
+namespace cppcmb {
+
+/**
+ * The token rules of a mode.
+ */
+template <typename... Rs>
+class lexer_mode_t {
+private:
+    std::tuple<Rs...> m_Rules;
+
+public:
+    // Might be skip_t, if the mode only skips
+    using token_type = detail::first_not_skip_t<typename Rs::tag_type...>;
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... RFwd>
+    constexpr lexer_mode_t(RFwd&&... rules)
+        : m_Rules(cppcmb_fwd(rules)...) {
+    }
+
+    cppcmb_getter(rules, m_Rules)
+};
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename... RFwd>
+[[nodiscard]] constexpr auto lexer_mode(RFwd&&... rules) {
+    return lexer_mode_t<detail::remove_cvref_t<RFwd>...>(
+        cppcmb_fwd(rules)...
+    );
+}
+
+template <typename Lexer, typename Src>
+class modal_token_iterator;
+
+/**
+ * The first mode is the initial one. The longest match wins in a mode, and
+ * from the rules that match the same length, the first one. Note that this is
+ * different from lexer, where the first rule that matches wins, even if a
+ * later one would match more.
+ */
+template <typename Tag>
+class modal_lexer {
+public:
+    using token_type = Tag;
+
+private:
+    enum class action { none, push, pop };
+
+    struct rule_info {
+        // Empty for skipped rules
+        std::optional<Tag> tag;
+        action             act = action::none;
+        std::size_t        target = 0;
+    };
+
+    struct mode_info {
+        detail::dfa            automaton;
+        std::vector<rule_info> rules;
+    };
+
+    std::vector<mode_info> m_Modes;
+
+    template <typename Action>
+    static constexpr action action_of() noexcept {
+        if constexpr (std::is_same_v<Action, pop_mode_t>) {
+            return action::pop;
+        }
+        else if constexpr (std::is_same_v<Action, no_mode_t>) {
+            return action::none;
+        }
+        else {
+            return action::push;
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename R>
+    static void add_rule(detail::nfa& n, std::size_t start,
+        std::vector<std::size_t>& ends, mode_info& mode, R const& r) {
+        using action_type = typename R::action_type;
+
+        auto p = detail::str_to_rule_parser<R::case_insensitive>(r.source());
+        auto f = detail::nfa_builder::build(n, p);
+        n.add_epsilon(start, f.start);
+        ends.push_back(f.end);
+
+        rule_info info;
+        if constexpr (!std::is_same_v<typename R::tag_type, skip_t>) {
+            info.tag = r.tag();
+        }
+        info.act = action_of<action_type>();
+        if constexpr (action_of<action_type>() == action::push) {
+            info.target = action_type::mode;
+        }
+        mode.rules.push_back(std::move(info));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... Rs>
+    static mode_info compile_mode(lexer_mode_t<Rs...> const& m) {
+        mode_info mode;
+        detail::nfa n;
+        auto start = n.add_state();
+        std::vector<std::size_t> ends;
+        std::apply([&](auto const&... rules) {
+            (add_rule(n, start, ends, mode, rules), ...);
+        }, m.rules());
+        mode.automaton = detail::dfa(n, start, ends);
+        return mode;
+    }
+
+    [[nodiscard]] bool pushed_modes_exist() const noexcept {
+        for (auto const& m : m_Modes) {
+            for (auto const& r : m.rules) {
+                if (r.act == action::push && r.target >= m_Modes.size()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename... Ms>
+    explicit modal_lexer(Ms const&... modes)
+        : m_Modes{ compile_mode(modes)... } {
+        cppcmb_assert("A pushed mode must exist!", pushed_modes_exist());
+    }
+
+    [[nodiscard]] std::size_t mode_count() const noexcept {
+        return m_Modes.size();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto begin(Src const& src) const {
+        return modal_token_iterator<modal_lexer, Src>(*this, src);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Starts lexing in the middle of the source, in the given mode stack.
+     */
+    template <typename Src>
+    [[nodiscard]] auto begin(Src const& src, std::size_t offset,
+        std::vector<std::size_t> modes) const {
+        return modal_token_iterator<modal_lexer, Src>(
+            *this, src, offset, std::move(modes)
+        );
+    }
+
+    // Just to avoid nasty bugs
+    template <typename Src>
+    auto begin(Src const&& src) const = delete;
+
+    template <typename Src>
+    auto begin(Src const&& src, std::size_t offset,
+        std::vector<std::size_t> modes) const = delete;
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] auto end() const {
+        return modal_token_iterator<modal_lexer, std::string_view>();
+    }
+
+private:
+    template <typename, typename>
+    friend class modal_token_iterator;
+};
+
+template <typename... Ms>
+modal_lexer(Ms const&...) -> modal_lexer<
+    detail::first_not_skip_t<typename Ms::token_type...>
+>;
+
+/**
+ * Iterates over the tokens, keeping the stack of modes. Popping the initial
+ * mode is ignored. Like with lexer, errors are reported as failures, and
+ * incrementing skips a single character.
+ */
+template <typename Lexer, typename Src>
+class modal_token_iterator {
+public:
+    using token_type        = typename Lexer::token_type;
+    using value_type        =
+        result<token<typename reader<Src>::value_type, token_type>>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = value_type const*;
+    using reference         = value_type const&;
+    using iterator_category = std::forward_iterator_tag;
+
+    static_assert(
+        !std::is_same_v<token_type, skip_t>,
+        "There must be at least one token rule that doesn't skip!"
+    );
+
+private:
+    Lexer const*              m_Lexer = nullptr;
+    reader<Src>               m_Reader;
+    std::vector<std::size_t>  m_Modes;
+    std::optional<value_type> m_Last;
+    std::size_t               m_Reach = 0;
+
+    [[nodiscard]] bool at_end() const noexcept {
+        return m_Reader.source_ptr() == nullptr || m_Reader.is_end();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void find_token() {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "The modal lexer only works on contiguous sources!"
+        );
+        using action = typename Lexer::action;
+        using char_t = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<char_t>;
+
+        m_Last.reset();
+        while (!m_Reader.is_end()) {
+            auto const& mode = m_Lexer->m_Modes[m_Modes.back()];
+            auto const& src = m_Reader.source();
+            auto const* data = std::data(src) + m_Reader.cursor();
+            auto const len = std::size(src) - m_Reader.cursor();
+            std::size_t furthest = 0;
+            std::size_t rule = 0;
+            auto matched = mode.automaton.longest_match(
+                data, len, furthest, rule
+            );
+            if (m_Reader.cursor() + furthest > m_Reach) {
+                m_Reach = m_Reader.cursor() + furthest;
+            }
+            if (matched <= 0) {
+                // An empty match would make no progress
+                m_Last = value_type(failure(), furthest);
+                return;
+            }
+
+            auto const& info = mode.rules[rule];
+            if (info.act == action::push) {
+                m_Modes.push_back(info.target);
+            }
+            else if (info.act == action::pop && m_Modes.size() > 1) {
+                m_Modes.pop_back();
+            }
+
+            auto n = std::size_t(matched);
+            if (info.tag) {
+                auto tok = token(string_t(data, n), *info.tag);
+                m_Last = value_type(success(std::move(tok), n), furthest);
+                return;
+            }
+            m_Reader.seek(m_Reader.cursor() + n);
+        }
+    }
+
+public:
+    modal_token_iterator() = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    modal_token_iterator(Lexer const& l, Src const& src)
+        : modal_token_iterator(l, src, 0, { 0 }) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Starts lexing at the offset, with the given mode stack, that must not
+     * be empty.
+     */
+    modal_token_iterator(Lexer const& l, Src const& src, std::size_t offset,
+        std::vector<std::size_t> modes)
+        : m_Lexer(::std::addressof(l)), m_Reader(src, offset),
+          m_Modes(std::move(modes)), m_Reach(offset) {
+        cppcmb_assert("The mode stack can't be empty!", !m_Modes.empty());
+        find_token();
+    }
+
+    /**
+     * The offset of the current token (or error) in the source.
+     */
+    [[nodiscard]] std::size_t position() const noexcept {
+        return m_Reader.cursor();
+    }
+
+    /**
+     * The mode stack, after the current token.
+     */
+    [[nodiscard]] std::vector<std::size_t> const& modes() const noexcept {
+        return m_Modes;
+    }
+
+    /**
+     * The end of the furthest part of the source that was looked at so far.
+     * Changes at or after this offset don't affect the tokens up to now.
+     */
+    [[nodiscard]] std::size_t reach() const noexcept {
+        return m_Reach;
+    }
+
+    /**
+     * The current mode, after the current token.
+     */
+    [[nodiscard]] std::size_t mode() const noexcept {
+        return m_Modes.empty() ? 0 : m_Modes.back();
+    }
+
+    /**
+     * The number of modes on the stack.
+     */
+    [[nodiscard]] std::size_t depth() const noexcept {
+        return m_Modes.size();
+    }
+
+    template <typename Src2>
+    [[nodiscard]] bool operator==(modal_token_iterator<Lexer, Src2> const& o)
+        const noexcept {
+        if (at_end() || o.at_end()) {
+            return at_end() && o.at_end();
+        }
+        void const* src = m_Reader.source_ptr();
+        void const* other = o.m_Reader.source_ptr();
+        return src == other && m_Reader.cursor() == o.m_Reader.cursor();
+    }
+
+    template <typename Src2>
+    [[nodiscard]] bool operator!=(modal_token_iterator<Lexer, Src2> const& o)
+        const noexcept {
+        return !operator==(o);
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+        cppcmb_assert(
+            "A value must be present for de-referencing!",
+            m_Last.has_value()
+        );
+        return *m_Last;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+        return ::std::addressof(operator*());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    // NOLINTNEXTLINE(cert-dcl21-cpp)
+    modal_token_iterator& operator++() & {
+        cppcmb_assert(
+            "A token iterator at the end can't be incremented!",
+            !at_end() && m_Last.has_value()
+        );
+        auto const& last = *m_Last;
+        if (last.is_success()) {
+            m_Reader.seek(m_Reader.cursor() + last.success().matched());
+        }
+        else {
+            // For failures we skip a single character
+            m_Reader.seek(m_Reader.cursor() + 1);
+        }
+        find_token();
+        return *this;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    // NOLINTNEXTLINE(cert-dcl21-cpp)
+    modal_token_iterator operator++(int) & {
+        auto cpy = *this;
+        operator++();
+        return cpy;
+    }
+
+private:
+    template <typename, typename>
+    friend class modal_token_iterator;
+};
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_MODAL_LEXER_HPP */
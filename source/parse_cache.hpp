@@ -0,0 +1,181 @@
+/**
+ * parse_cache.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A content-addressed LRU cache in front of a parser. Inputs are identified by
+ * a 128-bit hash of their contents, so repeated inputs are only parsed once.
+ * Results are shared and immutable. Each entry owns a copy of its input, so
+ * results that reference the source stay valid for as long as they are held,
+ * even after the entry has been evicted.
+ */
+
+#ifndef CPPCMB_PARSE_CACHE_HPP
+#define CPPCMB_PARSE_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include "detail.hpp"
+#include "parser.hpp"
+
+namespace cppcmb {
+
+/**
+ * Usage statistics of a parse_cache.
+ */
+struct parse_cache_stats {
+    std::size_t hits      = 0;
+    std::size_t misses    = 0;
+    std::size_t evictions = 0;
+    std::size_t entries   = 0;
+    std::size_t bytes     = 0;
+};
+
+template <typename P, typename CharT = char>
+class parse_cache {
+private:
+    cppcmb_self_check(parse_cache);
+
+    using view_type = std::basic_string_view<CharT>;
+
+public:
+    using result_type = detail::remove_cvref_t<decltype(
+        std::declval<parser<P>&>().parse(std::declval<view_type const&>())
+    )>;
+
+private:
+    /**
+     * The input and the result parsed from it, allocated together so the
+     * result can't outlive the input.
+     */
+    struct payload {
+        std::basic_string<CharT>   input;
+        std::optional<result_type> value;
+    };
+
+    struct entry {
+        detail::hash128          key;
+        std::shared_ptr<payload> data;
+        std::size_t              bytes;
+    };
+
+    using lru_list = std::list<entry>;
+
+    parser<P>         m_Parser;
+    std::size_t       m_Budget;
+    lru_list          m_Entries;
+    std::unordered_map<
+        detail::hash128,
+        typename lru_list::iterator,
+        detail::hash128_hasher
+    >                 m_Index;
+    parse_cache_stats m_Stats;
+
+    // XXX(LPeter1997): Noexcept specifier
+    void evict_until(std::size_t budget) {
+        while (m_Stats.bytes > budget && !m_Entries.empty()) {
+            auto& last = m_Entries.back();
+            m_Stats.bytes -= last.bytes;
+            m_Index.erase(last.key);
+            m_Entries.pop_back();
+            ++m_Stats.evictions;
+        }
+        m_Stats.entries = m_Entries.size();
+    }
+
+    [[nodiscard]] static std::shared_ptr<result_type const>
+    alias(std::shared_ptr<payload> const& data) noexcept {
+        return std::shared_ptr<result_type const>(data, &*data->value);
+    }
+
+public:
+    /**
+     * Creates a cache that holds at most budget bytes worth of entries. An
+     * entry is accounted with the size of it's input and it's bookkeeping.
+     */
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    parse_cache(PFwd&& p, std::size_t budget)
+        : m_Parser(cppcmb_fwd(p)), m_Budget(budget) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Parses the input, or returns the cached result if the same input has
+     * been parsed before.
+     */
+    [[nodiscard]] std::shared_ptr<result_type const> parse(view_type src) {
+        auto key = detail::hash_string(src);
+
+        auto it = m_Index.find(key);
+        if (it != m_Index.end() && it->second->data->input == src) {
+            // Hit, move it to the front
+            m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+            ++m_Stats.hits;
+            return alias(it->second->data);
+        }
+        ++m_Stats.misses;
+
+        auto data = std::make_shared<payload>();
+        data->input.assign(src.data(), src.size());
+        data->value.emplace(m_Parser.parse(view_type(data->input)));
+
+        auto bytes = sizeof(payload) + sizeof(entry)
+                   + data->input.size() * sizeof(CharT);
+        if (bytes > m_Budget) {
+            // Would never fit, don't disturb the cache
+            return alias(data);
+        }
+
+        if (it != m_Index.end()) {
+            // Hash collision with a different input, replace the old entry
+            m_Stats.bytes -= it->second->bytes;
+            m_Entries.erase(it->second);
+            m_Index.erase(it);
+        }
+        evict_until(m_Budget - bytes);
+        m_Entries.push_front(entry{ key, data, bytes });
+        m_Index[key] = m_Entries.begin();
+        m_Stats.bytes += bytes;
+        m_Stats.entries = m_Entries.size();
+        return alias(data);
+    }
+
+    [[nodiscard]] parse_cache_stats const& stats() const noexcept {
+        return m_Stats;
+    }
+
+    [[nodiscard]] std::size_t budget() const noexcept {
+        return m_Budget;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Changes the byte budget, evicting entries if needed.
+     */
+    void set_budget(std::size_t budget) {
+        m_Budget = budget;
+        evict_until(m_Budget);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void clear() {
+        m_Entries.clear();
+        m_Index.clear();
+        m_Stats.bytes = 0;
+        m_Stats.entries = 0;
+    }
+};
+
+template <typename PFwd>
+parse_cache(PFwd, std::size_t) -> parse_cache<PFwd>;
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSE_CACHE_HPP */
@@ -11,10 +11,21 @@
 #ifndef CPPCMB_PARSER_HPP
 #define CPPCMB_PARSER_HPP
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
 #include "detail.hpp"
 #include "memo_context.hpp"
+#include "persistence.hpp"
 #include "reader.hpp"
+#include "text_edit.hpp"
 
 namespace cppcmb {
 
@@ -23,8 +34,18 @@ class parser {
 private:
     cppcmb_self_check(parser);
 
-    P            m_Parser;
-    memo_context m_Context;
+    P                          m_Parser;
+    memo_context               m_Context;
+    std::optional<std::size_t> m_AutoCompact;
+    compaction_stats           m_LastCompaction;
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Res>
+    void after_parse(Res const& res) {
+        if (m_AutoCompact && res.is_success()) {
+            m_LastCompaction = m_Context.memo().compact(*m_AutoCompact);
+        }
+    }
 
 public:
     // XXX(LPeter1997): Noexcept specifier
@@ -37,8 +58,29 @@ public:
     template <typename Src>
     [[nodiscard]] constexpr decltype(auto) parse(Src const& src) {
         m_Context.clear();
+        m_Context.reset_state();
         auto r = reader(src, m_Context);
-        return m_Parser.apply(r);
+        decltype(auto) res = m_Parser.apply(r);
+        after_parse(res);
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Sets the parse state, that the stateful combinators can read and
+     * change. Every parse and reparse starts from a copy of init.
+     */
+    template <typename T>
+    void set_state(T init) {
+        m_Context.set_state(std::move(init));
+    }
+
+    /**
+     * The state at the end of the last parse.
+     */
+    template <typename T>
+    [[nodiscard]] T const& state() const noexcept {
+        return m_Context.template peek_state<T>();
     }
 
     // XXX(LPeter1997): Noexcept specifier
@@ -48,8 +90,230 @@ public:
         std::size_t start, std::size_t rem, std::size_t ins) {
 
         m_Context.memo().invalidate(start, rem, ins);
+        m_Context.reset_state();
         auto r = reader(src, m_Context);
-        return m_Parser.apply(r);
+        decltype(auto) res = m_Parser.apply(r);
+        after_parse(res);
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Like reparse, but the edit is detected from the previous version of
+     * the source, for clients that only know the whole new text.
+     */
+    template <typename Src1, typename Src2>
+    [[nodiscard]] constexpr decltype(auto)
+    reparse_from(Src1 const& old_src, Src2 const& new_src) {
+        return reparse(new_src, detect_edit(old_src, new_src));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Reparse with an edit of elements of the source, like the token edit
+     * that token_stream::relex reports.
+     */
+    template <typename Src>
+    [[nodiscard]] constexpr decltype(auto)
+    reparse(Src const& src, text_edit const& edit) {
+        return reparse(src, edit.start, edit.rem, edit.ins);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Re-parses only the smallest memorized parser application that contains
+     * the edit, instead of the whole source. A block is only accepted, if its
+     * new match ends at the shifted end of the old one. The memorized parsers
+     * enclosing it are then re-derived from the inside out, they reuse the
+     * new block and every other result the edit didn't touch, and each of
+     * them has to keep its length too. Every memorized result that looked at
+     * the edit has to be computed again by these. Otherwise the edit could
+     * change a decision outside of them, so the next smallest enclosing block
+     * is tried. Returns nothing if none of them fit, then reparse is needed.
+     * The parser must not be moved since the previous parse.
+     */
+    template <typename Src>
+    [[nodiscard]] std::optional<reparsed_block>
+    reparse_block(Src const& src,
+        std::size_t start, std::size_t rem, std::size_t ins) {
+
+        auto& memo = m_Context.memo();
+        auto const end = start + rem;
+        auto dropped = memo.overlapping(start, rem);
+        memo.invalidate(start, rem, ins);
+
+        // The blocks containing the edit, from the smallest
+        std::vector<detail::overlapping_entry const*> blocks;
+        for (auto const& e : dropped) {
+            if (e.is_block && e.pos <= start && end <= e.pos + e.matched) {
+                blocks.push_back(&e);
+            }
+        }
+        std::sort(blocks.begin(), blocks.end(),
+            [](auto const* l, auto const* r) {
+                return l->matched < r->matched
+                    || (l->matched == r->matched && l->pos > r->pos);
+            }
+        );
+
+        // Where a dropped entry is expected after the edit, the entries
+        // starting in the removed part start at the edit
+        auto moved = [&](std::size_t pos) {
+            return pos < end ? std::min(pos, start) : pos + ins - rem;
+        };
+        auto rebuilt = [&](detail::overlapping_entry const& e) {
+            return memo.contains(e.pid, moved(e.pos))
+                || (e.pos == start && memo.contains(e.pid, start));
+        };
+        auto reapply = [&](detail::overlapping_entry const& b) {
+            auto res = b.block.reapply(
+                b.block.self, ::std::addressof(src), typeid(Src),
+                b.pos, m_Context
+            );
+            if (res && res->length != b.matched - rem + ins) {
+                res.reset();
+            }
+            return res;
+        };
+        auto encloses = [](detail::overlapping_entry const& outer,
+            detail::overlapping_entry const& inner) {
+            return outer.pos <= inner.pos
+                && inner.pos + inner.matched <= outer.pos + outer.matched;
+        };
+
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+            auto const& b = *blocks[i];
+            auto res = reapply(b);
+            bool fits = res.has_value();
+            // The memorized parents along the spine
+            auto const* top = &b;
+            for (auto j = i + 1; fits && j < blocks.size(); ++j) {
+                if (encloses(*blocks[j], *top)) {
+                    top = blocks[j];
+                    fits = reapply(*top).has_value();
+                }
+            }
+            for (auto it = dropped.begin(); fits && it != dropped.end(); ++it) {
+                fits = encloses(*top, *it) && rebuilt(*it);
+            }
+            if (fits) {
+                res->rule = b.pid;
+                return res;
+            }
+            // The next block has to compute them by itself
+            for (auto const& e : dropped) {
+                memo.erase(e.pid, moved(e.pos));
+                if (e.pos == start) {
+                    memo.erase(e.pid, start);
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Applies p, usually a rule of the grammar, at the offset of the source.
+     * The memo context is shared with parse and reparse, so the results that
+     * are memorized already are reused. It's not cleared, and neither is the
+     * parse state reset.
+     */
+    template <typename Q, typename Src>
+    [[nodiscard]] constexpr decltype(auto)
+    parse_at(Q const& p, Src const& src, std::size_t offset) {
+        cppcmb_assert_parser(Q, Src);
+
+        auto r = reader(src, offset, m_Context);
+        return p.apply(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Like parse_at, but the source is treated as if it ended at end. The
+     * memorized results that looked at the end are dropped before and after,
+     * as they see a different source with and without the bound.
+     */
+    template <typename Q, typename CharT, typename Traits>
+    [[nodiscard]] constexpr auto
+    parse_at(Q const& p, std::basic_string_view<CharT, Traits> const& src,
+        std::size_t offset, std::size_t end) {
+
+        using string_t = std::basic_string_view<CharT, Traits>;
+        cppcmb_assert_parser(Q, string_t);
+        cppcmb_assert(
+            "The bounds must be inside the source!",
+            offset <= end && end <= src.size()
+        );
+
+        auto& memo = m_Context.memo();
+        memo.invalidate(end, 0, 0);
+        auto bounded = src.substr(0, end);
+        auto r = reader(bounded, offset, m_Context);
+        // Copied, the invalidation might drop the entry it refers to
+        auto res = p.apply(r);
+        memo.invalidate(end, 0, 0);
+        return res;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Drops the memorized results that the last parse didn't derive its
+     * result from, unless they start at most neighborhood elements away from
+     * one it did. These are mostly failed alternatives and the results under
+     * them, that later parses are unlikely to ask for again.
+     */
+    compaction_stats compact(std::size_t neighborhood = 0) {
+        m_LastCompaction = m_Context.memo().compact(neighborhood);
+        return m_LastCompaction;
+    }
+
+    /**
+     * Compacts the memo table after every successful parse and reparse.
+     */
+    void enable_auto_compact(std::size_t neighborhood = 0) noexcept {
+        m_AutoCompact = neighborhood;
+    }
+
+    void disable_auto_compact() noexcept {
+        m_AutoCompact = std::nullopt;
+    }
+
+    [[nodiscard]] compaction_stats const& last_compaction()
+        const noexcept {
+        return m_LastCompaction;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Saves the persistable memo entries of the last parse of src, the ones
+     * of the parsers memorized with a key. The version identifies the
+     * grammar, it must be changed whenever the grammar behaves differently,
+     * even if it's type doesn't change, like when an action calls a different
+     * function.
+     */
+    template <typename Src>
+    void save_memo(std::ostream& os, Src const& src,
+        std::uint64_t version) const {
+
+        detail::save_memo(
+            m_Context, os, detail::stable_type_id<P>(), version,
+            detail::source_hash(src)
+        );
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Loads memo entries saved by save_memo for the same grammar, version and
+     * source. Use reparse afterwards (with the edits since saving, if any),
+     * parse would discard the loaded entries. Returns false if nothing was
+     * loaded.
+     */
+    template <typename Src>
+    bool load_memo(std::istream& is, Src const& src, std::uint64_t version) {
+        return detail::load_memo(
+            m_Context, is, detail::stable_type_id<P>(), version,
+            detail::source_hash(src)
+        );
     }
 };
 
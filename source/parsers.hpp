@@ -12,20 +12,34 @@
 
 #include "parsers/action.hpp"
 #include "parsers/alt.hpp"
+#include "parsers/auto_packrat.hpp"
 #include "parsers/combinator.hpp"
+#include "parsers/dfa.hpp"
 #include "parsers/drec_packrat.hpp"
 #include "parsers/eager_alt.hpp"
 #include "parsers/end.hpp"
 #include "parsers/epsilon.hpp"
+#include "parsers/find.hpp"
+#include "parsers/hash_cons.hpp"
+#include "parsers/ilit.hpp"
+#include "parsers/intern.hpp"
 #include "parsers/irec_packrat.hpp"
+#include "parsers/lazy.hpp"
+#include "parsers/left_recursion.hpp"
 #include "parsers/many.hpp"
 #include "parsers/many1.hpp"
+#include "parsers/min_width.hpp"
 #include "parsers/one.hpp"
 #include "parsers/opt.hpp"
 #include "parsers/packrat.hpp"
 #include "parsers/regex.hpp"
+#include "parsers/regex_capture.hpp"
+#include "parsers/repeat.hpp"
 #include "parsers/rule.hpp"
 #include "parsers/seq.hpp"
+#include "parsers/skip_balanced.hpp"
+#include "parsers/stateful.hpp"
 #include "parsers/todo.hpp"
+#include "parsers/unicode.hpp"
 
 #endif /* CPPCMB_PARSERS_HPP */
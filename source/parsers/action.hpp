@@ -49,6 +49,9 @@ public:
         : m_Parser(cppcmb_fwd(cmb)), m_Fn(cppcmb_fwd(fn)) {
     }
 
+    cppcmb_getter(underlying, m_Parser)
+    cppcmb_getter(function, m_Fn)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& src) const {
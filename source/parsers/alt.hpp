@@ -12,6 +12,7 @@
 #define CPPCMB_PARSERS_ALT_HPP
 
 #include "combinator.hpp"
+#include "../memo_context.hpp"
 #include "../result.hpp"
 #include "../sum.hpp"
 
@@ -53,6 +54,9 @@ public:
         : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
     }
 
+    cppcmb_getter(first, m_First)
+    cppcmb_getter(second, m_Second)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
@@ -63,6 +67,7 @@ public:
         using result_t = result<value_t<Src>>;
 
         // Try to apply the first alternative
+        auto branch = detail::branch_scope(r);
         auto p1_inv = m_First.apply(r);
         if (p1_inv.is_success()) {
             auto p1_succ = std::move(p1_inv).success();
@@ -75,6 +80,8 @@ public:
             );
         }
 
+        branch.backtrack();
+
         // Try to apply the second alternative
         auto p2_inv = m_Second.apply(r);
         if (p2_inv.is_success()) {
@@ -88,6 +95,8 @@ public:
             );
         }
 
+        branch.backtrack();
+
         // Both failed, return the error which got further
         auto p1_err = std::move(p1_inv).failure();
         auto p2_err = std::move(p2_inv).failure();
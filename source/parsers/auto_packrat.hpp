@@ -0,0 +1,114 @@
+/**
+ * auto_packrat.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * An adaptively memorizing parser. It starts out without memorization and
+ * samples how often the rule is re-evaluated at the same position. Once the
+ * rate of re-evaluations passes a threshold, it becomes a packrat parser.
+ * The decision is kept in the memo context, so it survives between parses.
+ */
+
+#ifndef CPPCMB_PARSERS_AUTO_PACKRAT_HPP
+#define CPPCMB_PARSERS_AUTO_PACKRAT_HPP
+
+#include <cstddef>
+#include <utility>
+#include "packrat.hpp"
+
+namespace cppcmb {
+
+template <typename P>
+class auto_packrat_t : public detail::packrat_base<auto_packrat_t<P>> {
+private:
+    cppcmb_self_check(auto_packrat_t);
+
+    P           m_Parser;
+    std::size_t m_MinSamples = 16;
+    std::size_t m_Percent    = 20;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr auto_packrat_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    /**
+     * Memorization is turned on after at least min_samples sampled
+     * evaluations, if at least percent% of them were re-evaluations.
+     */
+    template <typename PFwd>
+    constexpr auto_packrat_t(PFwd&& p,
+        std::size_t min_samples, std::size_t percent)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)),
+          m_MinSamples(min_samples), m_Percent(percent) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * The ID to look up the statistics of this rule in a memo context.
+     */
+    [[nodiscard]] constexpr auto const& id() const noexcept {
+        return this->original_id();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> parser_result_t<P, Src> {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = parser_result_t<P, Src>;
+
+        auto& stats = r.context().rule_stats()[this->original_id()];
+        if (stats.memoized()) {
+            auto* entry = this->get_memo(r);
+            if (entry != nullptr) {
+                return std::any_cast<result_t&>(*entry);
+            }
+            auto frame = detail::state_frame_scope(r.context().memo());
+            auto res = m_Parser.apply(r);
+            auto furth = res.furthest();
+            return this->put_memo(
+                r, std::move(res), furth, this->block_of(r)
+            );
+        }
+        stats.record(r.cursor(), m_MinSamples, m_Percent);
+        return m_Parser.apply(r);
+    }
+};
+
+template <typename PFwd>
+auto_packrat_t(PFwd) -> auto_packrat_t<PFwd>;
+
+template <typename PFwd>
+auto_packrat_t(PFwd, std::size_t, std::size_t) -> auto_packrat_t<PFwd>;
+
+/**
+ * Wrapper to make any combinator an adaptive packrat parser.
+ */
+template <typename PFwd>
+[[nodiscard]] constexpr auto memo_auto(PFwd&& p)
+    cppcmb_return(auto_packrat_t(cppcmb_fwd(p)))
+
+template <typename PFwd>
+[[nodiscard]] constexpr auto memo_auto(PFwd&& p,
+    std::size_t min_samples, std::size_t percent)
+    cppcmb_return(auto_packrat_t(cppcmb_fwd(p), min_samples, percent))
+
+struct as_memo_auto_t {};
+
+inline constexpr auto as_memo_auto = as_memo_auto_t();
+
+// Adaptive packrat
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+constexpr auto operator%=(P&& parser, as_memo_auto_t)
+    cppcmb_return(memo_auto(cppcmb_fwd(parser)))
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_AUTO_PACKRAT_HPP */
@@ -0,0 +1,623 @@
+/**
+ * dfa.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Compiles regular combinators (no recursion, only sequences, alternatives,
+ * repetitions and character filters) into a single DFA. The compiled parser
+ * makes one pass over the input without any per-character combinator calls.
+ */
+
+#ifndef CPPCMB_PARSERS_DFA_HPP
+#define CPPCMB_PARSERS_DFA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "action.hpp"
+#include "alt.hpp"
+#include "combinator.hpp"
+#include "eager_alt.hpp"
+#include "ilit.hpp"
+#include "many.hpp"
+#include "many1.hpp"
+#include "one.hpp"
+#include "opt.hpp"
+#include "regex.hpp"
+#include "seq.hpp"
+#include "../detail.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+#include "../transformations/filter.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+/**
+ * True, if the function of the action returns a maybe, so the action can fail
+ * on a value. The DFA only knows the characters, it can't fail like that.
+ * DFAs are applied to characters, so the values are the ones parsed from
+ * strings.
+ */
+template <typename P, typename Fn>
+struct is_failing_action : is_maybe<remove_cvref_t<std::invoke_result_t<
+    action_apply_helper, Fn const&, parser_value_t<P, std::string_view>
+>>> {};
+
+/**
+ * A combinator that consumes exactly one character of a set.
+ */
+template <typename P>
+struct is_char_class : std::false_type {};
+
+template <typename P>
+inline constexpr bool is_char_class_v =
+    is_char_class<remove_cvref_t<P>>::value;
+
+template <>
+struct is_char_class<one_t> : std::true_type {};
+
+template <typename Pred>
+struct is_char_class<action_t<one_t, filter<Pred>>> : std::true_type {};
+
+// Any other filter rejects based on the values, that's not a character class
+template <typename P, typename Pred>
+struct is_char_class<action_t<P, filter<Pred>>> : std::false_type {};
+
+template <typename P, typename Fn>
+struct is_char_class<action_t<P, Fn>> : std::conjunction<
+    is_char_class<P>, std::negation<is_failing_action<P, Fn>>
+> {};
+
+template <typename P1, typename P2>
+struct is_char_class<alt_t<P1, P2>>
+    : std::bool_constant<is_char_class_v<P1> && is_char_class_v<P2>> {};
+
+template <typename P1, typename P2>
+struct is_char_class<eager_alt_t<P1, P2>>
+    : std::bool_constant<is_char_class_v<P1> && is_char_class_v<P2>> {};
+
+template <typename P>
+struct is_char_class<regex::not_char<P>> : is_char_class<P> {};
+
+/**
+ * The regular combinators. Actions are looked through, as only the matched
+ * length matters for a DFA, except for the ones that can fail. Filters are
+ * only allowed on single characters.
+ */
+template <typename P>
+struct is_regular : is_char_class<P> {};
+
+template <typename P1, typename P2>
+struct is_regular<seq_t<P1, P2>>
+    : std::bool_constant<
+        is_regular<remove_cvref_t<P1>>::value
+     && is_regular<remove_cvref_t<P2>>::value> {};
+
+template <typename P1, typename P2>
+struct is_regular<alt_t<P1, P2>>
+    : std::bool_constant<
+        is_regular<remove_cvref_t<P1>>::value
+     && is_regular<remove_cvref_t<P2>>::value> {};
+
+template <typename P1, typename P2>
+struct is_regular<eager_alt_t<P1, P2>>
+    : std::bool_constant<
+        is_regular<remove_cvref_t<P1>>::value
+     && is_regular<remove_cvref_t<P2>>::value> {};
+
+template <typename P, typename Fn>
+struct is_regular<action_t<P, Fn>> : std::conjunction<
+    is_regular<remove_cvref_t<P>>, std::negation<is_failing_action<P, Fn>>
+> {};
+
+template <typename P, typename Pred>
+struct is_regular<action_t<P, filter<Pred>>> : is_char_class<P> {};
+
+template <typename P>
+struct is_regular<opt_t<P>> : is_regular<remove_cvref_t<P>> {};
+
+template <typename P, typename To>
+struct is_regular<many_t<P, To>> : is_regular<remove_cvref_t<P>> {};
+
+template <typename P, typename To>
+struct is_regular<many1_t<P, To>> : is_regular<remove_cvref_t<P>> {};
+
+template <std::size_t I, typename P>
+struct is_regular<regex::group<I, P>> : is_regular<remove_cvref_t<P>> {};
+
+template <typename P>
+struct is_regular<ignore_case_t<P>> : is_regular<remove_cvref_t<P>> {};
+
+/**
+ * Builds the NFA of a regular combinator. Filter predicates are evaluated
+ * for every byte value, so they must not depend on anything else.
+ */
+struct nfa_builder {
+    // XXX(LPeter1997): Noexcept specifier
+    static byte_set char_set(one_t const&) {
+        return byte_set().set();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Pred>
+    static byte_set char_set(action_t<one_t, filter<Pred>> const& p) {
+        byte_set set;
+        for (std::size_t b = 0; b < 256; ++b) {
+            auto ch = static_cast<char>(static_cast<unsigned char>(b));
+            if (p.function().predicate()(ch)) {
+                set.set(b);
+            }
+        }
+        return set;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename Fn>
+    static byte_set char_set(action_t<P, Fn> const& p) {
+        return char_set(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static byte_set char_set(alt_t<P1, P2> const& p) {
+        return char_set(p.first()) | char_set(p.second());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static byte_set char_set(eager_alt_t<P1, P2> const& p) {
+        return char_set(p.first()) | char_set(p.second());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static byte_set char_set(regex::not_char<P> const& p) {
+        return ~char_set(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static nfa::fragment build(nfa& n, P const& p) {
+        if constexpr (is_char_class_v<P>) {
+            return n.bytes(char_set(p));
+        }
+        else {
+            return build_composite(n, p);
+        }
+    }
+
+private:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static nfa::fragment build_composite(nfa& n, seq_t<P1, P2> const& p) {
+        auto a = build(n, p.first());
+        auto b = build(n, p.second());
+        return n.sequence(a, b);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static nfa::fragment build_composite(nfa& n, alt_t<P1, P2> const& p) {
+        auto a = build(n, p.first());
+        auto b = build(n, p.second());
+        return n.choice(a, b);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static nfa::fragment build_composite(nfa& n,
+        eager_alt_t<P1, P2> const& p) {
+        auto a = build(n, p.first());
+        auto b = build(n, p.second());
+        return n.choice(a, b);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename Fn>
+    static nfa::fragment build_composite(nfa& n, action_t<P, Fn> const& p) {
+        return build(n, p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static nfa::fragment build_composite(nfa& n, opt_t<P> const& p) {
+        return n.optional(build(n, p.underlying()));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static nfa::fragment build_composite(nfa& n, many_t<P, To> const& p) {
+        return n.repeat(build(n, p.underlying()));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t I, typename P>
+    static nfa::fragment build_composite(nfa& n,
+        regex::group<I, P> const& p) {
+        // Group I is recorded by the tags 2I and 2I + 1
+        return n.tagged(build(n, p.underlying()), 2 * I, 2 * I + 1);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static nfa::fragment build_composite(nfa& n, ignore_case_t<P> const& p) {
+        auto first = n.size();
+        auto f = build(n, p.underlying());
+        n.fold_case(first);
+        return f;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static nfa::fragment build_composite(nfa& n, many1_t<P, To> const& p) {
+        auto first = build(n, p.underlying());
+        auto rest = n.repeat(build(n, p.underlying()));
+        return n.sequence(first, rest);
+    }
+};
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Compiles a regular combinator.
+ */
+template <typename P>
+[[nodiscard]] dfa compile_dfa(P const& p) {
+    static_assert(
+        is_regular<remove_cvref_t<P>>::value,
+        "Only regular combinators can be compiled to a DFA!"
+    );
+    nfa n;
+    auto f = nfa_builder::build(n, p);
+    return dfa(n, f);
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * The bytes that can start a non-empty match of the DFA.
+ */
+[[nodiscard]] inline byte_set first_bytes(dfa const& d) {
+    auto live = d.live_states();
+    byte_set set;
+    for (std::size_t b = 0; b < 256; ++b) {
+        if (live[d.next(d.start(), static_cast<unsigned char>(b))]) {
+            set.set(b);
+        }
+    }
+    return set;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * The bytes that can extend a match of the DFA towards a longer one.
+ */
+[[nodiscard]] inline byte_set extension_bytes(dfa const& d) {
+    auto live = d.live_states();
+    byte_set set;
+    for (dfa::state_type s = 1; s < d.state_count(); ++s) {
+        if (!d.accepting(s)) {
+            continue;
+        }
+        for (std::size_t b = 0; b < 256; ++b) {
+            if (live[d.next(s, static_cast<unsigned char>(b))]) {
+                set.set(b);
+            }
+        }
+    }
+    return set;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * True, if a match of shorter is a proper prefix of a match of longer.
+ */
+[[nodiscard]] inline bool extends_prefix(dfa const& shorter,
+    dfa const& longer) {
+    auto live1 = shorter.live_states();
+    auto live2 = longer.live_states();
+    auto n2 = longer.state_count();
+    std::vector<bool> seen(shorter.state_count() * n2);
+    std::vector<std::pair<dfa::state_type, dfa::state_type>> stack;
+    stack.emplace_back(shorter.start(), longer.start());
+    seen[shorter.start() * n2 + longer.start()] = true;
+    while (!stack.empty()) {
+        auto [s1, s2] = stack.back();
+        stack.pop_back();
+        for (std::size_t b = 0; b < 256; ++b) {
+            auto t1 = shorter.next(s1, static_cast<unsigned char>(b));
+            auto t2 = longer.next(s2, static_cast<unsigned char>(b));
+            if (!live2[t2]) {
+                continue;
+            }
+            if (shorter.accepting(s1)) {
+                return true;
+            }
+            if (live1[t1] && !seen[t1 * n2 + t2]) {
+                seen[t1 * n2 + t2] = true;
+                stack.emplace_back(t1, t2);
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks, if a regular combinator always matches the longest prefix in its
+ * language, like its DFA. Ordered choice and greedy repetitions never give
+ * up a match they made, so this holds, if
+ *  - no match of an alternative is a proper prefix of a later one's,
+ *  - no match of the first part of a sequence can be extended by a byte
+ *    that starts the second part,
+ *  - a repeated parser can't match empty, and no match of it can be extended
+ *    by a byte that starts the next repetition.
+ * Case folding only merges bytes, so it's checked without the folding.
+ */
+struct longest_match_check {
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check(P const& p) {
+        if constexpr (is_char_class_v<P>) {
+            return true;
+        }
+        else {
+            return check_composite(p);
+        }
+    }
+
+private:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static bool check_composite(seq_t<P1, P2> const& p) {
+        if (!check(p.first()) || !check(p.second())) {
+            return false;
+        }
+        auto ext = extension_bytes(compile_dfa(p.first()));
+        return (ext & first_bytes(compile_dfa(p.second()))).none();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static bool check_composite(alt_t<P1, P2> const& p) {
+        return check(p.first()) && check(p.second())
+            && !extends_prefix(compile_dfa(p.first()), compile_dfa(p.second()));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P1, typename P2>
+    static bool check_composite(eager_alt_t<P1, P2> const& p) {
+        // Takes the longer one anyway
+        return check(p.first()) && check(p.second());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename Fn>
+    static bool check_composite(action_t<P, Fn> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check_composite(opt_t<P> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static bool check_composite(many_t<P, To> const& p) {
+        return check_repeated(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P, typename To>
+    static bool check_composite(many1_t<P, To> const& p) {
+        return check_repeated(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t I, typename P>
+    static bool check_composite(regex::group<I, P> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check_composite(ignore_case_t<P> const& p) {
+        return check(p.underlying());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename P>
+    static bool check_repeated(P const& p) {
+        if (!check(p)) {
+            return false;
+        }
+        auto d = compile_dfa(p);
+        return !d.accepting(d.start())
+            && (extension_bytes(d) & first_bytes(d)).none();
+    }
+};
+
+} /* namespace detail */
+
+/**
+ * True, if the combinator describes a regular language, so it can be
+ * compiled with dfa.
+ */
+template <typename P>
+inline constexpr bool is_regular_v =
+    detail::is_regular<detail::remove_cvref_t<P>>::value;
+
+/**
+ * A regular combinator compiled into a DFA. The DFA matches the longest
+ * prefix that is in the language of the combinator, and the result is the
+ * matched part of the source. Ordered choice and greedy repetitions can
+ * match less (like "in" | "int" on "int"), these combinators are not
+ * compiled, but applied as they are, so the result never changes. Values of
+ * actions are dropped.
+ */
+template <typename P>
+class dfa_t : public combinator<dfa_t<P>> {
+private:
+    cppcmb_self_check(dfa_t);
+
+    P                                  m_Parser;
+    std::shared_ptr<detail::dfa const> m_Dfa;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    dfa_t(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)),
+          m_Dfa(detail::longest_match_check::check(m_Parser)
+              ? std::make_shared<detail::dfa const>(
+                  detail::compile_dfa(m_Parser))
+              : nullptr) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * True, if the combinator could be compiled without changing what it
+     * matches.
+     */
+    [[nodiscard]] bool compiled() const noexcept {
+        return m_Dfa != nullptr;
+    }
+
+    /**
+     * The compiled automaton.
+     */
+    [[nodiscard]] detail::dfa const& automaton() const noexcept {
+        cppcmb_assert("The combinator is not compiled!", compiled());
+        return *m_Dfa;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "DFAs can only be applied to contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
+
+        auto const* data = std::data(r.source()) + r.cursor();
+        if (!compiled()) {
+            auto inv = m_Parser.apply(r);
+            if (inv.is_failure()) {
+                return result_t(std::move(inv).failure(), inv.furthest());
+            }
+            auto n = inv.success().matched();
+            return result_t(success(string_t(data, n), n), inv.furthest());
+        }
+        auto const len = std::size(r.source()) - r.cursor();
+        std::size_t furthest = 0;
+        auto matched = m_Dfa->longest_match(data, len, furthest);
+        if (matched < 0) {
+            return result_t(failure(), furthest);
+        }
+        auto n = std::size_t(matched);
+        return result_t(success(string_t(data, n), n), furthest);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Validates many records, each one has to match as a whole. Bit i % 64
+     * of word i / 64 of the result is set, if the i-th record matches. The
+     * records are matched in batches of detail::dfa::batch_lanes, or one by
+     * one, if the combinator is not compiled.
+     */
+    template <typename It>
+    [[nodiscard]] std::vector<std::uint64_t> validate(It first, It last)
+        const {
+        using record_t = detail::remove_cvref_t<decltype(*first)>;
+        using char_t = detail::remove_cvref_t<
+            decltype(*std::data(std::declval<record_t const&>()))
+        >;
+        constexpr auto lanes = detail::dfa::batch_lanes;
+
+        std::vector<std::uint64_t> bits;
+        if (!compiled()) {
+            for (std::size_t i = 0; first != last; ++first, ++i) {
+                if (i % 64 == 0) {
+                    bits.push_back(0);
+                }
+                auto rec = std::basic_string_view<char_t>(
+                    std::data(*first), std::size(*first)
+                );
+                auto inv = m_Parser.apply(reader(rec));
+                if (inv.is_success() && inv.success().matched() == rec.size()) {
+                    bits[i / 64] |= std::uint64_t(1) << (i % 64);
+                }
+            }
+            return bits;
+        }
+        std::array<char_t const*, lanes> data{};
+        std::array<std::size_t, lanes> lens{};
+        std::size_t n = 0;
+        std::size_t count = 0;
+        auto flush = [&] {
+            auto batch = m_Dfa->full_match_batch(data.data(), lens.data(), n);
+            auto at = count - n;
+            if (bits.size() * 64 < count) {
+                bits.push_back(0);
+            }
+            // A batch never straddles two words, as 64 % lanes == 0
+            bits[at / 64] |= std::uint64_t(batch) << (at % 64);
+            n = 0;
+        };
+        for (; first != last; ++first) {
+            data[n] = std::data(*first);
+            lens[n] = std::size(*first);
+            ++n;
+            ++count;
+            if (n == lanes) {
+                flush();
+            }
+        }
+        if (n != 0) {
+            flush();
+        }
+        return bits;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Range>
+    [[nodiscard]] std::vector<std::uint64_t> validate(Range const& records)
+        const {
+        return validate(std::begin(records), std::end(records));
+    }
+};
+
+template <typename PFwd>
+dfa_t(PFwd) -> dfa_t<PFwd>;
+
+/**
+ * Compiles a regular combinator into a DFA.
+ */
+template <typename PFwd>
+[[nodiscard]] auto dfa(PFwd&& p)
+    cppcmb_return(dfa_t(cppcmb_fwd(p)))
+
+struct as_dfa_t {};
+
+inline constexpr auto as_dfa = as_dfa_t();
+
+// DFA compilation
+template <typename P, cppcmb_requires_t(detail::is_combinator_cvref_v<P>)>
+auto operator%=(P&& parser, as_dfa_t)
+    cppcmb_return(dfa(cppcmb_fwd(parser)))
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_DFA_HPP */
@@ -12,6 +12,7 @@
 #define CPPCMB_PARSERS_EAGER_ALT_HPP
 
 #include "alt.hpp"
+#include "../memo_context.hpp"
 
 namespace cppcmb {
 
@@ -37,6 +38,9 @@ public:
         : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
     }
 
+    cppcmb_getter(first, m_First)
+    cppcmb_getter(second, m_Second)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
@@ -46,47 +50,45 @@ public:
 
         using result_t = result<value_t<Src>>;
 
-        // Try to apply both alternatives
+        // Try to apply both alternatives, from the same state
+        auto first = detail::branch_scope(r);
         auto p1_inv = m_First.apply(r);
+        // If the first one changed the state, the change is undone for the
+        // second one, and the first one is applied again, if it's taken
+        bool const reapply = first.changed_state();
+        if (reapply || p1_inv.is_failure()) {
+            first.backtrack();
+        }
+        auto second = detail::branch_scope(r);
         auto p2_inv = m_Second.apply(r);
 
         auto furthest = std::max(p1_inv.furthest(), p2_inv.furthest());
 
-        // Both succeeded
-        if (p1_inv.is_success() && p2_inv.is_success()) {
-            // Return the one that got further
-            // If they both got the same distance, return the first one
-            auto p1_succ = std::move(p1_inv).success();
-            auto p2_succ = std::move(p2_inv).success();
-
-            if (p1_succ.matched() >= p2_succ.matched()) {
-                return result_t(success(
-                    sum_values<value_t<Src>>(std::move(p1_succ).value()),
-                    p1_succ.matched()
-                ), furthest);
-            }
-            return result_t(success(
-                sum_values<value_t<Src>>(std::move(p2_succ).value()),
-                p2_succ.matched()
-            ), furthest);
-        }
-        // LHS succeeded
-        if (p1_inv.is_success()) {
-            auto p1_succ = std::move(p1_inv).success();
+        auto take = [&](auto&& inv) {
+            auto succ = std::move(inv).success();
             return result_t(success(
-                sum_values<value_t<Src>>(std::move(p1_succ).value()),
-                p1_succ.matched()
+                sum_values<value_t<Src>>(std::move(succ).value()),
+                succ.matched()
             ), furthest);
+        };
+
+        // Return the one that got further
+        // If they both got the same distance, return the first one
+        if (p1_inv.is_success() && (p2_inv.is_failure()
+         || p1_inv.success().matched() >= p2_inv.success().matched())) {
+            second.backtrack();
+            if (reapply) {
+                return take(m_First.apply(r));
+            }
+            return take(std::move(p1_inv));
         }
-        // RHS succeeded
         if (p2_inv.is_success()) {
-            auto p2_succ = std::move(p2_inv).success();
-            return result_t(success(
-                sum_values<value_t<Src>>(std::move(p2_succ).value()),
-                p2_succ.matched()
-            ), furthest);
+            first.backtrack_until(second);
+            return take(std::move(p2_inv));
         }
 
+        second.backtrack();
+
         // Both failed, return the error which got further
         auto p1_err = std::move(p1_inv).failure();
         auto p2_err = std::move(p2_inv).failure();
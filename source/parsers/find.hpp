@@ -0,0 +1,109 @@
+/**
+ * find.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Scans forward for the first match of a regular combinator, skipping
+ * everything before it.
+ */
+
+#ifndef CPPCMB_PARSERS_FIND_HPP
+#define CPPCMB_PARSERS_FIND_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include "combinator.hpp"
+#include "dfa.hpp"
+#include "../detail.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Compiles a regular combinator into a DFA, with its prefilter.
+ */
+template <typename P>
+[[nodiscard]] dfa_searcher compile_searcher(P const& p) {
+    return dfa_searcher(compile_dfa(p));
+}
+
+} /* namespace detail */
+
+/**
+ * Finds the first (leftmost-longest) match of a regular combinator from the
+ * cursor on. The result is the matched part of the source, the skipped part
+ * is consumed too. Fails, if there's no match until the end of the source.
+ */
+template <typename P>
+class find_t : public combinator<find_t<P>> {
+private:
+    cppcmb_self_check(find_t);
+
+    P                                           m_Parser;
+    std::shared_ptr<detail::dfa_searcher const> m_Searcher;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    find_t(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)),
+          m_Searcher(std::make_shared<detail::dfa_searcher const>(
+              detail::compile_searcher(m_Parser)
+          )) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * The compiled automaton and its prefilter.
+     */
+    [[nodiscard]] detail::dfa_searcher const& searcher() const noexcept {
+        return *m_Searcher;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Searching only works in contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
+
+        auto const* data = std::data(r.source()) + r.cursor();
+        auto const len = std::size(r.source()) - r.cursor();
+        std::size_t furthest = 0;
+        auto m = m_Searcher->search(data, len, 0, furthest);
+        if (m.begin == detail::prefilter::npos) {
+            return result_t(failure(), furthest);
+        }
+        auto matched = m.begin + m.length;
+        return result_t(
+            success(string_t(data + m.begin, m.length), matched), furthest
+        );
+    }
+};
+
+template <typename PFwd>
+find_t(PFwd) -> find_t<PFwd>;
+
+/**
+ * Scans forward for the first match of a regular combinator.
+ */
+template <typename PFwd>
+[[nodiscard]] auto find(PFwd&& p)
+    cppcmb_return(find_t(cppcmb_fwd(p)))
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_FIND_HPP */
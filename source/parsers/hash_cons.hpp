@@ -0,0 +1,80 @@
+/**
+ * hash_cons.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Hash-conses the successful value of a parser in a pool, the result is the
+ * shared value instead of a copy of its own.
+ */
+
+#ifndef CPPCMB_PARSERS_HASH_CONS_HPP
+#define CPPCMB_PARSERS_HASH_CONS_HPP
+
+#include <memory>
+#include "combinator.hpp"
+#include "../detail.hpp"
+#include "../hash_cons_pool.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+
+/**
+ * The pool is referenced, it has to outlive the parser. Memorizing the
+ * hash-consed parser instead of the underlying one makes the memo table share
+ * the values too.
+ */
+template <typename P, typename Pool>
+class hash_cons_t : public combinator<hash_cons_t<P, Pool>> {
+private:
+    P     m_Parser;
+    Pool* m_Pool;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    hash_cons_t(PFwd&& p, Pool& pool)
+        : m_Parser(cppcmb_fwd(p)), m_Pool(::std::addressof(pool)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    [[nodiscard]] Pool& pool() const noexcept {
+        return *m_Pool;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = result<typename Pool::pointer_type>;
+
+        auto res = m_Parser.apply(r);
+        if (res.is_failure()) {
+            return result_t(std::move(res).failure(), res.furthest());
+        }
+        auto len = res.success().matched();
+        auto shared = m_Pool->intern(std::move(res).success().value());
+        return result_t(success(std::move(shared), len), res.furthest());
+    }
+};
+
+template <typename PFwd, typename Pool>
+hash_cons_t(PFwd, Pool&) -> hash_cons_t<PFwd, Pool>;
+
+/**
+ * Hash-conses what p produces in the pool.
+ */
+template <typename PFwd, typename Pool>
+[[nodiscard]] auto hash_cons(PFwd&& p, Pool& pool)
+    cppcmb_return(hash_cons_t(cppcmb_fwd(p), pool))
+
+// The pool would be destroyed before the parser is used
+template <typename PFwd, typename Pool>
+void hash_cons(PFwd&& p, Pool const&& pool) = delete;
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_HASH_CONS_HPP */
@@ -0,0 +1,292 @@
+/**
+ * ilit.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Case-insensitive literal and keyword matching. Only ASCII letters are folded,
+ * every other character has to match exactly. The input is never copied, it's
+ * folded in place while comparing.
+ */
+
+#ifndef CPPCMB_PARSERS_ILIT_HPP
+#define CPPCMB_PARSERS_ILIT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include "combinator.hpp"
+#include "../detail.hpp"
+#include "../product.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+
+namespace detail {
+
+template <typename T>
+[[nodiscard]] constexpr T ascii_to_lower(T c) noexcept {
+    if (c >= T('A') && c <= T('Z')) {
+        return T(c - T('A') + T('a'));
+    }
+    return c;
+}
+
+template <typename T>
+[[nodiscard]] constexpr bool ascii_has_upper(std::basic_string_view<T> str)
+    noexcept {
+    for (auto c : str) {
+        if (c >= T('A') && c <= T('Z')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * A view of the source that returns every element with ASCII letters
+ * converted to lower-case.
+ */
+template <typename Src>
+class ascii_fold_view {
+private:
+    Src const* m_Source;
+
+public:
+    constexpr explicit ascii_fold_view(Src const& src) noexcept
+        : m_Source(::std::addressof(src)) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] constexpr auto operator[](std::size_t idx) const {
+        return ascii_to_lower(remove_cvref_t<decltype((*m_Source)[idx])>(
+            (*m_Source)[idx]
+        ));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] constexpr auto size() const {
+        return std::size(*m_Source);
+    }
+};
+
+/**
+ * Compares the literal with the source at the given position, ignoring ASCII
+ * case. Returns the number of matching elements, which is the length of the
+ * literal on success.
+ */
+template <typename Src, typename CharT>
+[[nodiscard]] constexpr std::size_t ascii_icase_prefix(
+    Src const& src, std::size_t idx, std::basic_string_view<CharT> lit) {
+
+    using elem_t = remove_cvref_t<decltype(src[idx])>;
+
+    auto const size = std::size(src);
+    auto const len = lit.size();
+    std::size_t i = 0;
+
+    if constexpr (is_contiguous_source_v<Src>
+               && sizeof(elem_t) == 1 && sizeof(CharT) == 1) {
+        // Compare 8 bytes at a time
+        auto const* data = std::data(src) + idx;
+        auto const* ldata = lit.data();
+        while (i + swar_width <= len && idx + i + swar_width <= size) {
+            auto w1 = swar_to_lower(swar_load(data + i));
+            auto w2 = swar_to_lower(swar_load(ldata + i));
+            if (w1 != w2) {
+                // Let the element-wise loop find the exact position
+                break;
+            }
+            i += swar_width;
+        }
+    }
+
+    for (; i < len && idx + i < size; ++i) {
+        if (ascii_to_lower(src[idx + i]) != elem_t(ascii_to_lower(lit[i]))) {
+            break;
+        }
+    }
+    return i;
+}
+
+} /* namespace detail */
+
+/**
+ * Matches a literal, ignoring ASCII case.
+ */
+template <typename CharT>
+class ilit_t : public combinator<ilit_t<CharT>> {
+private:
+    std::basic_string_view<CharT> m_Literal;
+
+public:
+    constexpr ilit_t(std::basic_string_view<CharT> lit) noexcept
+        : m_Literal(lit) {
+    }
+
+    [[nodiscard]] constexpr auto const& literal() const noexcept {
+        return m_Literal;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<product<>> {
+
+        using result_t = result<product<>>;
+
+        auto len = detail::ascii_icase_prefix(
+            r.source(), r.cursor(), m_Literal
+        );
+        if (len == m_Literal.size()) {
+            return result_t(success(product<>(), len), len);
+        }
+        // We looked at the mismatching element too, if there was one
+        auto peeked = r.cursor() + len < std::size(r.source()) ? len + 1 : len;
+        return result_t(failure(), peeked);
+    }
+};
+
+template <typename CharT>
+ilit_t(std::basic_string_view<CharT>) -> ilit_t<CharT>;
+
+/**
+ * Creates a case-insensitive literal parser.
+ */
+template <typename CharT>
+[[nodiscard]] constexpr auto ilit(CharT const* lit) noexcept {
+    return ilit_t(std::basic_string_view<CharT>(lit));
+}
+
+template <typename CharT>
+[[nodiscard]] constexpr auto ilit(std::basic_string_view<CharT> lit) noexcept {
+    return ilit_t(lit);
+}
+
+/**
+ * Applies the underlying parser to the input with ASCII letters folded to
+ * lower-case. The underlying parser has to expect lower-case input.
+ */
+template <typename P>
+class ignore_case_t : public combinator<ignore_case_t<P>> {
+private:
+    cppcmb_self_check(ignore_case_t);
+
+    P m_Parser;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr ignore_case_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        using view_t = detail::ascii_fold_view<Src>;
+        cppcmb_assert_parser(P, view_t);
+
+        auto folded = view_t(r.source());
+        return m_Parser.apply(reader(folded, r.cursor(), r.context_ptr()));
+    }
+};
+
+template <typename PFwd>
+ignore_case_t(PFwd) -> ignore_case_t<PFwd>;
+
+/**
+ * Wrapper to make any combinator case-insensitive.
+ */
+template <typename PFwd>
+[[nodiscard]] constexpr auto ignore_case(PFwd&& p)
+    cppcmb_return(ignore_case_t(cppcmb_fwd(p)))
+
+/**
+ * Matches the longest of the given keywords, ignoring ASCII case. The result
+ * is the index of the matched keyword.
+ */
+template <typename CharT, std::size_t N>
+class ikeyword_set_t : public combinator<ikeyword_set_t<CharT, N>> {
+private:
+    std::array<std::basic_string_view<CharT>, N> m_Keywords;
+
+public:
+    constexpr ikeyword_set_t(
+        std::array<std::basic_string_view<CharT>, N> const& kws) noexcept
+        : m_Keywords(kws) {
+    }
+
+    cppcmb_getter(keywords, m_Keywords)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<std::size_t> {
+
+        using result_t = result<std::size_t>;
+
+        auto const& src = r.source();
+        auto const idx = r.cursor();
+        auto const rem = std::size(src) - idx;
+
+        if (rem == 0) {
+            return result_t(failure(), 0U);
+        }
+        // Most keywords can be ruled out by their first character
+        auto first = detail::ascii_to_lower(src[idx]);
+
+        std::size_t best = N;
+        std::size_t best_len = 0;
+        std::size_t furthest = 1;
+        for (std::size_t i = 0; i < N; ++i) {
+            auto const& kw = m_Keywords[i];
+            if (kw.size() > rem || (best != N && kw.size() <= best_len)) {
+                continue;
+            }
+            if (!kw.empty()
+             && first != decltype(first)(detail::ascii_to_lower(kw[0]))) {
+                continue;
+            }
+            auto len = detail::ascii_icase_prefix(src, idx, kw);
+            furthest = std::max(furthest, std::min(len + 1, rem));
+            if (len == kw.size()) {
+                best = i;
+                best_len = len;
+            }
+        }
+
+        if (best == N) {
+            return result_t(failure(), furthest);
+        }
+        return result_t(success(best, best_len), furthest);
+    }
+};
+
+/**
+ * Creates a case-insensitive keyword-set parser.
+ */
+template <typename CharT, typename... Ts>
+[[nodiscard]] constexpr auto ikeywords(CharT const* first, Ts const*... rest)
+    noexcept {
+
+    static_assert(
+        (... && std::is_same_v<CharT, Ts>),
+        "All keywords must have the same character type!"
+    );
+    using str_t = std::basic_string_view<CharT>;
+    return ikeyword_set_t<CharT, sizeof...(Ts) + 1>({
+        str_t(first), str_t(rest)...
+    });
+}
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_ILIT_HPP */
@@ -0,0 +1,88 @@
+/**
+ * intern.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Interns the matched part of the source in a symbol table, the result is the
+ * id of the symbol instead of the string.
+ */
+
+#ifndef CPPCMB_PARSERS_INTERN_HPP
+#define CPPCMB_PARSERS_INTERN_HPP
+
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include "combinator.hpp"
+#include "../detail.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+#include "../symbol_table.hpp"
+
+namespace cppcmb {
+
+/**
+ * The table is referenced, it has to outlive the parser. Works with any table
+ * that has an intern member function, like symbol_table or
+ * concurrent_symbol_table.
+ */
+template <typename P, typename Table>
+class intern_t : public combinator<intern_t<P, Table>> {
+private:
+    P      m_Parser;
+    Table* m_Table;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    intern_t(PFwd&& p, Table& table)
+        : m_Parser(cppcmb_fwd(p)), m_Table(::std::addressof(table)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    [[nodiscard]] Table& table() const noexcept {
+        return *m_Table;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Only contiguous sources can be interned!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<symbol_id>;
+
+        auto res = m_Parser.apply(r);
+        if (res.is_failure()) {
+            return result_t(std::move(res).failure(), res.furthest());
+        }
+        auto len = res.success().matched();
+        auto span = string_t(std::data(r.source()) + r.cursor(), len);
+        return result_t(success(m_Table->intern(span), len), res.furthest());
+    }
+};
+
+template <typename PFwd, typename Table>
+intern_t(PFwd, Table&) -> intern_t<PFwd, Table>;
+
+/**
+ * Interns what p matches in the table.
+ */
+template <typename PFwd, typename Table>
+[[nodiscard]] auto intern(PFwd&& p, Table& table)
+    cppcmb_return(intern_t(cppcmb_fwd(p), table))
+
+// The table would be destroyed before the parser is used
+template <typename PFwd, typename Table>
+void intern(PFwd&& p, Table const&& table) = delete;
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_INTERN_HPP */
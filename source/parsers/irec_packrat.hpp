@@ -14,6 +14,14 @@
 
 namespace cppcmb {
 
+namespace detail {
+
+// Defined in left_recursion.hpp, it needs every combinator
+template <typename P>
+struct in_left_cycle;
+
+} /* namespace detail */
+
 template <typename P>
 class irec_packrat_t : public detail::packrat_base<irec_packrat_t<P>> {
 private:
@@ -67,7 +75,9 @@ private:
             // Remove the rule id from the evaluation id set of the head
             h.eval_set().erase(it);
             auto tmp_res = m_Parser.apply(r);
-            *cached = tmp_res;
+            // Put, so the entry knows how far the new result looked
+            this->put_memo(r, tmp_res, tmp_res.furthest());
+            return std::any(std::move(tmp_res));
         }
 
         return *cached;
@@ -196,6 +206,30 @@ public:
 
         using return_t = parser_result_t<P, Src>;
 
+        if constexpr (!detail::in_left_cycle<irec_packrat_t>::value) {
+            // Can't be part of a left-recursion, no heads to track
+            auto* entry = this->get_memo(r);
+            if (entry != nullptr) {
+                return this-> template to_result<return_t>(*entry);
+            }
+            auto frame = detail::state_frame_scope(r.context().memo());
+            auto res = m_Parser.apply(r);
+            auto furth = res.furthest();
+            return this->put_memo(
+                r, std::move(res), furth, this->block_of(r)
+            );
+        }
+        else {
+            return apply_lr(r);
+        }
+    }
+
+private:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    constexpr auto apply_lr(reader<Src> const& r) const {
+        using return_t = parser_result_t<P, Src>;
+
         auto& lr_stack = r.context().call_stack();
 
         auto m = recall(r);
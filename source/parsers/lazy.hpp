@@ -0,0 +1,205 @@
+/**
+ * lazy.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Deferred parsing of nested regions. A cheap skipper steps over the region
+ * (like a function body) and only it's span is recorded. The actual parser is
+ * applied when the result is first asked for, and the result is kept.
+ */
+
+#ifndef CPPCMB_PARSERS_LAZY_HPP
+#define CPPCMB_PARSERS_LAZY_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "combinator.hpp"
+#include "../memo_context.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+
+namespace detail {
+
+/**
+ * The first elements of a source, so a parser can't look past them. The
+ * positions stay the same as in the whole source.
+ */
+template <typename Src>
+class source_prefix {
+private:
+    Src const*  m_Source;
+    std::size_t m_Size;
+
+public:
+    constexpr source_prefix(Src const& src, std::size_t size) noexcept
+        : m_Source(::std::addressof(src)), m_Size(size) {
+    }
+
+    [[nodiscard]] constexpr decltype(auto) operator[](std::size_t idx)
+        const noexcept {
+        return (*m_Source)[idx];
+    }
+
+    [[nodiscard]] constexpr std::size_t size() const noexcept {
+        return m_Size;
+    }
+
+    // Only for contiguous sources
+    template <typename S = Src>
+    [[nodiscard]] constexpr auto data() const noexcept
+        -> decltype(std::data(std::declval<S const&>())) {
+        return std::data(*m_Source);
+    }
+};
+
+} /* namespace detail */
+
+/**
+ * A handle to a region that hasn't been parsed yet. Copies share the parsed
+ * result. The source has to outlive the handle, just like for any result that
+ * refers to the source. Handles are not thread-safe.
+ */
+template <typename P, typename Src>
+class lazy_handle {
+public:
+    using source_type = detail::source_prefix<Src>;
+    using result_type = parser_result_t<P, source_type>;
+
+private:
+    struct state {
+        std::shared_ptr<P const>    parser;
+        // Kept here, nested handles refer to it
+        source_type                 source;
+        std::size_t                 start;
+        std::size_t                 length;
+        // Only created for the bodies that are parsed
+        std::optional<memo_context> context;
+        std::optional<result_type>  value;
+
+        state(std::shared_ptr<P const> p, Src const& src,
+            std::size_t start, std::size_t len)
+            : parser(std::move(p)), source(src, start + len),
+              start(start), length(len) {
+        }
+    };
+
+    std::shared_ptr<state> m_State;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    lazy_handle(std::shared_ptr<P const> p, Src const& src,
+        std::size_t start, std::size_t len)
+        : m_State(std::make_shared<state>(std::move(p), src, start, len)) {
+    }
+
+    /**
+     * The position of the region in the source.
+     */
+    [[nodiscard]] std::size_t start() const noexcept {
+        return m_State->start;
+    }
+
+    /**
+     * The number of elements the skipper consumed.
+     */
+    [[nodiscard]] std::size_t length() const noexcept {
+        return m_State->length;
+    }
+
+    [[nodiscard]] bool is_parsed() const noexcept {
+        return m_State->value.has_value();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Parses the region, if it hasn't been parsed yet. The parser starts at
+     * the beginning of the region, it's positions are relative to the whole
+     * source. It can't look past the region, and it fails if it doesn't
+     * consume exactly what the skipper did.
+     */
+    [[nodiscard]] result_type const& get() const {
+        auto& st = *m_State;
+        if (!st.value) {
+            auto r = reader(st.source, st.start, st.context.emplace());
+            auto res = st.parser->apply(r);
+            if (res.is_success() && res.success().matched() != st.length) {
+                st.value.emplace(failure(), res.furthest());
+            }
+            else {
+                st.value.emplace(std::move(res));
+            }
+            // The body won't be parsed again
+            st.context.reset();
+        }
+        return *st.value;
+    }
+
+    [[nodiscard]] result_type const& operator*() const { return get(); }
+    [[nodiscard]] result_type const* operator->() const { return &get(); }
+};
+
+template <typename P, typename Skip>
+class lazy_t : public combinator<lazy_t<P, Skip>> {
+private:
+    std::shared_ptr<P const> m_Parser;
+    Skip                     m_Skipper;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd, typename SkipFwd>
+    lazy_t(PFwd&& p, SkipFwd&& skip)
+        : m_Parser(std::make_shared<P const>(cppcmb_fwd(p))),
+          m_Skipper(cppcmb_fwd(skip)) {
+    }
+
+    [[nodiscard]] P const& underlying() const noexcept {
+        return *m_Parser;
+    }
+
+    cppcmb_getter(skipper, m_Skipper)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const
+        -> result<lazy_handle<P, Src>> {
+        cppcmb_assert_parser(P, Src);
+        cppcmb_assert_parser(Skip, Src);
+
+        using result_t = result<lazy_handle<P, Src>>;
+
+        auto s_inv = m_Skipper.apply(r);
+        if (s_inv.is_failure()) {
+            return result_t(failure(), s_inv.furthest());
+        }
+        auto matched = s_inv.success().matched();
+        return result_t(
+            success(
+                lazy_handle<P, Src>(m_Parser, r.source(), r.cursor(), matched),
+                matched
+            ),
+            s_inv.furthest()
+        );
+    }
+};
+
+template <typename PFwd, typename SkipFwd>
+lazy_t(PFwd, SkipFwd) -> lazy_t<PFwd, SkipFwd>;
+
+/**
+ * Skips a region with skip, and parses it with p only when the result is
+ * accessed.
+ */
+template <typename PFwd, typename SkipFwd>
+[[nodiscard]] auto lazy(PFwd&& p, SkipFwd&& skip)
+    cppcmb_return(lazy_t(cppcmb_fwd(p), cppcmb_fwd(skip)))
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_LAZY_HPP */
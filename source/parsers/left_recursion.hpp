@@ -0,0 +1,231 @@
+/**
+ * left_recursion.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A compile-time analysis of the rule graph, that tells if a combinator can
+ * call itself without consuming anything first. Only those combinators can be
+ * left-recursive, the rest don't need the runtime bookkeeping of the
+ * left-recursive packrat parsers.
+ */
+
+#ifndef CPPCMB_PARSERS_LEFT_RECURSION_HPP
+#define CPPCMB_PARSERS_LEFT_RECURSION_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include "end.hpp"
+#include "epsilon.hpp"
+#include "many.hpp"
+#include "min_width.hpp"
+#include "opt.hpp"
+#include "regex.hpp"
+#include "repeat.hpp"
+#include "rule.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+template <typename... Ts>
+struct type_list {};
+
+template <typename L1, typename L2>
+struct concat_lists;
+
+template <typename... Ts, typename... Us>
+struct concat_lists<type_list<Ts...>, type_list<Us...>> {
+    using type = type_list<Ts..., Us...>;
+};
+
+template <typename L1, typename L2>
+using concat_lists_t = typename concat_lists<L1, L2>::type;
+
+/**
+ * What a combinator calls at the position it's applied at: the tags of the
+ * rules and if it might call the target itself. Unknown combinators are
+ * assumed to call the target, so the analysis stays conservative.
+ */
+template <typename Rules, bool Cyclic>
+struct left_info {
+    using rules = Rules;
+    static constexpr bool cyclic = Cyclic;
+};
+
+using left_leaf = left_info<type_list<>, false>;
+using left_cycle = left_info<type_list<>, true>;
+
+template <typename Target, typename P>
+struct left_calls : left_cycle {};
+
+template <typename Target, typename P>
+using left_calls_t = std::conditional_t<
+    std::is_same_v<Target, remove_cvref_t<P>>,
+    left_cycle,
+    left_calls<Target, remove_cvref_t<P>>
+>;
+
+template <typename I1, typename I2>
+using merge_left_t = left_info<
+    concat_lists_t<typename I1::rules, typename I2::rules>,
+    I1::cyclic || I2::cyclic
+>;
+
+// Rules are resolved lazily, the first call tells the tag
+
+template <typename Target, typename Val, typename Tag>
+struct left_calls<Target, rule_t<Val, Tag>>
+    : left_info<type_list<Tag>, false> {};
+
+// Combinators that call nothing at their position
+
+template <typename Target>
+struct left_calls<Target, one_t> : left_leaf {};
+
+template <typename Target>
+struct left_calls<Target, end_t> : left_leaf {};
+
+template <typename Target>
+struct left_calls<Target, epsilon_t> : left_leaf {};
+
+template <typename Target, typename P>
+struct left_calls<Target, dfa_t<P>> : left_leaf {};
+
+template <typename Target, typename P>
+struct left_calls<Target, find_t<P>> : left_leaf {};
+
+template <typename Target, typename P, std::size_t N>
+struct left_calls<Target, capture_t<P, N>> : left_leaf {};
+
+template <typename Target, typename CharT>
+struct left_calls<Target, ilit_t<CharT>> : left_leaf {};
+
+template <typename Target, typename CharT, std::size_t N>
+struct left_calls<Target, ikeyword_set_t<CharT, N>> : left_leaf {};
+
+template <typename Target, typename Table>
+struct left_calls<Target, unicode_class_t<Table>> : left_leaf {};
+
+template <typename Target, typename First, typename Rest>
+struct left_calls<Target, unicode_word_t<First, Rest>> : left_leaf {};
+
+template <typename Target, char Open, char Close, char Quote, char Escape>
+struct left_calls<Target, skip_balanced_t<Open, Close, Quote, Escape>>
+    : left_leaf {};
+
+// Composite combinators
+
+template <typename Target, typename P1, typename P2>
+struct left_calls<Target, seq_t<P1, P2>> : merge_left_t<
+    left_calls_t<Target, P1>,
+    std::conditional_t<
+        min_width_v<P1> == 0, left_calls_t<Target, P2>, left_leaf
+    >
+> {};
+
+template <typename Target, typename P1, typename P2>
+struct left_calls<Target, alt_t<P1, P2>>
+    : merge_left_t<left_calls_t<Target, P1>, left_calls_t<Target, P2>> {};
+
+template <typename Target, typename P1, typename P2>
+struct left_calls<Target, eager_alt_t<P1, P2>>
+    : merge_left_t<left_calls_t<Target, P1>, left_calls_t<Target, P2>> {};
+
+// Wrappers that call their parser at their own position
+
+template <typename Target, typename P, typename Fn>
+struct left_calls<Target, action_t<P, Fn>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, opt_t<P>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P, typename To>
+struct left_calls<Target, many_t<P, To>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P, typename To>
+struct left_calls<Target, many1_t<P, To>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P, std::size_t N, std::size_t M>
+struct left_calls<Target, repeat_t<P, N, M>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, ignore_case_t<P>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P, typename Table>
+struct left_calls<Target, intern_t<P, Table>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P, typename Pool>
+struct left_calls<Target, hash_cons_t<P, Pool>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename State, typename P, typename Fn>
+struct left_calls<Target, state_action_t<State, P, Fn>>
+    : left_calls_t<Target, P> {};
+
+template <typename Target, typename State, typename P, typename Pred>
+struct left_calls<Target, state_filter_t<State, P, Pred>>
+    : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, packrat_t<P>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, auto_packrat_t<P>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, drec_packrat_t<P>> : left_calls_t<Target, P> {};
+
+template <typename Target, typename P>
+struct left_calls<Target, irec_packrat_t<P>> : left_calls_t<Target, P> {};
+
+/**
+ * The combinator a rule is defined as.
+ */
+template <typename Tag>
+using rule_body_t = remove_cvref_t<decltype(rule_set<Tag>)>;
+
+/**
+ * Visits every rule reachable through left calls once, a worklist instead of
+ * recursion keeps cyclic rule graphs finite.
+ */
+template <typename Target, typename Seen, typename Todo>
+struct left_closure;
+
+template <typename Target, typename Seen, typename Info, typename Todo>
+struct left_expand : std::conditional_t<
+    Info::cyclic,
+    std::true_type,
+    left_closure<Target, Seen, concat_lists_t<Todo, typename Info::rules>>
+> {};
+
+template <typename Target, typename... Seen>
+struct left_closure<Target, type_list<Seen...>, type_list<>>
+    : std::false_type {};
+
+template <typename Target, typename... Seen, typename Tag, typename... Todo>
+struct left_closure<Target, type_list<Seen...>, type_list<Tag, Todo...>>
+    : std::conditional_t<
+        (std::is_same_v<Tag, Seen> || ...),
+        left_closure<Target, type_list<Seen...>, type_list<Todo...>>,
+        left_expand<
+            Target, type_list<Seen..., Tag>,
+            left_calls_t<Target, rule_body_t<Tag>>, type_list<Todo...>
+        >
+    > {};
+
+/**
+ * True, if P might call itself at the same position, through any number of
+ * rules. Rules that aren't defined yet count as cyclic.
+ */
+template <typename P>
+struct in_left_cycle : left_expand<
+    P, type_list<>, left_calls<P, P>, type_list<>
+> {};
+
+template <typename P>
+inline constexpr bool in_left_cycle_v =
+    in_left_cycle<remove_cvref_t<P>>::value;
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_LEFT_RECURSION_HPP */
@@ -14,6 +14,7 @@
 
 #include <vector>
 #include "combinator.hpp"
+#include "../memo_context.hpp"
 #include "../result.hpp"
 
 // XXX(LPeter1997): We could check the collection for push_back (better errors)
@@ -101,10 +102,12 @@ public:
         auto coll = value_t<Src>();
         auto rr = r;
         while (true) {
+            auto branch = detail::branch_scope(rr);
             auto p_inv = m_Parser.apply(rr);
             furthest = std::max(furthest, matched + p_inv.furthest());
             if (p_inv.is_failure()) {
                 // Stop applying
+                branch.backtrack();
                 break;
             }
             auto p_succ = std::move(p_inv).success();
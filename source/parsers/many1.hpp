@@ -47,6 +47,8 @@ public:
     [[nodiscard]] constexpr auto collect_to(To2) const&&
         cppcmb_return(many1_t<P, To2>(std::move(m_Parser).underlying()))
 
+    cppcmb_getter(underlying, m_Parser.underlying())
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
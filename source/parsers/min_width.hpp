@@ -0,0 +1,125 @@
+/**
+ * min_width.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A compile-time lower bound on the number of elements a combinator consumes
+ * when it succeeds. Combinators can use this to reject an input that is too
+ * short without trying to parse it. Anything unknown is assumed to be able to
+ * match nothing.
+ */
+
+#ifndef CPPCMB_PARSERS_MIN_WIDTH_HPP
+#define CPPCMB_PARSERS_MIN_WIDTH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include "action.hpp"
+#include "alt.hpp"
+#include "auto_packrat.hpp"
+#include "dfa.hpp"
+#include "drec_packrat.hpp"
+#include "eager_alt.hpp"
+#include "find.hpp"
+#include "hash_cons.hpp"
+#include "ilit.hpp"
+#include "intern.hpp"
+#include "irec_packrat.hpp"
+#include "many1.hpp"
+#include "one.hpp"
+#include "packrat.hpp"
+#include "regex_capture.hpp"
+#include "seq.hpp"
+#include "skip_balanced.hpp"
+#include "stateful.hpp"
+#include "unicode.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+template <typename P>
+struct min_width : std::integral_constant<std::size_t, 0> {};
+
+template <typename P>
+inline constexpr std::size_t min_width_v = min_width<remove_cvref_t<P>>::value;
+
+template <>
+struct min_width<one_t> : std::integral_constant<std::size_t, 1> {};
+
+template <typename Table>
+struct min_width<unicode_class_t<Table>>
+    : std::integral_constant<std::size_t, 1> {};
+
+template <typename First, typename Rest>
+struct min_width<unicode_word_t<First, Rest>>
+    : std::integral_constant<std::size_t, 1> {};
+
+template <char Open, char Close, char Quote, char Escape>
+struct min_width<skip_balanced_t<Open, Close, Quote, Escape>>
+    : std::integral_constant<std::size_t, 2> {};
+
+template <typename P1, typename P2>
+struct min_width<seq_t<P1, P2>>
+    : std::integral_constant<std::size_t,
+        min_width_v<P1> + min_width_v<P2>> {};
+
+template <typename P1, typename P2>
+struct min_width<alt_t<P1, P2>>
+    : std::integral_constant<std::size_t,
+        std::min(min_width_v<P1>, min_width_v<P2>)> {};
+
+template <typename P1, typename P2>
+struct min_width<eager_alt_t<P1, P2>>
+    : std::integral_constant<std::size_t,
+        std::min(min_width_v<P1>, min_width_v<P2>)> {};
+
+// Wrappers that don't change what their parser consumes
+
+template <typename P, typename Fn>
+struct min_width<action_t<P, Fn>> : min_width<P> {};
+
+template <typename P, typename To>
+struct min_width<many1_t<P, To>> : min_width<P> {};
+
+template <typename P>
+struct min_width<ignore_case_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<dfa_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<find_t<P>> : min_width<P> {};
+
+template <typename P, typename Pool>
+struct min_width<hash_cons_t<P, Pool>> : min_width<P> {};
+
+template <typename P, std::size_t N>
+struct min_width<capture_t<P, N>> : min_width<P> {};
+
+template <typename P, typename Table>
+struct min_width<intern_t<P, Table>> : min_width<P> {};
+
+template <typename State, typename P, typename Fn>
+struct min_width<state_action_t<State, P, Fn>> : min_width<P> {};
+
+template <typename State, typename P, typename Pred>
+struct min_width<state_filter_t<State, P, Pred>> : min_width<P> {};
+
+template <typename P>
+struct min_width<packrat_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<auto_packrat_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<drec_packrat_t<P>> : min_width<P> {};
+
+template <typename P>
+struct min_width<irec_packrat_t<P>> : min_width<P> {};
+
+} /* namespace detail */
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_MIN_WIDTH_HPP */
@@ -13,6 +13,7 @@
 #define CPPCMB_PARSERS_OPT_HPP
 
 #include "combinator.hpp"
+#include "../memo_context.hpp"
 
 namespace cppcmb {
 
@@ -33,6 +34,8 @@ public:
         : m_Parser(cppcmb_fwd(p)) {
     }
 
+    cppcmb_getter(underlying, m_Parser)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
@@ -41,8 +44,10 @@ public:
 
         using result_t = result<value_t<Src>>;
 
+        auto branch = detail::branch_scope(r);
         auto p_inv = m_Parser.apply(r);
         if (p_inv.is_failure()) {
+            branch.backtrack();
             return result_t(
                 success(value_t<Src>(none()), 0U),
                 p_inv.furthest()
@@ -10,15 +10,44 @@
 #ifndef CPPCMB_PARSERS_PACKRAT_HPP
 #define CPPCMB_PARSERS_PACKRAT_HPP
 
+#include <any>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <typeinfo>
 #include <utility>
 #include "combinator.hpp"
 #include "../memo_context.hpp"
+#include "../persistence.hpp"
 
 namespace cppcmb {
 
 namespace detail {
 
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * The block_reapply_fn of the parser P on sources of type Src. Failures are
+ * not reported, the enclosing block has to be tried then.
+ */
+template <typename P, typename Src>
+std::optional<reparsed_block> reapply_block(void const* self,
+    void const* src, std::type_info const& src_type,
+    std::size_t pos, memo_context& ctx) {
+
+    if (src_type != typeid(Src)) {
+        return std::nullopt;
+    }
+    auto const& p = *static_cast<P const*>(self);
+    auto r = reader(*static_cast<Src const*>(src), pos, ctx);
+    auto res = p.apply(r);
+    if (res.is_failure()) {
+        return std::nullopt;
+    }
+    auto len = res.success().matched();
+    return reparsed_block{ 0, pos, len, std::any(std::move(res)) };
+}
+
 template <typename Self>
 class packrat_base : public combinator<Self> {
 private:
@@ -37,10 +66,22 @@ protected:
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src, typename TFwd>
     constexpr auto& put_memo(reader<Src> const& r,
-        TFwd&& val, std::size_t furth) const {
+        TFwd&& val, std::size_t furth,
+        memo_block block = memo_block()) const {
 
         auto& table = r.context().memo();
-        return table.put(original_id(), r, cppcmb_fwd(val), furth);
+        return table.put(original_id(), r, cppcmb_fwd(val), furth, block);
+    }
+
+    /**
+     * Makes the entries put with it re-parsable by themselves.
+     */
+    template <typename Src>
+    [[nodiscard]] constexpr memo_block block_of(reader<Src> const&)
+        const noexcept {
+        return memo_block{
+            static_cast<Self const*>(this), &reapply_block<Self, Src>
+        };
     }
 
     // XXX(LPeter1997): Noexcept specifier
@@ -49,6 +90,46 @@ protected:
         auto& table = r.context().memo();
         return table.get(original_id(), r);
     }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Like put_memo, but the entry will be saved with the memo context, under
+     * the stable ID of the parser.
+     */
+    template <typename Src, typename TFwd>
+    auto& put_persistent_memo(reader<Src> const& r, std::uint64_t sid,
+        TFwd&& val, std::size_t furth,
+        memo_block block = memo_block()) const {
+
+        using raw_type = remove_cvref_t<TFwd>;
+        auto& table = r.context().memo();
+        table.register_persistent(original_id(), persistent_rule{
+            sid, &persist_any<raw_type>
+        });
+        return table.put(original_id(), r, cppcmb_fwd(val), furth, block);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Decodes the entry at the reader position that has been loaded from a
+     * previous process, if there is one.
+     */
+    template <typename Result, typename Src>
+    [[nodiscard]] Result* restore_memo(reader<Src> const& r,
+        std::uint64_t sid) const {
+
+        auto& table = r.context().memo();
+        auto e = table.take_pending(sid, r.cursor());
+        if (!e) {
+            return nullptr;
+        }
+        auto data = std::string_view(e->data);
+        auto res = persist_traits<Result>::read(data);
+        if (!res) {
+            return nullptr;
+        }
+        return &put_persistent_memo(r, sid, std::move(*res), e->furthest);
+    }
 };
 
 } /* namespace detail */
@@ -58,7 +139,9 @@ class packrat_t : public detail::packrat_base<packrat_t<P>> {
 private:
     cppcmb_self_check(packrat_t);
 
-    P m_Parser;
+    P                            m_Parser;
+    // Only the results of parsers with a key are persisted
+    std::optional<std::uint64_t> m_Key;
 
 public:
     template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
@@ -67,6 +150,12 @@ public:
         : m_Parser(cppcmb_fwd(p)) {
     }
 
+    template <typename PFwd>
+    packrat_t(PFwd&& p, std::string_view key)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)), m_Key(detail::hash_string(key).low) {
+    }
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr decltype(auto) apply(reader<Src> const& r) const {
@@ -76,8 +165,24 @@ public:
 
         auto* entry = this->get_memo(r);
         if (entry == nullptr) {
+            auto frame = detail::state_frame_scope(r.context().memo());
+            if constexpr (is_persistable_v<result_t>) {
+                if (m_Key) {
+                    auto* res =
+                        this->template restore_memo<result_t>(r, *m_Key);
+                    if (res != nullptr) {
+                        return *res;
+                    }
+                    auto fresh = m_Parser.apply(r);
+                    auto furth = fresh.furthest();
+                    return this->put_persistent_memo(
+                        r, *m_Key, std::move(fresh), furth, this->block_of(r)
+                    );
+                }
+            }
             auto res = m_Parser.apply(r);
-            return this->put_memo(r, std::move(res), res.furthest());
+            auto furth = res.furthest();
+            return this->put_memo(r, std::move(res), furth, this->block_of(r));
         }
         return std::any_cast<result_t&>(*entry);
     }
@@ -86,6 +191,9 @@ public:
 template <typename PFwd>
 packrat_t(PFwd) -> packrat_t<PFwd>;
 
+template <typename PFwd>
+packrat_t(PFwd, std::string_view) -> packrat_t<PFwd>;
+
 /**
  * Wrapper to make any combinator a packrat parser.
  */
@@ -93,6 +201,15 @@ template <typename PFwd>
 [[nodiscard]] constexpr auto memo(PFwd&& p)
     cppcmb_return(packrat_t(cppcmb_fwd(p)))
 
+/**
+ * Like memo, but the results are saved and loaded with the memo table (see
+ * parser::save_memo), if they have persist_traits. The key identifies the
+ * rule across processes, it must be unique in the grammar.
+ */
+template <typename PFwd>
+[[nodiscard]] auto memo(PFwd&& p, std::string_view key)
+    cppcmb_return(packrat_t(cppcmb_fwd(p), key))
+
 struct as_self_t {};
 struct as_memo_t {};
 
@@ -118,6 +118,8 @@ public:
         : m_Parser(cppcmb_fwd(p)) {
     }
 
+    cppcmb_getter(underlying, m_Parser)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
@@ -139,7 +141,66 @@ public:
 template <typename PFwd>
 not_char(PFwd) -> not_char<PFwd>;
 
-struct parser {
+/**
+ * Marks the I-th capture group (counted from 1) of a pattern. As a parser,
+ * it's the same as the underlying one.
+ */
+template <std::size_t I, typename P>
+class group : public combinator<group<I, P>> {
+private:
+    cppcmb_self_check(group);
+
+    P m_Parser;
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr group(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+        return m_Parser.apply(r);
+    }
+};
+
+/**
+ * The number of capture groups that start before the index.
+ */
+template <typename Src>
+[[nodiscard]] constexpr std::size_t count_groups(Src src, std::size_t end)
+    noexcept {
+    std::size_t n = 0;
+    bool in_class = false;
+    for (std::size_t i = 0; i < end && i < src().size(); ++i) {
+        char c = src()[i];
+        if (c == '\\') {
+            // Skip the escaped character
+            ++i;
+        }
+        else if (in_class) {
+            in_class = c != ']';
+        }
+        else if (c == '[') {
+            in_class = true;
+        }
+        else if (c == '(') {
+            ++n;
+        }
+    }
+    return n;
+}
+
+/**
+ * When Capture is true, the groups are wrapped in the group marker.
+ */
+template <bool Capture>
+struct basic_parser {
     template <typename T>
     [[nodiscard]] static constexpr auto star(T p) noexcept {
         return action_t((*p >> collect_to<drop_collection>), select<>);
@@ -160,9 +221,16 @@ struct parser {
         return std::is_same_v<remove_cvref_t<T>, failure>;
     }
 
+    // The parser peeks one past the end of the pattern, which must be a
+    // constant expression too
     template <std::size_t Idx, typename Src>
     [[nodiscard]] static constexpr char char_at(Src src) noexcept {
-        return src()[Idx];
+        if constexpr (Idx < src().size()) {
+            return src()[Idx];
+        }
+        else {
+            return '\0';
+        }
     }
 
     [[nodiscard]] static constexpr bool is_special(char ch) noexcept {
@@ -257,7 +325,17 @@ struct parser {
                 static_assert(!is_failure(sub));
                 constexpr std::size_t NextIdx = Idx + 1 + sub.matched();
                 static_assert(char_at<NextIdx>(src) == ')');
-                return success(sub.value(), sub.matched() + 2);
+                if constexpr (Capture) {
+                    constexpr std::size_t I = count_groups(src, Idx) + 1;
+                    using sub_t = remove_cvref_t<decltype(sub.value())>;
+                    return success(
+                        group<I, sub_t>(sub.value()),
+                        sub.matched() + 2
+                    );
+                }
+                else {
+                    return success(sub.value(), sub.matched() + 2);
+                }
             }
             else if constexpr (curr == '[') {
                 // Character classes
@@ -378,6 +456,8 @@ struct parser {
     }
 };
 
+using parser = basic_parser<false>;
+
 } /* namespace regex */
 } /* namespace detail */
 
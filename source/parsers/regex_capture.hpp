@@ -0,0 +1,145 @@
+/**
+ * regex_capture.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Compile-time RegEx strings with capture groups. The groups are returned as
+ * views into the source, the match never backtracks or allocates for
+ * one-pass patterns.
+ */
+
+#ifndef CPPCMB_PARSERS_REGEX_CAPTURE_HPP
+#define CPPCMB_PARSERS_REGEX_CAPTURE_HPP
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include "combinator.hpp"
+#include "dfa.hpp"
+#include "regex.hpp"
+#include "../detail.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+namespace detail {
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Compiles a regular combinator with capture group markers.
+ */
+template <typename P>
+[[nodiscard]] capture_automaton compile_captures(P const& p) {
+    static_assert(
+        is_regular<remove_cvref_t<P>>::value,
+        "Only regular combinators can be compiled to an automaton!"
+    );
+    nfa n;
+    auto f = nfa_builder::build(n, p);
+    return capture_automaton(std::move(n), f);
+}
+
+} /* namespace detail */
+
+/**
+ * Matches the longest prefix, like dfa. The result has the whole match at
+ * index 0, and the I-th group at index I. A group that didn't take part in
+ * the match is an empty view with a null data pointer. When a group matched
+ * multiple times (in a repetition), the last one is returned.
+ */
+template <typename P, std::size_t N>
+class capture_t : public combinator<capture_t<P, N>> {
+private:
+    static constexpr std::size_t tags = 2 * (N + 1);
+
+    static_assert(
+        tags <= detail::capture_automaton::max_tags,
+        "Too many capture groups!"
+    );
+
+    P                                               m_Parser;
+    std::shared_ptr<detail::capture_automaton const> m_Automaton;
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename PFwd>
+    explicit capture_t(PFwd&& p)
+        : m_Parser(cppcmb_fwd(p)),
+          m_Automaton(std::make_shared<detail::capture_automaton const>(
+              detail::compile_captures(m_Parser)
+          )) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    /**
+     * True, if the pattern is matched in one deterministic pass. Otherwise
+     * the tagged NFA is simulated, which needs some memory for each match.
+     */
+    [[nodiscard]] bool one_pass() const noexcept {
+        return m_Automaton->one_pass();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Captures can only be matched in contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using groups_t = std::array<string_t, N + 1>;
+        using result_t = result<groups_t>;
+
+        auto const* data = std::data(r.source()) + r.cursor();
+        auto const len = std::size(r.source()) - r.cursor();
+        std::size_t furthest = 0;
+        detail::tag_positions<tags> pos;
+        auto matched = m_Automaton->longest_match(data, len, pos, furthest);
+        if (matched < 0) {
+            return result_t(failure(), furthest);
+        }
+
+        auto n = std::size_t(matched);
+        groups_t groups;
+        groups[0] = string_t(data, n);
+        for (std::size_t i = 1; i <= N; ++i) {
+            auto open = pos[2 * i];
+            auto close = pos[2 * i + 1];
+            if (open != detail::npos_tag && close != detail::npos_tag
+                && open <= close) {
+                groups[i] = string_t(data + open, close - open);
+            }
+        }
+        return result_t(success(std::move(groups), n), furthest);
+    }
+};
+
+/**
+ * Creates a parser from a compile-time RegEx string, that returns the
+ * capture groups. Use cppcmb_str to create the string.
+ */
+template <typename Str>
+[[nodiscard]] auto regex_capture(Str str) {
+    using parser_t = detail::regex::basic_parser<true>;
+
+    constexpr auto res = parser_t::top<0>(str);
+    static_assert(
+        !parser_t::is_failure(res),
+        "Invalid regular-expression!"
+    );
+    constexpr auto n = detail::regex::count_groups(str, str().size());
+    return capture_t<detail::remove_cvref_t<decltype(res.value())>, n>(
+        res.value()
+    );
+}
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_REGEX_CAPTURE_HPP */
@@ -0,0 +1,139 @@
+/**
+ * repeat.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A combinator that applies it's parser at least N and at most M times. The
+ * results are collected into a std::array when N == M, and into an
+ * inline_vector otherwise, so it never allocates.
+ */
+
+#ifndef CPPCMB_PARSERS_REPEAT_HPP
+#define CPPCMB_PARSERS_REPEAT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "combinator.hpp"
+#include "min_width.hpp"
+#include "../inline_vector.hpp"
+#include "../memo_context.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+
+template <typename P, std::size_t N, std::size_t M>
+class repeat_t : public combinator<repeat_t<P, N, M>> {
+private:
+    static_assert(N <= M, "The minimum repetition can't exceed the maximum!");
+
+    cppcmb_self_check(repeat_t);
+
+    template <typename Src>
+    using element_t = parser_value_t<P, Src>;
+
+    template <typename Src>
+    using value_t = std::conditional_t<N == M,
+        std::array<element_t<Src>, N>,
+        inline_vector<element_t<Src>, M>
+    >;
+
+    P m_Parser;
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename T, std::size_t... Is>
+    [[nodiscard]] static constexpr auto to_array(
+        inline_vector<T, M>& coll, std::index_sequence<Is...>) {
+        return std::array<T, N>{ std::move(coll[Is])... };
+    }
+
+public:
+    template <typename PFwd, cppcmb_requires_t(!is_self_v<PFwd>)>
+    constexpr repeat_t(PFwd&& p)
+        noexcept(std::is_nothrow_constructible_v<P, PFwd&&>)
+        : m_Parser(cppcmb_fwd(p)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<value_t<Src>> {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = result<value_t<Src>>;
+
+        if constexpr (N > 0 && detail::min_width_v<P> > 0) {
+            // The input can't possibly hold N elements, don't even try
+            auto rem = std::size(r.source()) - r.cursor();
+            if (rem < N * detail::min_width_v<P>) {
+                return result_t(failure(), rem);
+            }
+        }
+
+        std::size_t furthest = 0U;
+        std::size_t matched = 0U;
+        auto coll = inline_vector<element_t<Src>, M>();
+        auto rr = r;
+        while (!coll.full()) {
+            auto branch = detail::branch_scope(rr);
+            auto p_inv = m_Parser.apply(rr);
+            furthest = std::max(furthest, matched + p_inv.furthest());
+            if (p_inv.is_failure()) {
+                // Stop applying
+                branch.backtrack();
+                break;
+            }
+            auto p_succ = std::move(p_inv).success();
+            matched += p_succ.matched();
+            // Add to collection
+            coll.push_back(std::move(p_succ).value());
+            // Move reader
+            rr.seek(rr.cursor() + p_succ.matched());
+        }
+
+        if (coll.size() < N) {
+            return result_t(failure(), furthest);
+        }
+        if constexpr (N == M) {
+            return result_t(
+                success(to_array(coll, std::make_index_sequence<N>()), matched),
+                furthest
+            );
+        }
+        else {
+            return result_t(success(std::move(coll), matched), furthest);
+        }
+    }
+};
+
+/**
+ * Creates a parser that applies p exactly N times.
+ */
+template <std::size_t N, typename PFwd>
+[[nodiscard]] constexpr auto repeat(PFwd&& p)
+    cppcmb_return(repeat_t<detail::remove_cvref_t<PFwd>, N, N>(cppcmb_fwd(p)))
+
+/**
+ * Creates a parser that applies p at least N and at most M times.
+ */
+template <std::size_t N, std::size_t M, typename PFwd>
+[[nodiscard]] constexpr auto repeat(PFwd&& p)
+    cppcmb_return(repeat_t<detail::remove_cvref_t<PFwd>, N, M>(cppcmb_fwd(p)))
+
+namespace detail {
+
+template <typename P, std::size_t N, std::size_t M>
+struct min_width<repeat_t<P, N, M>>
+    : std::integral_constant<std::size_t, N * min_width_v<P>> {};
+
+} /* namespace detail */
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_REPEAT_HPP */
@@ -39,6 +39,9 @@ public:
         : m_First(cppcmb_fwd(p1)), m_Second(cppcmb_fwd(p2)) {
     }
 
+    cppcmb_getter(first, m_First)
+    cppcmb_getter(second, m_Second)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename Src>
     [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
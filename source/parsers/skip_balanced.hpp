@@ -0,0 +1,130 @@
+/**
+ * skip_balanced.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Skips a region enclosed in balanced delimiters, like { ... }. Delimiters
+ * inside quoted strings are ignored, and quotes can be escaped inside the
+ * strings. The input is classified 64 bytes at a time, the nesting depth is
+ * only tracked at the unquoted delimiters.
+ */
+
+#ifndef CPPCMB_PARSERS_SKIP_BALANCED_HPP
+#define CPPCMB_PARSERS_SKIP_BALANCED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include "combinator.hpp"
+#include "../detail.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+
+/**
+ * Quote and Escape can be '\0' to disable them. Like in JSON, escapes are
+ * recognized everywhere, an escaped quote never starts or ends a string. The
+ * result is the skipped part of the source, including the delimiters.
+ */
+template <char Open, char Close, char Quote = '\0', char Escape = '\0'>
+class skip_balanced_t
+    : public combinator<skip_balanced_t<Open, Close, Quote, Escape>> {
+private:
+    static_assert(Open != Close, "The delimiters must be different!");
+    static_assert(Open != '\0' && Close != '\0', "Delimiters can't be '\\0'!");
+    static_assert(
+        Escape == '\0' || Quote != '\0',
+        "Escapes are only meaningful inside quotes!"
+    );
+
+    static constexpr auto to_byte(char c) noexcept {
+        return static_cast<unsigned char>(c);
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Balanced regions can only be skipped in contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
+
+        static_assert(
+            sizeof(value_type) == 1,
+            "Balanced regions can only be skipped in byte sources!"
+        );
+
+        auto const* data = std::data(r.source());
+        auto const size = std::size(r.source());
+        auto const start = r.cursor();
+
+        if (start >= size) {
+            return result_t(failure(), 0U);
+        }
+        if (data[start] != value_type(Open)) {
+            return result_t(failure(), 1U);
+        }
+
+        // Start after the opening delimiter
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto const* bytes = reinterpret_cast<unsigned char const*>(data);
+        std::size_t depth = 1;
+        auto escapes = detail::escape_scanner();
+        auto quotes = detail::quote_scanner();
+        for (auto pos = start + 1; pos < size; pos += detail::block_width) {
+            auto block = detail::byte_block(bytes + pos, size - pos);
+
+            auto outside = ~std::uint64_t(0);
+            if constexpr (Quote != '\0') {
+                auto quote = block.eq(to_byte(Quote));
+                if constexpr (Escape != '\0') {
+                    quote &= ~escapes.next(block.eq(to_byte(Escape)));
+                }
+                outside = ~quotes.next(quote);
+            }
+            auto opens = block.eq(to_byte(Open)) & outside;
+            auto closes = block.eq(to_byte(Close)) & outside;
+
+            if (detail::bit_count(closes) < depth) {
+                // Can't reach depth 0 in this block
+                depth += detail::bit_count(opens);
+                depth -= detail::bit_count(closes);
+                continue;
+            }
+
+            auto marks = opens | closes;
+            while (marks != 0) {
+                auto bit = detail::bit_ctz(marks);
+                marks &= marks - 1;
+                if ((opens >> bit) & 1U) {
+                    ++depth;
+                }
+                else if (--depth == 0) {
+                    auto matched = pos + bit + 1 - start;
+                    return result_t(
+                        success(string_t(data + start, matched), matched),
+                        matched
+                    );
+                }
+            }
+        }
+        // Unterminated
+        return result_t(failure(), size - start);
+    }
+};
+
+template <char Open, char Close, char Quote = '\0', char Escape = '\0'>
+inline constexpr auto skip_balanced =
+    skip_balanced_t<Open, Close, Quote, Escape>();
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_SKIP_BALANCED_HPP */
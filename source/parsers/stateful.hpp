@@ -0,0 +1,126 @@
+/**
+ * stateful.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Combinators that read and change the parse state set on the parser, for
+ * context-sensitive grammars, like C, where typedef names change how later
+ * declarations are parsed.
+ */
+
+#ifndef CPPCMB_PARSERS_STATEFUL_HPP
+#define CPPCMB_PARSERS_STATEFUL_HPP
+
+#include <type_traits>
+#include <utility>
+#include "combinator.hpp"
+#include "../detail.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+
+/**
+ * Calls fn(state, value) on the success of p, the value is passed through.
+ * The change is undone, if an enclosing alternative, optional or repetition
+ * fails later. The state is copied for that at most once per open branch.
+ */
+template <typename State, typename P, typename Fn>
+class state_action_t : public combinator<state_action_t<State, P, Fn>> {
+private:
+    P  m_Parser;
+    Fn m_Fn;
+
+public:
+    template <typename PFwd, typename FnFwd>
+    constexpr state_action_t(PFwd&& p, FnFwd&& fn)
+        noexcept(
+            std::is_nothrow_constructible_v<P, PFwd&&>
+         && std::is_nothrow_constructible_v<Fn, FnFwd&&>
+        )
+        : m_Parser(cppcmb_fwd(p)), m_Fn(cppcmb_fwd(fn)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+    cppcmb_getter(function, m_Fn)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        auto res = m_Parser.apply(r);
+        if (res.is_success()) {
+            auto const& val = res.success().value();
+            r.context().template update_state<State>([&](State& st) {
+                m_Fn(st, val);
+            });
+        }
+        return res;
+    }
+};
+
+/**
+ * Succeeds, if p succeeds and pred(state, value) is true.
+ */
+template <typename State, typename P, typename Pred>
+class state_filter_t : public combinator<state_filter_t<State, P, Pred>> {
+private:
+    P    m_Parser;
+    Pred m_Pred;
+
+public:
+    template <typename PFwd, typename PredFwd>
+    constexpr state_filter_t(PFwd&& p, PredFwd&& pred)
+        noexcept(
+            std::is_nothrow_constructible_v<P, PFwd&&>
+         && std::is_nothrow_constructible_v<Pred, PredFwd&&>
+        )
+        : m_Parser(cppcmb_fwd(p)), m_Pred(cppcmb_fwd(pred)) {
+    }
+
+    cppcmb_getter(underlying, m_Parser)
+    cppcmb_getter(predicate, m_Pred)
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        cppcmb_assert_parser(P, Src);
+
+        using result_t = parser_result_t<P, Src>;
+
+        auto res = m_Parser.apply(r);
+        if (res.is_failure()) {
+            return res;
+        }
+        auto const& st = r.context().template read_state<State>();
+        if (!m_Pred(st, res.success().value())) {
+            return result_t(failure(), res.furthest());
+        }
+        return res;
+    }
+};
+
+/**
+ * Changes the parse state of type State with fn on the success of p.
+ */
+template <typename State, typename PFwd, typename FnFwd>
+[[nodiscard]] constexpr auto state_action(PFwd&& p, FnFwd&& fn)
+    cppcmb_return(state_action_t<
+        State, detail::remove_cvref_t<PFwd>, detail::remove_cvref_t<FnFwd>
+    >(cppcmb_fwd(p), cppcmb_fwd(fn)))
+
+/**
+ * Filters the successes of p with a predicate on the parse state of type
+ * State.
+ */
+template <typename State, typename PFwd, typename PredFwd>
+[[nodiscard]] constexpr auto state_filter(PFwd&& p, PredFwd&& pred)
+    cppcmb_return(state_filter_t<
+        State, detail::remove_cvref_t<PFwd>, detail::remove_cvref_t<PredFwd>
+    >(cppcmb_fwd(p), cppcmb_fwd(pred)))
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_STATEFUL_HPP */
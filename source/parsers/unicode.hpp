@@ -0,0 +1,325 @@
+/**
+ * unicode.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Character-class parsers for common Unicode properties. They decode a single
+ * code point (UTF-8, UTF-16 or UTF-32, depending on the element size of the
+ * source) and look it up in generated two-stage tables.
+ */
+
+#ifndef CPPCMB_PARSERS_UNICODE_HPP
+#define CPPCMB_PARSERS_UNICODE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include "combinator.hpp"
+#include "../detail.hpp"
+#include "../reader.hpp"
+#include "../result.hpp"
+
+namespace cppcmb {
+
+namespace detail {
+
+/**
+ * Checks if the code point has the property described by the table.
+ */
+template <typename Table>
+[[nodiscard]] constexpr bool has_unicode_property(char32_t cp) noexcept {
+    if (cp < 0x80) {
+        // ASCII fast-path
+        return ((Table::ascii[cp >> 6] >> (cp & 63)) & 1U) != 0;
+    }
+    auto hi = std::size_t(cp >> unicode_block_bits);
+    if (hi >= std::size(Table::stage1)) {
+        return false;
+    }
+    auto const& block = Table::stage2[Table::stage1[hi]];
+    auto lo = cp & ((char32_t(1) << unicode_block_bits) - 1);
+    return ((block[lo >> 6] >> (lo & 63)) & 1U) != 0;
+}
+
+/**
+ * The ASCII part of a property table as ranges of bytes, so the ASCII words
+ * can be tested with a few SWAR range compares, instead of byte by byte.
+ */
+template <typename Table>
+struct ascii_ranges {
+    static constexpr std::size_t capacity = 8;
+
+    unsigned char lo[capacity] = {};
+    unsigned char hi[capacity] = {};
+    std::size_t   count = 0;
+    // False, if the table has more ranges than the capacity
+    bool          fits = true;
+
+    constexpr ascii_ranges() noexcept {
+        for (char32_t cp = 0; cp < 0x80; ++cp) {
+            if (!has_unicode_property<Table>(cp)) {
+                continue;
+            }
+            auto b = static_cast<unsigned char>(cp);
+            if (count > 0 && hi[count - 1] + 1 == b) {
+                hi[count - 1] = b;
+            }
+            else if (count < capacity) {
+                lo[count] = b;
+                hi[count] = b;
+                ++count;
+            }
+            else {
+                fits = false;
+            }
+        }
+    }
+};
+
+template <typename Table>
+inline constexpr auto ascii_ranges_v = ascii_ranges<Table>();
+
+/**
+ * Returns a word, where the high bit of lane i is set if byte i of the ASCII
+ * word has the property described by the table.
+ */
+template <typename Table>
+[[nodiscard]] constexpr std::uint64_t ascii_property_lanes(std::uint64_t word)
+    noexcept {
+    constexpr auto const& ranges = ascii_ranges_v<Table>;
+
+    std::uint64_t lanes = 0;
+    if constexpr (ranges.fits) {
+        for (std::size_t i = 0; i < ranges.count; ++i) {
+            lanes |= swar_in_range(word, ranges.lo[i], ranges.hi[i]);
+        }
+    }
+    else {
+        for (std::size_t i = 0; i < swar_width; ++i) {
+            auto b = char32_t((word >> (8 * i)) & 0xFF);
+            if (has_unicode_property<Table>(b)) {
+                lanes |= std::uint64_t(0x80) << (8 * i);
+            }
+        }
+    }
+    return lanes;
+}
+
+/**
+ * The result of decoding a code point.
+ * A length of 0 means that the input was malformed, in that case peeked tells
+ * how many elements had to be looked at to find that out.
+ */
+struct decoded_codepoint {
+    char32_t    value  = 0;
+    std::size_t length = 0;
+    std::size_t peeked = 0;
+};
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename Src>
+[[nodiscard]] constexpr decoded_codepoint
+decode_codepoint(Src const& src, std::size_t idx) {
+    using elem_t = remove_cvref_t<decltype(src[idx])>;
+
+    auto const size = std::size(src);
+    if (idx >= size) {
+        return { 0, 0, 0 };
+    }
+
+    if constexpr (sizeof(elem_t) == 1) {
+        // UTF-8
+        auto b0 = static_cast<unsigned char>(src[idx]);
+        if (b0 < 0x80) {
+            return { b0, 1, 1 };
+        }
+
+        std::size_t len = 0;
+        char32_t cp = 0;
+        char32_t min = 0;
+        if ((b0 & 0xE0) == 0xC0) {
+            len = 2;
+            cp = b0 & 0x1F;
+            min = 0x80;
+        }
+        else if ((b0 & 0xF0) == 0xE0) {
+            len = 3;
+            cp = b0 & 0x0F;
+            min = 0x800;
+        }
+        else if ((b0 & 0xF8) == 0xF0) {
+            len = 4;
+            cp = b0 & 0x07;
+            min = 0x10000;
+        }
+        else {
+            // Stray continuation or invalid lead byte
+            return { 0, 0, 1 };
+        }
+
+        for (std::size_t i = 1; i < len; ++i) {
+            if (idx + i >= size) {
+                return { 0, 0, i };
+            }
+            auto b = static_cast<unsigned char>(src[idx + i]);
+            if ((b & 0xC0) != 0x80) {
+                return { 0, 0, i + 1 };
+            }
+            cp = (cp << 6) | (b & 0x3F);
+        }
+
+        // Overlong encodings, surrogates and out-of-range values
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return { 0, 0, len };
+        }
+        return { cp, len, len };
+    }
+    else if constexpr (sizeof(elem_t) == 2) {
+        // UTF-16
+        auto w0 = char32_t(static_cast<char16_t>(src[idx]));
+        if (w0 < 0xD800 || w0 > 0xDFFF) {
+            return { w0, 1, 1 };
+        }
+        if (w0 > 0xDBFF) {
+            // Unpaired low surrogate
+            return { 0, 0, 1 };
+        }
+        if (idx + 1 >= size) {
+            return { 0, 0, 1 };
+        }
+        auto w1 = char32_t(static_cast<char16_t>(src[idx + 1]));
+        if (w1 < 0xDC00 || w1 > 0xDFFF) {
+            return { 0, 0, 2 };
+        }
+        return { 0x10000 + ((w0 - 0xD800) << 10) + (w1 - 0xDC00), 2, 2 };
+    }
+    else {
+        // UTF-32
+        auto cp = char32_t(src[idx]);
+        if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return { 0, 0, 1 };
+        }
+        return { cp, 1, 1 };
+    }
+}
+
+} /* namespace detail */
+
+/**
+ * Matches a single code point that has the property described by Table.
+ */
+template <typename Table>
+class unicode_class_t : public combinator<unicode_class_t<Table>> {
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const
+        -> result<char32_t> {
+
+        using result_t = result<char32_t>;
+
+        auto cp = detail::decode_codepoint(r.source(), r.cursor());
+        if (cp.length == 0 || !detail::has_unicode_property<Table>(cp.value)) {
+            return result_t(failure(), cp.peeked);
+        }
+        return result_t(success(cp.value, cp.length), cp.length);
+    }
+};
+
+// Values for the supported properties
+inline constexpr auto xid_start =
+    unicode_class_t<detail::xid_start_table>();
+inline constexpr auto xid_continue =
+    unicode_class_t<detail::xid_continue_table>();
+inline constexpr auto unicode_letter =
+    unicode_class_t<detail::letter_table>();
+inline constexpr auto unicode_digit =
+    unicode_class_t<detail::digit_table>();
+inline constexpr auto unicode_space =
+    unicode_class_t<detail::space_table>();
+
+/**
+ * Matches a code point from the First class, followed by as many code points
+ * from the Rest class as possible. The result is the matched part of the
+ * source. Runs of ASCII characters are scanned 8 bytes at a time.
+ */
+template <typename First, typename Rest>
+class unicode_word_t : public combinator<unicode_word_t<First, Rest>> {
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    template <typename Src>
+    [[nodiscard]] constexpr auto apply(reader<Src> const& r) const {
+        static_assert(
+            detail::is_contiguous_source_v<Src>,
+            "Unicode words can only be matched in contiguous sources!"
+        );
+
+        using value_type = typename reader<Src>::value_type;
+        using string_t = std::basic_string_view<value_type>;
+        using result_t = result<string_t>;
+
+        auto const& src = r.source();
+        auto const* data = std::data(src);
+        auto const size = std::size(src);
+        auto const start = r.cursor();
+
+        auto first = detail::decode_codepoint(src, start);
+        if (first.length == 0
+        || !detail::has_unicode_property<First>(first.value)) {
+            return result_t(failure(), first.peeked);
+        }
+
+        std::size_t idx = start + first.length;
+        std::size_t peeked = 0;
+        while (true) {
+            if constexpr (sizeof(value_type) == 1) {
+                // Bulk-scan ASCII runs
+                while (idx + detail::swar_width <= size) {
+                    auto word = detail::swar_load(data + idx);
+                    if (!detail::swar_is_ascii(word)) {
+                        break;
+                    }
+                    auto outside =
+                        ~detail::ascii_property_lanes<Rest>(word)
+                        & detail::swar_highs;
+                    if (outside != 0) {
+                        // Found the end of the word
+                        idx += detail::bit_ctz(outside) / 8;
+                        peeked = 1;
+                        break;
+                    }
+                    idx += detail::swar_width;
+                }
+                if (peeked != 0) {
+                    break;
+                }
+            }
+            // Slow-path for non-ASCII and the tail of the input
+            auto cp = detail::decode_codepoint(src, idx);
+            if (cp.length == 0
+            || !detail::has_unicode_property<Rest>(cp.value)) {
+                peeked = cp.peeked;
+                break;
+            }
+            idx += cp.length;
+        }
+
+        auto matched = idx - start;
+        return result_t(
+            success(string_t(data + start, matched), matched),
+            matched + peeked
+        );
+    }
+};
+
+// Value for Unicode identifiers (UAX #31 default identifiers)
+inline constexpr auto xid_identifier = unicode_word_t<
+    detail::xid_start_table,
+    detail::xid_continue_table
+>();
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PARSERS_UNICODE_HPP */
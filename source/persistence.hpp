@@ -0,0 +1,329 @@
+/**
+ * persistence.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Saving and loading memo tables, so a process can start with the results of
+ * a previous one. Only packrat parsers created with a key (see memo) whose
+ * values are persistable (see persist_traits) are saved, the key identifies
+ * them across processes. The grammar is identified by a version given by the
+ * user, and by a hash of it's type. A saved table is only loaded if the
+ * grammar and the source are the same as when it was saved. The types don't
+ * capture the functions and tables the grammar refers to, so the version must
+ * be changed whenever the grammar behaves differently.
+ */
+
+#ifndef CPPCMB_PERSISTENCE_HPP
+#define CPPCMB_PERSISTENCE_HPP
+
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include "detail.hpp"
+#include "memo_context.hpp"
+#include "product.hpp"
+#include "reader.hpp"
+#include "result.hpp"
+
+namespace cppcmb {
+
+/**
+ * Describes how a value is written to and read from bytes. Specialize this
+ * for your own types with the members:
+ *  - static void write(std::string& out, T const& val)
+ *  - static std::optional<T> read(std::string_view& in)
+ * The read function must consume what it reads from the front of in.
+ * Values that point to memory (like views of the source) must not be
+ * persisted, because the memory won't be there in the next process.
+ */
+template <typename T, typename = void>
+struct persist_traits {};
+
+template <typename T>
+struct persist_traits<T,
+    std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>> {
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(std::string& out, T const& val) {
+        char buf[sizeof(T)];
+        std::memcpy(buf, &val, sizeof(T));
+        out.append(buf, sizeof(T));
+    }
+
+    [[nodiscard]] static std::optional<T> read(std::string_view& in) noexcept {
+        if (in.size() < sizeof(T)) {
+            return std::nullopt;
+        }
+        T val;
+        std::memcpy(&val, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return val;
+    }
+};
+
+namespace detail {
+
+template <typename T>
+using persist_write_t = decltype(persist_traits<T>::write(
+    std::declval<std::string&>(), std::declval<T const&>()
+));
+
+} /* namespace detail */
+
+template <typename T>
+inline constexpr bool is_persistable_v =
+    detail::is_detected_v<detail::persist_write_t, T>;
+
+template <typename... Ts>
+struct persist_traits<product<Ts...>,
+    std::enable_if_t<(... && is_persistable_v<Ts>)>> {
+
+private:
+    template <std::size_t... Is>
+    static void write_impl(std::string& out, product<Ts...> const& val,
+        std::index_sequence<Is...>) {
+        (persist_traits<Ts>::write(out, val.template get<Is>()), ...);
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(std::string& out, product<Ts...> const& val) {
+        write_impl(out, val, product<Ts...>::index_sequence);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static std::optional<product<Ts...>>
+    read(std::string_view& in) {
+        // Braced initialization keeps the order of reads
+        auto elems = std::tuple<std::optional<Ts>...>{
+            persist_traits<Ts>::read(in)...
+        };
+        if (!std::apply([](auto const&... e) { return (true && ... && e); },
+            elems)) {
+            return std::nullopt;
+        }
+        return std::apply([](auto&&... e) {
+            return product<Ts...>(std::move(*e)...);
+        }, std::move(elems));
+    }
+};
+
+template <typename T>
+struct persist_traits<result<T>, std::enable_if_t<is_persistable_v<T>>> {
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(std::string& out, result<T> const& val) {
+        using size_traits = persist_traits<std::uint64_t>;
+
+        size_traits::write(out, std::uint64_t(val.furthest()));
+        if (val.is_failure()) {
+            out.push_back('\0');
+            return;
+        }
+        out.push_back('\1');
+        auto const& succ = val.success();
+        size_traits::write(out, std::uint64_t(succ.matched()));
+        persist_traits<T>::write(out, succ.value());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static std::optional<result<T>> read(std::string_view& in) {
+        using size_traits = persist_traits<std::uint64_t>;
+
+        auto furthest = size_traits::read(in);
+        if (!furthest || in.empty()) {
+            return std::nullopt;
+        }
+        auto tag = in.front();
+        in.remove_prefix(1);
+        if (tag == '\0') {
+            return result<T>(failure(), std::size_t(*furthest));
+        }
+        auto matched = size_traits::read(in);
+        if (!matched) {
+            return std::nullopt;
+        }
+        auto val = persist_traits<T>::read(in);
+        if (!val) {
+            return std::nullopt;
+        }
+        return result<T>(
+            success(std::move(*val), std::size_t(*matched)),
+            std::size_t(*furthest)
+        );
+    }
+};
+
+namespace detail {
+
+/**
+ * An identifier for a type that is the same across processes, as long as the
+ * program doesn't change. Only the type, not the state of a value.
+ */
+template <typename T>
+[[nodiscard]] std::uint64_t stable_type_id() noexcept {
+    static auto const id = [] {
+        auto const* name = typeid(T).name();
+        return hash_bytes(name, std::strlen(name)).low;
+    }();
+    return id;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename T>
+void persist_any(std::any const& val, std::string& out) {
+    persist_traits<T>::write(out, std::any_cast<T const&>(val));
+}
+
+template <typename Src>
+[[nodiscard]] hash128 source_hash(Src const& src) noexcept {
+    static_assert(
+        is_contiguous_source_v<Src>,
+        "Only contiguous sources can be hashed for persistence!"
+    );
+    using elem_t = remove_cvref_t<decltype(*std::data(src))>;
+    return hash_bytes(std::data(src), std::size(src) * sizeof(elem_t));
+}
+
+inline constexpr char          memo_magic[4]       = { 'C', 'C', 'M', 'B' };
+inline constexpr std::uint32_t memo_format_version = 2;
+// Written in native byte order, so a foreign file can be recognized
+inline constexpr std::uint32_t memo_byte_order     = 0x01020304;
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename T>
+void write_raw(std::ostream& os, T const& val) {
+    std::string buf;
+    persist_traits<T>::write(buf, val);
+    os.write(buf.data(), std::streamsize(buf.size()));
+}
+
+// XXX(LPeter1997): Noexcept specifier
+template <typename T>
+[[nodiscard]] std::optional<T> read_raw(std::istream& is) {
+    char buf[sizeof(T)];
+    if (!is.read(buf, sizeof(T))) {
+        return std::nullopt;
+    }
+    auto view = std::string_view(buf, sizeof(T));
+    return persist_traits<T>::read(view);
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Reads len bytes. The length comes from the file, so the buffer only grows
+ * with what is actually read, a corrupt length can't allocate much more than
+ * what the stream holds.
+ */
+[[nodiscard]] inline bool read_bytes(std::istream& is, std::uint64_t len,
+    std::string& out) {
+
+    constexpr std::uint64_t chunk = 4096;
+    out.clear();
+    while (len > 0) {
+        auto n = std::size_t(len < chunk ? len : chunk);
+        auto old = out.size();
+        out.resize(old + n);
+        if (!is.read(out.data() + old, std::streamsize(n))) {
+            return false;
+        }
+        len -= n;
+    }
+    return true;
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Writes every persistable entry of the context.
+ */
+inline void save_memo(memo_context const& ctx, std::ostream& os,
+    std::uint64_t grammar, std::uint64_t version, hash128 source) {
+
+    os.write(memo_magic, sizeof(memo_magic));
+    write_raw(os, memo_format_version);
+    write_raw(os, memo_byte_order);
+    write_raw(os, grammar);
+    write_raw(os, version);
+    write_raw(os, source.low);
+    write_raw(os, source.high);
+
+    std::uint64_t count = 0;
+    ctx.memo().for_each_persistent([&](auto, auto, auto, auto const&) {
+        ++count;
+    });
+    write_raw(os, count);
+
+    ctx.memo().for_each_persistent([&](std::uint64_t sid, std::size_t pos,
+        std::size_t furthest, std::string const& data) {
+        write_raw(os, sid);
+        write_raw(os, std::uint64_t(pos));
+        write_raw(os, std::uint64_t(furthest));
+        write_raw(os, std::uint64_t(data.size()));
+        os.write(data.data(), std::streamsize(data.size()));
+    });
+}
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * Reads the entries written by save_memo into the context. The entries are
+ * only decoded when their parser asks for them. Returns false (and leaves the
+ * context empty) if the data doesn't match the grammar or the source.
+ */
+inline bool load_memo(memo_context& ctx, std::istream& is,
+    std::uint64_t grammar, std::uint64_t version, hash128 source) {
+
+    ctx.clear();
+
+    char magic[sizeof(memo_magic)];
+    if (!is.read(magic, sizeof(magic))
+     || std::memcmp(magic, memo_magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    if (read_raw<std::uint32_t>(is) != memo_format_version
+     || read_raw<std::uint32_t>(is) != memo_byte_order
+     || read_raw<std::uint64_t>(is) != grammar
+     || read_raw<std::uint64_t>(is) != version
+     || read_raw<std::uint64_t>(is) != source.low
+     || read_raw<std::uint64_t>(is) != source.high) {
+        return false;
+    }
+
+    auto count = read_raw<std::uint64_t>(is);
+    if (!count) {
+        return false;
+    }
+    for (std::uint64_t i = 0; i < *count; ++i) {
+        auto sid = read_raw<std::uint64_t>(is);
+        auto pos = read_raw<std::uint64_t>(is);
+        auto furthest = read_raw<std::uint64_t>(is);
+        auto len = read_raw<std::uint64_t>(is);
+        if (!sid || !pos || !furthest || !len) {
+            ctx.clear();
+            return false;
+        }
+        std::string data;
+        if (!read_bytes(is, *len, data)) {
+            ctx.clear();
+            return false;
+        }
+        ctx.memo().add_pending(*sid, std::size_t(*pos),
+            pending_entry{ std::move(data), std::size_t(*furthest) });
+    }
+    return true;
+}
+
+} /* namespace detail */
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_PERSISTENCE_HPP */
@@ -11,6 +11,7 @@
 #define CPPCMB_READER_HPP
 
 #include <cstddef>
+#include <iterator>
 #include <memory>
 #include "detail.hpp"
 
@@ -37,6 +38,16 @@ inline constexpr bool is_reader_source_v =
        is_detected_v<element_at_t, T>
     && is_detected_v<msize_t, T>;
 
+template <typename T>
+using mdata_t = decltype(std::data(std::declval<T const&>()));
+
+/**
+ * Sources that store their elements contiguously (like std::basic_string_view)
+ * can be scanned in bulk instead of element-by-element.
+ */
+template <typename T>
+inline constexpr bool is_contiguous_source_v = is_detected_v<mdata_t, T>;
+
 } /* namespace detail */
 
 class memo_context;
@@ -100,7 +111,8 @@ public:
         return cursor() >= std::size(source());
     }
 
-    [[nodiscard]] constexpr auto const& current() const noexcept {
+    // Sources (like views) are allowed to return their elements by value
+    [[nodiscard]] constexpr decltype(auto) current() const noexcept {
         cppcmb_assert(
             "current() can only be invoked when the cursor is not past the "
             "elements!",
@@ -0,0 +1,163 @@
+/**
+ * search.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Unanchored searching, not a combinator. Iterates over all the
+ * non-overlapping matches of a regular combinator in a source.
+ */
+
+#ifndef CPPCMB_SEARCH_HPP
+#define CPPCMB_SEARCH_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include "detail.hpp"
+#include "reader.hpp"
+#include "parsers/find.hpp"
+
+namespace cppcmb {
+
+/**
+ * Iterates over the matches, from left to right. Each match is the longest
+ * one that starts at the leftmost possible position after the previous one.
+ * After an empty match the search continues one character later.
+ */
+template <typename CharT>
+class match_iterator {
+public:
+    using value_type        = std::basic_string_view<CharT>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = value_type const*;
+    using reference         = value_type const&;
+    using iterator_category = std::forward_iterator_tag;
+
+private:
+    detail::dfa_searcher const* m_Searcher = nullptr;
+    CharT const*                m_Data = nullptr;
+    std::size_t                 m_Size = 0;
+    value_type                  m_Match;
+
+    // XXX(LPeter1997): Noexcept specifier
+    void find_from(std::size_t from) {
+        std::size_t furthest = 0;
+        auto m = from > m_Size
+            ? detail::match_span()
+            : m_Searcher->search(m_Data, m_Size, from, furthest);
+        if (m.begin == detail::prefilter::npos) {
+            m_Searcher = nullptr;
+            m_Match = value_type();
+        }
+        else {
+            m_Match = value_type(m_Data + m.begin, m.length);
+        }
+    }
+
+public:
+    match_iterator() = default;
+
+    // XXX(LPeter1997): Noexcept specifier
+    match_iterator(detail::dfa_searcher const& searcher,
+        CharT const* data, std::size_t size)
+        : m_Searcher(&searcher), m_Data(data), m_Size(size) {
+        find_from(0);
+    }
+
+    [[nodiscard]] reference operator*() const noexcept {
+        return m_Match;
+    }
+
+    [[nodiscard]] pointer operator->() const noexcept {
+        return &m_Match;
+    }
+
+    /**
+     * The offset of the current match in the source.
+     */
+    [[nodiscard]] std::size_t position() const noexcept {
+        return std::size_t(m_Match.data() - m_Data);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    match_iterator& operator++() {
+        auto end = position() + m_Match.size();
+        find_from(m_Match.empty() ? end + 1 : end);
+        return *this;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    match_iterator operator++(int) {
+        auto tmp = *this;
+        ++*this;
+        return tmp;
+    }
+
+    [[nodiscard]] friend bool operator==(match_iterator const& l,
+        match_iterator const& r) noexcept {
+        if (l.m_Searcher == nullptr || r.m_Searcher == nullptr) {
+            return l.m_Searcher == r.m_Searcher;
+        }
+        return l.m_Match.data() == r.m_Match.data()
+            && l.m_Match.size() == r.m_Match.size();
+    }
+
+    [[nodiscard]] friend bool operator!=(match_iterator const& l,
+        match_iterator const& r) noexcept {
+        return !(l == r);
+    }
+};
+
+/**
+ * The matches of a search. The source isn't copied, it has to outlive the
+ * range.
+ */
+template <typename CharT>
+class match_range {
+private:
+    std::shared_ptr<detail::dfa_searcher const> m_Searcher;
+    CharT const*                                m_Data;
+    std::size_t                                 m_Size;
+
+public:
+    match_range(std::shared_ptr<detail::dfa_searcher const> searcher,
+        CharT const* data, std::size_t size) noexcept
+        : m_Searcher(std::move(searcher)), m_Data(data), m_Size(size) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] match_iterator<CharT> begin() const {
+        return match_iterator<CharT>(*m_Searcher, m_Data, m_Size);
+    }
+
+    [[nodiscard]] match_iterator<CharT> end() const noexcept {
+        return match_iterator<CharT>();
+    }
+};
+
+// XXX(LPeter1997): Noexcept specifier
+/**
+ * All the matches of a regular combinator (like the ones created by regex) in
+ * the source.
+ */
+template <typename Src, typename P>
+[[nodiscard]] auto regex_search(Src const& src, P const& pattern) {
+    static_assert(
+        detail::is_contiguous_source_v<Src>,
+        "Searching only works in contiguous sources!"
+    );
+    using char_t = detail::remove_cvref_t<decltype(*std::data(src))>;
+
+    return match_range<char_t>(
+        std::make_shared<detail::dfa_searcher const>(
+            detail::compile_searcher(pattern)
+        ),
+        std::data(src), std::size(src)
+    );
+}
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_SEARCH_HPP */
@@ -0,0 +1,263 @@
+/**
+ * symbol_table.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Interning of identifiers. Every distinct string is stored once, in an arena,
+ * and gets a 32-bit id, so comparing interned strings is comparing integers.
+ */
+
+#ifndef CPPCMB_SYMBOL_TABLE_HPP
+#define CPPCMB_SYMBOL_TABLE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "detail.hpp"
+
+namespace cppcmb {
+
+using symbol_id = std::uint32_t;
+
+inline constexpr symbol_id no_symbol = symbol_id(-1);
+
+/**
+ * An open-addressed hash table from strings to ids. The ids are given out
+ * consecutively from 0. The strings are copied into arena blocks that never
+ * move, so the views returned by name() stay valid as long as the table.
+ */
+template <typename CharT>
+class basic_symbol_table {
+public:
+    using string_type = std::basic_string_view<CharT>;
+
+    // The size of an arena block, longer strings get their own
+    static constexpr std::size_t block_size = 4096;
+
+private:
+    struct slot {
+        symbol_id     id   = no_symbol;
+        // The low bits of the hash, to skip most string comparisons
+        std::uint32_t hash = 0;
+    };
+
+    std::vector<slot>                     m_Slots;
+    std::vector<string_type>              m_Names;
+    std::vector<std::unique_ptr<CharT[]>> m_Blocks;
+    std::vector<std::unique_ptr<CharT[]>> m_Large;
+    std::size_t                           m_BlockUsed = block_size;
+
+    [[nodiscard]] static std::uint64_t hash_of(string_type str) noexcept {
+        return detail::hash_string(str).low;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    string_type store(string_type str) {
+        if (str.empty()) {
+            return string_type();
+        }
+        CharT* mem;
+        if (str.size() > block_size / 4) {
+            // Long strings would waste most of a block
+            mem = m_Large.emplace_back(new CharT[str.size()]).get();
+        }
+        else {
+            if (block_size - m_BlockUsed < str.size()) {
+                m_Blocks.emplace_back(new CharT[block_size]);
+                m_BlockUsed = 0;
+            }
+            mem = m_Blocks.back().get() + m_BlockUsed;
+            m_BlockUsed += str.size();
+        }
+        std::copy(str.begin(), str.end(), mem);
+        return string_type(mem, str.size());
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void grow() {
+        auto slots = std::vector<slot>(
+            m_Slots.empty() ? 64 : m_Slots.size() * 2
+        );
+        auto const mask = slots.size() - 1;
+        for (auto const& s : m_Slots) {
+            if (s.id == no_symbol) {
+                continue;
+            }
+            auto i = std::size_t(hash_of(m_Names[s.id])) & mask;
+            while (slots[i].id != no_symbol) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = s;
+        }
+        m_Slots = std::move(slots);
+    }
+
+    /**
+     * The slot of the string, or the empty slot where it would be inserted.
+     */
+    [[nodiscard]] std::size_t probe(string_type str, std::uint64_t h)
+        const noexcept {
+        auto const mask = m_Slots.size() - 1;
+        auto i = std::size_t(h) & mask;
+        while (true) {
+            auto const& s = m_Slots[i];
+            if (s.id == no_symbol
+                || (s.hash == std::uint32_t(h) && m_Names[s.id] == str)) {
+                return i;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+public:
+    basic_symbol_table() = default;
+
+    basic_symbol_table(basic_symbol_table const&) = delete;
+    basic_symbol_table& operator=(basic_symbol_table const&) = delete;
+
+    basic_symbol_table(basic_symbol_table&&) noexcept = default;
+    basic_symbol_table& operator=(basic_symbol_table&&) noexcept = default;
+
+    /**
+     * The number of distinct strings.
+     */
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_Names.size();
+    }
+
+    /**
+     * The string of the id.
+     */
+    [[nodiscard]] string_type name(symbol_id id) const noexcept {
+        cppcmb_assert("Unknown symbol!", id < m_Names.size());
+        return m_Names[id];
+    }
+
+    /**
+     * The id of the string, or no_symbol, if it was never interned.
+     */
+    [[nodiscard]] symbol_id find(string_type str) const noexcept {
+        if (m_Slots.empty()) {
+            return no_symbol;
+        }
+        return m_Slots[probe(str, hash_of(str))].id;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The id of the string, a new one if it wasn't interned yet.
+     */
+    symbol_id intern(string_type str) {
+        // Keep the load factor under 1/2
+        if (2 * (m_Names.size() + 1) > m_Slots.size()) {
+            grow();
+        }
+        auto h = hash_of(str);
+        auto& s = m_Slots[probe(str, h)];
+        if (s.id == no_symbol) {
+            cppcmb_assert(
+                "Too many symbols!", m_Names.size() < std::size_t(no_symbol)
+            );
+            s.id = symbol_id(m_Names.size());
+            s.hash = std::uint32_t(h);
+            m_Names.push_back(store(str));
+        }
+        return s.id;
+    }
+};
+
+using symbol_table = basic_symbol_table<char>;
+
+/**
+ * A symbol table that can be used from multiple threads. Strings are
+ * distributed between independently locked shards by their hash, the low
+ * bits of an id tell its shard. Ids are unique, but not consecutive.
+ */
+template <typename CharT, std::size_t Shards = 16>
+class basic_concurrent_symbol_table {
+public:
+    using string_type = std::basic_string_view<CharT>;
+
+    static_assert(
+        Shards > 0 && (Shards & (Shards - 1)) == 0,
+        "The number of shards must be a power of 2!"
+    );
+
+private:
+    static constexpr std::size_t shard_bits = detail::bit_count(Shards - 1);
+
+    struct shard {
+        std::mutex                mutex;
+        basic_symbol_table<CharT> table;
+    };
+
+    std::array<shard, Shards> m_Shards;
+
+    [[nodiscard]] static std::size_t shard_of(string_type str) noexcept {
+        // The high bits, the tables use the low ones
+        return std::size_t(detail::hash_string(str).high) & (Shards - 1);
+    }
+
+public:
+    /**
+     * The number of distinct strings.
+     */
+    [[nodiscard]] std::size_t size() {
+        std::size_t n = 0;
+        for (auto& s : m_Shards) {
+            std::lock_guard lock(s.mutex);
+            n += s.table.size();
+        }
+        return n;
+    }
+
+    /**
+     * The string of the id.
+     */
+    [[nodiscard]] string_type name(symbol_id id) {
+        auto& s = m_Shards[id & (Shards - 1)];
+        std::lock_guard lock(s.mutex);
+        return s.table.name(id >> shard_bits);
+    }
+
+    /**
+     * The id of the string, or no_symbol, if it was never interned.
+     */
+    [[nodiscard]] symbol_id find(string_type str) {
+        auto index = shard_of(str);
+        auto& s = m_Shards[index];
+        std::lock_guard lock(s.mutex);
+        auto id = s.table.find(str);
+        return id == no_symbol
+            ? no_symbol
+            : symbol_id((id << shard_bits) | index);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * The id of the string, a new one if it wasn't interned yet.
+     */
+    symbol_id intern(string_type str) {
+        auto index = shard_of(str);
+        auto& s = m_Shards[index];
+        std::lock_guard lock(s.mutex);
+        cppcmb_assert(
+            "Too many symbols!",
+            s.table.size() < (std::size_t(no_symbol) >> shard_bits)
+        );
+        auto id = s.table.intern(str);
+        return symbol_id((id << shard_bits) | index);
+    }
+};
+
+using concurrent_symbol_table = basic_concurrent_symbol_table<char>;
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_SYMBOL_TABLE_HPP */
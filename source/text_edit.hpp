@@ -0,0 +1,62 @@
+/**
+ * text_edit.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * Recovers the edit between two versions of a source, for clients that only
+ * send the whole new text, so the incremental reparse can still be used.
+ */
+
+#ifndef CPPCMB_TEXT_EDIT_HPP
+#define CPPCMB_TEXT_EDIT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include "detail.hpp"
+
+namespace cppcmb {
+
+/**
+ * rem elements were replaced by ins new ones at start.
+ */
+struct text_edit {
+    std::size_t start = 0;
+    std::size_t rem   = 0;
+    std::size_t ins   = 0;
+};
+
+/**
+ * The smallest single edit that turns old_src into new_src: everything
+ * outside of it is the common prefix and suffix of the two. If the sources
+ * are equal, the edit is empty and at the end.
+ */
+template <typename Src1, typename Src2>
+[[nodiscard]] text_edit detect_edit(Src1 const& old_src, Src2 const& new_src)
+    noexcept {
+    static_assert(
+        detail::is_contiguous_source_v<Src1>
+     && detail::is_contiguous_source_v<Src2>,
+        "Edits can only be detected between contiguous sources!"
+    );
+
+    auto const* o = std::data(old_src);
+    auto const* n = std::data(new_src);
+    auto const o_len = std::size(old_src);
+    auto const n_len = std::size(new_src);
+    auto const shorter = std::min(o_len, n_len);
+
+    auto prefix = detail::common_prefix(o, n, shorter);
+    // The suffix can't overlap the prefix
+    auto suffix = detail::common_suffix(
+        o + o_len, n + n_len, shorter - prefix
+    );
+    return text_edit{
+        prefix, o_len - prefix - suffix, n_len - prefix - suffix
+    };
+}
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_TEXT_EDIT_HPP */
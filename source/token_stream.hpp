@@ -0,0 +1,286 @@
+/**
+ * token_stream.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * The tokens of a source, for grammars that parse tokens instead of
+ * characters. After an edit only the tokens around it are lexed again, and
+ * the change is reported in tokens, so the memo entries of the parser can be
+ * invalidated by token index.
+ */
+
+#ifndef CPPCMB_TOKEN_STREAM_HPP
+#define CPPCMB_TOKEN_STREAM_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "detail.hpp"
+#include "text_edit.hpp"
+#include "token.hpp"
+
+namespace cppcmb {
+
+/**
+ * Works with lexers that can start in the middle of a source, like
+ * modal_lexer. Lexing errors are left out of the stream. The lexer is
+ * referenced, it has to outlive the stream.
+ */
+template <typename Lexer, typename CharT = char>
+class token_stream {
+public:
+    using string_type = std::basic_string_view<CharT>;
+    using tag_type    = typename Lexer::token_type;
+    using token_type  = token<CharT, tag_type>;
+
+    /**
+     * The tokens of the stream, with their contents in the current source.
+     * They are made on access, so a relex doesn't have to touch them.
+     */
+    class tokens_view {
+    private:
+        token_stream const* m_Stream;
+
+    public:
+        explicit tokens_view(token_stream const& s) noexcept
+            : m_Stream(::std::addressof(s)) {
+        }
+
+        [[nodiscard]] token_type operator[](std::size_t i) const noexcept {
+            auto t = m_Stream->at(i);
+            return token_type(
+                m_Stream->m_Source.substr(t.offset, t.length), t.type
+            );
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return m_Stream->size();
+        }
+    };
+
+private:
+    struct token_info {
+        std::size_t offset;
+        std::size_t length;
+        // The furthest offset looked at up to and including this token
+        std::size_t reach;
+        // The index of the mode stack after this token
+        std::size_t modes;
+        tag_type    type;
+    };
+
+    Lexer const*                                       m_Lexer;
+    string_type                                        m_Source;
+    // The tokens are kept in a gap buffer, with the gap at the last edit.
+    // The ones after the gap store their offset and reach from the end of
+    // the source, so they stay valid, when the source before them changes
+    std::vector<token_info>                            m_Info;
+    std::size_t                                        m_GapBegin = 0;
+    std::size_t                                        m_GapEnd = 0;
+    std::vector<std::vector<std::size_t>>              m_ModeStacks;
+    std::map<std::vector<std::size_t>, std::size_t>    m_ModeIds;
+
+    // XXX(LPeter1997): Noexcept specifier
+    std::size_t intern_modes(std::vector<std::size_t> const& modes) {
+        auto [it, inserted] = m_ModeIds.try_emplace(modes, m_ModeStacks.size());
+        if (inserted) {
+            m_ModeStacks.push_back(modes);
+        }
+        return it->second;
+    }
+
+    /**
+     * Switches a token between offsets from the start and from the end of
+     * the source.
+     */
+    [[nodiscard]] token_info flip(token_info t) const noexcept {
+        t.offset = m_Source.size() - t.offset;
+        t.reach = m_Source.size() - t.reach;
+        return t;
+    }
+
+    [[nodiscard]] token_info at(std::size_t i) const noexcept {
+        if (i < m_GapBegin) {
+            return m_Info[i];
+        }
+        return flip(m_Info[i + (m_GapEnd - m_GapBegin)]);
+    }
+
+    /**
+     * The mode stack after the token at the physical index i.
+     */
+    [[nodiscard]] std::size_t modes_after(std::size_t i) const noexcept {
+        return m_Info[i].modes;
+    }
+
+    /**
+     * Moves the gap before the i-th token.
+     */
+    void move_gap(std::size_t i) noexcept {
+        while (m_GapBegin > i) {
+            --m_GapBegin;
+            --m_GapEnd;
+            m_Info[m_GapEnd] = flip(m_Info[m_GapBegin]);
+        }
+        while (m_GapBegin < i) {
+            m_Info[m_GapBegin] = flip(m_Info[m_GapEnd]);
+            ++m_GapBegin;
+            ++m_GapEnd;
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Adds a token into the gap.
+     */
+    void push(token_info const& t) {
+        if (m_GapBegin == m_GapEnd) {
+            auto grow = std::max(std::size_t(16), m_Info.size() / 2);
+            m_Info.insert(
+                m_Info.begin() + std::ptrdiff_t(m_GapEnd), grow, t
+            );
+            m_GapEnd += grow;
+        }
+        m_Info[m_GapBegin++] = t;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Lexes from the offset into the gap, until the end, or until the lexer
+     * is in sync with the old tokens after the gap again. The old tokens
+     * before that point are dropped, returns their count. first is the
+     * index of the first old token after the gap.
+     */
+    std::size_t lex(std::size_t from, std::size_t first,
+        std::vector<std::size_t> const& modes, text_edit const& edit) {
+        auto prev_modes = modes;
+        auto it = m_Lexer->begin(m_Source, from, modes);
+        for (; it != m_Lexer->end(); ++it) {
+            auto pos = it.position();
+            if (pos >= edit.start + edit.ins) {
+                // Past the edit, the old tokens follow, if the lexer is at
+                // the start of one in the same state
+                auto back = m_Info.begin() + std::ptrdiff_t(m_GapEnd);
+                auto j = std::lower_bound(
+                    back, m_Info.end(), m_Source.size() - pos,
+                    [](token_info const& t, std::size_t from_end) {
+                        return t.offset > from_end;
+                    }
+                );
+                if (j != m_Info.end() && m_Source.size() - j->offset == pos) {
+                    auto k = std::size_t(j - m_Info.begin());
+                    auto before = k == m_GapEnd
+                        ? (first == 0 ? std::size_t(0) : modes_after(first - 1))
+                        : modes_after(k - 1);
+                    if (m_ModeStacks[before] == prev_modes) {
+                        auto dropped = k - m_GapEnd;
+                        m_GapEnd = k;
+                        return dropped;
+                    }
+                }
+            }
+            auto const& res = *it;
+            if (res.is_success()) {
+                push({
+                    pos, res.success().matched(), it.reach(),
+                    intern_modes(it.modes()), res.success().value().type()
+                });
+            }
+            prev_modes = it.modes();
+        }
+        auto dropped = m_Info.size() - m_GapEnd;
+        m_GapEnd = m_Info.size();
+        return dropped;
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    token_stream(Lexer const& l, string_type src)
+        : m_Lexer(::std::addressof(l)), m_Source(src) {
+        intern_modes({ 0 });
+        for (auto it = l.begin(m_Source); it != l.end(); ++it) {
+            if (it->is_success()) {
+                push({
+                    it.position(), it->success().matched(), it.reach(),
+                    intern_modes(it.modes()), it->success().value().type()
+                });
+            }
+        }
+    }
+
+    // Just to avoid nasty bugs
+    token_stream(Lexer const&& l, string_type src) = delete;
+
+    /**
+     * The tokens, this is what the parser should be applied to.
+     */
+    [[nodiscard]] tokens_view tokens() const noexcept {
+        return tokens_view(*this);
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_Info.size() - (m_GapEnd - m_GapBegin);
+    }
+
+    /**
+     * The offset of the i-th token in the source.
+     */
+    [[nodiscard]] std::size_t offset(std::size_t i) const noexcept {
+        return at(i).offset;
+    }
+
+    /**
+     * The number of different mode stacks seen.
+     */
+    [[nodiscard]] std::size_t mode_stack_count() const noexcept {
+        return m_ModeStacks.size();
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Updates the tokens for the edited source, given the edit in
+     * characters. Returns the edit in tokens, that can be passed to reparse.
+     * Only the tokens that looked at the edited part are lexed again, until
+     * the lexer gets back to the start of an old token in the same state.
+     * The work is proportional to the relexed tokens and the distance from
+     * the previous edit, the tokens after the edit are not touched.
+     */
+    text_edit relex(string_type src, text_edit const& edit) {
+        // The first token that could see the edit
+        std::size_t first = 0;
+        for (auto last = size(); first < last;) {
+            auto mid = first + (last - first) / 2;
+            if (at(mid).reach < edit.start) {
+                first = mid + 1;
+            }
+            else {
+                last = mid;
+            }
+        }
+        auto from = std::size_t(0);
+        auto modes = m_ModeStacks[0];
+        if (first != 0) {
+            auto prev = at(first - 1);
+            from = prev.offset + prev.length;
+            modes = m_ModeStacks[prev.modes];
+        }
+
+        move_gap(first);
+        // The tokens after the gap are in the new source from now on
+        m_Source = src;
+        auto rem = lex(from, first, modes, edit);
+        return text_edit{ first, rem, m_GapBegin - first };
+    }
+};
+
+template <typename Lexer, typename CharT>
+token_stream(Lexer const&, std::basic_string_view<CharT>)
+    -> token_stream<Lexer, CharT>;
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_TOKEN_STREAM_HPP */
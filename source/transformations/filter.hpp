@@ -38,6 +38,8 @@ public:
         : m_Predicate(cppcmb_fwd(pred)) {
     }
 
+    cppcmb_getter(predicate, m_Predicate)
+
     // XXX(LPeter1997): Noexcept specifier
     template <typename... Ts>
     [[nodiscard]] constexpr auto operator()(Ts&&... args) const
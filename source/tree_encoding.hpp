@@ -0,0 +1,1132 @@
+/**
+ * tree_encoding.hpp
+ *
+ * Copyright (c) 2018-2019 Peter Lenkefi
+ * Distributed under the MIT License.
+ *
+ * A compact binary encoding for parse results, so they can be handed to other
+ * processes without reparsing. The encoding is driven by the C++ type of the
+ * value, so no type information is stored. Integers are varints, strings are
+ * indices into a deduplicated string table and collections are prefixed with
+ * the relative offset to their end, so they can be skipped in constant time.
+ *
+ * A document can be read in place from any byte buffer (for example a mapped
+ * file): tree_view navigates it without decoding anything, strings are views
+ * into the buffer.
+ *
+ * Layout:
+ *  - Magic "CCMT", version byte, reserved byte
+ *  - u32 string count N, u32 offsets[N + 1], string bytes
+ *  - The root value
+ * Fixed-width numbers are little-endian.
+ */
+
+#ifndef CPPCMB_TREE_ENCODING_HPP
+#define CPPCMB_TREE_ENCODING_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "detail.hpp"
+#include "inline_vector.hpp"
+#include "maybe.hpp"
+#include "product.hpp"
+#include "sum.hpp"
+
+namespace cppcmb {
+
+namespace detail {
+
+inline constexpr char          tree_magic[4]  = { 'C', 'C', 'M', 'T' };
+inline constexpr unsigned char tree_version   = 2;
+inline constexpr std::size_t   tree_header_size = sizeof(tree_magic) + 2;
+
+/**
+ * Builds the encoded form of a value.
+ */
+class tree_writer {
+private:
+    std::string                                    m_Body;
+    std::vector<std::string>                       m_Strings;
+    std::unordered_map<std::string, std::uint32_t> m_StringIDs;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void put_u32(std::string& out, std::uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(char((v >> (8 * i)) & 0xFF));
+        }
+    }
+
+public:
+    // XXX(LPeter1997): Noexcept specifier
+    void varint(std::uint64_t v) {
+        while (v >= 0x80) {
+            m_Body.push_back(char((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        m_Body.push_back(char(v));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    void raw(void const* data, std::size_t len) {
+        m_Body.append(static_cast<char const*>(data), len);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] std::uint32_t intern(std::string_view str) {
+        auto [it, inserted] = m_StringIDs.insert({
+            std::string(str), std::uint32_t(m_Strings.size())
+        });
+        if (inserted) {
+            m_Strings.push_back(it->first);
+        }
+        return it->second;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Reserves room for a relative offset, that is filled by end_span.
+     */
+    [[nodiscard]] std::size_t begin_span() {
+        put_u32(m_Body, 0);
+        return m_Body.size();
+    }
+
+    void end_span(std::size_t start) noexcept {
+        auto len = std::uint32_t(m_Body.size() - start);
+        for (std::size_t i = 0; i < 4; ++i) {
+            m_Body[start - 4 + i] = char((len >> (8 * i)) & 0xFF);
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] std::string finish() const {
+        std::string out;
+        out.append(tree_magic, sizeof(tree_magic));
+        out.push_back(char(tree_version));
+        out.push_back('\0');
+        put_u32(out, std::uint32_t(m_Strings.size()));
+        std::uint32_t offs = 0;
+        for (auto const& s : m_Strings) {
+            put_u32(out, offs);
+            offs += std::uint32_t(s.size());
+        }
+        put_u32(out, offs);
+        for (auto const& s : m_Strings) {
+            out += s;
+        }
+        out += m_Body;
+        return out;
+    }
+};
+
+/**
+ * A cursor into an encoded document. Every read is bounds-checked.
+ */
+class tree_reader {
+private:
+    char const*   m_Pos     = nullptr;
+    char const*   m_End     = nullptr;
+    char const*   m_Offsets = nullptr;
+    char const*   m_Strings = nullptr;
+    std::uint32_t m_StringCount = 0;
+
+    [[nodiscard]] static std::uint32_t get_u32(char const* p) noexcept {
+        std::uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            v |= std::uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+        return v;
+    }
+
+public:
+    constexpr tree_reader() noexcept = default;
+
+    /**
+     * Reads the header, leaves the cursor at the root value.
+     */
+    [[nodiscard]] bool open(std::string_view bytes) noexcept {
+        m_Pos = bytes.data();
+        m_End = bytes.data() + bytes.size();
+        if (bytes.size() < tree_header_size + 4
+         || std::memcmp(m_Pos, tree_magic, sizeof(tree_magic)) != 0
+         || static_cast<unsigned char>(m_Pos[4]) != tree_version) {
+            return false;
+        }
+        m_Pos += tree_header_size;
+        m_StringCount = get_u32(m_Pos);
+        m_Pos += 4;
+        if (std::size_t(m_End - m_Pos) / 4 < std::size_t(m_StringCount) + 1) {
+            return false;
+        }
+        m_Offsets = m_Pos;
+        m_Pos += (std::size_t(m_StringCount) + 1) * 4;
+        m_Strings = m_Pos;
+        // Offsets must be increasing and inside the buffer
+        std::uint32_t prev = 0;
+        for (std::uint32_t i = 0; i <= m_StringCount; ++i) {
+            auto o = get_u32(m_Offsets + 4 * std::size_t(i));
+            if (o < prev) {
+                return false;
+            }
+            prev = o;
+        }
+        if (std::size_t(m_End - m_Pos) < prev) {
+            return false;
+        }
+        m_Pos += prev;
+        return true;
+    }
+
+    [[nodiscard]] bool at_end() const noexcept {
+        return m_Pos == m_End;
+    }
+
+    [[nodiscard]] char const* position() const noexcept {
+        return m_Pos;
+    }
+
+    [[nodiscard]] bool varint(std::uint64_t& out) noexcept {
+        out = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (m_Pos == m_End) {
+                return false;
+            }
+            auto b = static_cast<unsigned char>(*m_Pos++);
+            out |= std::uint64_t(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    [[nodiscard]] bool raw(void* out, std::size_t len) noexcept {
+        if (std::size_t(m_End - m_Pos) < len) {
+            return false;
+        }
+        std::memcpy(out, m_Pos, len);
+        m_Pos += len;
+        return true;
+    }
+
+    [[nodiscard]] bool u32(std::uint32_t& out) noexcept {
+        if (m_End - m_Pos < 4) {
+            return false;
+        }
+        out = get_u32(m_Pos);
+        m_Pos += 4;
+        return true;
+    }
+
+    [[nodiscard]] bool skip(std::size_t len) noexcept {
+        if (std::size_t(m_End - m_Pos) < len) {
+            return false;
+        }
+        m_Pos += len;
+        return true;
+    }
+
+    [[nodiscard]] bool string(std::uint64_t idx, std::string_view& out)
+        const noexcept {
+        if (idx >= m_StringCount) {
+            return false;
+        }
+        auto from = get_u32(m_Offsets + 4 * std::size_t(idx));
+        auto to = get_u32(m_Offsets + 4 * std::size_t(idx + 1));
+        out = std::string_view(m_Strings + from, to - from);
+        return true;
+    }
+};
+
+template <typename T>
+inline constexpr bool is_tree_integral_v =
+    (std::is_integral_v<T> || std::is_enum_v<T>);
+
+template <typename T>
+struct is_tree_string : std::false_type {};
+
+template <typename Traits, typename Alloc>
+struct is_tree_string<std::basic_string<char, Traits, Alloc>>
+    : std::true_type {};
+
+template <typename Traits>
+struct is_tree_string<std::basic_string_view<char, Traits>>
+    : std::true_type {};
+
+} /* namespace detail */
+
+/**
+ * Describes how a type is encoded. Specializations provide:
+ *  - decoded_type: the type the value is decoded into
+ *  - static void write(detail::tree_writer&, T const&)
+ *  - static bool validate(detail::tree_reader&): validates and steps over a
+ *    value
+ *  - static void skip(detail::tree_reader&): steps over a validated value,
+ *    collections are skipped in constant time
+ *  - static decoded_type read(detail::tree_reader&): reads a validated value
+ *  - static constexpr std::size_t min_width: the fewest bytes a value is
+ *    encoded in, 1 if not given. Collections with more elements than their
+ *    span can hold are rejected with it, so it must be at least 1.
+ */
+template <typename T, typename = void>
+struct tree_codec {};
+
+template <typename T>
+using tree_decoded_t = typename tree_codec<T>::decoded_type;
+
+namespace detail {
+
+template <typename T, typename = void>
+struct tree_min_width : std::integral_constant<std::size_t, 1> {};
+
+template <typename T>
+struct tree_min_width<T, std::void_t<decltype(tree_codec<T>::min_width)>>
+    : std::integral_constant<std::size_t, tree_codec<T>::min_width> {};
+
+template <typename T>
+inline constexpr std::size_t tree_min_width_v = tree_min_width<T>::value;
+
+/**
+ * True, if this host stores numbers with the most significant byte first.
+ */
+[[nodiscard]] inline bool big_endian_host() noexcept {
+    std::uint16_t const one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+} /* namespace detail */
+
+// Integers, characters, booleans and enums
+template <typename T>
+struct tree_codec<T, std::enable_if_t<detail::is_tree_integral_v<T>>> {
+private:
+    using int_type = std::conditional_t<std::is_enum_v<T>,
+        std::underlying_type<T>,
+        std::enable_if<true, T>
+    >;
+    using repr_type = typename int_type::type;
+
+    [[nodiscard]] static bool read_repr(detail::tree_reader& r, repr_type& out)
+        noexcept {
+        std::uint64_t v;
+        if (!r.varint(v)) {
+            return false;
+        }
+        if constexpr (std::is_signed_v<repr_type>) {
+            // Zig-zag decoding
+            auto s = std::int64_t(v >> 1) ^ -std::int64_t(v & 1);
+            if (s < std::numeric_limits<repr_type>::min()
+             || s > std::numeric_limits<repr_type>::max()) {
+                return false;
+            }
+            out = repr_type(s);
+        }
+        else {
+            if (v > std::uint64_t(std::numeric_limits<repr_type>::max())) {
+                return false;
+            }
+            out = repr_type(v);
+        }
+        return true;
+    }
+
+public:
+    using decoded_type = T;
+
+    static constexpr std::size_t min_width = 1;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, T const& val) {
+        auto v = repr_type(val);
+        if constexpr (std::is_signed_v<repr_type>) {
+            // Zig-zag encoding, so small negative numbers stay short
+            auto s = std::int64_t(v);
+            w.varint((std::uint64_t(s) << 1) ^ std::uint64_t(s >> 63));
+        }
+        else {
+            w.varint(std::uint64_t(v));
+        }
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        repr_type v;
+        return read_repr(r, v);
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t v;
+        (void)r.varint(v);
+    }
+
+    [[nodiscard]] static T read(detail::tree_reader& r) noexcept {
+        repr_type v{};
+        (void)read_repr(r, v);
+        return T(v);
+    }
+};
+
+// Floating-point numbers
+template <typename T>
+struct tree_codec<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+private:
+    using bytes_type = std::array<unsigned char, sizeof(T)>;
+
+    /**
+     * Swaps between the native and the little-endian byte order.
+     */
+    static void to_little(bytes_type& bytes) noexcept {
+        if (detail::big_endian_host()) {
+            for (std::size_t i = 0; i < sizeof(T) / 2; ++i) {
+                std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+            }
+        }
+    }
+
+public:
+    using decoded_type = T;
+
+    static constexpr std::size_t min_width = sizeof(T);
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, T const& val) {
+        bytes_type bytes;
+        std::memcpy(bytes.data(), &val, sizeof(T));
+        to_little(bytes);
+        w.raw(bytes.data(), sizeof(T));
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        return r.skip(sizeof(T));
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        (void)r.skip(sizeof(T));
+    }
+
+    [[nodiscard]] static T read(detail::tree_reader& r) noexcept {
+        bytes_type bytes{};
+        (void)r.raw(bytes.data(), sizeof(T));
+        to_little(bytes);
+        T val;
+        std::memcpy(&val, bytes.data(), sizeof(T));
+        return val;
+    }
+};
+
+// Strings decode into views of the document
+template <typename T>
+struct tree_codec<T, std::enable_if_t<detail::is_tree_string<T>::value>> {
+    using decoded_type = std::string_view;
+
+    static constexpr std::size_t min_width = 1;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, T const& val) {
+        w.varint(w.intern(std::string_view(val)));
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t idx;
+        std::string_view str;
+        return r.varint(idx) && r.string(idx, str);
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t idx;
+        (void)r.varint(idx);
+    }
+
+    [[nodiscard]] static std::string_view read(detail::tree_reader& r)
+        noexcept {
+        std::uint64_t idx = 0;
+        std::string_view str;
+        (void)(r.varint(idx) && r.string(idx, str));
+        return str;
+    }
+};
+
+template <typename... Ts>
+struct tree_codec<product<Ts...>> {
+    using decoded_type = product<tree_decoded_t<Ts>...>;
+
+    static constexpr std::size_t min_width =
+        (std::size_t(0) + ... + detail::tree_min_width_v<Ts>);
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, product<Ts...> const& val) {
+        write_impl(w, val, product<Ts...>::index_sequence);
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        return (true && ... && tree_codec<Ts>::validate(r));
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        (..., tree_codec<Ts>::skip(r));
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        // Braced initialization keeps the order of reads
+        return decoded_type{ tree_codec<Ts>::read(r)... };
+    }
+
+private:
+    template <std::size_t... Is>
+    static void write_impl(detail::tree_writer& w,
+        product<Ts...> const& val, std::index_sequence<Is...>) {
+        (tree_codec<Ts>::write(w, val.template get<Is>()), ...);
+    }
+};
+
+// The empty product is a zero byte, so every value takes up room
+template <>
+struct tree_codec<product<>> {
+    using decoded_type = product<>;
+
+    static constexpr std::size_t min_width = 1;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, product<> const&) {
+        w.varint(0);
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t v;
+        return r.varint(v) && v == 0;
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t v;
+        (void)r.varint(v);
+    }
+
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) noexcept {
+        skip(r);
+        return decoded_type();
+    }
+};
+
+template <typename... Ts>
+struct tree_codec<sum<Ts...>> {
+private:
+    using types = std::tuple<Ts...>;
+
+    template <std::size_t I>
+    using alt_t = std::tuple_element_t<I, types>;
+
+    template <std::size_t I>
+    [[nodiscard]] static bool validate_alt(std::uint64_t idx,
+        detail::tree_reader& r) noexcept {
+        if constexpr (I == sizeof...(Ts)) {
+            return false;
+        }
+        else {
+            if (idx == I) {
+                return tree_codec<alt_t<I>>::validate(r);
+            }
+            return validate_alt<I + 1>(idx, r);
+        }
+    }
+
+    template <std::size_t I>
+    static void skip_alt(std::uint64_t idx, detail::tree_reader& r) noexcept {
+        if constexpr (I < sizeof...(Ts)) {
+            if (idx == I) {
+                tree_codec<alt_t<I>>::skip(r);
+            }
+            else {
+                skip_alt<I + 1>(idx, r);
+            }
+        }
+    }
+
+public:
+    using decoded_type = sum<tree_decoded_t<Ts>...>;
+
+    static constexpr std::size_t min_width = 1;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, sum<Ts...> const& val) {
+        auto const& var = val.as_variant();
+        w.varint(var.index());
+        std::visit([&](auto const& alt) {
+            tree_codec<detail::remove_cvref_t<decltype(alt)>>::write(w, alt);
+        }, var);
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t idx;
+        return r.varint(idx) && validate_alt<0>(idx, r);
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t idx = 0;
+        (void)r.varint(idx);
+        skip_alt<0>(idx, r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    template <std::size_t I = 0>
+    [[nodiscard]] static decoded_type read_alt(std::uint64_t idx,
+        detail::tree_reader& r) {
+        if constexpr (I + 1 == sizeof...(Ts)) {
+            return decoded_type(tree_codec<alt_t<I>>::read(r));
+        }
+        else {
+            if (idx == I) {
+                return decoded_type(tree_codec<alt_t<I>>::read(r));
+            }
+            return read_alt<I + 1>(idx, r);
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t idx = 0;
+        (void)r.varint(idx);
+        return read_alt(idx, r);
+    }
+};
+
+template <typename T>
+struct tree_codec<maybe<T>> {
+    using decoded_type = maybe<tree_decoded_t<T>>;
+
+    static constexpr std::size_t min_width = 1;
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(detail::tree_writer& w, maybe<T> const& val) {
+        w.varint(val.is_some() ? 1 : 0);
+        if (val.is_some()) {
+            tree_codec<T>::write(w, val.some().value());
+        }
+    }
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        std::uint64_t tag;
+        if (!r.varint(tag) || tag > 1) {
+            return false;
+        }
+        return tag == 0 || tree_codec<T>::validate(r);
+    }
+
+    static void skip(detail::tree_reader& r) noexcept {
+        std::uint64_t tag = 0;
+        (void)r.varint(tag);
+        if (tag == 1) {
+            tree_codec<T>::skip(r);
+        }
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t tag = 0;
+        (void)r.varint(tag);
+        if (tag == 0) {
+            return decoded_type(none());
+        }
+        return decoded_type(some<tree_decoded_t<T>>(tree_codec<T>::read(r)));
+    }
+};
+
+namespace detail {
+
+/**
+ * Common encoding of collections: element count, relative offset to the end
+ * and the elements.
+ */
+template <typename Coll, typename T>
+struct tree_collection_codec {
+    static_assert(
+        tree_min_width_v<T> > 0,
+        "Collection elements must be encoded in at least a byte!"
+    );
+
+    // The count is at least a byte, the span is 4
+    static constexpr std::size_t min_width = 5;
+
+    /**
+     * The most elements a span of len bytes can hold.
+     */
+    [[nodiscard]] static constexpr std::uint64_t capacity(std::uint32_t len)
+        noexcept {
+        return len / tree_min_width_v<T>;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    static void write(tree_writer& w, Coll const& val) {
+        w.varint(std::size(val));
+        auto span = w.begin_span();
+        for (auto const& e : val) {
+            tree_codec<T>::write(w, e);
+        }
+        w.end_span(span);
+    }
+
+    /**
+     * Reads the header of the collection.
+     */
+    [[nodiscard]] static bool header(tree_reader& r,
+        std::uint64_t& count, std::uint32_t& len) noexcept {
+        return r.varint(count) && r.u32(len);
+    }
+
+    [[nodiscard]] static bool validate(tree_reader& r) noexcept {
+        std::uint64_t count;
+        std::uint32_t len;
+        if (!header(r, count, len)) {
+            return false;
+        }
+        auto elems = r;
+        if (count > capacity(len) || !r.skip(len)) {
+            return false;
+        }
+        // Validate the elements too, they must fill the span exactly
+        for (std::uint64_t i = 0; i < count; ++i) {
+            if (!tree_codec<T>::validate(elems)) {
+                return false;
+            }
+        }
+        return elems.position() == r.position();
+    }
+
+    static void skip(tree_reader& r) noexcept {
+        std::uint64_t count;
+        std::uint32_t len = 0;
+        (void)(header(r, count, len) && r.skip(len));
+    }
+};
+
+} /* namespace detail */
+
+template <typename T, typename Alloc>
+struct tree_codec<std::vector<T, Alloc>>
+    : detail::tree_collection_codec<std::vector<T, Alloc>, T> {
+
+    using decoded_type = std::vector<tree_decoded_t<T>>;
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t count = 0;
+        std::uint32_t len = 0;
+        (void)tree_codec::header(r, count, len);
+        decoded_type res;
+        // Never reserve more than the span can hold
+        res.reserve(std::size_t(
+            std::min<std::uint64_t>(count, tree_codec::capacity(len))
+        ));
+        for (std::uint64_t i = 0; i < count; ++i) {
+            res.push_back(tree_codec<T>::read(r));
+        }
+        return res;
+    }
+};
+
+template <typename T, std::size_t N>
+struct tree_codec<std::array<T, N>>
+    : detail::tree_collection_codec<std::array<T, N>, T> {
+
+    using decoded_type = std::array<tree_decoded_t<T>, N>;
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        auto rr = r;
+        std::uint64_t count;
+        std::uint32_t len;
+        return tree_codec::header(rr, count, len) && count == N
+            && detail::tree_collection_codec<std::array<T, N>, T>::validate(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t count = 0;
+        std::uint32_t len = 0;
+        (void)tree_codec::header(r, count, len);
+        return read_impl(r, std::make_index_sequence<N>());
+    }
+
+private:
+    template <std::size_t... Is>
+    [[nodiscard]] static decoded_type read_impl(detail::tree_reader& r,
+        std::index_sequence<Is...>) {
+        // Braced initialization keeps the order of reads
+        return decoded_type{ ((void)Is, tree_codec<T>::read(r))... };
+    }
+};
+
+template <typename T, std::size_t N>
+struct tree_codec<inline_vector<T, N>>
+    : detail::tree_collection_codec<inline_vector<T, N>, T> {
+
+    using decoded_type = inline_vector<tree_decoded_t<T>, N>;
+
+    [[nodiscard]] static bool validate(detail::tree_reader& r) noexcept {
+        auto rr = r;
+        std::uint64_t count;
+        std::uint32_t len;
+        using base_t = detail::tree_collection_codec<inline_vector<T, N>, T>;
+        return tree_codec::header(rr, count, len) && count <= N
+            && base_t::validate(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] static decoded_type read(detail::tree_reader& r) {
+        std::uint64_t count = 0;
+        std::uint32_t len = 0;
+        (void)tree_codec::header(r, count, len);
+        decoded_type res;
+        for (std::uint64_t i = 0; i < count; ++i) {
+            res.push_back(tree_codec<T>::read(r));
+        }
+        return res;
+    }
+};
+
+/**
+ * Encodes a value into a self-contained document.
+ */
+template <typename T>
+[[nodiscard]] std::string encode_tree(T const& val) {
+    auto w = detail::tree_writer();
+    tree_codec<T>::write(w, val);
+    return w.finish();
+}
+
+/**
+ * A read-only cursor to an encoded value of type T. Nothing is decoded until
+ * it's asked for.
+ */
+template <typename T>
+class tree_view {
+private:
+    detail::tree_reader m_Reader;
+
+public:
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    /**
+     * Decodes the whole value. Strings will still be views of the document.
+     */
+    [[nodiscard]] tree_decoded_t<T> decode() const {
+        auto r = m_Reader;
+        return tree_codec<T>::read(r);
+    }
+};
+
+template <typename... Ts>
+class tree_view<product<Ts...>> {
+private:
+    detail::tree_reader m_Reader;
+
+public:
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
+
+    /**
+     * The view of the Idx-th element.
+     */
+    template <std::size_t Idx>
+    [[nodiscard]] auto get() const noexcept {
+        auto r = m_Reader;
+        skip_to(r, std::make_index_sequence<Idx>());
+        using elem_t = std::tuple_element_t<Idx, std::tuple<Ts...>>;
+        return tree_view<elem_t>(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<product<Ts...>> decode() const {
+        auto r = m_Reader;
+        return tree_codec<product<Ts...>>::read(r);
+    }
+
+private:
+    template <std::size_t... Is>
+    static void skip_to(detail::tree_reader& r, std::index_sequence<Is...>)
+        noexcept {
+        (..., tree_codec<std::tuple_element_t<Is, std::tuple<Ts...>>>::skip(r));
+    }
+};
+
+template <typename... Ts>
+class tree_view<sum<Ts...>> {
+private:
+    detail::tree_reader m_Reader;
+
+public:
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
+
+    /**
+     * The index of the alternative that is stored.
+     */
+    [[nodiscard]] std::size_t index() const noexcept {
+        auto r = m_Reader;
+        std::uint64_t idx = 0;
+        (void)r.varint(idx);
+        return std::size_t(idx);
+    }
+
+    /**
+     * The view of the Idx-th alternative. Only valid if index() == Idx.
+     */
+    template <std::size_t Idx>
+    [[nodiscard]] auto get() const noexcept {
+        cppcmb_assert("Wrong alternative of sum!", index() == Idx);
+        auto r = m_Reader;
+        std::uint64_t idx;
+        (void)r.varint(idx);
+        using alt_t = std::tuple_element_t<Idx, std::tuple<Ts...>>;
+        return tree_view<alt_t>(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<sum<Ts...>> decode() const {
+        auto r = m_Reader;
+        return tree_codec<sum<Ts...>>::read(r);
+    }
+};
+
+template <typename T>
+class tree_view<maybe<T>> {
+private:
+    detail::tree_reader m_Reader;
+
+public:
+    constexpr explicit tree_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
+
+    [[nodiscard]] bool is_some() const noexcept {
+        auto r = m_Reader;
+        std::uint64_t tag = 0;
+        (void)r.varint(tag);
+        return tag == 1;
+    }
+
+    [[nodiscard]] bool is_none() const noexcept {
+        return !is_some();
+    }
+
+    /**
+     * The view of the contained value. Only valid if is_some().
+     */
+    [[nodiscard]] tree_view<T> some() const noexcept {
+        cppcmb_assert("some() on an empty maybe!", is_some());
+        auto r = m_Reader;
+        std::uint64_t tag;
+        (void)r.varint(tag);
+        return tree_view<T>(r);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<maybe<T>> decode() const {
+        auto r = m_Reader;
+        return tree_codec<maybe<T>>::read(r);
+    }
+};
+
+namespace detail {
+
+/**
+ * The view of a collection. Elements are visited in order, whole
+ * collections are skipped in constant time.
+ */
+template <typename Coll, typename T>
+class tree_collection_view {
+private:
+    detail::tree_reader m_Reader;
+
+    [[nodiscard]] detail::tree_reader elements(std::uint64_t& count)
+        const noexcept {
+        auto r = m_Reader;
+        std::uint32_t len;
+        (void)(r.varint(count) && r.u32(len));
+        return r;
+    }
+
+public:
+    class iterator {
+    private:
+        detail::tree_reader m_Reader;
+        std::uint64_t       m_Remaining = 0;
+
+    public:
+        using value_type = tree_view<T>;
+
+        constexpr iterator() noexcept = default;
+
+        constexpr iterator(detail::tree_reader r, std::uint64_t rem) noexcept
+            : m_Reader(r), m_Remaining(rem) {
+        }
+
+        [[nodiscard]] tree_view<T> operator*() const noexcept {
+            return tree_view<T>(m_Reader);
+        }
+
+        iterator& operator++() noexcept {
+            tree_codec<T>::skip(m_Reader);
+            --m_Remaining;
+            return *this;
+        }
+
+        [[nodiscard]] bool operator==(iterator const& o) const noexcept {
+            return m_Remaining == o.m_Remaining;
+        }
+
+        [[nodiscard]] bool operator!=(iterator const& o) const noexcept {
+            return !(*this == o);
+        }
+    };
+
+    constexpr explicit tree_collection_view(detail::tree_reader r) noexcept
+        : m_Reader(r) {
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        std::uint64_t count = 0;
+        (void)elements(count);
+        return std::size_t(count);
+    }
+
+    [[nodiscard]] bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    [[nodiscard]] iterator begin() const noexcept {
+        std::uint64_t count = 0;
+        auto r = elements(count);
+        return iterator(r, count);
+    }
+
+    [[nodiscard]] iterator end() const noexcept {
+        return iterator();
+    }
+
+    /**
+     * The view of the idx-th element. This steps over the previous elements.
+     */
+    [[nodiscard]] tree_view<T> operator[](std::size_t idx) const noexcept {
+        cppcmb_assert("Index out of bounds!", idx < size());
+        auto it = begin();
+        for (std::size_t i = 0; i < idx; ++i) {
+            ++it;
+        }
+        return *it;
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<Coll> decode() const {
+        auto r = m_Reader;
+        return tree_codec<Coll>::read(r);
+    }
+};
+
+} /* namespace detail */
+
+template <typename T, typename Alloc>
+class tree_view<std::vector<T, Alloc>>
+    : public detail::tree_collection_view<std::vector<T, Alloc>, T> {
+public:
+    using detail::tree_collection_view<
+        std::vector<T, Alloc>, T
+    >::tree_collection_view;
+};
+
+template <typename T, std::size_t N>
+class tree_view<std::array<T, N>>
+    : public detail::tree_collection_view<std::array<T, N>, T> {
+public:
+    using detail::tree_collection_view<
+        std::array<T, N>, T
+    >::tree_collection_view;
+};
+
+template <typename T, std::size_t N>
+class tree_view<inline_vector<T, N>>
+    : public detail::tree_collection_view<inline_vector<T, N>, T> {
+public:
+    using detail::tree_collection_view<
+        inline_vector<T, N>, T
+    >::tree_collection_view;
+};
+
+/**
+ * An encoded document over a byte buffer that it doesn't own. The buffer is
+ * validated once when opening, every view of it is safe to use afterwards.
+ */
+template <typename T>
+class tree_document {
+private:
+    detail::tree_reader m_Root;
+
+    constexpr explicit tree_document(detail::tree_reader r) noexcept
+        : m_Root(r) {
+    }
+
+public:
+    /**
+     * Opens a document. Returns nothing if the bytes are not a valid encoding
+     * of a T.
+     */
+    [[nodiscard]] static std::optional<tree_document> open(
+        std::string_view bytes) noexcept {
+
+        auto r = detail::tree_reader();
+        if (!r.open(bytes)) {
+            return std::nullopt;
+        }
+        auto end = r;
+        if (!tree_codec<T>::validate(end) || !end.at_end()) {
+            return std::nullopt;
+        }
+        return tree_document(r);
+    }
+
+    [[nodiscard]] tree_view<T> root() const noexcept {
+        return tree_view<T>(m_Root);
+    }
+
+    // XXX(LPeter1997): Noexcept specifier
+    [[nodiscard]] tree_decoded_t<T> decode() const {
+        return root().decode();
+    }
+};
+
+/**
+ * Decodes an encoded document. Strings are views of the bytes.
+ */
+template <typename T>
+[[nodiscard]] std::optional<tree_decoded_t<T>> decode_tree(
+    std::string_view bytes) {
+
+    auto doc = tree_document<T>::open(bytes);
+    if (!doc) {
+        return std::nullopt;
+    }
+    return doc->decode();
+}
+
+} /* namespace cppcmb */
+
+#endif /* CPPCMB_TREE_ENCODING_HPP */
@@ -1,3 +1,9 @@
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
 #include <string_view>
 #include <type_traits>
 #include <vector>
@@ -165,3 +171,1297 @@ TEST_CASE("'seq' succeeds if all elements succeed", "[seq]") {
 		}
 	}
 }
+
+TEST_CASE("'ilit' matches literals ignoring ASCII case", "[ilit]") {
+	auto p = pc::ilit("select_from_where");
+
+	SECTION("mixed case input") {
+		std::string_view src = "SeLeCt_FROM_where x";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().matched() == 17);
+	}
+
+	SECTION("mismatch in the middle") {
+		std::string_view src = "select_frum_where";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_failure());
+		REQUIRE(res.furthest() == 10);
+	}
+
+	SECTION("keyword sets pick the longest match") {
+		auto kws = pc::ikeywords("in", "insert", "into");
+		std::string_view src = "INSERT INTO";
+		auto res = kws.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().value() == 1);
+		REQUIRE(res.success().matched() == 6);
+	}
+}
+
+TEST_CASE("Case-insensitive lexer rules", "[lexer]") {
+	enum class tok { kw_select, ident };
+
+	auto lexer = pc::lexer(
+		cppcmb_token("select", tok::kw_select, pc::icase),
+		cppcmb_token("[a-zA-Z]+", tok::ident),
+		cppcmb_token(" ", pc::skip)
+	);
+
+	std::string_view src = "SELECT x";
+	std::vector<tok> types;
+	for (auto it = lexer.begin(src); it != lexer.end(); ++it) {
+		REQUIRE(it->is_success());
+		types.push_back(it->success().value().type());
+	}
+
+	REQUIRE(types == std::vector<tok>{ tok::kw_select, tok::ident });
+}
+
+TEST_CASE("'repeat' applies a parser a bounded number of times", "[repeat]") {
+	SECTION("exact count collects into an array") {
+		auto p = pc::repeat<3>(match<'a'>);
+		std::string_view src = "aaaa";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		auto succ = res.success();
+		REQUIRE(same_type_v<decltype(succ.value()), std::array<char, 3>>);
+		REQUIRE(succ.value() == std::array<char, 3>{ 'a', 'a', 'a' });
+		REQUIRE(succ.matched() == 3);
+	}
+
+	SECTION("scanning stops at the maximum") {
+		auto p = pc::repeat<1, 3>(match<'a'>);
+		std::string_view src = "aaaaa";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		auto succ = res.success();
+		REQUIRE(succ.value().size() == 3);
+		REQUIRE(succ.matched() == 3);
+		REQUIRE(res.furthest() == 3);
+	}
+
+	SECTION("too few matches") {
+		auto p = pc::repeat<2, 4>(match<'a'>);
+		std::string_view src = "ab";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_failure());
+		REQUIRE(res.furthest() == 2);
+	}
+
+	SECTION("input shorter than the minimum fails up front") {
+		auto p = pc::repeat<4>(match<'a'>);
+		std::string_view src = "aaa";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_failure());
+		REQUIRE(res.furthest() == 3);
+	}
+}
+
+TEST_CASE("'parse_cache' shares results of repeated inputs", "[parse_cache]") {
+	auto cache = pc::parse_cache(pc::xid_identifier, 1024);
+
+	std::string input = "hello world";
+	auto r1 = cache.parse(input);
+	// The cached result must not reference the caller's buffer
+	input = "xxxxx xxxxx";
+	auto r2 = cache.parse("hello world");
+
+	REQUIRE(r1 == r2);
+	REQUIRE(r1->is_success());
+	REQUIRE(r1->success().value() == "hello");
+	REQUIRE(cache.stats().hits == 1);
+	REQUIRE(cache.stats().misses == 1);
+
+	SECTION("entries are evicted to stay in budget") {
+		cache.set_budget(cache.stats().bytes);
+		(void)cache.parse("other");
+
+		REQUIRE(cache.stats().evictions == 1);
+		REQUIRE(cache.stats().entries == 1);
+		REQUIRE(cache.stats().bytes <= cache.budget());
+		// The evicted result is still usable
+		REQUIRE(r1->success().value() == "hello");
+	}
+}
+
+namespace {
+int persisted_calls = 0;
+} /* namespace */
+
+TEST_CASE("Memo tables can be saved and loaded", "[persistence]") {
+	auto count = [](char c) {
+		++persisted_calls;
+		return c;
+	};
+	auto counted = pc::memo(match<'a'>[count], "counted");
+	auto grammar = *counted;
+
+	std::string_view src = "aaab";
+	std::stringstream stream;
+	{
+		auto p = pc::parser(grammar);
+		persisted_calls = 0;
+		REQUIRE(p.parse(src).is_success());
+		REQUIRE(persisted_calls == 3);
+		p.save_memo(stream, src, 1);
+	}
+
+	SECTION("a fresh parser picks up the saved results") {
+		auto p = pc::parser(grammar);
+		REQUIRE(p.load_memo(stream, src, 1));
+		persisted_calls = 0;
+		// Edited since saving
+		std::string_view src2 = "aaabb";
+		auto res = p.reparse(src2, 4, 0, 1);
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().value().size() == 3);
+		REQUIRE(persisted_calls == 0);
+	}
+
+	SECTION("a different source is rejected") {
+		auto p = pc::parser(grammar);
+		REQUIRE(!p.load_memo(stream, std::string_view("aaaa"), 1));
+	}
+
+	SECTION("a different grammar version is rejected") {
+		auto p = pc::parser(grammar);
+		REQUIRE(!p.load_memo(stream, src, 2));
+	}
+
+	SECTION("a corrupt length is rejected") {
+		auto bytes = stream.str();
+		// The data length of the first entry
+		auto const len_at = 4 + 4 + 4 + 8 * 5 + 8 * 3;
+		for (std::size_t i = 0; i < 8; ++i) {
+			bytes[len_at + i] = '\xFF';
+		}
+		std::stringstream corrupt(bytes);
+		auto p = pc::parser(grammar);
+		REQUIRE(!p.load_memo(corrupt, src, 1));
+	}
+
+	SECTION("rules without a key are not saved") {
+		auto unkeyed = *pc::memo(match<'a'>[count]);
+		auto p = pc::parser(unkeyed);
+		REQUIRE(p.parse(src).is_success());
+		std::stringstream out;
+		p.save_memo(out, src, 1);
+
+		auto q = pc::parser(unkeyed);
+		REQUIRE(q.load_memo(out, src, 1));
+		persisted_calls = 0;
+		REQUIRE(q.reparse(src, 0, 0, 0).is_success());
+		REQUIRE(persisted_calls == 3);
+	}
+}
+
+TEST_CASE("Parse trees can be encoded and read in place", "[tree_encoding]") {
+	using node_t = pc::product<std::string_view, int, std::vector<pc::sum<char, unsigned>>>;
+	using tree_t = std::vector<node_t>;
+
+	tree_t tree{
+		node_t(std::string_view("x"), -3, std::vector<pc::sum<char, unsigned>>{ 'a', 300U }),
+		node_t(std::string_view("x"), 7, std::vector<pc::sum<char, unsigned>>{}),
+	};
+
+	auto bytes = pc::encode_tree(tree);
+
+	SECTION("decoding restores the value") {
+		auto decoded = pc::decode_tree<tree_t>(bytes);
+
+		REQUIRE(decoded.has_value());
+		REQUIRE(same_type_v<decltype(*decoded), tree_t&>);
+		REQUIRE(*decoded == tree);
+		// Strings point into the buffer
+		auto str = decoded->front().get<0>();
+		REQUIRE(str.data() >= bytes.data());
+		REQUIRE(str.data() < bytes.data() + bytes.size());
+	}
+
+	SECTION("views navigate without decoding") {
+		auto doc = pc::tree_document<tree_t>::open(bytes);
+		REQUIRE(doc.has_value());
+
+		auto root = doc->root();
+		REQUIRE(root.size() == 2);
+		REQUIRE(root[1].get<1>().decode() == 7);
+		auto alts = root[0].get<2>();
+		REQUIRE(alts.size() == 2);
+		REQUIRE(alts[1].index() == 1);
+		REQUIRE(alts[1].get<1>().decode() == 300U);
+	}
+
+	SECTION("corrupt input is rejected") {
+		REQUIRE(!pc::decode_tree<tree_t>(bytes.substr(0, bytes.size() - 1)));
+		REQUIRE(!pc::decode_tree<tree_t>("garbage"));
+
+		// Trailing bytes in the span of a collection
+		auto ints = pc::encode_tree(std::vector<int>{ 1 });
+		REQUIRE(pc::decode_tree<std::vector<int>>(ints).has_value());
+		ints[ints.size() - 5] += 1;
+		ints.push_back('\0');
+		REQUIRE(!pc::decode_tree<std::vector<int>>(ints));
+
+		// More elements than the span can hold
+		ints = pc::encode_tree(std::vector<int>{ 1 });
+		ints[ints.size() - 6] = 2;
+		REQUIRE(!pc::decode_tree<std::vector<int>>(ints));
+
+		// Empty elements still take up a byte, so the count is bounded
+		using empties_t = std::vector<pc::product<>>;
+		auto empties = pc::encode_tree(empties_t(3));
+		REQUIRE(pc::decode_tree<empties_t>(empties)->size() == 3);
+		auto huge = empties.substr(0, empties.size() - 8)
+			+ std::string(9, '\xFF') + '\x01'
+			+ empties.substr(empties.size() - 7);
+		REQUIRE(!pc::decode_tree<empties_t>(huge));
+	}
+
+	SECTION("floats are little-endian") {
+		auto one = pc::encode_tree(1.0f);
+		auto bits = std::string("\0\0\x80\x3F", 4);
+		REQUIRE(one.substr(one.size() - 4) == bits);
+		REQUIRE(pc::decode_tree<float>(one) == 1.0f);
+	}
+}
+
+namespace {
+int auto_memo_calls = 0;
+} /* namespace */
+
+TEST_CASE("'as_memo_auto' memoizes rules that get re-evaluated", "[memo_auto]") {
+	auto count = [](char c) {
+		++auto_memo_calls;
+		return c;
+	};
+	auto x = match<'a'>[count] %= pc::as_memo_auto;
+	auto p = pc::parser(*((x & match<'b'>) | (x & match<'c'>)));
+
+	std::string src;
+	for (int i = 0; i < 200; ++i) {
+		src += "ac";
+	}
+
+	auto_memo_calls = 0;
+	auto res = p.parse(std::string_view(src));
+
+	REQUIRE(res.is_success());
+	REQUIRE(res.success().matched() == src.size());
+	// Without memoization every 'a' would be parsed twice
+	REQUIRE(auto_memo_calls < 400);
+	REQUIRE(auto_memo_calls >= 200);
+
+	SECTION("copies keep the decision in their own statistics") {
+		auto original = std::make_optional(p);
+		auto copy = *original;
+		original.reset();
+
+		auto_memo_calls = 0;
+		REQUIRE(copy.parse(std::string_view(src)).is_success());
+		REQUIRE(auto_memo_calls == 200);
+	}
+}
+
+TEST_CASE("Memo tables can be compacted", "[compact]") {
+	auto a = pc::memo(match<'a'>);
+	auto b = pc::memo(match<'b'>);
+	auto grammar = *(a | b | pc::memo(match<'c'>));
+	auto p = pc::parser(grammar);
+
+	std::string_view src = "aaaaabbbbbcccccddddd";
+	REQUIRE(p.parse(src).is_success());
+
+	SECTION("failures away from successes are dropped") {
+		auto wide = p.compact(100);
+		REQUIRE(wide.entries_removed == 0);
+
+		auto stats = p.compact(0);
+		// Only the failures at the final position have no success there
+		REQUIRE(stats.entries_removed == 3);
+		REQUIRE(stats.bytes_reclaimed > 0);
+	}
+
+	SECTION("compaction can run after every parse") {
+		p.enable_auto_compact();
+		REQUIRE(p.reparse(src, 19, 1, 1).is_success());
+		REQUIRE(p.last_compaction().entries_removed == 3);
+	}
+}
+
+TEST_CASE("Compaction drops the successes of failed alternatives",
+	"[compact]") {
+
+	auto item = pc::memo(match<'a'>);
+	auto top = pc::memo(*item & match<'!'>) | pc::memo(+pc::one);
+	auto p = pc::parser(top);
+
+	std::string_view src = "aaaa?";
+	REQUIRE(p.parse(src).success().matched() == 5);
+
+	SECTION("only the neighborhood of the derivation is kept") {
+		// The items at 3 and 4 are too far from the start
+		REQUIRE(p.compact(2).entries_removed == 2);
+		// Only the ones at the start of the derivation are kept
+		REQUIRE(p.compact(0).entries_removed == 2);
+	}
+
+	SECTION("the results under the derivation are kept") {
+		int calls = 0;
+		auto counted = pc::memo(match<'a'>[([&calls](char c) {
+			++calls;
+			return c;
+		})]);
+		auto q = pc::parser(pc::memo(*counted));
+		std::string_view as = "aaaa";
+		REQUIRE(q.parse(as).is_success());
+
+		// Only the failed item at the end is dropped
+		REQUIRE(q.compact(0).entries_removed == 1);
+		calls = 0;
+		REQUIRE(q.reparse(as, 0, 0, 0).success().matched() == 4);
+		REQUIRE(calls == 1);
+	}
+}
+
+namespace {
+int lazy_calls = 0;
+} /* namespace */
+
+TEST_CASE("'lazy' defers parsing until the result is accessed", "[lazy]") {
+	auto count = [](char c) {
+		++lazy_calls;
+		return c;
+	};
+	auto body = *match<'a'>[count];
+	auto p = pc::lazy(body, *match<'a'>) & match<'b'>;
+
+	std::string_view src = "aaab";
+	lazy_calls = 0;
+	auto res = p.apply(pc::reader(src));
+
+	REQUIRE(res.is_success());
+	auto handle = res.success().value().get<0>();
+	REQUIRE(handle.start() == 0);
+	REQUIRE(handle.length() == 3);
+	REQUIRE(!handle.is_parsed());
+	REQUIRE(lazy_calls == 0);
+
+	REQUIRE(handle->is_success());
+	REQUIRE(handle->success().value().size() == 3);
+	REQUIRE(lazy_calls == 3);
+
+	// Copies share the parsed result
+	auto copy = handle;
+	REQUIRE(copy.is_parsed());
+	(void)copy.get();
+	REQUIRE(lazy_calls == 3);
+
+	// The body has to consume exactly the skipped region
+	auto short_body = pc::lazy(match<'a'>, *match<'a'>);
+	REQUIRE(short_body.apply(pc::reader(src)).success().value()
+		->is_failure());
+	auto long_body = pc::lazy(*pc::one, *match<'a'>);
+	auto all = long_body.apply(pc::reader(src)).success().value();
+	REQUIRE(all->is_success());
+	REQUIRE(all->success().value().size() == 3);
+}
+
+namespace {
+
+// Reference implementation for 'skip_balanced'
+std::size_t balanced_length(std::string_view s) {
+	std::size_t depth = 0;
+	bool in_str = false;
+	bool esc = false;
+	for (std::size_t i = 0; i < s.size(); ++i) {
+		char c = s[i];
+		bool escaped = esc;
+		esc = !escaped && c == '\\';
+		if (c == '"' && !escaped) in_str = !in_str;
+		else if (in_str) continue;
+		else if (c == '{') ++depth;
+		else if (c == '}' && --depth == 0) return i + 1;
+	}
+	return 0;
+}
+
+} /* namespace */
+
+TEST_CASE("'skip_balanced' skips nested regions", "[skip_balanced]") {
+	auto p = pc::skip_balanced<'{', '}', '"', '\\'>;
+
+	SECTION("delimiters in strings are ignored") {
+		std::string_view src = R"({ a { "}\"}" } b } c)";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().value() == R"({ a { "}\"}" } b })");
+	}
+
+	SECTION("unterminated regions fail") {
+		std::string_view src = "{ { }";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_failure());
+		REQUIRE(res.furthest() == 5);
+	}
+
+	SECTION("agrees with a byte-by-byte scan across blocks") {
+		std::uint64_t seed = 12345;
+		auto next = [&] {
+			seed = seed * 6364136223846793005U + 1442695040888963407U;
+			return std::size_t(seed >> 33);
+		};
+		char const alphabet[] = "{}\"\\ab";
+		for (int n = 0; n < 300; ++n) {
+			std::string src = "{";
+			auto len = next() % 400;
+			for (std::size_t i = 0; i < len; ++i) {
+				src += alphabet[next() % 6];
+			}
+			auto expected = balanced_length(src);
+			auto res = p.apply(pc::reader(src));
+
+			REQUIRE(res.is_success() == (expected != 0));
+			if (expected != 0) {
+				REQUIRE(res.success().matched() == expected);
+			}
+		}
+	}
+}
+
+namespace {
+
+bool is_alpha(char c) { return std::isalpha(static_cast<unsigned char>(c)); }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+bool is_dot(char c) { return c == '.'; }
+pc::maybe<char> only_a(char c) {
+	if (c == 'a') {
+		return pc::some(c);
+	}
+	return pc::none();
+}
+
+} /* namespace */
+
+TEST_CASE("Regular combinators can be compiled to a DFA", "[dfa]") {
+	auto alpha = pc::one[pc::filter(is_alpha)];
+	auto digit = pc::one[pc::filter(is_digit)];
+	auto ident = alpha & *(alpha | digit);
+	auto number = +digit & -(pc::one[pc::filter(is_dot)] & +digit);
+
+	REQUIRE(pc::is_regular_v<decltype(ident)>);
+	REQUIRE(pc::is_regular_v<decltype(number)>);
+	REQUIRE(!pc::is_regular_v<decltype(ident[pc::filter(is_alpha)])>);
+	// The DFA couldn't honor the failure of the action
+	REQUIRE(!pc::is_regular_v<decltype(pc::one[only_a])>);
+	REQUIRE(pc::is_regular_v<decltype(pc::one[is_alpha])>);
+
+	SECTION("matches the same as the combinators") {
+		auto ident_dfa = ident %= pc::as_dfa;
+		auto number_dfa = pc::dfa(number);
+		REQUIRE(ident_dfa.compiled());
+		REQUIRE(number_dfa.compiled());
+		for (std::string_view src : {
+			"abc12+", "a", "1abc", "", "12.5x", "12.", "007"
+		}) {
+			auto r1 = ident.apply(pc::reader(src));
+			auto r2 = ident_dfa.apply(pc::reader(src));
+			REQUIRE(r1.is_success() == r2.is_success());
+			if (r1.is_success()) {
+				REQUIRE(r1.success().matched() == r2.success().matched());
+				REQUIRE(r2.success().value()
+					== src.substr(0, r1.success().matched()));
+			}
+
+			auto n1 = number.apply(pc::reader(src));
+			auto n2 = number_dfa.apply(pc::reader(src));
+			REQUIRE(n1.is_success() == n2.is_success());
+			if (n1.is_success()) {
+				REQUIRE(n1.success().matched() == n2.success().matched());
+			}
+		}
+	}
+
+	SECTION("regexes are regular") {
+		auto re = pc::dfa(pc::regex(cppcmb_str("[a-c]+(x|yz)?[^0-9]")));
+		std::string_view src = "abcyz!";
+
+		REQUIRE(re.apply(pc::reader(src)).success().matched() == 6);
+		REQUIRE(re.apply(pc::reader(std::string_view("a1"))).is_failure());
+		// [a-c]+ takes the "b" of "ab1" that [^0-9] would need
+		REQUIRE(!re.compiled());
+		REQUIRE(re.apply(pc::reader(std::string_view("ab1"))).is_failure());
+	}
+
+	SECTION("combinators that can match less than the longest prefix") {
+		auto in = match<'i'> & match<'n'>;
+		auto int_ = in & match<'t'>;
+		std::string_view src = "int";
+
+		auto kw = (in | int_) %= pc::as_dfa;
+		REQUIRE(!kw.compiled());
+		REQUIRE(kw.apply(pc::reader(src)).success().matched() == 2);
+		auto kw_ordered = (int_ | in) %= pc::as_dfa;
+		REQUIRE(kw_ordered.compiled());
+		REQUIRE(kw_ordered.apply(pc::reader(src)).success().matched() == 3);
+
+		// The repetition never leaves an 'a' for the last one
+		auto as = pc::dfa(*match<'a'> & match<'a'>);
+		REQUIRE(!as.compiled());
+		REQUIRE(as.apply(pc::reader(std::string_view("aa"))).is_failure());
+		auto records = std::vector<std::string>{ "aa", "" };
+		REQUIRE(as.validate(records) == std::vector<std::uint64_t>{ 0 });
+	}
+}
+
+TEST_CASE("'regex_capture' returns the capture groups", "[regex_capture]") {
+	SECTION("one-pass patterns") {
+		auto p = pc::regex_capture(cppcmb_str("([a-z]+)=([0-9]+)(;)?"));
+		std::string_view src = "key=123,rest";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(p.one_pass());
+		REQUIRE(res.is_success());
+		auto const& g = res.success().value();
+		REQUIRE(g.size() == 4);
+		REQUIRE(g[0] == "key=123");
+		REQUIRE(g[1] == "key");
+		REQUIRE(g[2] == "123");
+		REQUIRE(g[3].data() == nullptr);
+	}
+
+	SECTION("repeated and nested groups") {
+		auto p = pc::regex_capture(cppcmb_str("((a|b)c)*d"));
+		std::string_view src = "acbcd";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().value()[1] == "bc");
+		REQUIRE(res.success().value()[2] == "b");
+	}
+
+	SECTION("patterns that are not one-pass") {
+		auto p = pc::regex_capture(cppcmb_str("([a-z]*)([a-z0-9]*)x"));
+		std::string_view src = "ab12x";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(!p.one_pass());
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().value()[1] == "ab");
+		REQUIRE(res.success().value()[2] == "12");
+		REQUIRE(p.apply(pc::reader(std::string_view("ab12"))).is_failure());
+	}
+}
+
+TEST_CASE("Regular combinators can be searched for", "[find]") {
+	SECTION("'find' skips to the first match") {
+		auto p = pc::find(pc::regex(cppcmb_str("err(or)?=[0-9]+")));
+		std::string_view src = "ok=1 e=2 erro=3 error=42 err=7";
+		auto res = p.apply(pc::reader(src));
+
+		REQUIRE(p.searcher().filter().prefix() == "err");
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().value() == "error=42");
+		REQUIRE(res.success().matched() == src.find(" err=7"));
+		REQUIRE(p.apply(pc::reader(std::string_view("erro=1"))).is_failure());
+	}
+
+	SECTION("'regex_search' iterates over all matches") {
+		std::string_view src = "a1 bb22 c 333d";
+		std::vector<std::string_view> found;
+		for (auto m : pc::regex_search(src, pc::regex(cppcmb_str("[0-9]+")))) {
+			found.push_back(m);
+		}
+		REQUIRE(found == std::vector<std::string_view>{ "1", "22", "333" });
+
+		auto all = pc::regex_search(src, pc::regex(cppcmb_str("[a-z]*")));
+		auto it = all.begin();
+		REQUIRE(*it == "a");
+		REQUIRE((++it).position() == 1);
+		REQUIRE(it->empty());
+		REQUIRE(std::distance(all.begin(), all.end()) == 14);
+	}
+
+	SECTION("searching is linear on long non-matching input") {
+		// Every 'a' can start a match, that only fails at the end
+		auto text = std::string(std::size_t(1) << 20, 'a');
+		auto pattern = pc::regex(cppcmb_str("[a-z]+[0-9]"));
+		auto none = pc::regex_search(text, pattern);
+		REQUIRE(none.begin() == none.end());
+
+		text += "1 b2";
+		std::vector<std::string_view> found;
+		for (auto m : pc::regex_search(text, pattern)) {
+			found.push_back(m);
+		}
+		REQUIRE(found.size() == 2);
+		REQUIRE(found[0].size() == text.size() - 3);
+		REQUIRE(found[1] == "b2");
+	}
+
+	SECTION("the leftmost match wins over an earlier ending one") {
+		auto p = pc::regex(cppcmb_str("ab|xaby"));
+		auto all = pc::regex_search(std::string_view("-xaby"), p);
+		REQUIRE(*all.begin() == "xaby");
+	}
+}
+
+TEST_CASE("DFAs can validate records in batches", "[dfa]") {
+	auto p = pc::dfa(pc::regex(cppcmb_str("[0-9]+-[a-z]*")));
+	REQUIRE(p.compiled());
+	std::vector<std::string> records;
+	for (std::size_t i = 0; i < 70; ++i) {
+		records.push_back(std::to_string(i) + (i % 3 == 0 ? "-id" : "+x"));
+	}
+	records.push_back("");
+	records.push_back("12-");
+
+	auto bits = p.validate(records);
+	REQUIRE(bits.size() == 2);
+	for (std::size_t i = 0; i < records.size(); ++i) {
+		bool valid = (bits[i / 64] >> (i % 64)) & 1;
+		auto res = p.apply(pc::reader(std::string_view(records[i])));
+		bool expected = res.is_success()
+			&& res.success().matched() == records[i].size();
+		REQUIRE(valid == expected);
+	}
+	REQUIRE(((bits[1] >> (71 - 64)) & 1) == 1);
+}
+
+TEST_CASE("Identifiers can be interned", "[intern]") {
+	SECTION("symbol tables deduplicate strings") {
+		pc::symbol_table table;
+		std::string long_name(3000, 'x');
+		auto a = table.intern("alpha");
+		auto b = table.intern("beta");
+		auto l = table.intern(long_name);
+		for (int i = 0; i < 1000; ++i) {
+			table.intern("n" + std::to_string(i));
+		}
+
+		REQUIRE(a != b);
+		REQUIRE(table.intern(std::string("alpha")) == a);
+		REQUIRE(table.find("beta") == b);
+		REQUIRE(table.find("gamma") == pc::no_symbol);
+		REQUIRE(table.name(a) == "alpha");
+		REQUIRE(table.name(l) == long_name);
+		REQUIRE(table.name(table.find("n999")) == "n999");
+		REQUIRE(table.size() == 1003);
+	}
+
+	SECTION("concurrent symbol tables") {
+		pc::concurrent_symbol_table table;
+		auto a = table.intern("alpha");
+		REQUIRE(table.intern("alpha") == a);
+		REQUIRE(table.find("alpha") == a);
+		REQUIRE(table.name(a) == "alpha");
+		REQUIRE(table.find("beta") == pc::no_symbol);
+		REQUIRE(table.intern("beta") != a);
+		REQUIRE(table.size() == 2);
+	}
+
+	SECTION("the intern combinator returns ids") {
+		pc::symbol_table table;
+		auto ident = pc::intern(pc::regex(cppcmb_str("[a-z]+")), table);
+		auto p = pc::parser(ident & pc::one & ident);
+		auto res = p.parse(std::string_view("foo.foo"));
+
+		REQUIRE(res.is_success());
+		auto const& v = res.success().value();
+		REQUIRE(v.get<0>() == v.get<2>());
+		REQUIRE(table.name(v.get<0>()) == "foo");
+		REQUIRE(table.size() == 1);
+	}
+}
+
+TEST_CASE("Modal lexers switch rules on a mode stack", "[lexer]") {
+	enum class tok { ident, lbrace, rbrace, quote, text, interp };
+
+	// Mode 0 is code, mode 1 is the inside of a string literal
+	auto lexer = pc::modal_lexer(
+		pc::lexer_mode(
+			cppcmb_token("\"", tok::quote, pc::push_mode<1>),
+			cppcmb_token("{", tok::lbrace, pc::push_mode<0>),
+			cppcmb_token("}", tok::rbrace, pc::pop_mode),
+			cppcmb_token("if", tok::ident, pc::icase),
+			cppcmb_token("[a-zA-Z]+", tok::ident),
+			cppcmb_token(" ", pc::skip)
+		),
+		pc::lexer_mode(
+			cppcmb_token("\"", tok::quote, pc::pop_mode),
+			cppcmb_token("${", tok::interp, pc::push_mode<0>),
+			cppcmb_token("[^\"$]+", tok::text)
+		)
+	);
+
+	std::string_view src = "IF \"a {b} ${x \"y\"} c\" z";
+	std::vector<tok> types;
+	std::vector<std::string_view> contents;
+	std::size_t max_depth = 0;
+	for (auto it = lexer.begin(src); it != lexer.end(); ++it) {
+		REQUIRE(it->is_success());
+		types.push_back(it->success().value().type());
+		contents.push_back(it->success().value().content());
+		max_depth = std::max(max_depth, it.depth());
+	}
+
+	REQUIRE(lexer.mode_count() == 2);
+	REQUIRE(max_depth == 4);
+	REQUIRE(types == std::vector<tok>{
+		tok::ident, tok::quote, tok::text, tok::interp, tok::ident,
+		tok::quote, tok::text, tok::quote, tok::rbrace, tok::text,
+		tok::quote, tok::ident
+	});
+	REQUIRE(contents[2] == "a {b} ");
+	REQUIRE(contents[9] == " c");
+
+	auto unterminated = std::string_view("\"$");
+	auto it = lexer.begin(unterminated);
+	REQUIRE((++it)->is_failure());
+}
+
+TEST_CASE("Lexing services lex ranges from checkpoints", "[lexer]") {
+	enum class tok { ident, quote, text };
+
+	auto lexer = pc::modal_lexer(
+		pc::lexer_mode(
+			cppcmb_token("\"", tok::quote, pc::push_mode<1>),
+			cppcmb_token("[a-z]+", tok::ident),
+			cppcmb_token("[ \n]", pc::skip)
+		),
+		pc::lexer_mode(
+			cppcmb_token("\"", tok::quote, pc::pop_mode),
+			cppcmb_token("[^\"]+", tok::text)
+		)
+	);
+
+	std::string doc;
+	for (int i = 0; i < 100; ++i) {
+		doc += i % 10 == 0 ? "s \"multi\nline\" x\n" : "a b\n";
+	}
+
+	// Reference: lexing from the start
+	auto all_tokens = [&](std::string const& src) {
+		std::vector<std::pair<std::size_t, tok>> res;
+		for (auto it = lexer.begin(src); it != lexer.end(); ++it) {
+			res.emplace_back(it.position(), it->success().value().type());
+		}
+		return res;
+	};
+	auto in_range = [&](std::string const& src, std::size_t from,
+		std::size_t to) {
+		std::vector<std::pair<std::size_t, tok>> res;
+		for (auto [pos, t] : all_tokens(src)) {
+			auto tlen = 1;
+			if (t != tok::quote) {
+				tlen = int(src.find_first_of("\" \n", pos + 1) - pos);
+				if (t == tok::text) tlen = int(src.find('"', pos) - pos);
+			}
+			if (pos < to && pos + tlen > from) res.emplace_back(pos, t);
+		}
+		return res;
+	};
+
+	auto service = pc::lexing_service(lexer, 8);
+	auto lex = [&](std::string const& src, std::size_t from, std::size_t to) {
+		std::vector<std::pair<std::size_t, tok>> res;
+		service.lex_range(src, from, to, [&](auto const& r, std::size_t pos) {
+			REQUIRE(r.is_success());
+			res.emplace_back(pos, r.success().value().type());
+		});
+		return res;
+	};
+
+	REQUIRE(lex(doc, 10, 40) == in_range(doc, 10, 40));
+	REQUIRE(lex(doc, 300, 320) == in_range(doc, 300, 320));
+	auto saved = service.checkpoints().size();
+	REQUIRE(saved > 5);
+	REQUIRE(service.checkpoints().back().offset < 320 + 40);
+	// Inside the multi-line string
+	auto inside = doc.find("line", 200);
+	REQUIRE(lex(doc, inside, inside + 20) == in_range(doc, inside, inside + 20));
+
+	// An edit keeps the checkpoints before it
+	auto at = doc.find("a b", 150);
+	doc.insert(at, "\"open ");
+	service.edit(at);
+	REQUIRE(service.checkpoints().size() < saved);
+	REQUIRE(service.checkpoints().size() > 1);
+	REQUIRE(service.checkpoints().back().reach < at);
+	REQUIRE(lex(doc, at, doc.size()) == in_range(doc, at, doc.size()));
+}
+
+namespace {
+int ident_calls = 0;
+int type_checks = 0;
+} /* namespace */
+
+TEST_CASE("Parse state is tracked by the memorization", "[state]") {
+	auto is_lower = [](char c) { return c >= 'a' && c <= 'z'; };
+	auto count = [](char c) {
+		++ident_calls;
+		return c;
+	};
+	auto is_type = [](std::string const& types, char c) {
+		++type_checks;
+		return types.find(c) != std::string::npos;
+	};
+	auto add_type = [](std::string& types, char c) { types.push_back(c); };
+	auto tag = [](char t) { return [t](auto&&...) { return t; }; };
+
+	auto ident = pc::memo(pc::one[pc::filter(is_lower)][count]);
+	auto type_name = pc::memo(pc::state_filter<std::string>(ident, is_type));
+	auto typedef_ = match<'t'> & pc::state_action<std::string>(ident, add_type)
+		& match<';'>;
+	auto ptr_decl = type_name & match<'*'> & ident & match<';'>;
+	auto decl = type_name & ident & match<';'>;
+	auto expr = ident & ident & match<';'>;
+	auto stmt = typedef_[tag('T')] | ptr_decl[tag('P')]
+		| decl[tag('D')] | expr[tag('E')];
+	auto p = pc::parser(*stmt);
+
+	SECTION("declarations change how later statements parse") {
+		p.set_state(std::string());
+		auto res = p.parse(std::string_view("ab;tb;bc;b*c;"));
+
+		REQUIRE(res.is_success());
+		auto const& tags = res.success().value();
+		REQUIRE(tags == std::vector<char>{ 'E', 'T', 'D', 'P' });
+		REQUIRE(p.state<std::string>() == "b");
+
+		// Every parse starts from the initial state
+		res = p.parse(std::string_view("bc;"));
+		REQUIRE(res.success().value() == std::vector<char>{ 'E' });
+	}
+
+	SECTION("results are only reused in the same state") {
+		std::string_view src = "ab;";
+		p.set_state(std::string());
+		ident_calls = 0;
+		type_checks = 0;
+		REQUIRE(p.parse(src).success().value() == std::vector<char>{ 'E' });
+		// The second declaration alternative reuses the type check
+		REQUIRE(type_checks == 1);
+		REQUIRE(ident_calls == 2);
+
+		p.set_state(std::string("a"));
+		auto res = p.reparse(src, src.size(), 0, 0);
+		REQUIRE(res.success().value() == std::vector<char>{ 'D' });
+		REQUIRE(type_checks == 2);
+		// Results that don't depend on the state are still reused
+		REQUIRE(ident_calls == 2);
+	}
+}
+
+TEST_CASE("State changes of failed branches are undone", "[state]") {
+	auto is_lower = [](char c) { return c >= 'a' && c <= 'z'; };
+	auto add = [](std::string& names, char c) { names.push_back(c); };
+
+	auto ident = pc::one[pc::filter(is_lower)];
+	auto decl = pc::state_action<std::string>(ident, add) & match<';'>;
+
+	auto names_after = [](auto const& q, std::string_view src) {
+		auto p = pc::parser(q);
+		p.set_state(std::string());
+		REQUIRE(p.parse(src).is_success());
+		return p.template state<std::string>();
+	};
+
+	SECTION("alternatives") {
+		REQUIRE(names_after(*(decl | ident & match<'.'>), "a;b.c;") == "ac");
+		// A committed optional inside a failed alternative
+		REQUIRE(names_after((-decl & match<'!'>) | pc::one, "a;?") == "");
+	}
+
+	SECTION("optionals and repetitions") {
+		REQUIRE(names_after(-decl & ident & match<'.'>, "b.") == "");
+		REQUIRE(names_after(*decl & ident, "a;b;c") == "ab");
+		REQUIRE(names_after(pc::repeat<0, 4>(decl) & ident, "a;b") == "a");
+	}
+
+	SECTION("eager alternatives") {
+		REQUIRE(names_after(decl || ident & match<';'> & ident, "a;b") == "");
+		REQUIRE(names_after(decl || ident, "a;") == "a");
+	}
+}
+
+namespace {
+
+int lr_digit_calls = 0;
+
+auto lr_add = [](int l, char, int r) { return l + r; };
+auto lr_to_int = [](char c) {
+	++lr_digit_calls;
+	return int(c - '0');
+};
+
+} /* namespace */
+
+cppcmb_decl(lr_sum, int);
+cppcmb_decl(lr_term, int);
+cppcmb_decl(lr_digit, int);
+
+// lr_sum and lr_term are indirectly left-recursive, lr_digit isn't
+cppcmb_def(lr_sum) = pc::pass
+	| (lr_term & match<'+'> & lr_digit) [lr_add]
+	| lr_digit
+	%= pc::as_memo_i;
+
+cppcmb_def(lr_term) = lr_sum %= pc::as_memo_i;
+
+cppcmb_def(lr_digit) =
+	pc::one[pc::filter(is_char<'1'>)][lr_to_int] %= pc::as_memo_i;
+
+template <typename R>
+using lr_body_t = pc::detail::rule_body_t<typename R::tag_type>;
+
+TEST_CASE("Left-recursion cycles are found at compile time", "[irec]") {
+	static_assert(pc::detail::in_left_cycle_v<lr_body_t<decltype(lr_sum)>>);
+	static_assert(pc::detail::in_left_cycle_v<lr_body_t<decltype(lr_term)>>);
+	static_assert(
+		!pc::detail::in_left_cycle_v<lr_body_t<decltype(lr_digit)>>
+	);
+
+	auto p = pc::parser(lr_sum);
+	lr_digit_calls = 0;
+	auto res = p.parse(std::string_view("1+1+1"));
+
+	REQUIRE(res.is_success());
+	REQUIRE(res.success().matched() == 5);
+	REQUIRE(res.success().value() == 3);
+	// The rules outside of the cycle are still memorized
+	REQUIRE(lr_digit_calls == 3);
+}
+
+TEST_CASE("Grown left-recursive results are invalidated by edits", "[irec]") {
+	auto p = pc::parser(lr_sum);
+	REQUIRE(p.parse(std::string_view("1+1+1+1")).success().value() == 4);
+
+	// The re-evaluated entries of the cycle looked at the whole sum
+	std::string_view src = "1+2+1+1+1";
+	auto res = p.reparse(src, 1, 0, 2);
+
+	REQUIRE(res.is_success());
+	REQUIRE(res.success().matched() == 1);
+	REQUIRE(res.success().value() == 1);
+}
+
+TEST_CASE("Rules can be applied at an offset", "[parser]") {
+	std::string_view src = "1+1+1";
+	auto p = pc::parser(lr_sum);
+	REQUIRE(p.parse(src).success().value() == 3);
+
+	SECTION("memorized results are reused") {
+		lr_digit_calls = 0;
+		auto res = p.parse_at(lr_digit, src, 4);
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().matched() == 1);
+		REQUIRE(lr_digit_calls == 0);
+
+		REQUIRE(p.parse_at(lr_sum, src, 2).success().matched() == 3);
+		REQUIRE(lr_digit_calls == 0);
+	}
+
+	SECTION("the source can be bounded") {
+		auto res = p.parse_at(lr_sum, src, 0, 3);
+		REQUIRE(res.success().matched() == 3);
+		REQUIRE(res.success().value() == 2);
+
+		// The bounded results aren't seen by unbounded parses
+		REQUIRE(p.parse_at(lr_sum, src, 0).success().value() == 3);
+	}
+}
+
+namespace {
+int block_calls = 0;
+} /* namespace */
+
+TEST_CASE("Edits can be re-parsed in the enclosing block", "[parser]") {
+	auto count = [](char c) {
+		++block_calls;
+		return c;
+	};
+	auto block = pc::memo(match<'('> & *match<'a'>[count] & match<')'>);
+	using block_result_t =
+		pc::parser_result_t<decltype(block), std::string_view>;
+	auto p = pc::parser(*block);
+	REQUIRE(p.parse(std::string_view("(aa)(aaa)(a)")).is_success());
+
+	SECTION("the block is re-parsed in place") {
+		std::string_view src = "(aa)(aaaa)(a)";
+		block_calls = 0;
+		auto res = p.reparse_block(src, 6, 0, 1);
+
+		REQUIRE(res.has_value());
+		REQUIRE(res->offset == 4);
+		REQUIRE(res->length == 6);
+		auto const& r = std::any_cast<block_result_t const&>(res->result);
+		REQUIRE(r.success().value().get<1>().size() == 4);
+		REQUIRE(block_calls == 4);
+
+		// The rest of the memo table is still usable
+		block_calls = 0;
+		REQUIRE(p.reparse(src, 0, 0, 0).success().value().size() == 3);
+		REQUIRE(block_calls == 2);
+	}
+
+	SECTION("an edit that moves the block boundary escalates") {
+		std::string_view src = "(aa)(aaa(a)";
+		REQUIRE(!p.reparse_block(src, 8, 1, 0).has_value());
+	}
+}
+
+TEST_CASE("Blocks under memorized parents are re-parsed in place",
+	"[parser]") {
+
+	auto count = [](char c) {
+		++block_calls;
+		return c;
+	};
+	auto a = pc::memo(match<'a'>[count]);
+	auto as = pc::memo(*a);
+	auto block = pc::memo(match<'('> & as & match<')'>);
+	auto top = pc::memo(*block);
+	auto p = pc::parser(top);
+	REQUIRE(p.parse(std::string_view("(aa)(aaa)(a)")).is_success());
+
+	SECTION("the parents are re-derived from the new block") {
+		std::string_view src = "(aa)(aaaa)(a)";
+		block_calls = 0;
+		auto res = p.reparse_block(src, 6, 0, 1);
+
+		// The run of a's grows by the insertion, the letters around the
+		// insertion are tried first, but they can't grow
+		REQUIRE(res.has_value());
+		REQUIRE(res->offset == 5);
+		REQUIRE(res->length == 4);
+		REQUIRE(block_calls == 5);
+
+		// The top rule was re-derived with the new block
+		block_calls = 0;
+		auto const& all = p.parse_at(top, src, 0);
+		REQUIRE(block_calls == 0);
+		REQUIRE(all.success().matched() == 13);
+		REQUIRE(all.success().value().size() == 3);
+		REQUIRE(all.success().value()[1].get<1>().size() == 4);
+	}
+
+	SECTION("an edit that keeps every length re-parses the letter") {
+		std::string_view src = "(aa)(aaa)(a)";
+		block_calls = 0;
+		auto res = p.reparse_block(src, 6, 1, 1);
+
+		REQUIRE(res.has_value());
+		REQUIRE(res->offset == 6);
+		REQUIRE(res->length == 1);
+		// The neighbours looked at the edited letter too
+		REQUIRE(block_calls == 3);
+	}
+
+	SECTION("an edit that moves the block boundary escalates") {
+		std::string_view src = "(aa)(aaa(a)";
+		REQUIRE(!p.reparse_block(src, 8, 1, 0).has_value());
+	}
+}
+
+namespace {
+bool is_lower(char c) { return c >= 'a' && c <= 'z'; }
+bool is_not_nl(char c) { return c != '\n'; }
+} /* namespace */
+
+TEST_CASE("Edits that change a decision outside the block escalate",
+	"[parser]") {
+
+	auto lower = pc::one[pc::filter(is_lower)];
+	auto not_nl = pc::one[pc::filter(is_not_nl)];
+	auto tag1 = [](std::vector<char> const&, char) { return 1; };
+	auto tag2 = [](std::vector<char> const&) { return 2; };
+	auto top =
+		  (pc::memo(+lower) & match<'!'>)[tag1]
+		| pc::memo(+not_nl)[tag2];
+	auto p = pc::parser(top);
+	REQUIRE(p.parse(std::string_view("abc?")).success().value() == 2);
+
+	// The first alternative looked at the '?' too, now it succeeds
+	std::string_view src = "abc!";
+	REQUIRE(!p.reparse_block(src, 3, 1, 1).has_value());
+	REQUIRE(p.reparse(src, 0, 0, 0).success().value() == 1);
+}
+
+TEST_CASE("Edits are detected from full texts", "[parser]") {
+	SECTION("the changed region is found") {
+		std::string a(100, 'x');
+		std::string b = a;
+		b.replace(40, 3, "yyyyy");
+		auto e = pc::detect_edit(a, b);
+		REQUIRE(e.start == 40);
+		REQUIRE(e.rem == 3);
+		REQUIRE(e.ins == 5);
+
+		// Repeated text is not counted twice
+		e = pc::detect_edit(std::string_view("aa"), std::string_view("aaa"));
+		REQUIRE(e.start == 2);
+		REQUIRE(e.rem == 0);
+		REQUIRE(e.ins == 1);
+
+		e = pc::detect_edit(a, a);
+		REQUIRE(e.start == 100);
+		REQUIRE(e.rem + e.ins == 0);
+	}
+
+	SECTION("reparse_from reuses the unchanged results") {
+		auto count = [](char c) {
+			++block_calls;
+			return c;
+		};
+		auto block = pc::memo(match<'('> & *match<'a'>[count] & match<')'>);
+		auto p = pc::parser(*block);
+		std::string_view old_src = "(aa)(aaa)(a)";
+		std::string_view new_src = "(aa)(aaaa)(a)";
+		REQUIRE(p.parse(old_src).is_success());
+
+		block_calls = 0;
+		auto res = p.reparse_from(old_src, new_src);
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().matched() == new_src.size());
+		REQUIRE(block_calls == 4);
+	}
+}
+
+namespace {
+int term_calls = 0;
+} /* namespace */
+
+TEST_CASE("Token streams are relexed around edits", "[lexer]") {
+	enum class tk { ident, comma };
+
+	auto lexer = pc::modal_lexer(pc::lexer_mode(
+		cppcmb_token("[a-z]+", tk::ident),
+		cppcmb_token(",", tk::comma),
+		cppcmb_token(" ", pc::skip)
+	));
+	std::string_view src = "ab , cd , ef";
+	auto stream = pc::token_stream(lexer, src);
+	REQUIRE(stream.size() == 5);
+
+	SECTION("an edit inside a token only replaces that token") {
+		std::string_view edited = "ab , cx , ef";
+		auto d = stream.relex(edited, pc::text_edit{ 6, 1, 1 });
+
+		REQUIRE(d.start == 2);
+		REQUIRE(d.rem == 1);
+		REQUIRE(d.ins == 1);
+		REQUIRE(stream.tokens()[2].content() == "cx");
+		auto const* last = stream.tokens()[4].content().data();
+		REQUIRE(last - edited.data() == 10);
+	}
+
+	SECTION("a token can be split") {
+		std::string_view edited = "ab , c d , ef";
+		auto d = stream.relex(edited, pc::text_edit{ 6, 0, 1 });
+
+		REQUIRE(d.start == 2);
+		REQUIRE(d.rem == 1);
+		REQUIRE(d.ins == 2);
+		REQUIRE(stream.size() == 6);
+		REQUIRE(stream.offset(5) == 11);
+	}
+
+	SECTION("edits anywhere keep the stream in sync") {
+		auto text = std::string(src);
+		auto stacks = stream.mode_stack_count();
+		auto edit = [&](std::size_t at, std::size_t rem, std::string_view ins) {
+			text.replace(at, rem, ins);
+			stream.relex(text, pc::text_edit{ at, rem, ins.size() });
+			auto fresh = pc::token_stream(lexer, std::string_view(text));
+			REQUIRE(stream.size() == fresh.size());
+			for (std::size_t i = 0; i < fresh.size(); ++i) {
+				auto t = stream.tokens()[i];
+				REQUIRE(stream.offset(i) == fresh.offset(i));
+				REQUIRE(t.content() == fresh.tokens()[i].content());
+				REQUIRE(t.type() == fresh.tokens()[i].type());
+			}
+		};
+		edit(0, 0, "gh , ");
+		edit(text.size(), 0, " , ij");
+		edit(5, 2, "xyz");
+		edit(0, 4, "");
+		edit(3, 0, ",");
+		edit(text.size() - 2, 2, "");
+		// Stacks seen before are not stored again
+		REQUIRE(stream.mode_stack_count() == stacks);
+	}
+
+	SECTION("only the memo entries of the changed tokens are invalidated") {
+		using tok_t = decltype(stream)::token_type;
+		auto is_ident = [](tok_t const& t) { return t.type() == tk::ident; };
+		auto is_comma = [](tok_t const& t) { return t.type() == tk::comma; };
+		auto count = [](tok_t const& t) {
+			++term_calls;
+			return t;
+		};
+		auto term = pc::memo(pc::one[pc::filter(is_ident)][count]);
+		auto p = pc::parser(term & *(pc::one[pc::filter(is_comma)] & term));
+		REQUIRE(p.parse(stream.tokens()).is_success());
+
+		std::string_view edited = "ab , cx , ef";
+		auto d = stream.relex(edited, pc::text_edit{ 6, 1, 1 });
+		term_calls = 0;
+		auto res = p.reparse(stream.tokens(), d);
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().matched() == 5);
+		REQUIRE(term_calls == 1);
+	}
+}
+
+TEST_CASE("Equal values can be hash-consed", "[hash_cons]") {
+	SECTION("pools share equal values") {
+		pc::hash_cons_pool<std::string> pool;
+		auto a = pool.intern(std::string("alpha"));
+		auto b = pool.intern(std::string("beta"));
+		for (int i = 0; i < 1000; ++i) {
+			pool.intern(std::to_string(i));
+		}
+
+		REQUIRE(a != b);
+		REQUIRE(pool.intern(std::string("alpha")) == a);
+		REQUIRE(*b == "beta");
+		REQUIRE(pool.size() == 1002);
+
+		pool.clear();
+		REQUIRE(pool.size() == 0);
+		// Values that are still referenced survive
+		REQUIRE(*a == "alpha");
+	}
+
+	SECTION("the hash_cons combinator shares the parsed values") {
+		auto to_string = [](std::vector<char> const& cs) {
+			return std::string(cs.begin(), cs.end());
+		};
+		pc::hash_cons_pool<std::string> pool;
+		auto group = match<'('> & (+match<'a'>)[to_string] & match<')'>;
+		auto p = pc::parser(*pc::hash_cons(group[pc::select<1>], pool));
+		auto res = p.parse(std::string_view("(aa)(a)(aa)(aa)"));
+
+		REQUIRE(res.is_success());
+		auto const& v = res.success().value();
+		REQUIRE(v.size() == 4);
+		REQUIRE(v[0] == v[2]);
+		REQUIRE(v[0] == v[3]);
+		REQUIRE(v[0] != v[1]);
+		REQUIRE(*v[1] == "a");
+		REQUIRE(pool.size() == 2);
+	}
+}
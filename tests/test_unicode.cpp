@@ -0,0 +1,91 @@
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "catch.hpp"
+#include "../cppcmb.hpp"
+
+namespace pc = cppcmb;
+
+TEST_CASE("Unicode classes decode a single code point", "[unicode]") {
+	SECTION("ASCII letter") {
+		std::string_view src = "ab";
+		auto res = pc::xid_start.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().matched() == 1);
+		REQUIRE(res.success().value() == U'a');
+	}
+
+	SECTION("multi-byte letter") {
+		std::string_view src = "\xC3\xA9t\xC3\xA9";
+		auto res = pc::xid_start.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().matched() == 2);
+		REQUIRE(res.success().value() == U'é');
+	}
+
+	SECTION("digits are not identifier starts") {
+		std::string_view src = "1a";
+
+		REQUIRE(pc::xid_start.apply(pc::reader(src)).is_failure());
+		REQUIRE(pc::xid_continue.apply(pc::reader(src)).is_success());
+		REQUIRE(pc::unicode_digit.apply(pc::reader(src)).is_success());
+	}
+
+	SECTION("malformed input fails") {
+		std::string_view src = "\xC3(";
+		auto res = pc::unicode_letter.apply(pc::reader(src));
+
+		REQUIRE(res.is_failure());
+		REQUIRE(res.furthest() == 2);
+	}
+}
+
+TEST_CASE("'xid_identifier' matches whole identifiers", "[unicode]") {
+	SECTION("long ASCII identifier") {
+		std::string_view src = "some_long_identifier_name1 = 3";
+		auto res = pc::xid_identifier.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().value() == "some_long_identifier_name1");
+		REQUIRE(res.furthest() == 27);
+	}
+
+	SECTION("mixed identifier") {
+		std::string_view src = "caf\xC3\xA9_\xCE\xBB\xCE\xBBx+";
+		auto res = pc::xid_identifier.apply(pc::reader(src));
+
+		REQUIRE(res.is_success());
+		REQUIRE(res.success().matched() == src.size() - 1);
+	}
+
+	SECTION("ASCII runs end at any byte of a word") {
+		for (std::size_t n = 1; n < 24; ++n) {
+			auto text = std::string(n, 'a') + "- b_9 c0";
+			if (n > 1) {
+				text[n / 2] = n % 2 == 0 ? '_' : '7';
+			}
+			auto src = std::string_view(text);
+			auto res = pc::xid_identifier.apply(pc::reader(src));
+
+			REQUIRE(res.is_success());
+			REQUIRE(res.success().matched() == n);
+			REQUIRE(res.furthest() == n + 1);
+		}
+	}
+
+	SECTION("ASCII properties are tested as ranges") {
+		auto const& ranges = pc::detail::ascii_ranges_v<
+			pc::detail::xid_continue_table
+		>;
+		REQUIRE(ranges.fits);
+		// Digits, upper-case letters, the underscore and lower-case letters
+		REQUIRE(ranges.count == 4);
+	}
+
+	SECTION("must not start with a digit") {
+		std::string_view src = "1abc";
+		REQUIRE(pc::xid_identifier.apply(pc::reader(src)).is_failure());
+	}
+}